@@ -0,0 +1,161 @@
+/**
+ * @file AsyncQueue.hpp
+ * @brief Header file for awaitable queue
+ *
+ * Provides a queue that any thread may push to and a coroutine on an event
+ * loop may await, the consumer is woken through an eventfd only when idle
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <deque>             ///< For std::deque container
+#include <mutex>             ///< For std::mutex and std::lock_guard
+#include <optional>          ///< For std::optional
+#include <atomic>            ///< For std::atomic
+#include <cstdint>           ///< For fixed width integer types
+#include <cstdlib>           ///< For exit
+#include <iostream>          ///< For std::cerr
+#include <sys/eventfd.h>     ///< For eventfd
+#include <unistd.h>          ///< For read, write and close
+#include "EventLoop.hpp"
+#include "Task.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @class AsyncQueue
+ * @brief Multi producer, single consumer queue with an awaitable pop
+ */
+template <typename T>
+class AsyncQueue
+{
+    public:
+        /**
+         * @brief Constructor to create the wake-up eventfd
+         */
+        AsyncQueue()
+        {
+            m_eventFileDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if(-1 == m_eventFileDescriptor)
+            {
+                std::cerr << "An error occurred while creating the queue event\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        AsyncQueue(const AsyncQueue&) = delete;             ///< Delete copy constructor
+        AsyncQueue& operator=(const AsyncQueue&) = delete;  ///< Delete copy assignment operator
+        AsyncQueue(AsyncQueue&&) = delete;                  ///< Delete move constructor
+        AsyncQueue& operator=(AsyncQueue&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Destroy the AsyncQueue object
+         */
+        ~AsyncQueue()
+        {
+            close(m_eventFileDescriptor);
+        }
+        /**
+         * @brief Add an item, safe to call from any thread
+         */
+        void push(T item)
+        {
+            bool IsWakeNeeded = false;
+            {
+                std::lock_guard<std::mutex> lock(m_queueMutex);
+                m_items.push_back(std::move(item));
+                updateDepth();
+                IsWakeNeeded = std::exchange(m_isConsumerWaiting, false);
+            }
+            if(IsWakeNeeded)
+            {
+                uint64_t Value = 1;
+                ssize_t NumberOfWrittenBytes = write(m_eventFileDescriptor, &Value, sizeof(Value));
+                (void)NumberOfWrittenBytes;
+            }
+        }
+        /**
+         * @brief Remove the next item without waiting
+         * @return The next item, empty if the queue is empty
+         */
+        std::optional<T> tryPop()
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            if(m_items.empty())
+            {
+                return std::nullopt;
+            }
+            T Item = std::move(m_items.front());
+            m_items.pop_front();
+            updateDepth();
+            return Item;
+        }
+        /**
+         * @brief Await the next item on the consumer's loop
+         * @return The next item, empty if the loop is stopping
+         */
+        Task<std::optional<T>> pop(EventLoop& loop)
+        {
+            while(true)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_queueMutex);
+                    if(!m_items.empty())
+                    {
+                        T Item = std::move(m_items.front());
+                        m_items.pop_front();
+                        updateDepth();
+                        co_return Item;
+                    }
+                    m_isConsumerWaiting = true;
+                }
+                bool IsReadable = co_await loop.waitReadable(m_eventFileDescriptor);
+                if(!IsReadable)
+                {
+                    co_return std::nullopt;
+                }
+                uint64_t Value;
+                ssize_t NumberOfReadBytes = read(m_eventFileDescriptor, &Value, sizeof(Value));
+                (void)NumberOfReadBytes;
+            }
+        }
+        /**
+         * @brief Get the number of queued items, never blocks
+         */
+        size_t size() const
+        {
+            return m_depth.load(std::memory_order_relaxed);
+        }
+        /**
+         * @brief Get the largest number of items ever queued, never blocks
+         */
+        size_t getHighWaterMark() const
+        {
+            return m_highWaterMark.load(std::memory_order_relaxed);
+        }
+    private:
+        std::deque<T> m_items{};                 ///< Queued items
+        std::atomic<size_t> m_depth{0};          ///< Mirror of the item count for lock-free readers
+        std::atomic<size_t> m_highWaterMark{0};  ///< Largest item count
+        bool m_isConsumerWaiting{false};         ///< Consumer is suspended and needs a wake-up
+        int m_eventFileDescriptor{-1};           ///< Wakes the consumer
+        mutable std::mutex m_queueMutex;         ///< Protects the items
+        /**
+         * @brief helper function to publish the item count, called with the mutex held
+         */
+        void updateDepth()
+        {
+            m_depth.store(m_items.size(), std::memory_order_relaxed);
+            if(m_items.size() > m_highWaterMark.load(std::memory_order_relaxed))
+            {
+                m_highWaterMark.store(m_items.size(), std::memory_order_relaxed);
+            }
+        }
+};
+} // namespace App
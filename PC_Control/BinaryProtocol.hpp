@@ -0,0 +1,87 @@
+/**
+ * @file BinaryProtocol.hpp
+ * @brief Header file for the binary command framing
+ *
+ * Defines the compact framing a client negotiates with the "protocol binary"
+ * text command. Every frame starts with a fixed header in network byte
+ * order: command ID, flags, request ID and payload length. Command IDs come
+ * from the PCControl registry and are sent to the client in the handshake
+ * reply, so the server dispatches a binary request by array index instead of
+ * trimming, lowercasing and hashing its text. A response is sent once the
+ * handler ran, so it arrives in completion order, not request order; it
+ * carries the request ID of the client, which matches it to its request,
+ * and the handler result as payload.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <arpa/inet.h>           ///< For htons, htonl, ntohs and ntohl
+#include <cstddef>               ///< For size_t
+#include <cstdint>               ///< For fixed width integer types
+#include <cstring>               ///< For memcpy
+#include <string>                ///< For std::string class operations
+
+constexpr char BINARY_HANDSHAKE_COMMAND[]{"protocol binary"};  ///< Text command switching a connection to binary frames
+constexpr size_t BINARY_HEADER_SIZE{12};                       ///< Bytes of a frame header
+constexpr uint32_t BINARY_MAX_PAYLOAD{4096};                   ///< Largest payload accepted from a client
+constexpr uint16_t BINARY_FLAG_RESPONSE{0x0001};               ///< Frame sent by the server
+constexpr uint16_t BINARY_FLAG_ERROR{0x0002};                  ///< The request was refused, e.g. unknown command ID, or its handler failed
+constexpr uint16_t BINARY_FLAG_HANDSHAKE{0x0004};              ///< Payload is the command table, one "<id> <command>" line per command
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @brief Decoded header of a binary frame
+ */
+struct BinaryFrameHeader
+{
+    uint16_t commandID{};        ///< Registry ID of the command, 0 in the handshake reply
+    uint16_t flags{};            ///< BINARY_FLAG_* bits, 0 for a request
+    uint32_t requestID{};        ///< Chosen by the client, echoed in the response
+    uint32_t payloadLength{};    ///< Bytes following the header, the result text in a response
+};
+
+/**
+ * @brief helper function to decode a frame header from the start of a buffer
+ * @param data At least BINARY_HEADER_SIZE bytes
+ */
+inline BinaryFrameHeader decodeBinaryHeader(const char* data)
+{
+    uint16_t CommandID = 0;
+    uint16_t Flags = 0;
+    uint32_t RequestID = 0;
+    uint32_t PayloadLength = 0;
+    std::memcpy(&CommandID, data, sizeof(CommandID));
+    std::memcpy(&Flags, data + 2, sizeof(Flags));
+    std::memcpy(&RequestID, data + 4, sizeof(RequestID));
+    std::memcpy(&PayloadLength, data + 8, sizeof(PayloadLength));
+    return BinaryFrameHeader{ntohs(CommandID), ntohs(Flags), ntohl(RequestID), ntohl(PayloadLength)};
+}
+
+/**
+ * @brief helper function to append an encoded frame to an output buffer
+ */
+inline void appendBinaryFrame(std::string& output, const BinaryFrameHeader& header, const char* payload = nullptr, size_t payloadLength = 0)
+{
+    uint16_t CommandID = htons(header.commandID);
+    uint16_t Flags = htons(header.flags);
+    uint32_t RequestID = htonl(header.requestID);
+    uint32_t PayloadLength = htonl(static_cast<uint32_t>(payloadLength));
+    output.append(reinterpret_cast<const char*>(&CommandID), sizeof(CommandID));
+    output.append(reinterpret_cast<const char*>(&Flags), sizeof(Flags));
+    output.append(reinterpret_cast<const char*>(&RequestID), sizeof(RequestID));
+    output.append(reinterpret_cast<const char*>(&PayloadLength), sizeof(PayloadLength));
+    if(payloadLength > 0)
+    {
+        output.append(payload, payloadLength);
+    }
+}
+} // namespace App
@@ -0,0 +1,187 @@
+/**
+ * @file EventChannel.cpp
+ * @brief Source file for asynchronous diagnostic event channel
+ *
+ * Provides a leveled, rate-limited channel that diagnostic messages are
+ * published to instead of writing to the terminal, a writer thread prints
+ * them in batches so the request path does no synchronous terminal I/O
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <algorithm>         ///< For std::min
+#include <iostream>          ///< For std::cout and std::cerr
+#include <utility>           ///< For std::exchange
+#include "EventChannel.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+std::atomic<uint8_t> EventChannel::s_minimumLevel{static_cast<uint8_t>(Logger::Levels::DEBUG)};
+std::atomic<uint64_t> EventChannel::s_droppedCount{0};
+std::mutex EventChannel::s_channelMutex;
+std::condition_variable EventChannel::s_writerCondition;
+std::vector<EventChannel::Event> EventChannel::s_events;
+size_t EventChannel::s_capacity{EVENT_CHANNEL_CAPACITY};
+double EventChannel::s_tokens{EVENT_CHANNEL_BURST};
+std::chrono::steady_clock::time_point EventChannel::s_lastRefill{std::chrono::steady_clock::now()};
+uint64_t EventChannel::s_unreportedDropCount{0};
+bool EventChannel::s_isRunning{false};
+std::thread EventChannel::s_writerThread;
+std::function<void(Logger::Levels, const std::string&)> EventChannel::s_subscriber;
+
+/**
+ * @brief Start the writer thread, events are written synchronously until then
+ */
+void EventChannel::start()
+{
+    std::lock_guard<std::mutex> lock(s_channelMutex);
+    if(s_isRunning)
+    {
+        return;
+    }
+    s_isRunning = true;
+    s_writerThread = std::thread(&EventChannel::writeEvents);
+}
+/**
+ * @brief Write the pending events and stop the writer thread
+ */
+void EventChannel::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(s_channelMutex);
+        if(!s_isRunning)
+        {
+            return;
+        }
+        s_isRunning = false;
+    }
+    s_writerCondition.notify_one();
+    s_writerThread.join();
+}
+/**
+ * @brief Select the minimum level from a profile
+ */
+void EventChannel::setProfile(EventProfile profile)
+{
+    setLevel((EventProfile::PRODUCTION == profile) ? Logger::Levels::WARNING : Logger::Levels::DEBUG);
+}
+/**
+ * @brief Set the minimum level of published events
+ */
+void EventChannel::setLevel(Logger::Levels level)
+{
+    s_minimumLevel.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+/**
+ * @brief Set the events waiting for the writer before newer events are dropped
+ */
+void EventChannel::setCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(s_channelMutex);
+    s_capacity = capacity;
+}
+/**
+ * @brief Forward every written event, e.g. to subscribed clients
+ *
+ * Called from the thread writing the events, set before any other thread publishes
+ *
+ * @param subscriber Receives the level and text of each event, empty to stop forwarding
+ */
+void EventChannel::setSubscriber(std::function<void(Logger::Levels, const std::string&)> subscriber)
+{
+    s_subscriber = std::move(subscriber);
+}
+/**
+ * @brief Queue an event for the writer, dropped if over the rate limit or capacity
+ * @param level Event level, errors are written to stderr
+ * @param message Event text without a trailing newline
+ */
+void EventChannel::publish(Logger::Levels level, std::string message)
+{
+    std::unique_lock<std::mutex> lock(s_channelMutex);
+    if(!s_isRunning)
+    {
+        // No writer yet or any more, e.g. during start-up and shutdown
+        lock.unlock();
+        writeBatch({Event{level, std::move(message)}}, 0);
+        return;
+    }
+    // Token bucket: refill for the elapsed time, spend one token per event
+    auto Now = std::chrono::steady_clock::now();
+    double ElapsedSeconds = std::chrono::duration<double>(Now - s_lastRefill).count();
+    s_tokens = std::min<double>(EVENT_CHANNEL_BURST, s_tokens + (ElapsedSeconds * EVENT_CHANNEL_RATE_PER_SECOND));
+    s_lastRefill = Now;
+    if((s_tokens < 1.0) || (s_events.size() >= s_capacity))
+    {
+        s_unreportedDropCount++;
+        s_droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    s_tokens -= 1.0;
+    s_events.push_back(Event{level, std::move(message)});
+    // The writer wakes up on its own within the flush interval, only hurry it when filling up
+    if(s_events.size() == (s_capacity / 2))
+    {
+        lock.unlock();
+        s_writerCondition.notify_one();
+    }
+}
+/**
+ * @brief Writer loop printing the events in batches
+ */
+void EventChannel::writeEvents()
+{
+    std::vector<Event> Batch;
+    bool IsRunning = true;
+    while(IsRunning)
+    {
+        uint64_t DropCount = 0;
+        {
+            std::unique_lock<std::mutex> lock(s_channelMutex);
+            s_writerCondition.wait_for(lock, std::chrono::milliseconds(EVENT_CHANNEL_FLUSH_MS),
+                                       []() { return !s_isRunning || (s_events.size() >= (s_capacity / 2)); });
+            Batch.swap(s_events);
+            DropCount = std::exchange(s_unreportedDropCount, 0);
+            IsRunning = s_isRunning;
+        }
+        writeBatch(Batch, DropCount);
+        Batch.clear();
+    }
+}
+/**
+ * @brief helper function to write a batch of events to stdout and stderr
+ */
+void EventChannel::writeBatch(const std::vector<Event>& events, uint64_t dropCount)
+{
+    std::string OutputText;
+    std::string ErrorText;
+    for(const auto& PendingEvent : events)
+    {
+        std::string& Text = (PendingEvent.level >= Logger::Levels::ERROR) ? ErrorText : OutputText;
+        Text += PendingEvent.message;
+        Text += '\n';
+        if(s_subscriber)
+        {
+            s_subscriber(PendingEvent.level, PendingEvent.message);
+        }
+    }
+    if(dropCount > 0)
+    {
+        ErrorText += "[event channel] " + std::to_string(dropCount) + " events dropped\n";
+    }
+    // One write per stream and batch
+    if(!OutputText.empty())
+    {
+        std::cout << OutputText << std::flush;
+    }
+    if(!ErrorText.empty())
+    {
+        std::cerr << ErrorText;
+    }
+}
+} // namespace App
@@ -0,0 +1,141 @@
+/**
+ * @file EventChannel.hpp
+ * @brief Header file for asynchronous diagnostic event channel
+ *
+ * Provides a leveled, rate-limited channel that diagnostic messages are
+ * published to instead of writing to the terminal, a writer thread prints
+ * them in batches so the request path does no synchronous terminal I/O
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <atomic>                ///< For std::atomic
+#include <chrono>                ///< For std::chrono::steady_clock
+#include <condition_variable>    ///< For std::condition_variable
+#include <cstdint>               ///< For fixed width integer types
+#include <functional>            ///< For std::function
+#include <mutex>                 ///< For std::mutex
+#include <sstream>               ///< For std::ostringstream used by the publishing macros
+#include <string>                ///< For std::string class operations
+#include <thread>                ///< For std::thread
+#include <vector>                ///< For std::vector
+#include "Logger.hpp"
+
+constexpr size_t EVENT_CHANNEL_CAPACITY{4096};            ///< Events waiting for the writer, newer events are dropped
+constexpr uint32_t EVENT_CHANNEL_RATE_PER_SECOND{2000};   ///< Sustained events per second
+constexpr uint32_t EVENT_CHANNEL_BURST{500};              ///< Events accepted at once above the sustained rate
+constexpr uint32_t EVENT_CHANNEL_FLUSH_MS{50};            ///< Longest time an event waits for the writer
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @brief enum class EventProfile represents the output profiles of the channel
+ */
+enum class EventProfile : uint8_t
+{
+    VERBOSE    = UINT8_C(0),   ///< Every event including per request chatter
+    PRODUCTION = UINT8_C(1)    ///< Quiet, warnings and errors only
+};
+
+/**
+ * @class EventChannel
+ * @brief Process wide diagnostic channel drained by a writer thread
+ */
+class EventChannel
+{
+    public:
+        /**
+         * @brief Start the writer thread, events are written synchronously until then
+         */
+        static void start();
+        /**
+         * @brief Write the pending events and stop the writer thread
+         */
+        static void stop();
+        /**
+         * @brief Select the minimum level from a profile
+         */
+        static void setProfile(EventProfile profile);
+        /**
+         * @brief Set the minimum level of published events
+         */
+        static void setLevel(Logger::Levels level);
+        /**
+         * @brief Set the events waiting for the writer before newer events are dropped
+         */
+        static void setCapacity(size_t capacity);
+        /**
+         * @brief Check if events of a level are published, lets callers skip formatting
+         */
+        static bool isEnabled(Logger::Levels level)
+        {
+            return static_cast<uint8_t>(level) >= s_minimumLevel.load(std::memory_order_relaxed);
+        }
+        /**
+         * @brief Queue an event for the writer, dropped if over the rate limit or capacity
+         * @param level Event level, errors are written to stderr
+         * @param message Event text without a trailing newline
+         */
+        static void publish(Logger::Levels level, std::string message);
+        /**
+         * @brief Forward every written event, e.g. to subscribed clients
+         *
+         * Called from the thread writing the events, set before any other thread publishes
+         *
+         * @param subscriber Receives the level and text of each event, empty to stop forwarding
+         */
+        static void setSubscriber(std::function<void(Logger::Levels, const std::string&)> subscriber);
+        /**
+         * @brief Get the number of events dropped by the rate limit or capacity
+         */
+        static uint64_t getDroppedCount()
+        {
+            return s_droppedCount.load(std::memory_order_relaxed);
+        }
+    private:
+        /**
+         * @brief A queued event
+         */
+        struct Event
+        {
+            Logger::Levels level;       ///< Event level
+            std::string message;        ///< Event text
+        };
+        static std::atomic<uint8_t> s_minimumLevel;         ///< Events below this level are not published
+        static std::atomic<uint64_t> s_droppedCount;        ///< Events dropped since start
+        static std::mutex s_channelMutex;                   ///< Protects the queue and the rate limiter
+        static std::condition_variable s_writerCondition;   ///< Wakes the writer
+        static std::vector<Event> s_events;                 ///< Events waiting for the writer
+        static size_t s_capacity;                           ///< Events waiting for the writer before newer events are dropped
+        static double s_tokens;                             ///< Rate limiter tokens
+        static std::chrono::steady_clock::time_point s_lastRefill;  ///< Last rate limiter refill
+        static uint64_t s_unreportedDropCount;              ///< Drops not yet reported by the writer
+        static bool s_isRunning;                            ///< Writer thread is running
+        static std::thread s_writerThread;                  ///< Writes the events
+        static std::function<void(Logger::Levels, const std::string&)> s_subscriber;  ///< Receives every written event
+        /**
+         * @brief Writer loop printing the events in batches
+         */
+        static void writeEvents();
+        /**
+         * @brief helper function to write a batch of events to stdout and stderr
+         */
+        static void writeBatch(const std::vector<Event>& events, uint64_t dropCount);
+};
+} // namespace App
+
+// Convenience macros, the message is a stream expression formatted only if its level is enabled
+#define EVENT_PUBLISH(level, stream) \
+    do { if(App::EventChannel::isEnabled(level)) { std::ostringstream EventStream; EventStream << stream; App::EventChannel::publish(level, EventStream.str()); } } while(0)
+#define EVENT_DEBUG(stream)    EVENT_PUBLISH(App::Logger::Levels::DEBUG, stream)
+#define EVENT_INFO(stream)     EVENT_PUBLISH(App::Logger::Levels::INFO, stream)
+#define EVENT_WARNING(stream)  EVENT_PUBLISH(App::Logger::Levels::WARNING, stream)
+#define EVENT_ERROR(stream)    EVENT_PUBLISH(App::Logger::Levels::ERROR, stream)
@@ -0,0 +1,506 @@
+/**
+ * @file EventLoop.cpp
+ * @brief Source file for coroutine event loop
+ *
+ * Provides an epoll based event loop with awaitable socket operations and
+ * timers, coroutines spawned on the loop run until the loop is stopped
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <algorithm>         ///< For std::min, std::max and std::find
+#include <iostream>          ///< For std::cerr and std::cout
+#include <vector>            ///< For std::vector
+#include <cerrno>            ///< For errno
+#include <cstdint>           ///< For fixed width integer types
+#include <cstdlib>           ///< For exit
+#include <pthread.h>         ///< For pthread_getcpuclockid and pthread_setaffinity_np
+#include <sched.h>           ///< For cpu_set_t
+#include <sys/epoll.h>       ///< For epoll
+#include <sys/eventfd.h>     ///< For eventfd
+#include <sys/socket.h>      ///< For accept4, recv, send and sendmsg
+#include <unistd.h>          ///< For read, write, close and sysconf
+#include "EventLoop.hpp"
+#include "SharedMemoryChannel.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+/**
+ * @brief Constructor to create the epoll instance
+ */
+EventLoop::EventLoop()
+{
+    m_epollFileDescriptor = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeEventFileDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if((-1 == m_epollFileDescriptor) || (-1 == m_wakeEventFileDescriptor))
+    {
+        std::cerr << "An error occurred while creating the event loop\n";
+        exit(EXIT_FAILURE);
+    }
+    struct epoll_event Event{};
+    Event.events = EPOLLIN;
+    Event.data.fd = m_wakeEventFileDescriptor;
+    epoll_ctl(m_epollFileDescriptor, EPOLL_CTL_ADD, m_wakeEventFileDescriptor, &Event);
+}
+/**
+ * @brief Start a coroutine on the loop, the loop owns it until it finishes
+ * @param task The coroutine to run
+ */
+void EventLoop::spawn(Task<void> task)
+{
+    m_activeTaskCount++;
+    runDetached(*this, std::move(task));
+}
+/**
+ * @brief Coroutine owning a spawned task until it finishes
+ */
+EventLoop::DetachedTask EventLoop::runDetached(EventLoop& loop, Task<void> task)
+{
+    try
+    {
+        co_await task;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "Coroutine error: " << e.what() << '\n';
+    }
+    loop.m_activeTaskCount--;
+}
+/**
+ * @brief Run the loop until stop() is called and every spawned coroutine has finished
+ */
+void EventLoop::run()
+{
+    // The counters are read by other threads, they need the clock of this one
+    clockid_t CpuClock{};
+    if(0 == pthread_getcpuclockid(pthread_self(), &CpuClock))
+    {
+        m_cpuClock.store(CpuClock, std::memory_order_relaxed);
+        m_hasCpuClock.store(true, std::memory_order_release);
+    }
+    struct epoll_event Events[EVENT_LOOP_MAX_EVENTS];
+    std::vector<std::coroutine_handle<>> ReadyHandles;
+    while(m_activeTaskCount > 0)
+    {
+        if(isStopping())
+        {
+            cancelWaiters();
+            continue;
+        }
+        int NumberOfEvents = pollEvents(Events);
+        for(int Index = 0; Index < NumberOfEvents; Index++)
+        {
+            int FileDescriptor = Events[Index].data.fd;
+            if(FileDescriptor == m_wakeEventFileDescriptor)
+            {
+                uint64_t Value;
+                ssize_t NumberOfReadBytes = read(m_wakeEventFileDescriptor, &Value, sizeof(Value));
+                (void)NumberOfReadBytes;
+                continue;
+            }
+            auto StateIterator = m_fileDescriptorStates.find(FileDescriptor);
+            if(StateIterator == m_fileDescriptorStates.end())
+            {
+                continue;
+            }
+            // Errors and hang-ups wake both sides so the operation reports them
+            uint32_t ReadyEvents = Events[Index].events;
+            FileDescriptorState& State = StateIterator->second;
+            if((ReadyEvents & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && State.reader)
+            {
+                ReadyHandles.push_back(std::exchange(State.reader, nullptr));
+            }
+            if((ReadyEvents & (EPOLLOUT | EPOLLHUP | EPOLLERR)) && State.writer)
+            {
+                ReadyHandles.push_back(std::exchange(State.writer, nullptr));
+            }
+        }
+        // Resume after collecting, resumed coroutines may close and reuse file descriptors
+        for(auto Handle : ReadyHandles)
+        {
+            Handle.resume();
+        }
+        ReadyHandles.clear();
+        runExpiredTimers();
+    }
+}
+/**
+ * @brief Request the loop to stop, safe to call from any thread
+ */
+void EventLoop::stop()
+{
+    m_isStopping.store(true, std::memory_order_release);
+    uint64_t Value = 1;
+    ssize_t NumberOfWrittenBytes = write(m_wakeEventFileDescriptor, &Value, sizeof(Value));
+    (void)NumberOfWrittenBytes;
+}
+/**
+ * @brief Enable busy polling, call before run()
+ * @param maxSpin Longest spin before blocking, zero always blocks
+ */
+void EventLoop::setBusyPoll(std::chrono::microseconds maxSpin)
+{
+    // Spinning on a single CPU only delays the threads that produce the events
+    m_maxSpin = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? Clock::duration(maxSpin) : Clock::duration::zero();
+    if(m_maxSpin.count() > 0)
+    {
+        m_maxSpin = std::max<Clock::duration>(m_maxSpin, EVENT_LOOP_MIN_SPIN);
+    }
+    m_spinBudget = m_maxSpin;
+    m_spinBudgetNanoseconds.store(std::chrono::duration_cast<std::chrono::nanoseconds>(m_spinBudget).count(), std::memory_order_relaxed);
+}
+/**
+ * @brief Pin the loop thread to CPUs, call from the loop thread
+ * @param cpus CPU numbers, empty to allow every CPU
+ * @return False if the kernel refused the set, e.g. no listed CPU is online
+ */
+bool EventLoop::setCpuAffinity(const std::vector<int>& cpus)
+{
+    cpu_set_t CpuSet;
+    CPU_ZERO(&CpuSet);
+    for(int Cpu = 0; Cpu < CPU_SETSIZE; Cpu++)
+    {
+        // The kernel ignores the CPUs that are not online
+        if(cpus.empty() || (std::find(cpus.begin(), cpus.end(), Cpu) != cpus.end()))
+        {
+            CPU_SET(Cpu, &CpuSet);
+        }
+    }
+    return 0 == pthread_setaffinity_np(pthread_self(), sizeof(CpuSet), &CpuSet);
+}
+/**
+ * @brief Get the CPU cost counters, safe to call from any thread
+ */
+EventLoop::BusyPollStatistics EventLoop::getBusyPollStatistics() const
+{
+    BusyPollStatistics Statistics{};
+    timespec CpuTime{};
+    if(m_hasCpuClock.load(std::memory_order_acquire) && (0 == clock_gettime(m_cpuClock.load(std::memory_order_relaxed), &CpuTime)))
+    {
+        Statistics.cpuSeconds = static_cast<double>(CpuTime.tv_sec) + (static_cast<double>(CpuTime.tv_nsec) / 1e9);
+    }
+    Statistics.spinSeconds = static_cast<double>(m_spinNanoseconds.load(std::memory_order_relaxed)) / 1e9;
+    Statistics.spinPollCount = m_spinPollCount.load(std::memory_order_relaxed);
+    Statistics.spinHitCount = m_spinHitCount.load(std::memory_order_relaxed);
+    Statistics.blockingWaitCount = m_blockingWaitCount.load(std::memory_order_relaxed);
+    Statistics.spinBudgetUs = m_spinBudgetNanoseconds.load(std::memory_order_relaxed) / 1000;
+    return Statistics;
+}
+/**
+ * @brief Print event loop statistics.
+ */
+void EventLoop::printStatistics() const
+{
+    BusyPollStatistics Statistics = getBusyPollStatistics();
+    uint64_t SpinCount = Statistics.spinHitCount + Statistics.blockingWaitCount;
+    std::cout << "\n=== EVENT LOOP STATISTICS ===\n";
+    std::cout << "Busy poll: " << ((m_maxSpin.count() > 0) ? (std::to_string(getBusyPoll().count()) + " us") : std::string("disabled")) << '\n';
+    std::cout << "Thread CPU time: " << Statistics.cpuSeconds << " s\n";
+    std::cout << "Spin time: " << Statistics.spinSeconds << " s";
+    if(Statistics.cpuSeconds > 0)
+    {
+        std::cout << " (" << (100.0 * Statistics.spinSeconds / Statistics.cpuSeconds) << "% of CPU time)";
+    }
+    std::cout << '\n';
+    std::cout << "Non-blocking polls: " << Statistics.spinPollCount << '\n';
+    std::cout << "Spins ending with events: " << Statistics.spinHitCount;
+    if((m_maxSpin.count() > 0) && (SpinCount > 0))
+    {
+        std::cout << " (" << (100.0 * static_cast<double>(Statistics.spinHitCount) / static_cast<double>(SpinCount)) << "% of waits)";
+    }
+    std::cout << '\n';
+    std::cout << "Blocking waits: " << Statistics.blockingWaitCount << '\n';
+    std::cout << "=============================\n";
+}
+/**
+ * @brief Accept a connection on a non-blocking listening socket
+ * @return The non-blocking client file descriptor, -1 on error or stop
+ */
+Task<int> EventLoop::accept(int listeningFileDescriptor)
+{
+    while(true)
+    {
+        int ClientFileDescriptor = accept4(listeningFileDescriptor, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(ClientFileDescriptor != -1)
+        {
+            co_return ClientFileDescriptor;
+        }
+        if((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+        {
+            co_return -1;
+        }
+        bool IsReadable = co_await waitReadable(listeningFileDescriptor);
+        if(!IsReadable)
+        {
+            co_return -1;
+        }
+    }
+}
+/**
+ * @brief Receive available data from a non-blocking socket
+ * @return Number of received bytes, 0 on orderly shutdown, -1 on error or stop
+ */
+Task<ssize_t> EventLoop::receive(int fileDescriptor, void* buffer, size_t length)
+{
+    while(true)
+    {
+        ssize_t NumberOfReceivedBytes = recv(fileDescriptor, buffer, length, MSG_DONTWAIT);
+        if(NumberOfReceivedBytes >= 0)
+        {
+            co_return NumberOfReceivedBytes;
+        }
+        if((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+        {
+            co_return -1;
+        }
+        bool IsReadable = co_await waitReadable(fileDescriptor);
+        if(!IsReadable)
+        {
+            co_return -1;
+        }
+    }
+}
+/**
+ * @brief Send a whole buffer on a non-blocking socket
+ * @return False on error or stop
+ */
+Task<bool> EventLoop::send(int fileDescriptor, const void* buffer, size_t length)
+{
+    const char* Data = static_cast<const char*>(buffer);
+    while(length > 0)
+    {
+        ssize_t NumberOfSentBytes = ::send(fileDescriptor, Data, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if(NumberOfSentBytes >= 0)
+        {
+            Data += NumberOfSentBytes;
+            length -= static_cast<size_t>(NumberOfSentBytes);
+            continue;
+        }
+        if((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+        {
+            co_return false;
+        }
+        bool IsWritable = co_await waitWritable(fileDescriptor);
+        if(!IsWritable)
+        {
+            co_return false;
+        }
+    }
+    co_return true;
+}
+/**
+ * @brief Send from several buffers with one system call on a non-blocking socket
+ * @return Number of sent bytes, possibly fewer than the buffers hold, -1 on error or stop
+ */
+Task<ssize_t> EventLoop::sendVector(int fileDescriptor, const struct iovec* vectors, size_t count)
+{
+    // sendmsg is writev with MSG_NOSIGNAL, a vanished client must not raise SIGPIPE
+    msghdr Message{};
+    Message.msg_iov = const_cast<struct iovec*>(vectors);
+    Message.msg_iovlen = count;
+    while(true)
+    {
+        ssize_t NumberOfSentBytes = sendmsg(fileDescriptor, &Message, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if(NumberOfSentBytes >= 0)
+        {
+            co_return NumberOfSentBytes;
+        }
+        if((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+        {
+            co_return -1;
+        }
+        bool IsWritable = co_await waitWritable(fileDescriptor);
+        if(!IsWritable)
+        {
+            co_return -1;
+        }
+    }
+}
+/**
+ * @brief Forget the registration of a file descriptor and close it
+ */
+void EventLoop::closeFileDescriptor(int fileDescriptor)
+{
+    if(m_fileDescriptorStates.erase(fileDescriptor) > 0)
+    {
+        epoll_ctl(m_epollFileDescriptor, EPOLL_CTL_DEL, fileDescriptor, nullptr);
+    }
+    close(fileDescriptor);
+}
+/**
+ * @brief Wait for events, spinning first while busy polling finds traffic
+ * @return Number of events, as epoll_wait
+ */
+int EventLoop::pollEvents(struct epoll_event* events)
+{
+    int Timeout = computeTimeout();
+    if(0 == Timeout)
+    {
+        return epoll_wait(m_epollFileDescriptor, events, EVENT_LOOP_MAX_EVENTS, 0);
+    }
+    if(m_spinBudget.count() > 0)
+    {
+        auto SpinStart = Clock::now();
+        auto SpinEnd = SpinStart + m_spinBudget;
+        if(!m_timers.empty())
+        {
+            SpinEnd = std::min(SpinEnd, m_timers.begin()->first);
+        }
+        // Back off with pause between polls, each empty poll is a system call
+        uint32_t PauseCount = 1;
+        uint64_t PollCount = 0;
+        int NumberOfEvents = 0;
+        auto Now = SpinStart;
+        do
+        {
+            NumberOfEvents = epoll_wait(m_epollFileDescriptor, events, EVENT_LOOP_MAX_EVENTS, 0);
+            PollCount++;
+            if(0 != NumberOfEvents)
+            {
+                break;
+            }
+            for(uint32_t Pause = 0; Pause < PauseCount; Pause++)
+            {
+                pauseCore();
+            }
+            PauseCount = std::min(PauseCount * 2, EVENT_LOOP_MAX_PAUSE_COUNT);
+            Now = Clock::now();
+        } while(Now < SpinEnd);
+        m_spinPollCount.fetch_add(PollCount, std::memory_order_relaxed);
+        m_spinNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - SpinStart).count(), std::memory_order_relaxed);
+        if(0 != NumberOfEvents)
+        {
+            // Hot traffic, spin longer next time
+            m_spinHitCount.fetch_add(1, std::memory_order_relaxed);
+            m_spinBudget = std::min(m_spinBudget * 2, m_maxSpin);
+            m_spinBudgetNanoseconds.store(std::chrono::duration_cast<std::chrono::nanoseconds>(m_spinBudget).count(), std::memory_order_relaxed);
+            return NumberOfEvents;
+        }
+        Timeout = computeTimeout();
+        if(0 == Timeout)
+        {
+            // The spin ran into a timer, that says nothing about the traffic
+            return 0;
+        }
+        // Spun in vain, spin less until an idle loop only blocks
+        m_spinBudget /= 2;
+        if(m_spinBudget < EVENT_LOOP_MIN_SPIN)
+        {
+            m_spinBudget = Clock::duration::zero();
+        }
+        m_spinBudgetNanoseconds.store(std::chrono::duration_cast<std::chrono::nanoseconds>(m_spinBudget).count(), std::memory_order_relaxed);
+    }
+    m_blockingWaitCount.fetch_add(1, std::memory_order_relaxed);
+    if(0 == m_maxSpin.count())
+    {
+        return epoll_wait(m_epollFileDescriptor, events, EVENT_LOOP_MAX_EVENTS, Timeout);
+    }
+    auto WaitStart = Clock::now();
+    int NumberOfEvents = epoll_wait(m_epollFileDescriptor, events, EVENT_LOOP_MAX_EVENTS, Timeout);
+    if((NumberOfEvents > 0) && ((Clock::now() - WaitStart) < m_maxSpin))
+    {
+        // Events arrived within the spin limit, traffic picked up again
+        m_spinBudget = m_maxSpin;
+        m_spinBudgetNanoseconds.store(std::chrono::duration_cast<std::chrono::nanoseconds>(m_spinBudget).count(), std::memory_order_relaxed);
+    }
+    return NumberOfEvents;
+}
+/**
+ * @brief Register a coroutine waiting on a file descriptor
+ * @return False if the coroutine must not suspend
+ */
+bool EventLoop::addFileDescriptorWaiter(int fileDescriptor, bool isWrite, std::coroutine_handle<> handle)
+{
+    auto [StateIterator, IsInserted] = m_fileDescriptorStates.try_emplace(fileDescriptor);
+    if(IsInserted)
+    {
+        // Registered once, edge triggered, operations retry until EAGAIN before waiting
+        struct epoll_event Event{};
+        Event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        Event.data.fd = fileDescriptor;
+        if(-1 == epoll_ctl(m_epollFileDescriptor, EPOLL_CTL_ADD, fileDescriptor, &Event))
+        {
+            m_fileDescriptorStates.erase(StateIterator);
+            return false;
+        }
+    }
+    (isWrite ? StateIterator->second.writer : StateIterator->second.reader) = handle;
+    return true;
+}
+/**
+ * @brief Resume every suspended coroutine so it observes the stop
+ */
+void EventLoop::cancelWaiters()
+{
+    std::vector<std::coroutine_handle<>> Handles;
+    for(auto& [FileDescriptor, State] : m_fileDescriptorStates)
+    {
+        if(State.reader)
+        {
+            Handles.push_back(std::exchange(State.reader, nullptr));
+        }
+        if(State.writer)
+        {
+            Handles.push_back(std::exchange(State.writer, nullptr));
+        }
+    }
+    for(auto& [Expiry, Handle] : m_timers)
+    {
+        Handles.push_back(Handle);
+    }
+    m_timers.clear();
+    for(auto Handle : Handles)
+    {
+        Handle.resume();
+    }
+}
+/**
+ * @brief Resume the coroutines of expired timers
+ */
+void EventLoop::runExpiredTimers()
+{
+    // Collect first, a resumed coroutine that yields again waits for the next iteration
+    auto Now = Clock::now();
+    std::vector<std::coroutine_handle<>> ExpiredHandles;
+    while(!m_timers.empty() && (m_timers.begin()->first <= Now))
+    {
+        ExpiredHandles.push_back(m_timers.begin()->second);
+        m_timers.erase(m_timers.begin());
+    }
+    for(auto Handle : ExpiredHandles)
+    {
+        Handle.resume();
+    }
+}
+/**
+ * @brief Milliseconds epoll_wait may block before the next timer expires
+ */
+int EventLoop::computeTimeout() const
+{
+    if(m_timers.empty())
+    {
+        return -1;
+    }
+    auto Remaining = std::chrono::ceil<std::chrono::milliseconds>(m_timers.begin()->first - Clock::now());
+    return (Remaining.count() > 0) ? static_cast<int>(Remaining.count()) : 0;
+}
+/**
+ * @brief Destroy the EventLoop object
+ */
+EventLoop::~EventLoop()
+{
+    if(m_wakeEventFileDescriptor != -1)
+    {
+        close(m_wakeEventFileDescriptor);
+    }
+    if(m_epollFileDescriptor != -1)
+    {
+        close(m_epollFileDescriptor);
+    }
+}
+} // namespace App
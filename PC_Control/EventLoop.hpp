@@ -0,0 +1,254 @@
+/**
+ * @file EventLoop.hpp
+ * @brief Header file for coroutine event loop
+ *
+ * Provides an epoll based event loop with awaitable socket operations and
+ * timers, coroutines spawned on the loop run until the loop is stopped
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <atomic>            ///< For std::atomic
+#include <chrono>            ///< For std::chrono time points and durations
+#include <coroutine>         ///< For std::coroutine_handle
+#include <cstddef>           ///< For size_t
+#include <cstdint>           ///< For fixed width integer types
+#include <ctime>             ///< For clockid_t
+#include <map>               ///< For std::multimap
+#include <unordered_map>     ///< For std::unordered_map
+#include <vector>            ///< For std::vector
+#include <sys/types.h>       ///< For ssize_t
+#include <sys/uio.h>         ///< For struct iovec
+#include "Task.hpp"
+
+struct epoll_event;
+
+constexpr int EVENT_LOOP_MAX_EVENTS{64};    ///< Events handled per epoll_wait call
+constexpr uint32_t EVENT_LOOP_MAX_PAUSE_COUNT{64};  ///< Longest pause backoff between two polls while spinning
+constexpr std::chrono::nanoseconds EVENT_LOOP_MIN_SPIN{1000};  ///< Spin budget below which the loop only blocks
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @class EventLoop
+ * @brief Single threaded epoll event loop resuming coroutines on readiness and timers
+ *
+ * Every suspended operation returns false once stop() is called, so coroutines
+ * unwind and run() returns after the last spawned coroutine has finished.
+ * With busy polling enabled the loop polls without blocking for an adaptive
+ * budget before it blocks: the budget grows while spinning finds events and
+ * shrinks to nothing while the loop is idle.
+ */
+class EventLoop
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+        /**
+         * @brief CPU cost of the loop thread, readable from any thread
+         */
+        struct BusyPollStatistics
+        {
+            double cpuSeconds{};            ///< CPU time of the thread running the loop
+            double spinSeconds{};           ///< Part of the CPU time spent polling without blocking
+            uint64_t spinPollCount{};       ///< Non-blocking polls
+            uint64_t spinHitCount{};        ///< Spins that ended with events instead of blocking
+            uint64_t blockingWaitCount{};   ///< Polls that blocked the thread
+            int64_t spinBudgetUs{};         ///< Current adaptive spin budget
+        };
+        /**
+         * @brief Suspends until a file descriptor is readable or writable
+         */
+        class FileDescriptorAwaiter
+        {
+            public:
+                FileDescriptorAwaiter(EventLoop& loop, int fileDescriptor, bool isWrite)
+                    : m_loop{loop}, m_fileDescriptor{fileDescriptor}, m_isWrite{isWrite} {}
+                bool await_ready() const noexcept { return m_loop.isStopping(); }
+                bool await_suspend(std::coroutine_handle<> handle) { return m_loop.addFileDescriptorWaiter(m_fileDescriptor, m_isWrite, handle); }
+                bool await_resume() const noexcept { return !m_loop.isStopping(); }   ///< False if the loop is stopping
+            private:
+                EventLoop& m_loop;          ///< Loop resuming the coroutine
+                int m_fileDescriptor{};     ///< Awaited file descriptor
+                bool m_isWrite{};           ///< Await writability instead of readability
+        };
+        /**
+         * @brief Suspends until a point in time
+         */
+        class TimerAwaiter
+        {
+            public:
+                TimerAwaiter(EventLoop& loop, Clock::time_point expiry) : m_loop{loop}, m_expiry{expiry} {}
+                bool await_ready() const noexcept { return m_loop.isStopping(); }
+                void await_suspend(std::coroutine_handle<> handle) { m_loop.m_timers.emplace(m_expiry, handle); }
+                bool await_resume() const noexcept { return !m_loop.isStopping(); }   ///< False if the loop is stopping
+            private:
+                EventLoop& m_loop;                  ///< Loop resuming the coroutine
+                Clock::time_point m_expiry{};       ///< Wake up time
+        };
+        /**
+         * @brief Constructor to create the epoll instance
+         */
+        EventLoop();
+        EventLoop(const EventLoop&) = delete;             ///< Delete copy constructor
+        EventLoop& operator=(const EventLoop&) = delete;  ///< Delete copy assignment operator
+        EventLoop(EventLoop&&) = delete;                  ///< Delete move constructor
+        EventLoop& operator=(EventLoop&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Destroy the EventLoop object
+         */
+        ~EventLoop();
+        /**
+         * @brief Start a coroutine on the loop, the loop owns it until it finishes
+         * @param task The coroutine to run
+         */
+        void spawn(Task<void> task);
+        /**
+         * @brief Run the loop until stop() is called and every spawned coroutine has finished
+         */
+        void run();
+        /**
+         * @brief Request the loop to stop, safe to call from any thread
+         */
+        void stop();
+        /**
+         * @brief Enable busy polling, call before run()
+         * @param maxSpin Longest spin before blocking, zero always blocks
+         */
+        void setBusyPoll(std::chrono::microseconds maxSpin);
+        /**
+         * @brief Get the longest spin before blocking, zero if busy polling is disabled
+         */
+        std::chrono::microseconds getBusyPoll() const { return std::chrono::duration_cast<std::chrono::microseconds>(m_maxSpin); }
+        /**
+         * @brief Pin the loop thread to CPUs, call from the loop thread
+         * @param cpus CPU numbers, empty to allow every CPU
+         * @return False if the kernel refused the set, e.g. no listed CPU is online
+         */
+        bool setCpuAffinity(const std::vector<int>& cpus);
+        /**
+         * @brief Get the CPU cost counters, safe to call from any thread
+         */
+        BusyPollStatistics getBusyPollStatistics() const;
+        /**
+         * @brief Print event loop statistics.
+         */
+        void printStatistics() const;
+        /**
+         * @brief Check if the loop is stopping
+         */
+        bool isStopping() const { return m_isStopping.load(std::memory_order_acquire); }
+        /**
+         * @brief Await readability of a non-blocking file descriptor
+         */
+        FileDescriptorAwaiter waitReadable(int fileDescriptor) { return FileDescriptorAwaiter(*this, fileDescriptor, false); }
+        /**
+         * @brief Await writability of a non-blocking file descriptor
+         */
+        FileDescriptorAwaiter waitWritable(int fileDescriptor) { return FileDescriptorAwaiter(*this, fileDescriptor, true); }
+        /**
+         * @brief Await a point in time
+         */
+        TimerAwaiter sleepUntil(Clock::time_point expiry) { return TimerAwaiter(*this, expiry); }
+        /**
+         * @brief Await a duration
+         */
+        TimerAwaiter sleepFor(Clock::duration duration) { return TimerAwaiter(*this, Clock::now() + duration); }
+        /**
+         * @brief Let the loop handle pending events before the coroutine continues
+         */
+        TimerAwaiter yield() { return TimerAwaiter(*this, Clock::now()); }
+        /**
+         * @brief Accept a connection on a non-blocking listening socket
+         * @return The non-blocking client file descriptor, -1 on error or stop
+         */
+        Task<int> accept(int listeningFileDescriptor);
+        /**
+         * @brief Receive available data from a non-blocking socket
+         * @return Number of received bytes, 0 on orderly shutdown, -1 on error or stop
+         */
+        Task<ssize_t> receive(int fileDescriptor, void* buffer, size_t length);
+        /**
+         * @brief Send a whole buffer on a non-blocking socket
+         * @return False on error or stop
+         */
+        Task<bool> send(int fileDescriptor, const void* buffer, size_t length);
+        /**
+         * @brief Send from several buffers with one system call on a non-blocking socket
+         * @return Number of sent bytes, possibly fewer than the buffers hold, -1 on error or stop
+         */
+        Task<ssize_t> sendVector(int fileDescriptor, const struct iovec* vectors, size_t count);
+        /**
+         * @brief Forget the registration of a file descriptor and close it
+         */
+        void closeFileDescriptor(int fileDescriptor);
+    private:
+        /**
+         * @brief Coroutines suspended on a file descriptor
+         */
+        struct FileDescriptorState
+        {
+            std::coroutine_handle<> reader{};   ///< Coroutine awaiting readability
+            std::coroutine_handle<> writer{};   ///< Coroutine awaiting writability
+        };
+        int m_epollFileDescriptor{-1};                                      ///< epoll instance
+        int m_wakeEventFileDescriptor{-1};                                  ///< Wakes epoll_wait for stop
+        std::atomic<bool> m_isStopping{false};                              ///< Stop requested
+        size_t m_activeTaskCount{};                                         ///< Spawned coroutines still running
+        std::unordered_map<int, FileDescriptorState> m_fileDescriptorStates{};  ///< Registered file descriptors
+        std::multimap<Clock::time_point, std::coroutine_handle<>> m_timers{};  ///< Pending timers by expiry
+        Clock::duration m_maxSpin{};                                        ///< Busy poll limit, zero when disabled
+        Clock::duration m_spinBudget{};                                     ///< Adaptive spin before the next blocking wait
+        std::atomic<clockid_t> m_cpuClock{};                                ///< CPU clock of the thread running the loop
+        std::atomic<bool> m_hasCpuClock{false};                             ///< Set once run() started
+        std::atomic<int64_t> m_spinNanoseconds{0};                          ///< Time spent spinning
+        std::atomic<uint64_t> m_spinPollCount{0};                           ///< Non-blocking polls
+        std::atomic<uint64_t> m_spinHitCount{0};                            ///< Spins that found events
+        std::atomic<uint64_t> m_blockingWaitCount{0};                       ///< Blocking polls
+        std::atomic<int64_t> m_spinBudgetNanoseconds{0};                    ///< Mirror of the spin budget for readers
+        /**
+         * @brief Wait for events, spinning first while busy polling finds traffic
+         * @return Number of events, as epoll_wait
+         */
+        int pollEvents(struct epoll_event* events);
+        /**
+         * @brief Register a coroutine waiting on a file descriptor
+         * @return False if the coroutine must not suspend
+         */
+        bool addFileDescriptorWaiter(int fileDescriptor, bool isWrite, std::coroutine_handle<> handle);
+        /**
+         * @brief Resume every suspended coroutine so it observes the stop
+         */
+        void cancelWaiters();
+        /**
+         * @brief Resume the coroutines of expired timers
+         */
+        void runExpiredTimers();
+        /**
+         * @brief Milliseconds epoll_wait may block before the next timer expires
+         */
+        int computeTimeout() const;
+        /**
+         * @brief Coroutine owning a spawned task until it finishes
+         */
+        struct DetachedTask
+        {
+            struct promise_type
+            {
+                DetachedTask get_return_object() const noexcept { return {}; }
+                std::suspend_never initial_suspend() const noexcept { return {}; }
+                std::suspend_never final_suspend() const noexcept { return {}; }
+                void return_void() const noexcept {}
+                void unhandled_exception() const noexcept {}
+            };
+        };
+        static DetachedTask runDetached(EventLoop& loop, Task<void> task);
+};
+} // namespace App
@@ -0,0 +1,602 @@
+/**
+ * @file LogArchive.cpp
+ * @brief Source file for the compressed archive of sealed log segments
+ *
+ * Compresses sealed log segments on a background thread into framed, indexed
+ * archives and reads the records of a time range back
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <algorithm>             ///< For std::min
+#include <array>                 ///< For std::array
+#include <cerrno>                ///< For errno
+#include <cstdio>                ///< For std::rename and std::remove
+#include <cstring>               ///< For memcpy
+#include <fcntl.h>               ///< For open
+#include <fstream>               ///< For std::ifstream and std::ofstream
+#include <iostream>              ///< For std::cout and std::cerr
+#include <unistd.h>              ///< For write, fsync and close
+#include "LogArchive.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+namespace
+{
+/**
+ * @brief helper function to read four bytes at any alignment
+ */
+uint32_t load32(const char* data)
+{
+    uint32_t Value = 0;
+    std::memcpy(&Value, data, sizeof(Value));
+    return Value;
+}
+/**
+ * @brief helper function to append a length beyond the token nibble, 255 per byte until a smaller byte ends it
+ */
+void appendLength(std::string& output, size_t length)
+{
+    while(length >= 255)
+    {
+        output.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    output.push_back(static_cast<char>(length));
+}
+/**
+ * @brief helper function to read a length written by appendLength()
+ */
+bool readLength(const char* data, size_t size, size_t& position, size_t& length)
+{
+    uint8_t Byte = 255;
+    while(255 == Byte)
+    {
+        if(position >= size)
+        {
+            return false;
+        }
+        Byte = static_cast<uint8_t>(data[position++]);
+        length += Byte;
+    }
+    return true;
+}
+/**
+ * @brief helper function to append a sequence of literals followed by a match
+ */
+void appendSequence(std::string& output, const char* literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+    size_t MatchCode = matchLength - LOG_ARCHIVE_MIN_MATCH;
+    output.push_back(static_cast<char>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(MatchCode, 15)));
+    if(literalCount >= 15)
+    {
+        appendLength(output, literalCount - 15);
+    }
+    output.append(literals, literalCount);
+    output.push_back(static_cast<char>(offset & 0xFF));
+    output.push_back(static_cast<char>(offset >> 8));
+    if(MatchCode >= 15)
+    {
+        appendLength(output, MatchCode - 15);
+    }
+}
+/**
+ * @brief helper function to write a whole range to a file
+ */
+bool writeAll(int fileDescriptor, const void* data, size_t size)
+{
+    const char* Position = static_cast<const char*>(data);
+    while(size > 0)
+    {
+        ssize_t Written = ::write(fileDescriptor, Position, size);
+        if(Written < 0)
+        {
+            if(EINTR == errno)
+            {
+                continue;
+            }
+            return false;
+        }
+        Position += Written;
+        size -= static_cast<size_t>(Written);
+    }
+    return true;
+}
+} // namespace
+
+std::mutex LogArchive::s_archiveMutex;
+std::condition_variable LogArchive::s_archiveCondition;
+std::deque<std::string> LogArchive::s_pendingSegments;
+bool LogArchive::s_isRunning{false};
+std::thread LogArchive::s_archiveThread;
+std::atomic<uint64_t> LogArchive::s_segmentCount{0};
+std::atomic<uint64_t> LogArchive::s_rawBytes{0};
+std::atomic<uint64_t> LogArchive::s_compressedBytes{0};
+
+/**
+ * @brief Start the thread compressing the submitted segments
+ */
+void LogArchive::start()
+{
+    std::lock_guard<std::mutex> lock(s_archiveMutex);
+    if(s_isRunning)
+    {
+        return;
+    }
+    s_isRunning = true;
+    s_archiveThread = std::thread(&LogArchive::compressSegments);
+}
+/**
+ * @brief Compress the segments still waiting and stop the thread
+ */
+void LogArchive::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(s_archiveMutex);
+        if(!s_isRunning)
+        {
+            return;
+        }
+        s_isRunning = false;
+    }
+    s_archiveCondition.notify_one();
+    s_archiveThread.join();
+}
+/**
+ * @brief Queue a sealed segment for compression, thread safe
+ * @param segmentPath Segment file, replaced by segmentPath + LOG_ARCHIVE_EXTENSION once compressed
+ */
+void LogArchive::submit(const std::string& segmentPath)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_archiveMutex);
+        // Queued before start() too, the thread picks the segment up once it runs
+        s_pendingSegments.push_back(segmentPath);
+    }
+    s_archiveCondition.notify_one();
+}
+/**
+ * @brief Compress a segment into an archive and remove the segment
+ * @return False if the archive could not be written, the segment is then kept
+ */
+bool LogArchive::compressSegment(const std::string& segmentPath)
+{
+    std::ifstream Segment(segmentPath, std::ios::binary);
+    if(!Segment.is_open())
+    {
+        return false;
+    }
+    // Written under a temporary name, an archive with its final name is always complete
+    std::string ArchivePath = segmentPath + LOG_ARCHIVE_EXTENSION;
+    std::string TemporaryPath = ArchivePath + ".tmp";
+    int ArchiveFileDescriptor = ::open(TemporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(-1 == ArchiveFileDescriptor)
+    {
+        return false;
+    }
+    bool IsWritten = writeAll(ArchiveFileDescriptor, LOG_ARCHIVE_MAGIC, sizeof(LOG_ARCHIVE_MAGIC));
+    uint64_t Offset = sizeof(LOG_ARCHIVE_MAGIC);
+    uint64_t RawBytes = 0;
+    std::vector<IndexEntry> Index;
+    std::string Pending;
+    std::string Compressed;
+    std::vector<char> ReadBuffer(LOG_ARCHIVE_BLOCK_SIZE);
+    bool IsEndOfFile = false;
+    while(IsWritten && (!IsEndOfFile || !Pending.empty()))
+    {
+        while(!IsEndOfFile && (Pending.size() < LOG_ARCHIVE_BLOCK_SIZE))
+        {
+            Segment.read(ReadBuffer.data(), static_cast<std::streamsize>(ReadBuffer.size()));
+            Pending.append(ReadBuffer.data(), static_cast<size_t>(Segment.gcount()));
+            IsEndOfFile = !Segment;
+        }
+        // A frame ends after a whole line, only a line longer than a block is split
+        size_t BlockSize = std::min(Pending.size(), LOG_ARCHIVE_BLOCK_SIZE);
+        if(!IsEndOfFile || (Pending.size() > LOG_ARCHIVE_BLOCK_SIZE))
+        {
+            size_t LastNewline = Pending.rfind('\n', LOG_ARCHIVE_BLOCK_SIZE - 1);
+            if(std::string::npos != LastNewline)
+            {
+                BlockSize = LastNewline + 1;
+            }
+        }
+        FrameHeader Header{};
+        for(size_t LineStart = 0; LineStart < BlockSize;)
+        {
+            if('[' == Pending[LineStart])
+            {
+                int64_t Timestamp = parseTimestamp(std::string_view(Pending).substr(LineStart + 1, BlockSize - LineStart - 1));
+                if(LOG_ARCHIVE_NO_TIMESTAMP != Timestamp)
+                {
+                    Header.firstTimestamp = (LOG_ARCHIVE_NO_TIMESTAMP == Header.firstTimestamp) ? Timestamp : Header.firstTimestamp;
+                    Header.lastTimestamp = Timestamp;
+                }
+            }
+            size_t LineEnd = Pending.find('\n', LineStart);
+            LineStart = (std::string::npos == LineEnd) ? BlockSize : (LineEnd + 1);
+        }
+        compressBlock(Pending.data(), BlockSize, Compressed);
+        Header.rawSize = static_cast<uint32_t>(BlockSize);
+        Header.compressedSize = static_cast<uint32_t>(Compressed.size());
+        Index.push_back(IndexEntry{Offset, Header.firstTimestamp, Header.lastTimestamp});
+        IsWritten = writeAll(ArchiveFileDescriptor, &Header, sizeof(Header)) && writeAll(ArchiveFileDescriptor, Compressed.data(), Compressed.size());
+        Offset += sizeof(Header) + Compressed.size();
+        RawBytes += BlockSize;
+        Pending.erase(0, BlockSize);
+    }
+    Footer ArchiveFooter{};
+    ArchiveFooter.indexOffset = Offset;
+    ArchiveFooter.frameCount = static_cast<uint32_t>(Index.size());
+    IsWritten = IsWritten && !Segment.bad()
+             && writeAll(ArchiveFileDescriptor, Index.data(), Index.size() * sizeof(IndexEntry))
+             && writeAll(ArchiveFileDescriptor, &ArchiveFooter, sizeof(ArchiveFooter))
+             && (0 == fsync(ArchiveFileDescriptor));
+    ::close(ArchiveFileDescriptor);
+    if(!IsWritten || (0 != std::rename(TemporaryPath.c_str(), ArchivePath.c_str())))
+    {
+        std::remove(TemporaryPath.c_str());
+        return false;
+    }
+    std::remove(segmentPath.c_str());
+    s_segmentCount.fetch_add(1, std::memory_order_relaxed);
+    s_rawBytes.fetch_add(RawBytes, std::memory_order_relaxed);
+    s_compressedBytes.fetch_add(Offset + (Index.size() * sizeof(IndexEntry)) + sizeof(ArchiveFooter), std::memory_order_relaxed);
+    return true;
+}
+/**
+ * @brief Compress a block of at most LOG_ARCHIVE_BLOCK_SIZE bytes
+ * @param data Raw bytes
+ * @param size Number of raw bytes
+ * @param output Replaced with the compressed block
+ */
+void LogArchive::compressBlock(const char* data, size_t size, std::string& output)
+{
+    output.clear();
+    output.reserve(size + (size / 255) + 16);
+    // Last position each 4 byte sequence was seen at, plus one so zero means never
+    std::array<uint32_t, size_t{1} << LOG_ARCHIVE_HASH_BITS> Positions{};
+    size_t Anchor = 0;
+    size_t Position = 0;
+    while((Position + LOG_ARCHIVE_MIN_MATCH) <= size)
+    {
+        uint32_t Sequence = load32(data + Position);
+        uint32_t Hash = (Sequence * 2654435761U) >> (32 - LOG_ARCHIVE_HASH_BITS);
+        size_t Candidate = Positions[Hash];
+        Positions[Hash] = static_cast<uint32_t>(Position + 1);
+        if((0 == Candidate) || ((Position - (Candidate - 1)) > UINT16_MAX) || (load32(data + Candidate - 1) != Sequence))
+        {
+            Position++;
+            continue;
+        }
+        size_t MatchStart = Candidate - 1;
+        size_t MatchLength = LOG_ARCHIVE_MIN_MATCH;
+        while(((Position + MatchLength) < size) && (data[MatchStart + MatchLength] == data[Position + MatchLength]))
+        {
+            MatchLength++;
+        }
+        appendSequence(output, data + Anchor, Position - Anchor, Position - MatchStart, MatchLength);
+        Position += MatchLength;
+        Anchor = Position;
+    }
+    // The last sequence carries only literals, the decoder stops at the end of its input
+    size_t LiteralCount = size - Anchor;
+    output.push_back(static_cast<char>(std::min<size_t>(LiteralCount, 15) << 4));
+    if(LiteralCount >= 15)
+    {
+        appendLength(output, LiteralCount - 15);
+    }
+    output.append(data + Anchor, LiteralCount);
+}
+/**
+ * @brief Decompress a block
+ * @param data Compressed bytes
+ * @param size Number of compressed bytes
+ * @param rawSize Size of the block before compression
+ * @param output Replaced with the raw bytes
+ * @return False if the block is malformed
+ */
+bool LogArchive::decompressBlock(const char* data, size_t size, size_t rawSize, std::string& output)
+{
+    output.clear();
+    output.reserve(rawSize);
+    size_t Position = 0;
+    while(Position < size)
+    {
+        uint8_t Token = static_cast<uint8_t>(data[Position++]);
+        size_t LiteralCount = Token >> 4;
+        if((15 == LiteralCount) && !readLength(data, size, Position, LiteralCount))
+        {
+            return false;
+        }
+        if(((size - Position) < LiteralCount) || ((output.size() + LiteralCount) > rawSize))
+        {
+            return false;
+        }
+        output.append(data + Position, LiteralCount);
+        Position += LiteralCount;
+        if(Position == size)
+        {
+            break;
+        }
+        if((size - Position) < 2)
+        {
+            return false;
+        }
+        size_t Offset = static_cast<uint8_t>(data[Position]) | (static_cast<size_t>(static_cast<uint8_t>(data[Position + 1])) << 8);
+        Position += 2;
+        size_t MatchLength = Token & 0x0F;
+        if((15 == MatchLength) && !readLength(data, size, Position, MatchLength))
+        {
+            return false;
+        }
+        MatchLength += LOG_ARCHIVE_MIN_MATCH;
+        if((0 == Offset) || (Offset > output.size()) || ((output.size() + MatchLength) > rawSize))
+        {
+            return false;
+        }
+        // Byte by byte, a match may overlap the bytes it produces
+        size_t Source = output.size() - Offset;
+        size_t Destination = output.size();
+        output.resize(Destination + MatchLength);
+        for(size_t Index = 0; Index < MatchLength; Index++)
+        {
+            output[Destination + Index] = output[Source + Index];
+        }
+    }
+    return output.size() == rawSize;
+}
+/**
+ * @brief Convert a "YYYY-MM-DD HH:MM:SS" prefix into the sortable number YYYYMMDDHHMMSS
+ * @return LOG_ARCHIVE_NO_TIMESTAMP if the text does not start with a timestamp
+ */
+int64_t LogArchive::parseTimestamp(std::string_view text)
+{
+    constexpr std::string_view TIMESTAMP_PATTERN{"0000-00-00 00:00:00"};
+    if(text.size() < TIMESTAMP_PATTERN.size())
+    {
+        return LOG_ARCHIVE_NO_TIMESTAMP;
+    }
+    int64_t Timestamp = 0;
+    for(size_t Index = 0; Index < TIMESTAMP_PATTERN.size(); Index++)
+    {
+        if('0' == TIMESTAMP_PATTERN[Index])
+        {
+            if((text[Index] < '0') || (text[Index] > '9'))
+            {
+                return LOG_ARCHIVE_NO_TIMESTAMP;
+            }
+            Timestamp = (Timestamp * 10) + (text[Index] - '0');
+        }
+        else if(text[Index] != TIMESTAMP_PATTERN[Index])
+        {
+            return LOG_ARCHIVE_NO_TIMESTAMP;
+        }
+    }
+    return Timestamp;
+}
+/**
+ * @brief Print compression statistics.
+ */
+void LogArchive::printStatistics()
+{
+    uint64_t RawBytes = s_rawBytes.load(std::memory_order_relaxed);
+    uint64_t CompressedBytes = s_compressedBytes.load(std::memory_order_relaxed);
+    std::cout << "\n=== LOG ARCHIVE STATISTICS ===\n";
+    std::cout << "Segments compressed: " << s_segmentCount.load(std::memory_order_relaxed) << '\n';
+    std::cout << "Raw bytes: " << RawBytes << '\n';
+    std::cout << "Compressed bytes: " << CompressedBytes;
+    if(CompressedBytes > 0)
+    {
+        std::cout << " (ratio " << (static_cast<double>(RawBytes) / static_cast<double>(CompressedBytes)) << ")";
+    }
+    std::cout << '\n';
+    std::cout << "==============================\n";
+}
+/**
+ * @brief Archive thread loop compressing the pending segments
+ */
+void LogArchive::compressSegments()
+{
+    while(true)
+    {
+        std::string SegmentPath;
+        {
+            std::unique_lock<std::mutex> lock(s_archiveMutex);
+            s_archiveCondition.wait(lock, []() { return !s_isRunning || !s_pendingSegments.empty(); });
+            if(s_pendingSegments.empty())
+            {
+                // Stopped with nothing left to compress
+                return;
+            }
+            SegmentPath = std::move(s_pendingSegments.front());
+            s_pendingSegments.pop_front();
+        }
+        if(!compressSegment(SegmentPath))
+        {
+            // The sealed segment stays readable as plain text
+            std::cerr << "Unable to compress log segment: " << SegmentPath << std::endl;
+        }
+    }
+}
+
+/**
+ * @brief Constructor to set the archive file
+ */
+LogArchiveReader::LogArchiveReader(const std::string& fileName) : m_fileName{fileName}
+{
+}
+/**
+ * @brief Read the frame index, scans the frames if the archive has no complete index
+ * @return False if the file is no archive
+ */
+bool LogArchiveReader::open()
+{
+    m_index.clear();
+    std::ifstream Archive(m_fileName, std::ios::binary | std::ios::ate);
+    if(!Archive.is_open())
+    {
+        return false;
+    }
+    uint64_t FileSize = static_cast<uint64_t>(Archive.tellg());
+    char Magic[sizeof(LOG_ARCHIVE_MAGIC)]{};
+    Archive.seekg(0);
+    if(!Archive.read(Magic, sizeof(Magic)) || (0 != std::memcmp(Magic, LOG_ARCHIVE_MAGIC, sizeof(Magic))))
+    {
+        return false;
+    }
+    LogArchive::Footer ArchiveFooter{};
+    if(FileSize >= (sizeof(LOG_ARCHIVE_MAGIC) + sizeof(ArchiveFooter)))
+    {
+        Archive.seekg(static_cast<std::streamoff>(FileSize - sizeof(ArchiveFooter)));
+        Archive.read(reinterpret_cast<char*>(&ArchiveFooter), sizeof(ArchiveFooter));
+    }
+    uint64_t IndexSize = static_cast<uint64_t>(ArchiveFooter.frameCount) * sizeof(LogArchive::IndexEntry);
+    if(!Archive || (LOG_ARCHIVE_FOOTER_MAGIC != ArchiveFooter.magic) || ((ArchiveFooter.indexOffset + IndexSize + sizeof(ArchiveFooter)) != FileSize))
+    {
+        return scanFrames(FileSize);
+    }
+    m_index.resize(ArchiveFooter.frameCount);
+    Archive.seekg(static_cast<std::streamoff>(ArchiveFooter.indexOffset));
+    if(!Archive.read(reinterpret_cast<char*>(m_index.data()), static_cast<std::streamsize>(IndexSize)))
+    {
+        return scanFrames(FileSize);
+    }
+    return true;
+}
+/**
+ * @brief Stream the records of a time range in file order
+ * @param from First timestamp, see LogArchive::parseTimestamp()
+ * @param to Last timestamp, inclusive
+ * @param onRecord Receives each record without its newline
+ * @return False if a frame is damaged, the records before it were delivered
+ */
+bool LogArchiveReader::readRange(int64_t from, int64_t to, const std::function<void(std::string_view)>& onRecord) const
+{
+    std::ifstream Archive(m_fileName, std::ios::binary);
+    if(!Archive.is_open())
+    {
+        return false;
+    }
+    std::string Compressed;
+    std::string Block;
+    // A line longer than a block continues in the next frame
+    std::string PartialLine;
+    bool IsIncluded = true;
+    size_t NextFrame = 0;
+    for(size_t FrameIndex = 0; FrameIndex < m_index.size(); FrameIndex++)
+    {
+        const LogArchive::IndexEntry& Entry = m_index[FrameIndex];
+        // Frames without a timestamp continue the record before them and are read along with it
+        bool IsOutside = (LOG_ARCHIVE_NO_TIMESTAMP == Entry.firstTimestamp) ? (FrameIndex != NextFrame)
+                                                                             : ((Entry.lastTimestamp < from) || (Entry.firstTimestamp > to));
+        if(IsOutside)
+        {
+            continue;
+        }
+        if(FrameIndex != NextFrame)
+        {
+            // The lines up to the first timestamp continue a record of the skipped frames
+            PartialLine.clear();
+            IsIncluded = false;
+        }
+        NextFrame = FrameIndex + 1;
+        LogArchive::FrameHeader Header{};
+        Archive.seekg(static_cast<std::streamoff>(Entry.offset));
+        if(!Archive.read(reinterpret_cast<char*>(&Header), sizeof(Header)) || (LOG_ARCHIVE_FRAME_MAGIC != Header.magic)
+           || (Header.rawSize > LOG_ARCHIVE_BLOCK_SIZE))
+        {
+            return false;
+        }
+        Compressed.resize(Header.compressedSize);
+        if(!Archive.read(Compressed.data(), static_cast<std::streamsize>(Compressed.size()))
+           || !LogArchive::decompressBlock(Compressed.data(), Compressed.size(), Header.rawSize, Block))
+        {
+            return false;
+        }
+        size_t LineStart = 0;
+        while(LineStart < Block.size())
+        {
+            size_t LineEnd = Block.find('\n', LineStart);
+            if(std::string::npos == LineEnd)
+            {
+                PartialLine.append(Block, LineStart, std::string::npos);
+                break;
+            }
+            std::string_view Line(Block.data() + LineStart, LineEnd - LineStart);
+            if(!PartialLine.empty())
+            {
+                PartialLine.append(Line);
+                Line = PartialLine;
+            }
+            // Lines without a timestamp belong to the record before them
+            int64_t Timestamp = ((!Line.empty()) && ('[' == Line.front())) ? LogArchive::parseTimestamp(Line.substr(1)) : LOG_ARCHIVE_NO_TIMESTAMP;
+            if(LOG_ARCHIVE_NO_TIMESTAMP != Timestamp)
+            {
+                IsIncluded = (Timestamp >= from) && (Timestamp <= to);
+            }
+            if(IsIncluded)
+            {
+                onRecord(Line);
+            }
+            PartialLine.clear();
+            LineStart = LineEnd + 1;
+        }
+    }
+    if(!PartialLine.empty() && IsIncluded)
+    {
+        onRecord(PartialLine);
+    }
+    return true;
+}
+/**
+ * @brief Append the records of a time range to a log file
+ */
+bool LogArchiveReader::dumpToLogFile(const std::string& fileName, int64_t from, int64_t to) const
+{
+    std::ofstream FileHandle(fileName, std::ios::app);
+    if(!FileHandle.is_open())
+    {
+        std::cerr << "Failed to open file for dumping: " << fileName << std::endl;
+        return false;
+    }
+    bool IsRead = readRange(from, to, [&FileHandle](std::string_view Record)
+    {
+        FileHandle << Record << '\n';
+    });
+    FileHandle.close();
+    if(!IsRead)
+    {
+        std::cerr << "Archive is damaged, dumped the records before the damage: " << m_fileName << std::endl;
+        return false;
+    }
+    std::cout << "Logs dumped to: " << fileName << std::endl;
+    return true;
+}
+/**
+ * @brief helper function to rebuild the index from the frame headers
+ */
+bool LogArchiveReader::scanFrames(uint64_t fileSize)
+{
+    // An archive written by an interrupted run, every whole frame stays readable
+    std::ifstream Archive(m_fileName, std::ios::binary);
+    uint64_t Offset = sizeof(LOG_ARCHIVE_MAGIC);
+    LogArchive::FrameHeader Header{};
+    while((Offset + sizeof(Header)) <= fileSize)
+    {
+        Archive.seekg(static_cast<std::streamoff>(Offset));
+        if(!Archive.read(reinterpret_cast<char*>(&Header), sizeof(Header)) || (LOG_ARCHIVE_FRAME_MAGIC != Header.magic)
+           || ((Offset + sizeof(Header) + Header.compressedSize) > fileSize))
+        {
+            break;
+        }
+        m_index.push_back(LogArchive::IndexEntry{Offset, Header.firstTimestamp, Header.lastTimestamp});
+        Offset += sizeof(Header) + Header.compressedSize;
+    }
+    return true;
+}
+} // namespace App
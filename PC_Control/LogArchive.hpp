@@ -0,0 +1,189 @@
+/**
+ * @file LogArchive.hpp
+ * @brief Header file for the compressed archive of sealed log segments
+ *
+ * A logger seals its file once it reaches the segment size and hands it to
+ * the archive thread, which compresses it with a small LZ77 block codec into
+ * a framed file next to it. Each frame holds whole lines of up to
+ * LOG_ARCHIVE_BLOCK_SIZE bytes together with the first and last timestamp of
+ * its records, and an index at the end of the file lists every frame, so a
+ * reader decompresses only the frames of the time range it asks for.
+ *
+ * File layout, integers in host byte order:
+ *     LOG_ARCHIVE_MAGIC
+ *     frame:  FrameHeader, compressed block       (repeated)
+ *     index:  IndexEntry per frame
+ *     footer: Footer
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <atomic>                ///< For std::atomic counters
+#include <condition_variable>    ///< For std::condition_variable
+#include <cstddef>               ///< For size_t
+#include <cstdint>               ///< For fixed width integer types
+#include <deque>                 ///< For std::deque
+#include <functional>            ///< For std::function
+#include <limits>                ///< For std::numeric_limits
+#include <mutex>                 ///< For std::mutex
+#include <string>                ///< For std::string class operations
+#include <string_view>           ///< For std::string_view
+#include <thread>                ///< For std::thread
+#include <vector>                ///< For std::vector
+
+constexpr char LOG_ARCHIVE_MAGIC[8]{'P', 'C', 'L', 'Z', '0', '0', '1', '\n'};  ///< Identifies an archive file
+constexpr uint32_t LOG_ARCHIVE_FRAME_MAGIC{0x4D52464CU};   ///< Marks the start of a frame
+constexpr uint32_t LOG_ARCHIVE_FOOTER_MAGIC{0x5844494CU};  ///< Marks a complete index
+constexpr size_t LOG_ARCHIVE_BLOCK_SIZE{64 * 1024};        ///< Raw bytes per frame, within the reach of a match offset
+constexpr size_t LOG_ARCHIVE_HASH_BITS{12};                ///< log2 of the match finder table entries
+constexpr size_t LOG_ARCHIVE_MIN_MATCH{4};                 ///< Shortest match worth an offset
+constexpr char LOG_ARCHIVE_EXTENSION[]{".lz"};             ///< Appended to the name of a compressed segment
+constexpr int64_t LOG_ARCHIVE_NO_TIMESTAMP{-1};            ///< Frame without a timestamped record
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @class LogArchive
+ * @brief Block codec and background compression of sealed log segments
+ */
+class LogArchive
+{
+    public:
+        /**
+         * @brief Header in front of every compressed block
+         */
+        struct FrameHeader
+        {
+            uint32_t magic{LOG_ARCHIVE_FRAME_MAGIC};        ///< LOG_ARCHIVE_FRAME_MAGIC
+            uint32_t rawSize{};                              ///< Bytes of the decompressed block
+            uint32_t compressedSize{};                       ///< Bytes of the compressed block following the header
+            uint32_t reserved{};                             ///< Zero, keeps the timestamps aligned
+            int64_t firstTimestamp{LOG_ARCHIVE_NO_TIMESTAMP};  ///< Timestamp of the first record, see parseTimestamp()
+            int64_t lastTimestamp{LOG_ARCHIVE_NO_TIMESTAMP};   ///< Timestamp of the last record
+        };
+        /**
+         * @brief Index entry of a frame
+         */
+        struct IndexEntry
+        {
+            uint64_t offset{};                               ///< File offset of the frame header
+            int64_t firstTimestamp{LOG_ARCHIVE_NO_TIMESTAMP};  ///< Timestamp of the first record
+            int64_t lastTimestamp{LOG_ARCHIVE_NO_TIMESTAMP};   ///< Timestamp of the last record
+        };
+        /**
+         * @brief Last bytes of a complete archive
+         */
+        struct Footer
+        {
+            uint64_t indexOffset{};                          ///< File offset of the first index entry
+            uint32_t frameCount{};                           ///< Number of index entries
+            uint32_t magic{LOG_ARCHIVE_FOOTER_MAGIC};        ///< LOG_ARCHIVE_FOOTER_MAGIC
+        };
+        /**
+         * @brief Start the thread compressing the submitted segments
+         */
+        static void start();
+        /**
+         * @brief Compress the segments still waiting and stop the thread
+         */
+        static void stop();
+        /**
+         * @brief Queue a sealed segment for compression, thread safe
+         * @param segmentPath Segment file, replaced by segmentPath + LOG_ARCHIVE_EXTENSION once compressed
+         */
+        static void submit(const std::string& segmentPath);
+        /**
+         * @brief Compress a segment into an archive and remove the segment
+         * @return False if the archive could not be written, the segment is then kept
+         */
+        static bool compressSegment(const std::string& segmentPath);
+        /**
+         * @brief Compress a block of at most LOG_ARCHIVE_BLOCK_SIZE bytes
+         * @param data Raw bytes
+         * @param size Number of raw bytes
+         * @param output Replaced with the compressed block
+         */
+        static void compressBlock(const char* data, size_t size, std::string& output);
+        /**
+         * @brief Decompress a block
+         * @param data Compressed bytes
+         * @param size Number of compressed bytes
+         * @param rawSize Size of the block before compression
+         * @param output Replaced with the raw bytes
+         * @return False if the block is malformed
+         */
+        static bool decompressBlock(const char* data, size_t size, size_t rawSize, std::string& output);
+        /**
+         * @brief Convert a "YYYY-MM-DD HH:MM:SS" prefix into the sortable number YYYYMMDDHHMMSS
+         * @return LOG_ARCHIVE_NO_TIMESTAMP if the text does not start with a timestamp
+         */
+        static int64_t parseTimestamp(std::string_view text);
+        /**
+         * @brief Print compression statistics.
+         */
+        static void printStatistics();
+    private:
+        static std::mutex s_archiveMutex;                   ///< Protects the pending segments
+        static std::condition_variable s_archiveCondition;  ///< Wakes the archive thread
+        static std::deque<std::string> s_pendingSegments;   ///< Sealed segments waiting for compression
+        static bool s_isRunning;                            ///< Archive thread is running
+        static std::thread s_archiveThread;                 ///< Compresses the segments
+        static std::atomic<uint64_t> s_segmentCount;       ///< Segments compressed
+        static std::atomic<uint64_t> s_rawBytes;           ///< Bytes of the compressed segments
+        static std::atomic<uint64_t> s_compressedBytes;    ///< Bytes of the archives written
+        /**
+         * @brief Archive thread loop compressing the pending segments
+         */
+        static void compressSegments();
+};
+
+/**
+ * @class LogArchiveReader
+ * @brief Streams the records of an archive, decompressing only the frames of a time range
+ */
+class LogArchiveReader
+{
+    public:
+        /**
+         * @brief Constructor to set the archive file
+         */
+        explicit LogArchiveReader(const std::string& fileName);
+        /**
+         * @brief Read the frame index, scans the frames if the archive has no complete index
+         * @return False if the file is no archive
+         */
+        bool open();
+        /**
+         * @brief Get the number of frames
+         */
+        size_t getFrameCount() const { return m_index.size(); }
+        /**
+         * @brief Stream the records of a time range in file order
+         * @param from First timestamp, see LogArchive::parseTimestamp()
+         * @param to Last timestamp, inclusive
+         * @param onRecord Receives each record without its newline
+         * @return False if a frame is damaged, the records before it were delivered
+         */
+        bool readRange(int64_t from, int64_t to, const std::function<void(std::string_view)>& onRecord) const;
+        /**
+         * @brief Append the records of a time range to a log file
+         */
+        bool dumpToLogFile(const std::string& fileName, int64_t from = std::numeric_limits<int64_t>::min(),
+                           int64_t to = std::numeric_limits<int64_t>::max()) const;
+    private:
+        std::string m_fileName{};                       ///< Archive file
+        std::vector<LogArchive::IndexEntry> m_index{};  ///< Every frame in file order
+        /**
+         * @brief helper function to rebuild the index from the frame headers
+         */
+        bool scanFrames(uint64_t fileSize);
+};
+} // namespace App
@@ -15,7 +15,16 @@
 #include <chrono>
 #include <ctime>
 #include <sstream>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
 #include "Logger.hpp"
+#include "EventChannel.hpp"
+#include "LogArchive.hpp"    // Only for the archive extension, segments reach the archiver through the listener
 
 /************************************
  * NAMESPACES
@@ -27,56 +36,78 @@
  */
 namespace App
 {
+    std::atomic<uint64_t> Logger::s_droppedCount{0};
+    std::atomic<uint64_t> Logger::s_filteredCount{0};
+    std::atomic<bool> Logger::s_isBatchedWritesEnabled{false};
+    std::atomic<size_t> Logger::s_segmentSize{LOGGER_SEGMENT_SIZE};
+    std::function<void(const std::string&)> Logger::s_segmentListener;
+    std::atomic<Logger*> Logger::s_registeredLoggers[LOGGER_MAX_REGISTERED]{};
+    std::mutex Logger::s_registryMutex;
     /************************************
      * PUBLIC FUNCTIONS
      ************************************/
-    Logger::Logger(Levels logLevel, const std::string& logFileName, bool writeToConsole) : m_logLevel{logLevel}, m_isWriteToFileEnabled{!logFileName.empty()}, m_isWriteToConsoleEnabled{writeToConsole}
+    Logger::Logger(Levels logLevel, const std::string& logFileName, bool writeToConsole) : m_logLevel{logLevel}, m_batchBuffer{std::make_unique_for_overwrite<char[]>(LOGGER_BATCH_BUFFER_SIZE)}, m_isWriteToFileEnabled{!logFileName.empty()}, m_isWriteToConsoleEnabled{writeToConsole}
     {
         if(m_isWriteToFileEnabled)
         {
-            m_logFileHandle.open(logFileName, std::ios::app);
-            if(!m_logFileHandle.is_open())
+            m_isWriteToFileEnabled = openLogFile(logFileName);
+            if(!m_isWriteToFileEnabled)
             {
                 std::cerr << "Un-able to open the log file" << std::endl;
-                m_isWriteToFileEnabled = false;
             }
         }
+        // The crash handler only reaches registered loggers, the buffer is allocated before it may run
+        std::lock_guard<std::mutex> lock(s_registryMutex);
+        bool isRegistered = false;
+        for(auto& Slot : s_registeredLoggers)
+        {
+            if(nullptr == Slot.load(std::memory_order_relaxed))
+            {
+                Slot.store(this, std::memory_order_release);
+                isRegistered = true;
+                break;
+            }
+        }
+        if(!isRegistered)
+        {
+            std::cerr << "Logger registry is full, a crash loses the batched records of: " << logFileName << std::endl;
+        }
     }
     Logger::~Logger()
     {
-        if(m_logFileHandle.is_open())
         {
-            m_logFileHandle.close();
+            std::lock_guard<std::mutex> lock(s_registryMutex);
+            for(auto& Slot : s_registeredLoggers)
+            {
+                if(this == Slot.load(std::memory_order_relaxed))
+                {
+                    Slot.store(nullptr, std::memory_order_release);
+                    break;
+                }
+            }
         }
+        std::lock_guard<std::mutex> lock(m_logMutex);
+        closeLogFile();
     }
     void Logger::setWriteToFile(bool enabled, const std::string& fileName)
     {
         std::lock_guard<std::mutex> lock(m_logMutex);
         if(enabled && (!fileName.empty()))
         {
-            if(m_logFileHandle.is_open())
-            {
-                m_logFileHandle.close();
-            }
-            m_logFileName = fileName;
-            m_logFileHandle.open(m_logFileName, std::ios::app);
-            m_isWriteToFileEnabled = m_logFileHandle.is_open();
+            closeLogFile();
+            m_isWriteToFileEnabled = openLogFile(fileName);
         }
         else if(enabled && (fileName.empty()))
         {
-            if(!(m_logFileHandle.is_open()))
+            if(-1 == m_logFileDescriptor.load(std::memory_order_relaxed))
             {
-                m_logFileHandle.open(m_logFileName, std::ios::app);
-                m_isWriteToFileEnabled = m_logFileHandle.is_open();
+                m_isWriteToFileEnabled = openLogFile(m_logFileName);
             }
         }
         else
         {
             m_isWriteToFileEnabled = false;
-            if(m_logFileHandle.is_open())
-            {
-                m_logFileHandle.close();
-            }
+            closeLogFile();
         }
     }
     
@@ -123,8 +154,84 @@ namespace App
         {
             std::cout << "Log file: " << m_logFileName << std::endl;
         }
+        std::cout << "Batched writes: " << (isBatchedWritesEnabled() ? "Enabled" : "Disabled") << std::endl;
+        std::cout << "Pending batch: " << m_batchSize.load(std::memory_order_relaxed) << " bytes" << std::endl;
+        std::cout << "Sealed segments: " << m_sealedSegmentCount << std::endl;
         std::cout << "=========================" << std::endl;
     }
+
+    void Logger::setBatchedWrites(bool enabled)
+    {
+        s_isBatchedWritesEnabled.store(enabled, std::memory_order_relaxed);
+        if(!enabled)
+        {
+            flushAll();
+        }
+    }
+
+    void Logger::flushAll(void)
+    {
+        std::lock_guard<std::mutex> lock(s_registryMutex);
+        for(auto& Slot : s_registeredLoggers)
+        {
+            Logger* RegisteredLogger = Slot.load(std::memory_order_acquire);
+            if(nullptr != RegisteredLogger)
+            {
+                RegisteredLogger->flushLogfile();
+            }
+        }
+    }
+
+    void Logger::setSegmentSize(size_t segmentSize)
+    {
+        s_segmentSize.store(segmentSize, std::memory_order_relaxed);
+    }
+
+    void Logger::setSegmentListener(std::function<void(const std::string&)> listener)
+    {
+        s_segmentListener = std::move(listener);
+    }
+
+    void Logger::setAllLogLevels(Levels logLevel)
+    {
+        std::lock_guard<std::mutex> lock(s_registryMutex);
+        for(auto& Slot : s_registeredLoggers)
+        {
+            Logger* RegisteredLogger = Slot.load(std::memory_order_acquire);
+            if(nullptr != RegisteredLogger)
+            {
+                RegisteredLogger->setLogLevel(logLevel);
+            }
+        }
+    }
+
+    bool Logger::installCrashHandler(void)
+    {
+        // A stack overflow leaves no stack for the handler, it runs on its own
+        static char CrashStack[LOGGER_CRASH_STACK_SIZE];
+        stack_t AlternateStack{};
+        AlternateStack.ss_sp = CrashStack;
+        AlternateStack.ss_size = sizeof(CrashStack);
+        if(-1 == sigaltstack(&AlternateStack, nullptr))
+        {
+            std::cerr << "Unable to set the crash handler stack: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        struct sigaction CrashAction{};
+        CrashAction.sa_handler = handleCrashSignal;
+        sigemptyset(&CrashAction.sa_mask);
+        // The default action is restored on entry, re-raising the signal then ends the process as before
+        CrashAction.sa_flags = SA_ONSTACK | SA_RESETHAND;
+        for(int SignalNumber : {SIGSEGV, SIGABRT, SIGBUS})
+        {
+            if(-1 == sigaction(SignalNumber, &CrashAction, nullptr))
+            {
+                std::cerr << "Unable to install the crash handler: " << std::strerror(errno) << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
     /************************************
      * PRIVATE FUNCTIONS
      ************************************/
@@ -165,6 +272,7 @@ namespace App
         /* Filter out messages below the current log level */
         if(level < m_logLevel)
         {
+            s_filteredCount.fetch_add(1, std::memory_order_relaxed);
             return;
         }
         else
@@ -172,18 +280,20 @@ namespace App
             std::lock_guard<std::mutex> lock(m_logMutex);
             std::string formattedMessage = formatMessage(level, message);
             m_buffer.push_back(formattedMessage);
-            if(m_isWriteToConsoleEnabled)
+            if(m_isWriteToConsoleEnabled && EventChannel::isEnabled(level))
             {
-                std::cout << formattedMessage << std::endl;
+                /* Console output is written by the event channel thread */
+                EventChannel::publish(level, formattedMessage);
             }
             else
             {
                 /* Do nothing */
             }
-            if(m_isWriteToFileEnabled && m_logFileHandle.is_open())
+            if(m_isWriteToFileEnabled && (-1 != m_logFileDescriptor.load(std::memory_order_relaxed)))
             {
-                m_logFileHandle << formattedMessage << std::endl;
-                m_logFileHandle.flush();
+                formattedMessage.push_back('\n');
+                writeRecord(formattedMessage);
+                sealSegmentIfFull();
             }
             else
             {
@@ -191,4 +301,160 @@ namespace App
             }
         }
     }
+
+    bool Logger::openLogFile(const std::string& fileName)
+    {
+        m_logFileName = fileName;
+        int FileDescriptor = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        // An existing file counts towards its segment size
+        off_t FileSize = (-1 != FileDescriptor) ? ::lseek(FileDescriptor, 0, SEEK_END) : 0;
+        m_fileSize = (FileSize > 0) ? static_cast<size_t>(FileSize) : 0;
+        m_logFileDescriptor.store(FileDescriptor, std::memory_order_release);
+        return (-1 != FileDescriptor);
+    }
+
+    void Logger::sealSegmentIfFull(void)
+    {
+        size_t SegmentSize = s_segmentSize.load(std::memory_order_relaxed);
+        if((0 == SegmentSize) || (m_fileSize < SegmentSize) || (-1 == m_logFileDescriptor.load(std::memory_order_relaxed)))
+        {
+            return;
+        }
+        // Sealed segments sort by name in the order they were written
+        auto Now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        std::string SegmentPath = m_logFileName + "." + std::to_string(Now);
+        while((0 == ::access(SegmentPath.c_str(), F_OK)) || (0 == ::access((SegmentPath + LOG_ARCHIVE_EXTENSION).c_str(), F_OK)))
+        {
+            SegmentPath = m_logFileName + "." + std::to_string(++Now);
+        }
+        closeLogFile();
+        bool IsSealed = (0 == std::rename(m_logFileName.c_str(), SegmentPath.c_str()));
+        m_isWriteToFileEnabled = openLogFile(m_logFileName);
+        if(!IsSealed)
+        {
+            std::cerr << "Unable to seal log segment: " << m_logFileName << std::endl;
+            // Retried once the file grew by another segment
+            m_fileSize = 0;
+            return;
+        }
+        m_sealedSegmentCount++;
+        if(s_segmentListener)
+        {
+            s_segmentListener(SegmentPath);
+        }
+        else
+        {
+            /* Do nothing */
+        }
+    }
+
+    void Logger::writeToFile(int fileDescriptor, const char* data, size_t size, size_t recordCount)
+    {
+        if(writeAll(fileDescriptor, data, size))
+        {
+            m_fileSize += size;
+        }
+        else
+        {
+            s_droppedCount.fetch_add(recordCount, std::memory_order_relaxed);
+        }
+    }
+
+    void Logger::closeLogFile(void)
+    {
+        writeBatch();
+        int FileDescriptor = m_logFileDescriptor.exchange(-1, std::memory_order_acq_rel);
+        if(-1 != FileDescriptor)
+        {
+            ::close(FileDescriptor);
+        }
+    }
+
+    void Logger::writeBatch(void)
+    {
+        size_t BatchSize = m_batchSize.load(std::memory_order_relaxed);
+        int FileDescriptor = m_logFileDescriptor.load(std::memory_order_relaxed);
+        if((0 != BatchSize) && (-1 != FileDescriptor))
+        {
+            writeToFile(FileDescriptor, m_batchBuffer.get(), BatchSize, m_batchRecordCount);
+        }
+        else
+        {
+            // Without a file the batched records are lost
+            s_droppedCount.fetch_add(m_batchRecordCount, std::memory_order_relaxed);
+        }
+        m_batchSize.store(0, std::memory_order_release);
+        m_batchRecordCount = 0;
+    }
+
+    void Logger::writeRecord(const std::string& record)
+    {
+        if(!isBatchedWritesEnabled())
+        {
+            // Writing each record keeps it on disk even without the crash handler
+            writeBatch();
+            writeToFile(m_logFileDescriptor.load(std::memory_order_relaxed), record.data(), record.size(), 1);
+            return;
+        }
+        size_t BatchSize = m_batchSize.load(std::memory_order_relaxed);
+        if((BatchSize + record.size()) > LOGGER_BATCH_BUFFER_SIZE)
+        {
+            writeBatch();
+            BatchSize = 0;
+        }
+        if(record.size() > LOGGER_BATCH_BUFFER_SIZE)
+        {
+            writeToFile(m_logFileDescriptor.load(std::memory_order_relaxed), record.data(), record.size(), 1);
+            return;
+        }
+        std::memcpy(m_batchBuffer.get() + BatchSize, record.data(), record.size());
+        // The crash handler reads the size, the record bytes are complete before it grows
+        m_batchSize.store(BatchSize + record.size(), std::memory_order_release);
+    }
+
+    bool Logger::writeAll(int fileDescriptor, const char* data, size_t size)
+    {
+        while(size > 0)
+        {
+            ssize_t Written = ::write(fileDescriptor, data, size);
+            if(Written < 0)
+            {
+                if(EINTR == errno)
+                {
+                    continue;
+                }
+                return false;
+            }
+            data += Written;
+            size -= static_cast<size_t>(Written);
+        }
+        return true;
+    }
+
+    void Logger::handleCrashSignal(int signalNumber)
+    {
+        // Only write() and raise() run here, the crashed thread may hold any lock or be inside malloc
+        int SavedErrno = errno;
+        for(auto& Slot : s_registeredLoggers)
+        {
+            Logger* RegisteredLogger = Slot.load(std::memory_order_acquire);
+            if(nullptr == RegisteredLogger)
+            {
+                continue;
+            }
+            int FileDescriptor = RegisteredLogger->m_logFileDescriptor.load(std::memory_order_acquire);
+            size_t BatchSize = RegisteredLogger->m_batchSize.load(std::memory_order_acquire);
+            if((-1 != FileDescriptor) && (0 != BatchSize))
+            {
+                writeAll(FileDescriptor, RegisteredLogger->m_batchBuffer.get(), BatchSize);
+            }
+        }
+        // Format the signal number without the allocating stream functions
+        char Notice[]{"Fatal signal   : batched log records written\n"};
+        Notice[13] = static_cast<char>('0' + ((signalNumber / 10) % 10));
+        Notice[14] = static_cast<char>('0' + (signalNumber % 10));
+        writeAll(STDERR_FILENO, Notice, sizeof(Notice) - 1);
+        errno = SavedErrno;
+        raise(signalNumber);
+    }
 }
@@ -20,6 +20,14 @@
 #include <fstream>
 #include <mutex>
 #include <memory>
+#include <atomic>
+#include <iostream>
+#include <functional>
+
+constexpr size_t LOGGER_BATCH_BUFFER_SIZE{16384};   ///< Bytes of formatted records a batching logger holds before writing
+constexpr size_t LOGGER_MAX_REGISTERED{64};         ///< Loggers the crash handler and flushAll() can reach
+constexpr size_t LOGGER_CRASH_STACK_SIZE{65536};    ///< Alternate stack the crash handler runs on, covers stack overflows
+constexpr size_t LOGGER_SEGMENT_SIZE{4 * 1024 * 1024};  ///< File size at which a log is sealed and compressed in the background
 /************************************
  * NAMESPACES
  ************************************/
@@ -37,6 +45,16 @@ namespace App
      * This class provides a logging mechanism that is safe for use in
      * a multi-threaded environment. It supports logging messages to
      * both console and file outputs.
+     *
+     * File output is written per record by default. With batched writes
+     * enabled records collect in a buffer allocated at construction and
+     * reach the file in one write() when it fills or on a flush. The crash
+     * handler writes the pending records of every logger on SIGSEGV,
+     * SIGABRT and SIGBUS, so a batch is not lost when the process dies.
+     *
+     * A file that reaches the segment size is sealed under its name plus a
+     * millisecond timestamp and handed to the segment listener, e.g. the
+     * archiver compressing it.
      */
     class Logger
     {
@@ -147,16 +165,12 @@ namespace App
                 std::cout << "Log buffer cleared." << std::endl;
             }
             /**
-             * @brief Flush log buffer.
+             * @brief Write the batched records to the log file.
              */
             inline void flushLogfile(void)
             {
                 std::lock_guard<std::mutex> lock(m_logMutex);
-                if(m_logFileHandle.is_open())
-                {
-                    m_logFileHandle.flush();
-                }
-                
+                writeBatch();
             }
             /**
              * @brief Set write to file parameter.
@@ -174,12 +188,76 @@ namespace App
              * @brief Print some statistics.
              */
             void printStatistics(void);
+            /**
+             * @brief Get the number of records every logger failed to write to its file.
+             */
+            static inline uint64_t getDroppedCount(void)
+            {
+                return s_droppedCount.load(std::memory_order_relaxed);
+            }
+            /**
+             * @brief Get the number of messages every logger filtered out below its level.
+             */
+            static inline uint64_t getFilteredCount(void)
+            {
+                return s_filteredCount.load(std::memory_order_relaxed);
+            }
+            /**
+             * @brief Batch file writes of every logger instead of writing each record.
+             */
+            static void setBatchedWrites(bool enabled);
+            /**
+             * @brief Check if file writes are batched.
+             */
+            static inline bool isBatchedWritesEnabled(void)
+            {
+                return s_isBatchedWritesEnabled.load(std::memory_order_relaxed);
+            }
+            /**
+             * @brief Write the batched records of every logger, bounds how long a record waits.
+             */
+            static void flushAll(void);
+            /**
+             * @brief Set the file size at which logs are sealed for compression, 0 never seals.
+             */
+            static void setSegmentSize(size_t segmentSize);
+            /**
+             * @brief Set the function receiving the path of every sealed segment.
+             *
+             * Called with the log mutex of the sealing logger held, set before
+             * other threads log. Without a listener sealed segments stay as they are.
+             */
+            static void setSegmentListener(std::function<void(const std::string&)> listener);
+            /**
+             * @brief Set the log level of every logger.
+             */
+            static void setAllLogLevels(Levels logLevel);
+            /**
+             * @brief Install the handler writing the batched records on SIGSEGV, SIGABRT and SIGBUS.
+             *
+             * The handler runs on an alternate stack of the calling thread, so call it
+             * from the main thread before other threads start. The default action of
+             * the signal follows once the records are written.
+             */
+            static bool installCrashHandler(void);
         private:
+            static std::atomic<uint64_t> s_droppedCount;
+            static std::atomic<uint64_t> s_filteredCount;
+            static std::atomic<bool> s_isBatchedWritesEnabled;
+            static std::atomic<size_t> s_segmentSize;
+            static std::function<void(const std::string&)> s_segmentListener;
+            static std::atomic<Logger*> s_registeredLoggers[LOGGER_MAX_REGISTERED];
+            static std::mutex s_registryMutex;
             Levels m_logLevel;
             std::vector<std::string> m_buffer;
             mutable std::mutex m_logMutex;
             std::string m_logFileName;
-            std::ofstream m_logFileHandle;
+            std::atomic<int> m_logFileDescriptor{-1};
+            std::unique_ptr<char[]> m_batchBuffer;
+            std::atomic<size_t> m_batchSize{0};
+            size_t m_batchRecordCount{0};
+            size_t m_fileSize{0};
+            uint64_t m_sealedSegmentCount{0};
             bool m_isWriteToFileEnabled;
             bool m_isWriteToConsoleEnabled;
             /**
@@ -198,6 +276,38 @@ namespace App
              * @brief helper function to log the message into the buffer
              */
             void logMessage(Levels level, const std::string& message);
+            /**
+             * @brief helper function to open the log file for appending
+             */
+            bool openLogFile(const std::string& fileName);
+            /**
+             * @brief helper function to write the batch and close the log file
+             */
+            void closeLogFile(void);
+            /**
+             * @brief helper function to write the batched records, call with the log mutex held
+             */
+            void writeBatch(void);
+            /**
+             * @brief helper function to write a record to the file, batched or directly
+             */
+            void writeRecord(const std::string& record);
+            /**
+             * @brief helper function to write to the log file and count its size, or the lost records
+             */
+            void writeToFile(int fileDescriptor, const char* data, size_t size, size_t recordCount);
+            /**
+             * @brief helper function to seal the log file once it reached the segment size
+             */
+            void sealSegmentIfFull(void);
+            /**
+             * @brief helper function to write a whole range, async-signal-safe
+             */
+            static bool writeAll(int fileDescriptor, const char* data, size_t size);
+            /**
+             * @brief helper function to write the batches of every logger when the process crashes
+             */
+            static void handleCrashSignal(int signalNumber);
     };
      /**
       * @brief Singleton logger for global access
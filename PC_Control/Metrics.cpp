@@ -0,0 +1,288 @@
+/**
+ * @file Metrics.cpp
+ * @brief Source file for process metrics
+ *
+ * Provides counters, per-command handler latency and per-class queueing
+ * latency histograms kept in per-thread blocks that only their owning thread
+ * writes, a scrape sums every block into a Prometheus text snapshot without
+ * blocking the request path
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <cstring>           ///< For strncpy and strncmp
+#include <map>               ///< For std::map
+#include <sstream>           ///< For std::ostringstream
+#include "Metrics.hpp"
+
+const std::string METRICS_PREFIX{"pccontrol_"};         ///< Prefix of every metric name
+const std::string METRICS_OTHER_COMMAND{"other"};       ///< Label of the commands beyond the slot limit
+constexpr const char* PRIORITY_CLASS_LABELS[]{"high", "normal", "low"};   ///< Indexed by RequestPriority
+static_assert(std::size(PRIORITY_CLASS_LABELS) == App::REQUEST_PRIORITY_COUNT, "Every priority class needs a label");
+
+/**
+ * @brief Name and help text of each MetricCounter
+ */
+struct CounterDescription
+{
+    const char* name;     ///< Metric name without the common prefix
+    const char* help;     ///< Metric description
+};
+constexpr CounterDescription COUNTER_DESCRIPTIONS[]{
+    {"connections_accepted_total", "Client connections accepted"},
+    {"connections_closed_total",   "Client connections closed"},
+    {"received_bytes_total",       "Bytes received from clients"},
+    {"sent_bytes_total",           "Bytes sent to clients"},
+    {"handler_failures_total",     "Requests whose handler failed or threw"},
+    {"connections_timed_out_total", "Client connections closed by an idle, read or write timeout"},
+    {"rejected_requests_total",    "Requests answered busy instead of being queued"},
+};
+static_assert(std::size(COUNTER_DESCRIPTIONS) == App::METRIC_COUNTER_COUNT, "Every counter needs a description");
+
+/**
+ * @brief helper function to add to a counter that only the calling thread writes
+ */
+static void addToOwnCounter(std::atomic<uint64_t>& counter, uint64_t value)
+{
+    // A single writer needs no read-modify-write, readers see either value
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+/**
+ * @brief helper function to escape a Prometheus label value
+ */
+static std::string escapeLabel(const std::string& label)
+{
+    std::string Escaped;
+    for(char Character : label)
+    {
+        if((Character == '"') || (Character == '\\'))
+        {
+            Escaped += '\\';
+        }
+        Escaped += (Character == '\n') ? ' ' : Character;
+    }
+    return Escaped;
+}
+
+/**
+ * @brief Bucket counts and sum of a latency histogram merged over the threads
+ */
+struct MergedHistogram
+{
+    std::array<uint64_t, METRICS_LATENCY_BUCKET_COUNT> buckets{};   ///< Non-cumulative bucket counts
+    uint64_t latencySum{};                                          ///< Sum of latencies in nanoseconds
+};
+
+/**
+ * @brief helper function to write the samples of one labelled histogram
+ */
+static void appendHistogram(std::ostringstream& snapshot, const std::string& name, const std::string& label, const MergedHistogram& histogram)
+{
+    uint64_t Cumulative = 0;
+    for(size_t Bucket = 0; Bucket < METRICS_LATENCY_BUCKET_COUNT; Bucket++)
+    {
+        Cumulative += histogram.buckets[Bucket];
+        snapshot << name << "_bucket{" << label << ",le=\"";
+        if(Bucket < std::size(METRICS_LATENCY_BOUNDS_US))
+        {
+            snapshot << (METRICS_LATENCY_BOUNDS_US[Bucket] / 1e6);
+        }
+        else
+        {
+            snapshot << "+Inf";
+        }
+        snapshot << "\"} " << Cumulative << '\n';
+    }
+    snapshot << name << "_sum{" << label << "} " << (histogram.latencySum / 1e9) << '\n'
+             << name << "_count{" << label << "} " << Cumulative << '\n';
+}
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+std::mutex Metrics::s_registryMutex;
+std::vector<std::unique_ptr<Metrics::ThreadCounters>> Metrics::s_threadCounters;
+std::vector<Metrics::Gauge> Metrics::s_gauges;
+
+/**
+ * @brief Add to a counter of the calling thread, never blocks
+ */
+void Metrics::increment(MetricCounter counter, uint64_t value)
+{
+    addToOwnCounter(getThreadCounters().counters[static_cast<size_t>(counter)], value);
+}
+/**
+ * @brief Count a dispatched request and add its handler latency to the command histogram
+ * @param command The request, labelled by its first word
+ * @param latencyNanoseconds Time spent in the handler
+ */
+void Metrics::observeDispatch(const std::string& command, uint64_t latencyNanoseconds)
+{
+    ThreadCounters& Counters = getThreadCounters();
+    std::string Label = command.substr(0, command.find(' '));
+    // Find the slot of the command or publish a new one, the last slot collects the overflow
+    CommandSlot* Slot = &Counters.commands[METRICS_COMMAND_SLOTS - 1];
+    for(size_t SlotIndex = 0; SlotIndex < (METRICS_COMMAND_SLOTS - 1); SlotIndex++)
+    {
+        CommandSlot& Candidate = Counters.commands[SlotIndex];
+        if(!Candidate.isUsed.load(std::memory_order_relaxed))
+        {
+            strncpy(Candidate.command, Label.c_str(), METRICS_COMMAND_LENGTH - 1);
+            Candidate.isUsed.store(true, std::memory_order_release);
+            Slot = &Candidate;
+            break;
+        }
+        if(0 == strncmp(Candidate.command, Label.c_str(), METRICS_COMMAND_LENGTH - 1))
+        {
+            Slot = &Candidate;
+            break;
+        }
+    }
+    if((Slot == &Counters.commands[METRICS_COMMAND_SLOTS - 1]) && !Slot->isUsed.load(std::memory_order_relaxed))
+    {
+        strncpy(Slot->command, METRICS_OTHER_COMMAND.c_str(), METRICS_COMMAND_LENGTH - 1);
+        Slot->isUsed.store(true, std::memory_order_release);
+    }
+    observeLatency(Slot->latency, latencyNanoseconds);
+}
+/**
+ * @brief Add the time a request waited in the scheduler to the histogram of its priority class
+ * @param priority Priority class the request was scheduled in
+ * @param latencyNanoseconds Time from entering the scheduler to dispatch
+ */
+void Metrics::observeQueueing(RequestPriority priority, uint64_t latencyNanoseconds)
+{
+    observeLatency(getThreadCounters().queueing[static_cast<size_t>(priority)], latencyNanoseconds);
+}
+/**
+ * @brief Register a gauge read at every scrape, the reader must be thread-safe
+ * @param name Metric name without the common prefix
+ * @param help Metric description
+ * @param reader Returns the current value
+ */
+void Metrics::registerGauge(const std::string& name, const std::string& help, std::function<double()> reader)
+{
+    std::lock_guard<std::mutex> lock(s_registryMutex);
+    s_gauges.push_back(Gauge{name, help, std::move(reader)});
+}
+/**
+ * @brief Sum the blocks of every thread into a Prometheus text snapshot
+ */
+std::string Metrics::formatPrometheus()
+{
+    std::array<uint64_t, METRIC_COUNTER_COUNT> Counters{};
+    std::map<std::string, MergedHistogram> Histograms;
+    std::array<MergedHistogram, REQUEST_PRIORITY_COUNT> QueueingHistograms{};
+    auto Merge = [](MergedHistogram& Merged, const LatencyHistogram& Histogram)
+    {
+        for(size_t Bucket = 0; Bucket < METRICS_LATENCY_BUCKET_COUNT; Bucket++)
+        {
+            Merged.buckets[Bucket] += Histogram.buckets[Bucket].load(std::memory_order_relaxed);
+        }
+        Merged.latencySum += Histogram.latencySum.load(std::memory_order_relaxed);
+    };
+    std::ostringstream Snapshot;
+    std::lock_guard<std::mutex> lock(s_registryMutex);
+    for(const auto& Block : s_threadCounters)
+    {
+        for(size_t Counter = 0; Counter < METRIC_COUNTER_COUNT; Counter++)
+        {
+            Counters[Counter] += Block->counters[Counter].load(std::memory_order_relaxed);
+        }
+        for(const auto& Slot : Block->commands)
+        {
+            if(!Slot.isUsed.load(std::memory_order_acquire))
+            {
+                continue;
+            }
+            Merge(Histograms[Slot.command], Slot.latency);
+        }
+        for(size_t Class = 0; Class < REQUEST_PRIORITY_COUNT; Class++)
+        {
+            Merge(QueueingHistograms[Class], Block->queueing[Class]);
+        }
+    }
+    for(size_t Counter = 0; Counter < METRIC_COUNTER_COUNT; Counter++)
+    {
+        std::string Name = METRICS_PREFIX + COUNTER_DESCRIPTIONS[Counter].name;
+        Snapshot << "# HELP " << Name << ' ' << COUNTER_DESCRIPTIONS[Counter].help << '\n'
+                 << "# TYPE " << Name << " counter\n"
+                 << Name << ' ' << Counters[Counter] << '\n';
+    }
+    // Open connections follow from the accepted and closed counters
+    uint64_t Accepted = Counters[static_cast<size_t>(MetricCounter::CONNECTIONS_ACCEPTED)];
+    uint64_t Closed = Counters[static_cast<size_t>(MetricCounter::CONNECTIONS_CLOSED)];
+    Snapshot << "# HELP " << METRICS_PREFIX << "connections_open Client connections currently open\n"
+             << "# TYPE " << METRICS_PREFIX << "connections_open gauge\n"
+             << METRICS_PREFIX << "connections_open " << ((Accepted > Closed) ? (Accepted - Closed) : 0) << '\n';
+    for(const auto& RegisteredGauge : s_gauges)
+    {
+        std::string Name = METRICS_PREFIX + RegisteredGauge.name;
+        Snapshot << "# HELP " << Name << ' ' << RegisteredGauge.help << '\n'
+                 << "# TYPE " << Name << " gauge\n"
+                 << Name << ' ' << RegisteredGauge.reader() << '\n';
+    }
+    std::string DispatchName = METRICS_PREFIX + "dispatched_requests_total";
+    Snapshot << "# HELP " << DispatchName << " Requests handed to a handler\n"
+             << "# TYPE " << DispatchName << " counter\n";
+    for(const auto& [Command, Merged] : Histograms)
+    {
+        uint64_t Count = 0;
+        for(uint64_t BucketCount : Merged.buckets)
+        {
+            Count += BucketCount;
+        }
+        Snapshot << DispatchName << "{command=\"" << escapeLabel(Command) << "\"} " << Count << '\n';
+    }
+    std::string LatencyName = METRICS_PREFIX + "handler_latency_seconds";
+    Snapshot << "# HELP " << LatencyName << " Time spent in the request handler\n"
+             << "# TYPE " << LatencyName << " histogram\n";
+    for(const auto& [Command, Merged] : Histograms)
+    {
+        appendHistogram(Snapshot, LatencyName, "command=\"" + escapeLabel(Command) + "\"", Merged);
+    }
+    // Every class is exported from the start so a class without traffic reads as zero, not as missing
+    std::string QueueingName = METRICS_PREFIX + "queueing_latency_seconds";
+    Snapshot << "# HELP " << QueueingName << " Time a request waited in the scheduler before dispatch\n"
+             << "# TYPE " << QueueingName << " histogram\n";
+    for(size_t Class = 0; Class < REQUEST_PRIORITY_COUNT; Class++)
+    {
+        appendHistogram(Snapshot, QueueingName, std::string("class=\"") + PRIORITY_CLASS_LABELS[Class] + "\"", QueueingHistograms[Class]);
+    }
+    return Snapshot.str();
+}
+/**
+ * @brief Get the block of the calling thread, registered on first use
+ */
+Metrics::ThreadCounters& Metrics::getThreadCounters()
+{
+    thread_local ThreadCounters* Counters = nullptr;
+    if(nullptr == Counters)
+    {
+        // Blocks outlive their threads so their counts stay in the totals
+        std::lock_guard<std::mutex> lock(s_registryMutex);
+        s_threadCounters.push_back(std::make_unique<ThreadCounters>());
+        Counters = s_threadCounters.back().get();
+    }
+    return *Counters;
+}
+/**
+ * @brief helper function to add a latency to a histogram of the calling thread
+ */
+void Metrics::observeLatency(LatencyHistogram& histogram, uint64_t latencyNanoseconds)
+{
+    uint64_t LatencyMicroseconds = latencyNanoseconds / 1000;
+    size_t Bucket = 0;
+    while((Bucket < std::size(METRICS_LATENCY_BOUNDS_US)) && (LatencyMicroseconds > METRICS_LATENCY_BOUNDS_US[Bucket]))
+    {
+        Bucket++;
+    }
+    addToOwnCounter(histogram.buckets[Bucket], 1);
+    addToOwnCounter(histogram.latencySum, latencyNanoseconds);
+}
+} // namespace App
@@ -0,0 +1,135 @@
+/**
+ * @file Metrics.hpp
+ * @brief Header file for process metrics
+ *
+ * Provides counters, per-command handler latency and per-class queueing
+ * latency histograms kept in per-thread blocks that only their owning thread
+ * writes, a scrape sums every block into a Prometheus text snapshot without
+ * blocking the request path
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <array>             ///< For std::array
+#include <atomic>            ///< For std::atomic
+#include <cstdint>           ///< For fixed width integer types
+#include <functional>        ///< For std::function
+#include <memory>            ///< For std::unique_ptr
+#include <mutex>             ///< For std::mutex
+#include <string>            ///< For std::string class operations
+#include <vector>            ///< For std::vector
+#include "RequestScheduler.hpp"
+
+constexpr size_t METRICS_COMMAND_SLOTS{32};     ///< Commands tracked per thread, the last slot collects the rest
+constexpr size_t METRICS_COMMAND_LENGTH{32};    ///< Command label characters kept per slot
+constexpr uint64_t METRICS_LATENCY_BOUNDS_US[]{100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000, 250000, 1000000};  ///< Histogram bucket upper bounds
+constexpr size_t METRICS_LATENCY_BUCKET_COUNT{std::size(METRICS_LATENCY_BOUNDS_US) + 1};  ///< Buckets including +Inf
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @brief enum class MetricCounter represents the process wide counters
+ */
+enum class MetricCounter : uint8_t
+{
+    CONNECTIONS_ACCEPTED = UINT8_C(0),   ///< Client connections accepted
+    CONNECTIONS_CLOSED   = UINT8_C(1),   ///< Client connections closed
+    BYTES_RECEIVED       = UINT8_C(2),   ///< Bytes received from clients
+    BYTES_SENT           = UINT8_C(3),   ///< Bytes sent to clients
+    HANDLER_FAILURES     = UINT8_C(4),   ///< Requests whose handler failed or threw
+    CONNECTIONS_TIMED_OUT = UINT8_C(5),  ///< Client connections closed by an idle, read or write timeout
+    REQUESTS_REJECTED    = UINT8_C(6)    ///< Requests answered busy instead of being queued
+};
+constexpr size_t METRIC_COUNTER_COUNT{7};   ///< Number of counters
+
+/**
+ * @class Metrics
+ * @brief Process wide metrics with a single-writer counter block per thread
+ */
+class Metrics
+{
+    public:
+        /**
+         * @brief Add to a counter of the calling thread, never blocks
+         */
+        static void increment(MetricCounter counter, uint64_t value = 1);
+        /**
+         * @brief Count a dispatched request and add its handler latency to the command histogram
+         * @param command The request, labelled by its first word
+         * @param latencyNanoseconds Time spent in the handler
+         */
+        static void observeDispatch(const std::string& command, uint64_t latencyNanoseconds);
+        /**
+         * @brief Add the time a request waited in the scheduler to the histogram of its priority class
+         * @param priority Priority class the request was scheduled in
+         * @param latencyNanoseconds Time from entering the scheduler to dispatch
+         */
+        static void observeQueueing(RequestPriority priority, uint64_t latencyNanoseconds);
+        /**
+         * @brief Register a gauge read at every scrape, the reader must be thread-safe
+         * @param name Metric name without the common prefix
+         * @param help Metric description
+         * @param reader Returns the current value
+         */
+        static void registerGauge(const std::string& name, const std::string& help, std::function<double()> reader);
+        /**
+         * @brief Sum the blocks of every thread into a Prometheus text snapshot
+         */
+        static std::string formatPrometheus();
+    private:
+        /**
+         * @brief A latency histogram written only by its owning thread
+         */
+        struct LatencyHistogram
+        {
+            std::array<std::atomic<uint64_t>, METRICS_LATENCY_BUCKET_COUNT> buckets{};  ///< Non-cumulative bucket counts
+            std::atomic<uint64_t> latencySum{0};                                  ///< Sum of latencies in nanoseconds
+        };
+        /**
+         * @brief Dispatch count and latency histogram of a command
+         */
+        struct CommandSlot
+        {
+            std::atomic<bool> isUsed{false};                                      ///< Label is published
+            char command[METRICS_COMMAND_LENGTH]{};                               ///< Null-terminated label
+            LatencyHistogram latency{};                                           ///< Handler latency
+        };
+        /**
+         * @brief Counters written only by their owning thread
+         */
+        struct ThreadCounters
+        {
+            alignas(64) std::array<std::atomic<uint64_t>, METRIC_COUNTER_COUNT> counters{};  ///< Values per MetricCounter
+            std::array<CommandSlot, METRICS_COMMAND_SLOTS> commands{};                     ///< Per command histograms
+            std::array<LatencyHistogram, REQUEST_PRIORITY_COUNT> queueing{};               ///< Queueing latency per priority class
+        };
+        /**
+         * @brief A registered gauge
+         */
+        struct Gauge
+        {
+            std::string name;                   ///< Metric name without the common prefix
+            std::string help;                   ///< Metric description
+            std::function<double()> reader;     ///< Returns the current value
+        };
+        static std::mutex s_registryMutex;                                  ///< Protects the registries
+        static std::vector<std::unique_ptr<ThreadCounters>> s_threadCounters;  ///< Blocks of every thread that counted
+        static std::vector<Gauge> s_gauges;                                 ///< Registered gauges
+        /**
+         * @brief Get the block of the calling thread, registered on first use
+         */
+        static ThreadCounters& getThreadCounters();
+        /**
+         * @brief helper function to add a latency to a histogram of the calling thread
+         */
+        static void observeLatency(LatencyHistogram& histogram, uint64_t latencyNanoseconds);
+};
+} // namespace App
@@ -0,0 +1,124 @@
+/**
+ * @file MetricsServer.cpp
+ * @brief Source file for metrics endpoint
+ *
+ * Serves the Prometheus text snapshot of the process metrics over HTTP on a
+ * separate port, from its own thread and event loop so scrapes never share
+ * the request path
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <iostream>          ///< For std::cout
+#include <string>            ///< For std::string class operations
+#include <sys/socket.h>      ///< For socket, bind and listen
+#include <unistd.h>          ///< For close
+#include "MetricsServer.hpp"
+#include "Metrics.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+/**
+ * @brief Constructor to create the listening socket
+ * @param port The port number scrapes connect to
+ */
+MetricsServer::MetricsServer(int port)
+{
+    m_serverfileDescriptor = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(-1 == m_serverfileDescriptor)
+    {
+        m_metricsLogger.error("An error occurred while creating metrics socket");
+        exit(EXIT_FAILURE);
+    }
+    int ReuseAddress = 1;
+    setsockopt(m_serverfileDescriptor, SOL_SOCKET, SO_REUSEADDR, &ReuseAddress, sizeof(ReuseAddress));
+    m_serverStuctAddress.sin_family = AF_INET;
+    m_serverStuctAddress.sin_addr.s_addr = INADDR_ANY;
+    m_serverStuctAddress.sin_port = htons(port);
+    int SockBindState = bind(m_serverfileDescriptor, (struct sockaddr*)&m_serverStuctAddress, sizeof(m_serverStuctAddress));
+    if((-1 == SockBindState) || (-1 == listen(m_serverfileDescriptor, METRICS_BACKLOG)))
+    {
+        m_metricsLogger.error("An error occurred while binding metrics socket to IP/Port");
+        close(m_serverfileDescriptor);
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "Metrics are served on port: " << port << '\n';
+}
+/**
+ * @brief Start serving scrapes on the metrics thread
+ */
+void MetricsServer::start()
+{
+    m_loop.spawn(acceptScrapes());
+    m_metricsThread = std::thread([this]() { m_loop.run(); });
+}
+/**
+ * @brief Stop serving and wait for the metrics thread
+ */
+void MetricsServer::stop()
+{
+    m_loop.stop();
+    if(m_metricsThread.joinable())
+    {
+        m_metricsThread.join();
+    }
+}
+/**
+ * @brief Accept scrape connections until the loop stops
+ */
+Task<void> MetricsServer::acceptScrapes()
+{
+    while(!m_loop.isStopping())
+    {
+        int ClientfileDescriptor = co_await m_loop.accept(m_serverfileDescriptor);
+        if(-1 == ClientfileDescriptor)
+        {
+            if(!m_loop.isStopping())
+            {
+                m_metricsLogger.error("An error occurred while accepting metrics connection");
+            }
+            continue;
+        }
+        m_loop.spawn(serveScrape(ClientfileDescriptor));
+    }
+}
+/**
+ * @brief Read the scrape request, send the snapshot and close the connection
+ */
+Task<void> MetricsServer::serveScrape(int clientfileDescriptor)
+{
+    char Buffer[METRICS_BUFFER_SIZE];
+    // Any request is answered with the snapshot, the request line is not inspected
+    ssize_t NumberOfReceivedBytes = co_await m_loop.receive(clientfileDescriptor, Buffer, sizeof(Buffer));
+    if(NumberOfReceivedBytes > 0)
+    {
+        std::string Body = Metrics::formatPrometheus();
+        std::string Response = "HTTP/1.0 200 OK\r\n"
+                               "Content-Type: text/plain; version=0.0.4\r\n"
+                               "Content-Length: " + std::to_string(Body.size()) + "\r\n"
+                               "Connection: close\r\n\r\n" + Body;
+        bool IsSent = co_await m_loop.send(clientfileDescriptor, Response.data(), Response.size());
+        if(!IsSent && !m_loop.isStopping())
+        {
+            m_metricsLogger.error("An error occurred while sending metrics");
+        }
+    }
+    m_loop.closeFileDescriptor(clientfileDescriptor);
+}
+/**
+ * @brief Stop serving and close the listening socket
+ */
+MetricsServer::~MetricsServer()
+{
+    stop();
+    if(m_serverfileDescriptor != -1)
+    {
+        m_loop.closeFileDescriptor(m_serverfileDescriptor);
+    }
+}
+} // namespace App
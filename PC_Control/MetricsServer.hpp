@@ -0,0 +1,75 @@
+/**
+ * @file MetricsServer.hpp
+ * @brief Header file for metrics endpoint
+ *
+ * Serves the Prometheus text snapshot of the process metrics over HTTP on a
+ * separate port, from its own thread and event loop so scrapes never share
+ * the request path
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <thread>            ///< For std::thread
+#include <netinet/in.h>      ///< Internet address family structures (sockaddr_in, INADDR_ANY)
+#include "EventLoop.hpp"     ///< Coroutine event loop driving the sockets
+#include "Logger.hpp"        ///< Custom logger class for logging messages
+#include "Task.hpp"          ///< Coroutine task type
+
+constexpr int METRICS_BACKLOG{16};              ///< Maximum number of pending scrape connections
+constexpr int METRICS_BUFFER_SIZE{1024};        ///< Size of the buffer for the scrape request
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @class MetricsServer
+ * @brief Answers every HTTP request on its port with the current metrics
+ */
+class MetricsServer
+{
+    public:
+        /**
+         * @brief Constructor to create the listening socket
+         * @param port The port number scrapes connect to
+         */
+        explicit MetricsServer(int port);
+        MetricsServer(const MetricsServer&) = delete;             ///< Delete copy constructor
+        MetricsServer& operator=(const MetricsServer&) = delete;  ///< Delete copy assignment operator
+        MetricsServer(MetricsServer&&) = delete;                  ///< Delete move constructor
+        MetricsServer& operator=(MetricsServer&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Stop serving and close the listening socket
+         */
+        ~MetricsServer();
+        /**
+         * @brief Start serving scrapes on the metrics thread
+         */
+        void start();
+        /**
+         * @brief Stop serving and wait for the metrics thread
+         */
+        void stop();
+    private:
+        EventLoop m_loop{};                           ///< Event loop of the metrics thread
+        int m_serverfileDescriptor{-1};               ///< Listening socket
+        struct sockaddr_in m_serverStuctAddress{};    ///< Server address structure
+        std::thread m_metricsThread{};                ///< Runs the event loop
+        // Create Logger instance for metrics endpoint logging
+        Logger m_metricsLogger{Logger::Levels::ERROR, "MetricsLog.log", true};
+        /**
+         * @brief Accept scrape connections until the loop stops
+         */
+        Task<void> acceptScrapes();
+        /**
+         * @brief Read the scrape request, send the snapshot and close the connection
+         */
+        Task<void> serveScrape(int clientfileDescriptor);
+};
+} // namespace App
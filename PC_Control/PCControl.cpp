@@ -8,19 +8,26 @@
  * @version 1.0
  */
 
-#include <iostream>          ///< For std::cout and std::cerr
 #include <string>            ///< For std::string class operations
 #include <fstream>           ///< For file operations
 #include <functional>        ///< For std::function
 #include <cstdlib>           ///< For general utilities
+#include <cctype>            ///< For std::isspace
+#include <sstream>           ///< For std::stringstream
+#include <vector>            ///< For std::vector
 #include <signal.h>          ///< For kill signals
 #include <sys/stat.h>        ///< For chmod
 #include <unistd.h>          ///< For fork() and execlp() - UNIX system calls
 #include <sys/wait.h>        ///< For waitpid() - process waiting functions
 #include "PCControl.hpp"     ///< For std::function
 #include "Logger.hpp"
+#include "EventChannel.hpp"
 
 const char* PID_FILE = "ProcessID.pid";
+const std::string BATCH_KEYWORD{"batch"};                  ///< Prefix of a batch request
+const std::string BATCH_STOP_ON_ERROR{"--stop-on-error"};  ///< Batch option to skip the remaining steps after a failure
+constexpr char BATCH_STEP_SEPARATOR{';'};                  ///< Separates sequential steps of a batch
+constexpr char BATCH_COMMAND_SEPARATOR{'&'};               ///< Separates independent commands of a step
 
 /**
  * @namespace App
@@ -31,40 +38,299 @@ namespace App
 
 PCControl::PCControl()
 {
-    m_requestHandleTable["open_browser"] = std::bind(&PCControl::openBrowser, this);
-    m_requestHandleTable["close_browser"] = std::bind(&PCControl::closeBrowser, this);
+    insertRequestHandle("open_browser", std::bind(&PCControl::openBrowser, this), true, RequestPriority::NORMAL);
+    insertRequestHandle("close_browser", std::bind(&PCControl::closeBrowser, this), true, RequestPriority::HIGH);
 }
 /**
  * @brief Insert a request and its corresponding handler into a lookup table
  * @param request The client request to be handled
  * @param requestHandle The function to handle the specified request
+ * @param isIdempotent True if running the request twice has the same effect as running it once
+ * @param priority Scheduling class of the request unless the client carries its own
  */
-void PCControl::insertRequestHandle(std::string request, std::function<void(void)> requestHandle)
+void PCControl::insertRequestHandle(std::string request, std::function<void(void)> requestHandle, bool isIdempotent,
+                                    RequestPriority priority)
 {
-    m_requestHandleTable[request] = requestHandle;
+    m_requestHandleTable.update([&](RequestHandleTable& Table)
+    {
+        uint16_t CommandID = Table.assignID(request);
+        if(0 == CommandID)
+        {
+            m_PCControlLogger.error("No command ID left for request: " + request);
+            return;
+        }
+        Table.handles[CommandID] = RequestHandle{nullptr, "", requestHandle, isIdempotent, priority};
+    });
+}
+/**
+ * @brief Replace every command registered by a plugin with a new set
+ * @param pluginName Name identifying the plugin
+ * @param module Keeps the plugin code mapped while its handlers are reachable, null to unload
+ * @param requestHandles Commands registered by the plugin
+ */
+void PCControl::replacePluginHandles(const std::string& pluginName, std::shared_ptr<void> module,
+                                     const std::vector<PluginRequestHandle>& requestHandles)
+{
+    m_requestHandleTable.update([&](RequestHandleTable& Table)
+    {
+        // Drop the commands of the previous version of the plugin, their IDs stay reserved for them
+        for(auto& ExistingHandle : Table.handles)
+        {
+            if(ExistingHandle.pluginName == pluginName)
+            {
+                ExistingHandle = RequestHandle{};
+            }
+        }
+        for(const auto& RequestHandleEntry : requestHandles)
+        {
+            if(nullptr != Table.find(RequestHandleEntry.request))
+            {
+                m_PCControlLogger.error("Plugin " + pluginName + " cannot override request: " + RequestHandleEntry.request);
+                continue;
+            }
+            uint16_t CommandID = Table.assignID(RequestHandleEntry.request);
+            if(0 == CommandID)
+            {
+                m_PCControlLogger.error("No command ID left for request: " + RequestHandleEntry.request);
+                continue;
+            }
+            Table.handles[CommandID] = RequestHandle{module, pluginName, RequestHandleEntry.handle,
+                                                     RequestHandleEntry.isIdempotent, RequestHandleEntry.priority};
+        }
+    });
+    // The old table and the last reference to a replaced module are released by update
 }
 /**
  * @brief Handle the specified client request by invoking the corresponding handler
  * @param request The client request to be handled
+ * @return True if a handler was found and executed
  */
-void PCControl::handleRequest(std::string request)
+bool PCControl::handleRequest(std::string request)
+{
+    std::string Result;
+    return handleRequest(request, Result);
+}
+/**
+ * @brief Handle the specified client request and report its result
+ * @param request The client request to be handled
+ * @param result Filled with the result, one "command: status" entry per batch command
+ * @return True if every command was found and executed
+ */
+bool PCControl::handleRequest(std::string request, std::string& result)
 {
     // Remove any whitespace or newlines from the request
     request.erase(0, request.find_first_not_of(" \n\r\t"));  // left trim
     request.erase(request.find_last_not_of(" \n\r\t") + 1);  // right trim
+    // Batch requests carry their commands after the keyword
+    if((request.compare(0, BATCH_KEYWORD.length(), BATCH_KEYWORD) == 0) &&
+       (request.length() > BATCH_KEYWORD.length()) && std::isspace(static_cast<unsigned char>(request[BATCH_KEYWORD.length()])))
+    {
+        return handleBatchRequest(request.substr(BATCH_KEYWORD.length()), result);
+    }
+    bool IsExecuted = executeRequest(request);
+    result = IsExecuted ? "ok" : "no handler";
+    return IsExecuted;
+}
+
+/**
+ * @brief Look up and invoke the handler of a single command
+ * @param request The trimmed command
+ * @return True if a handler was found and executed
+ */
+bool PCControl::executeRequest(const std::string& request)
+{
+    // The table and the plugin code stay alive until the handler returns
+    auto Table = m_requestHandleTable.read();
     //Check if the request exists in the lookup table
-    if(m_requestHandleTable.find(request) == m_requestHandleTable.end())
+    return invokeRequestHandle(Table->find(request), request);
+}
+
+/**
+ * @brief Handle a command by its registry ID, an array index instead of a name lookup
+ * @param commandID ID from the command table of the binary handshake
+ * @param result Filled with the result
+ * @return True if a handler was found and executed
+ */
+bool PCControl::handleRequest(uint16_t commandID, std::string& result)
+{
+    auto Table = m_requestHandleTable.read();
+    const std::string& Command = (commandID < Table->commandNames.size()) ? Table->commandNames[commandID] : Table->commandNames[0];
+    bool IsExecuted = invokeRequestHandle(Table->find(commandID), Command);
+    result = IsExecuted ? "ok" : "no handler";
+    return IsExecuted;
+}
+
+/**
+ * @brief helper function to invoke a found handler
+ * @param requestHandle The handler, nullptr if none was found
+ * @param request The command, for diagnostics
+ * @return True if a handler was found and executed
+ */
+bool PCControl::invokeRequestHandle(const RequestHandle* requestHandle, const std::string& request)
+{
+    if(nullptr == requestHandle)
     {
         // Log error
-        std::cout << "No handler found for request: \"" << request << "\"" << std::endl;
         m_PCControlLogger.error("No handler found for request: " + request);
+        return false;
     }
-    else
+    if(isNoOpMode())
+    {
+        // The lookup and dispatch path is measured, the handler is not
+        return true;
+    }
+    EVENT_DEBUG("Handler found! Executing request: \"" << request << "\"");
+    // Invoke the handler function associated with the request
+    requestHandle->handle();
+    return true;
+}
+
+/**
+ * @brief Run the steps of a batch request as one unit
+ * @param batch The batch body without the "batch" keyword
+ * @param result Filled with the combined result
+ * @return True if every command was found and executed
+ */
+bool PCControl::handleBatchRequest(std::string batch, std::string& result)
+{
+    auto Trim = [](std::string& Text)
+    {
+        Text.erase(0, Text.find_first_not_of(" \n\r\t"));  // left trim
+        Text.erase(Text.find_last_not_of(" \n\r\t") + 1);  // right trim
+    };
+    Trim(batch);
+    bool IsStopOnError = false;
+    if(batch.compare(0, BATCH_STOP_ON_ERROR.length(), BATCH_STOP_ON_ERROR) == 0)
+    {
+        IsStopOnError = true;
+        batch.erase(0, BATCH_STOP_ON_ERROR.length());
+    }
+    // Split the batch into sequential steps of independent commands
+    std::vector<std::vector<std::string>> Steps;
+    std::stringstream BatchStream(batch);
+    std::string StepText;
+    while(std::getline(BatchStream, StepText, BATCH_STEP_SEPARATOR))
+    {
+        std::vector<std::string> Step;
+        std::stringstream StepStream(StepText);
+        std::string Command;
+        while(std::getline(StepStream, Command, BATCH_COMMAND_SEPARATOR))
+        {
+            Trim(Command);
+            if(!Command.empty())
+            {
+                Step.push_back(Command);
+            }
+        }
+        if(!Step.empty())
+        {
+            Steps.push_back(Step);
+        }
+    }
+    std::stringstream ResultStream;
+    bool IsSuccessful = true;
+    bool IsSkipping = false;
+    for(const auto& Step : Steps)
+    {
+        std::vector<bool> StepResults(Step.size(), false);
+        // Run on the calling thread, the handlers only start or signal processes and a thread per command
+        // would cost more than the command; a failed command does not stop the others of its step
+        for(size_t Index = 0; !IsSkipping && (Index < Step.size()); Index++)
+        {
+            StepResults[Index] = executeRequest(Step[Index]);
+        }
+        for(size_t Index = 0; Index < Step.size(); Index++)
+        {
+            if(ResultStream.tellp() > 0)
+            {
+                ResultStream << "; ";
+            }
+            ResultStream << Step[Index] << ": " << (IsSkipping ? "skipped" : (StepResults[Index] ? "ok" : "failed"));
+            if(!IsSkipping && !StepResults[Index])
+            {
+                IsSuccessful = false;
+            }
+        }
+        if(!IsSuccessful && IsStopOnError)
+        {
+            IsSkipping = true;
+        }
+    }
+    result = ResultStream.str();
+    EVENT_DEBUG("Batch result: " << result);
+    return IsSuccessful && !Steps.empty();
+}
+
+/**
+ * @brief Check if the specified request was registered as idempotent
+ * @param request The client request
+ * @return True if duplicates of the request may be merged
+ */
+bool PCControl::isIdempotent(const std::string& request) const
+{
+    auto Table = m_requestHandleTable.read();
+    const RequestHandle* Handle = Table->find(request);
+    return (nullptr != Handle) && Handle->isIdempotent;
+}
+
+/**
+ * @brief Check if the command with the specified ID was registered as idempotent
+ */
+bool PCControl::isIdempotent(uint16_t commandID) const
+{
+    auto Table = m_requestHandleTable.read();
+    const RequestHandle* Handle = Table->find(commandID);
+    return (nullptr != Handle) && Handle->isIdempotent;
+}
+
+/**
+ * @brief Get the priority the specified request was registered with
+ * @param request The client request
+ * @return The registered priority, NORMAL for unknown requests
+ */
+RequestPriority PCControl::getPriority(const std::string& request) const
+{
+    auto Table = m_requestHandleTable.read();
+    const RequestHandle* Handle = Table->find(request);
+    return (nullptr != Handle) ? Handle->priority : RequestPriority::NORMAL;
+}
+
+/**
+ * @brief Get the priority the command with the specified ID was registered with
+ */
+RequestPriority PCControl::getPriority(uint16_t commandID) const
+{
+    auto Table = m_requestHandleTable.read();
+    const RequestHandle* Handle = Table->find(commandID);
+    return (nullptr != Handle) ? Handle->priority : RequestPriority::NORMAL;
+}
+
+/**
+ * @brief Get the IDs of the registered commands, an ID stays with its command for the life of the process
+ * @return Pairs of command ID and command
+ */
+std::vector<std::pair<uint16_t, std::string>> PCControl::getCommandIDs() const
+{
+    auto Table = m_requestHandleTable.read();
+    std::vector<std::pair<uint16_t, std::string>> CommandIDs;
+    for(size_t CommandID = 1; CommandID < Table->handles.size(); CommandID++)
     {
-        std::cout << "Handler found! Executing request: \"" << request << "\"" << std::endl;
-        // Invoke the handler function associated with the request
-        m_requestHandleTable[request]();
+        if(Table->handles[CommandID].handle)
+        {
+            CommandIDs.emplace_back(static_cast<uint16_t>(CommandID), Table->commandNames[CommandID]);
+        }
     }
+    return CommandIDs;
+}
+
+/**
+ * @brief Get the command registered under an ID
+ * @return The command, empty if none is registered under the ID
+ */
+std::string PCControl::getCommandName(uint16_t commandID) const
+{
+    auto Table = m_requestHandleTable.read();
+    return (nullptr != Table->find(commandID)) ? Table->commandNames[commandID] : std::string{};
 }
 
 /**
@@ -72,27 +338,27 @@ void PCControl::handleRequest(std::string request)
  */
  void PCControl::openBrowser()
  {
-    std::cout << "Launching Firefox..." << std::endl;
+    EVENT_INFO("Launching Firefox...");
     // Creates a new process by duplicating the current process
     pid_t ProcessID = fork();
     // Check if fork() was successful
     if (ProcessID == -1)
     {
-        // Fork failed
-        std::cout << "Error: Failed to fork process" << std::endl;
-        // Log error
+        // Fork failed, log error
         m_PCControlLogger.error("Error: Failed to fork process");
+        reportProcessState("firefox", -1, "start_failed");
     }
     else if (ProcessID == 0)
     {
         // Child process
         // Try to execute Firefox
         execlp("firefox", "firefox", nullptr);
-        // If execlp returns, it failed
-        std::cout << "Error: Failed to launch Firefox" << std::endl;
-        std::cout << "Make sure Firefox is installed and in your PATH" << std::endl;
-        m_PCControlLogger.error("Error: Failed to launch Firefox");
-        m_PCControlLogger.error("Make sure Firefox is installed and in your PATH");
+        // If execlp returns, it failed. Only async-signal-safe calls are allowed in the child of a
+        // multithreaded process, the logger and event channel locks may be held by other threads
+        const char ErrorMessage[] = "Error: Failed to launch Firefox\nMake sure Firefox is installed and in your PATH\n";
+        ssize_t NumberOfWrittenBytes = write(STDERR_FILENO, ErrorMessage, sizeof(ErrorMessage) - 1);
+        (void)NumberOfWrittenBytes;
+        _exit(EXIT_FAILURE);
     }
     else
     {
@@ -102,13 +368,14 @@ void PCControl::handleRequest(std::string request)
         {
             ProcessIdFileHandler << ProcessID;
             ProcessIdFileHandler.close();
-            std::cout << "Firefox opened with PID: " << ProcessID << std::endl;
+            EVENT_INFO("Firefox opened with PID: " << ProcessID);
+            reportProcessState("firefox", ProcessID, "started");
         }
         else
         {
-            std::cout << "Error: Unable to open file to write Process ID" << std::endl;
             m_PCControlLogger.error("Error: Unable to open file to write Process ID");
             kill(ProcessID, SIGTERM);
+            reportProcessState("firefox", ProcessID, "stopping");
         }
     }
  }
@@ -118,7 +385,7 @@ void PCControl::handleRequest(std::string request)
  */
  void PCControl::closeBrowser()
  {
-    std::cout << "Attempting to close Firefox..." << std::endl;
+    EVENT_INFO("Attempting to close Firefox...");
     // Get the browser process ID
     pid_t ProcessID = m_broswerProcessID;
     if (ProcessID == -1)
@@ -133,14 +400,25 @@ void PCControl::handleRequest(std::string request)
         else
         {
             std::string error = "Error: Unable to determine Firefox process ID";
-            std::cout << error << std::endl;
             m_PCControlLogger.error(error);
             return;
         }
     }
     kill(ProcessID, SIGTERM);
+    reportProcessState("firefox", ProcessID, "stopping");
  }
 
+/**
+ * @brief helper function to report a process state change to the listener
+ */
+void PCControl::reportProcessState(const std::string& process, pid_t processID, const std::string& state) const
+{
+    if(m_processStateListener)
+    {
+        m_processStateListener(process, processID, state);
+    }
+}
+
 PCControl::~PCControl()
 {
     pid_t ProcessID = m_broswerProcessID;
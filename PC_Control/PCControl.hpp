@@ -12,7 +12,18 @@
 #include <string>            ///< For std::string class operations
 #include <functional>        ///< For std::function
 #include <unordered_map>     ///< For std::unordered_map
+#include <atomic>            ///< For std::atomic
+#include <memory>            ///< For std::shared_ptr
+#include <vector>            ///< For std::vector
+#include <utility>           ///< For std::pair
+#include <cstdint>           ///< For fixed width integer types
+#include <sys/types.h>       ///< For pid_t
 #include "Logger.hpp"
+#include "RequestScheduler.hpp"
+#include "RcuPointer.hpp"
+#include "PCControlPlugin.hpp"
+
+constexpr size_t COMMAND_ID_LIMIT{UINT16_MAX};   ///< Command IDs are 16 bit, 0 means none
 
 /**
  * @namespace App
@@ -35,17 +46,125 @@ namespace App
         ~PCControl();
         /**
          * @brief Insert a request and its corresponding handler into a lookup table
+         *
+         * Must not be called from inside a handler, it waits for running handlers to finish
+         *
          * @param request The client request to be handled
          * @param requestHandle The function to handle the specified request
+         * @param isIdempotent True if running the request twice has the same effect as running it once
+         * @param priority Scheduling class of the request unless the client carries its own
          */
-        void insertRequestHandle(std::string request, std::function<void(void)> requestHandle);
+        void insertRequestHandle(std::string request, std::function<void(void)> requestHandle, bool isIdempotent = false,
+                                 RequestPriority priority = RequestPriority::NORMAL);
         /**
          * @brief Handle the specified client request by invoking the corresponding handler
          * @param request The client request to be handled
+         * @return True if a handler was found and executed
+         */
+        bool handleRequest(std::string request);
+        /**
+         * @brief Handle the specified client request and report its result
+         *
+         * A request of the form "batch [--stop-on-error] <step>; <step>; ..." runs as one unit,
+         * steps run in order and the commands of a step joined by '&' all run even if one of them fails
+         *
+         * @param request The client request to be handled
+         * @param result Filled with the result, one "command: status" entry per batch command
+         * @return True if every command was found and executed
+         */
+        bool handleRequest(std::string request, std::string& result);
+        /**
+         * @brief Handle a command by its registry ID, an array index instead of a name lookup
+         * @param commandID ID from the command table of the binary handshake
+         * @param result Filled with the result
+         * @return True if a handler was found and executed
+         */
+        bool handleRequest(uint16_t commandID, std::string& result);
+        /**
+         * @brief Get the IDs of the registered commands, an ID stays with its command for the life of the process
+         * @return Pairs of command ID and command
+         */
+        std::vector<std::pair<uint16_t, std::string>> getCommandIDs() const;
+        /**
+         * @brief Get the command registered under an ID
+         * @return The command, empty if none is registered under the ID
+         */
+        std::string getCommandName(uint16_t commandID) const;
+        /**
+         * @brief Check if the specified request was registered as idempotent
+         * @param request The client request
+         * @return True if duplicates of the request may be merged
+         */
+        bool isIdempotent(const std::string& request) const;
+        /**
+         * @brief Check if the command with the specified ID was registered as idempotent
+         */
+        bool isIdempotent(uint16_t commandID) const;
+        /**
+         * @brief Get the priority the specified request was registered with
+         * @param request The client request
+         * @return The registered priority, NORMAL for unknown requests
+         */
+        RequestPriority getPriority(const std::string& request) const;
+        /**
+         * @brief Get the priority the command with the specified ID was registered with
+         */
+        RequestPriority getPriority(uint16_t commandID) const;
+        /**
+         * @brief Replace every command registered by a plugin with a new set
+         *
+         * The new table is published without blocking dispatch, the old one and with it
+         * the last reference to a replaced plugin module are released once in-flight
+         * handlers have finished. Must not be called from inside a handler.
+         *
+         * @param pluginName Name identifying the plugin
+         * @param module Keeps the plugin code mapped while its handlers are reachable, null to unload
+         * @param requestHandles Commands registered by the plugin
          */
-        void handleRequest(std::string request);
+        void replacePluginHandles(const std::string& pluginName, std::shared_ptr<void> module,
+                                  const std::vector<PluginRequestHandle>& requestHandles);
+        /**
+         * @brief Look up handlers without invoking them, for benchmarks that must not spawn browsers
+         * @param enabled True to skip the handler invocation
+         */
+        void setNoOpMode(bool enabled) { m_isNoOpModeEnabled.store(enabled, std::memory_order_relaxed); }
+        /**
+         * @brief Check if handlers are looked up without being invoked
+         */
+        bool isNoOpMode() const { return m_isNoOpModeEnabled.load(std::memory_order_relaxed); }
+        /**
+         * @brief Set the level of the handler log
+         */
+        void setLogLevel(Logger::Levels level) { m_PCControlLogger.setLogLevel(level); }
+        /**
+         * @brief Report the processes handlers start and stop, set before any request is handled
+         * @param listener Receives the process name, its ID and the new state, called from the handler thread
+         */
+        void setProcessStateListener(std::function<void(const std::string&, pid_t, const std::string&)> listener)
+        {
+            m_processStateListener = std::move(listener);
+        }
         private:
-        pid_t m_broswerProcessID{-1};     ///< Store broswer process ID
+        std::atomic<pid_t> m_broswerProcessID{-1};     ///< Store broswer process ID
+        std::atomic<bool> m_isNoOpModeEnabled{false};  ///< Skip handler invocation
+        std::function<void(const std::string&, pid_t, const std::string&)> m_processStateListener{};  ///< Told about process state changes
+        /**
+         * @brief helper function to report a process state change to the listener
+         */
+        void reportProcessState(const std::string& process, pid_t processID, const std::string& state) const;
+        /**
+         * @brief Look up and invoke the handler of a single command
+         * @param request The trimmed command
+         * @return True if a handler was found and executed
+         */
+        bool executeRequest(const std::string& request);
+        /**
+         * @brief Run the steps of a batch request as one unit
+         * @param batch The batch body without the "batch" keyword
+         * @param result Filled with the combined result
+         * @return True if every command was found and executed
+         */
+        bool handleBatchRequest(std::string batch, std::string& result);
         /**
          * @brief Open default browser
          */
@@ -54,8 +173,71 @@ namespace App
          * @brief Close default browser
          */  
         void closeBrowser();  
-        // Create Lookup table for request handlers
-        std::unordered_map<std::string, std::function<void(void)>> m_requestHandleTable;
+        /**
+         * @brief Registered handler and its attributes
+         */
+        struct RequestHandle
+        {
+            std::shared_ptr<void> module{};       ///< Owning plugin module, declared first so it is released last
+            std::string pluginName{};             ///< Owning plugin, empty for built-in handlers
+            std::function<void(void)> handle{};   ///< Function to handle the request
+            bool isIdempotent{false};             ///< Duplicates may be merged
+            RequestPriority priority{RequestPriority::NORMAL};  ///< Scheduling class
+        };
+        /**
+         * @brief Handlers indexed by command ID, so a binary request is dispatched by array index
+         */
+        struct RequestHandleTable
+        {
+            std::unordered_map<std::string, uint16_t> commandIDs{};   ///< ID of every command ever registered, never reused
+            std::vector<std::string> commandNames{std::string{}};     ///< Command of every ID, ID 0 means none
+            std::vector<RequestHandle> handles{RequestHandle{}};      ///< Handler of every ID, empty while unregistered
+            /**
+             * @brief Find the handler of a command, nullptr if it is not registered
+             */
+            const RequestHandle* find(const std::string& request) const
+            {
+                auto IDIterator = commandIDs.find(request);
+                return (IDIterator != commandIDs.end()) ? find(IDIterator->second) : nullptr;
+            }
+            /**
+             * @brief Find the handler registered under an ID, nullptr if none is
+             */
+            const RequestHandle* find(uint16_t commandID) const
+            {
+                return ((0 != commandID) && (commandID < handles.size()) && handles[commandID].handle) ? &handles[commandID] : nullptr;
+            }
+            /**
+             * @brief Get the ID of a command, assigning the next one to a new command
+             * @return The ID, 0 if every ID is taken
+             */
+            uint16_t assignID(const std::string& request)
+            {
+                auto IDIterator = commandIDs.find(request);
+                if(IDIterator != commandIDs.end())
+                {
+                    return IDIterator->second;
+                }
+                if(handles.size() >= COMMAND_ID_LIMIT)
+                {
+                    return 0;
+                }
+                uint16_t CommandID = static_cast<uint16_t>(handles.size());
+                commandIDs.emplace(request, CommandID);
+                commandNames.push_back(request);
+                handles.emplace_back();
+                return CommandID;
+            }
+        };
+        /**
+         * @brief helper function to invoke a found handler
+         * @param requestHandle The handler, nullptr if none was found
+         * @param request The command, for diagnostics
+         * @return True if a handler was found and executed
+         */
+        bool invokeRequestHandle(const RequestHandle* requestHandle, const std::string& request);
+        // Create Lookup table for request handlers, dispatch reads it without taking a lock
+        RcuPointer<RequestHandleTable> m_requestHandleTable{std::make_unique<RequestHandleTable>()};
         // Create Logger instance for PC Control logging
         Logger m_PCControlLogger{Logger::Levels::ERROR, "PCCControlLog.log", true}; 
     };
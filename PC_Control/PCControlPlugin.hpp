@@ -0,0 +1,74 @@
+/**
+ * @file PCControlPlugin.hpp
+ * @brief Header file for PC Control handler plugins
+ *
+ * A plugin is a shared object that exports PCCONTROL_PLUGIN_ENTRY_POINT and
+ * registers its commands through the PluginRegistrar it receives
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <string>            ///< For std::string class operations
+#include <functional>        ///< For std::function
+#include <vector>            ///< For std::vector
+#include "RequestScheduler.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @brief A command registered by a plugin
+ */
+struct PluginRequestHandle
+{
+    std::string request{};                              ///< The client request to be handled
+    std::function<void(void)> handle{};                 ///< The function to handle the request
+    bool isIdempotent{false};                           ///< Duplicates may be merged
+    RequestPriority priority{RequestPriority::NORMAL};  ///< Scheduling class
+};
+
+/**
+ * @class PluginRegistrar
+ * @brief Collects the commands a plugin registers while it is loaded
+ */
+class PluginRegistrar
+{
+    public:
+        /**
+         * @brief Insert a request and its corresponding handler
+         * @param request The client request to be handled
+         * @param requestHandle The function to handle the specified request
+         * @param isIdempotent True if running the request twice has the same effect as running it once
+         * @param priority Scheduling class of the request unless the client carries its own
+         */
+        void insertRequestHandle(const std::string& request, std::function<void(void)> requestHandle,
+                                 bool isIdempotent = false, RequestPriority priority = RequestPriority::NORMAL)
+        {
+            m_requestHandles.push_back(PluginRequestHandle{request, requestHandle, isIdempotent, priority});
+        }
+        /**
+         * @brief Get the registered commands
+         */
+        const std::vector<PluginRequestHandle>& getRequestHandles() const
+        {
+            return m_requestHandles;
+        }
+    private:
+        std::vector<PluginRequestHandle> m_requestHandles{};   ///< Registered commands
+};
+
+/**
+ * @brief Signature of the function every plugin exports
+ */
+using PluginEntryPoint = void (*)(PluginRegistrar& registrar);
+
+} // namespace App
+
+#define PCCONTROL_PLUGIN_ENTRY_POINT "registerPCControlPlugin"   ///< Name of the exported entry point
@@ -0,0 +1,233 @@
+/**
+ * @file PluginLoader.cpp
+ * @brief Source file for hot-reloadable handler plugins
+ *
+ * Loads handler plugins from a directory and reloads them when their shared
+ * object changes, without stopping the server
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <iostream>          ///< For std::cout
+#include <cerrno>            ///< For errno
+#include <filesystem>        ///< For directory iteration and paths
+#include <memory>            ///< For std::shared_ptr
+#include <dlfcn.h>           ///< For dlopen, dlsym and dlclose
+#include <fcntl.h>           ///< For open and the memfd seals
+#include <poll.h>            ///< For poll
+#include <sys/eventfd.h>     ///< For eventfd
+#include <sys/inotify.h>     ///< For inotify directory notifications
+#include <sys/mman.h>        ///< For memfd_create
+#include <sys/sendfile.h>    ///< For sendfile
+#include <sys/stat.h>        ///< For fstat
+#include <unistd.h>          ///< For read, write and close
+#include "PluginLoader.hpp"
+#include "EventChannel.hpp"
+
+constexpr uint32_t PLUGIN_WATCH_EVENTS{IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM};  ///< Changes that reload a plugin
+constexpr size_t PLUGIN_EVENT_BUFFER_SIZE{4096};   ///< Size of the buffer for inotify events
+const std::string PLUGIN_FILE_EXTENSION{".so"};    ///< Extension of plugin shared objects
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+/**
+ * @brief Constructor to initialize the plugin loader
+ * @param pcControl Dispatch table the plugin commands are registered into
+ * @param pluginDirectory Directory holding the plugin shared objects
+ */
+PluginLoader::PluginLoader(PCControl& pcControl, const std::string& pluginDirectory)
+    : m_pcControl{pcControl}, m_pluginDirectory{pluginDirectory}
+{
+}
+/**
+ * @brief Load every plugin of the directory and start watching it for changes
+ */
+void PluginLoader::start()
+{
+    std::error_code ErrorCode;
+    for(const auto& Entry : std::filesystem::directory_iterator(m_pluginDirectory, ErrorCode))
+    {
+        std::string FileName = Entry.path().filename().string();
+        if(isPluginFile(FileName))
+        {
+            loadPlugin(FileName);
+        }
+    }
+    if(ErrorCode)
+    {
+        m_pluginLogger.error("Unable to read plugin directory: " + m_pluginDirectory);
+        return;
+    }
+    m_inotifyFileDescriptor = inotify_init1(IN_CLOEXEC);
+    m_stopEventFileDescriptor = eventfd(0, EFD_CLOEXEC);
+    if((-1 == m_inotifyFileDescriptor) || (-1 == m_stopEventFileDescriptor) ||
+       (-1 == inotify_add_watch(m_inotifyFileDescriptor, m_pluginDirectory.c_str(), PLUGIN_WATCH_EVENTS)))
+    {
+        m_pluginLogger.error("Unable to watch plugin directory, plugins will not be reloaded: " + m_pluginDirectory);
+        return;
+    }
+    m_watcherThread = std::thread(&PluginLoader::watchPluginDirectory, this);
+    std::cout << "Watching plugin directory: " << m_pluginDirectory << '\n';
+}
+/**
+ * @brief Load or reload a plugin
+ * @param fileName File name of the shared object inside the plugin directory
+ * @return True if the plugin was loaded and registered
+ */
+bool PluginLoader::loadPlugin(const std::string& fileName)
+{
+    // The dynamic loader returns the already mapped object for a known path, so every version is loaded
+    // from its own anonymous copy; unlike a file in a shared directory nobody else can replace it before dlopen
+    std::filesystem::path SourcePath = std::filesystem::path(m_pluginDirectory) / fileName;
+    int CopyFileDescriptor = copyToSealedMemory(SourcePath.string(), SourcePath.stem().string() + "." + std::to_string(++m_generation));
+    if(-1 == CopyFileDescriptor)
+    {
+        m_pluginLogger.error("Unable to copy plugin: " + SourcePath.string());
+        return false;
+    }
+    std::string CopyPath = "/proc/self/fd/" + std::to_string(CopyFileDescriptor);
+    void* Handle = dlopen(CopyPath.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if(nullptr == Handle)
+    {
+        m_pluginLogger.error("Unable to load plugin " + fileName + ": " + dlerror());
+        close(CopyFileDescriptor);
+        return false;
+    }
+    // The copy stays open with the module, a reused descriptor number would name a loaded path again
+    std::shared_ptr<void> Module(Handle, [CopyFileDescriptor](void* ModuleHandle)
+    {
+        dlclose(ModuleHandle);
+        close(CopyFileDescriptor);
+    });
+    auto EntryPoint = reinterpret_cast<PluginEntryPoint>(dlsym(Handle, PCCONTROL_PLUGIN_ENTRY_POINT));
+    if(nullptr == EntryPoint)
+    {
+        m_pluginLogger.error("Plugin " + fileName + " does not export " + PCCONTROL_PLUGIN_ENTRY_POINT);
+        return false;
+    }
+    PluginRegistrar Registrar;
+    try
+    {
+        EntryPoint(Registrar);
+    }
+    catch(const std::exception& e)
+    {
+        m_pluginLogger.error("Plugin " + fileName + " failed to register: " + e.what());
+        return false;
+    }
+    m_pcControl.replacePluginHandles(fileName, Module, Registrar.getRequestHandles());
+    EVENT_INFO("Plugin loaded: " << fileName << " (" << Registrar.getRequestHandles().size() << " requests)");
+    return true;
+}
+/**
+ * @brief Unregister the commands of a plugin, its code is unloaded once they went quiet
+ * @param fileName File name of the shared object inside the plugin directory
+ */
+void PluginLoader::unloadPlugin(const std::string& fileName)
+{
+    m_pcControl.replacePluginHandles(fileName, nullptr, {});
+    EVENT_INFO("Plugin unloaded: " << fileName);
+}
+/**
+ * @brief Watcher loop reloading changed plugins
+ */
+void PluginLoader::watchPluginDirectory()
+{
+    alignas(struct inotify_event) char Buffer[PLUGIN_EVENT_BUFFER_SIZE];
+    struct pollfd PollFileDescriptors[2]{{m_inotifyFileDescriptor, POLLIN, 0}, {m_stopEventFileDescriptor, POLLIN, 0}};
+    while(true)
+    {
+        if(-1 == poll(PollFileDescriptors, 2, -1))
+        {
+            continue;
+        }
+        if(PollFileDescriptors[1].revents & POLLIN)
+        {
+            return;
+        }
+        ssize_t NumberOfReadBytes = read(m_inotifyFileDescriptor, Buffer, sizeof(Buffer));
+        for(ssize_t Offset = 0; Offset < NumberOfReadBytes;)
+        {
+            const auto* Event = reinterpret_cast<const struct inotify_event*>(Buffer + Offset);
+            Offset += sizeof(struct inotify_event) + Event->len;
+            if((Event->len == 0) || !isPluginFile(Event->name))
+            {
+                continue;
+            }
+            if(Event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+            {
+                loadPlugin(Event->name);
+            }
+            else
+            {
+                unloadPlugin(Event->name);
+            }
+        }
+    }
+}
+/**
+ * @brief helper function to copy a plugin into sealed anonymous memory
+ * @param sourcePath The plugin shared object
+ * @param copyName Name of the copy, shown in /proc/<pid>/maps
+ * @return Descriptor of the copy, -1 on failure
+ */
+int PluginLoader::copyToSealedMemory(const std::string& sourcePath, const std::string& copyName)
+{
+    int SourceFileDescriptor = open(sourcePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if(-1 == SourceFileDescriptor)
+    {
+        return -1;
+    }
+    int CopyFileDescriptor = memfd_create(copyName.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    struct stat SourceStatus{};
+    bool IsCopied = (-1 != CopyFileDescriptor) && (0 == fstat(SourceFileDescriptor, &SourceStatus));
+    for(off_t Offset = 0; IsCopied && (Offset < SourceStatus.st_size);)
+    {
+        ssize_t NumberOfCopiedBytes = sendfile(CopyFileDescriptor, SourceFileDescriptor, &Offset, static_cast<size_t>(SourceStatus.st_size - Offset));
+        IsCopied = (NumberOfCopiedBytes > 0) || ((-1 == NumberOfCopiedBytes) && (EINTR == errno));
+    }
+    close(SourceFileDescriptor);
+    // The loaded code can not change under the dynamic loader afterwards
+    IsCopied = IsCopied && (0 == fcntl(CopyFileDescriptor, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL));
+    if(!IsCopied && (-1 != CopyFileDescriptor))
+    {
+        close(CopyFileDescriptor);
+        CopyFileDescriptor = -1;
+    }
+    return CopyFileDescriptor;
+}
+/**
+ * @brief helper function to check the shared object extension
+ */
+bool PluginLoader::isPluginFile(const std::string& fileName)
+{
+    return (fileName.length() > PLUGIN_FILE_EXTENSION.length()) &&
+           (fileName.compare(fileName.length() - PLUGIN_FILE_EXTENSION.length(), PLUGIN_FILE_EXTENSION.length(), PLUGIN_FILE_EXTENSION) == 0);
+}
+/**
+ * @brief Stop watching, loaded plugins stay registered
+ */
+PluginLoader::~PluginLoader()
+{
+    if(m_watcherThread.joinable())
+    {
+        uint64_t StopValue = 1;
+        ssize_t NumberOfWrittenBytes = write(m_stopEventFileDescriptor, &StopValue, sizeof(StopValue));
+        (void)NumberOfWrittenBytes;
+        m_watcherThread.join();
+    }
+    if(m_inotifyFileDescriptor != -1)
+    {
+        close(m_inotifyFileDescriptor);
+    }
+    if(m_stopEventFileDescriptor != -1)
+    {
+        close(m_stopEventFileDescriptor);
+    }
+}
+} // namespace App
@@ -0,0 +1,88 @@
+/**
+ * @file PluginLoader.hpp
+ * @brief Header file for hot-reloadable handler plugins
+ *
+ * Loads handler plugins from a directory and reloads them when their shared
+ * object changes, without stopping the server
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <string>            ///< For std::string class operations
+#include <thread>            ///< For std::thread
+#include <cstdint>           ///< For fixed width integer types
+#include "PCControl.hpp"
+#include "Logger.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @class PluginLoader
+ * @brief Watches a plugin directory and registers plugin commands into PCControl
+ */
+class PluginLoader
+{
+    public:
+        /**
+         * @brief Constructor to initialize the plugin loader
+         * @param pcControl Dispatch table the plugin commands are registered into
+         * @param pluginDirectory Directory holding the plugin shared objects
+         */
+        PluginLoader(PCControl& pcControl, const std::string& pluginDirectory);
+        PluginLoader(const PluginLoader&) = delete;             ///< Delete copy constructor
+        PluginLoader& operator=(const PluginLoader&) = delete;  ///< Delete copy assignment operator
+        PluginLoader(PluginLoader&&) = delete;                  ///< Delete move constructor
+        PluginLoader& operator=(PluginLoader&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Stop watching, loaded plugins stay registered
+         */
+        ~PluginLoader();
+        /**
+         * @brief Load every plugin of the directory and start watching it for changes
+         */
+        void start();
+        /**
+         * @brief Load or reload a plugin
+         * @param fileName File name of the shared object inside the plugin directory
+         * @return True if the plugin was loaded and registered
+         */
+        bool loadPlugin(const std::string& fileName);
+        /**
+         * @brief Unregister the commands of a plugin, its code is unloaded once they went quiet
+         * @param fileName File name of the shared object inside the plugin directory
+         */
+        void unloadPlugin(const std::string& fileName);
+    private:
+        PCControl& m_pcControl;                       ///< Dispatch table owner
+        std::string m_pluginDirectory{};              ///< Watched directory
+        int m_inotifyFileDescriptor{-1};              ///< Directory change notifications
+        int m_stopEventFileDescriptor{-1};            ///< Wakes the watcher for shutdown
+        uint64_t m_generation{};                      ///< Numbers the loaded copies
+        std::thread m_watcherThread{};                ///< Reloads plugins on change
+        // Create Logger instance for plugin logging
+        Logger m_pluginLogger{Logger::Levels::ERROR, "PluginLog.log", true};
+        /**
+         * @brief Watcher loop reloading changed plugins
+         */
+        void watchPluginDirectory();
+        /**
+         * @brief helper function to check the shared object extension
+         */
+        static bool isPluginFile(const std::string& fileName);
+        /**
+         * @brief helper function to copy a plugin into sealed anonymous memory
+         * @param sourcePath The plugin shared object
+         * @param copyName Name of the copy, shown in /proc/<pid>/maps
+         * @return Descriptor of the copy, -1 on failure
+         */
+        static int copyToSealedMemory(const std::string& sourcePath, const std::string& copyName);
+};
+} // namespace App
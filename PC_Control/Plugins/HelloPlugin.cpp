@@ -0,0 +1,22 @@
+/**
+ * @file HelloPlugin.cpp
+ * @brief Example handler plugin for PC Control application
+ *
+ * Build into the plugin directory, the running server picks it up without a restart:
+ *     g++ -std=c++17 -shared -fPIC -I.. HelloPlugin.cpp -o HelloPlugin.so
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <iostream>              ///< For std::cout
+#include "PCControlPlugin.hpp"
+
+/**
+ * @brief Register the commands of the plugin
+ * @param registrar Collects the commands while the plugin is loaded
+ */
+extern "C" void registerPCControlPlugin(App::PluginRegistrar& registrar)
+{
+    registrar.insertRequestHandle("say_hello", []() { std::cout << "Hello from plugin" << std::endl; }, true, App::RequestPriority::LOW);
+}
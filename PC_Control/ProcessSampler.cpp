@@ -0,0 +1,349 @@
+/**
+ * @file ProcessSampler.cpp
+ * @brief Source file for the sampled process status cache
+ *
+ * Rereads the stat file of every managed process once per interval and
+ * publishes the formatted values, queries only look them up
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <algorithm>             ///< For std::remove_if
+#include <charconv>              ///< For std::from_chars
+#include <cstdio>                ///< For std::snprintf
+#include <fcntl.h>               ///< For open()
+#include <iostream>              ///< For std::cout
+#include <string_view>           ///< For std::string_view
+#include <time.h>                ///< For clock_gettime() and CLOCK_BOOTTIME
+#include <unistd.h>              ///< For pread(), close() and sysconf()
+#include "ProcessSampler.hpp"
+#include "EventChannel.hpp"
+
+const std::string QUERY_STATUS{"status"};   ///< Query of the server itself
+const std::string QUERY_PS{"ps"};           ///< Query of every tracked child
+const std::string QUERY_STATS{"stats"};     ///< Query of one tracked child, followed by its ID
+constexpr size_t STAT_UTIME_FIELD{14};      ///< User time in clock ticks, fields are numbered from 1 as in proc(5)
+constexpr size_t STAT_STIME_FIELD{15};      ///< System time in clock ticks
+constexpr size_t STAT_STARTTIME_FIELD{22};  ///< Start time in clock ticks after boot
+constexpr size_t STAT_RSS_FIELD{24};        ///< Resident set size in pages
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+namespace
+{
+/**
+ * @brief helper function to read the clock /proc start times are measured on
+ */
+int64_t getBootTimeNs()
+{
+    struct timespec Now{};
+    clock_gettime(CLOCK_BOOTTIME, &Now);
+    return static_cast<int64_t>(Now.tv_sec) * 1000000000 + Now.tv_nsec;
+}
+} // namespace
+
+/**
+ * @brief Constructor to open the stat file of the server itself
+ * @param interval Time between two samples
+ */
+ProcessSampler::ProcessSampler(std::chrono::milliseconds interval)
+    : m_intervalMs{interval.count()}, m_clockTicksPerSecond{sysconf(_SC_CLK_TCK)}, m_pageSize{sysconf(_SC_PAGESIZE)}
+{
+    m_server.name = "pccontrol";
+    m_server.processID = getpid();
+    m_server.statFileDescriptor = openStatFile(m_server.processID);
+    if(-1 == m_server.statFileDescriptor)
+    {
+        m_samplerLogger.error("Unable to open the stat file of the server");
+    }
+}
+/**
+ * @brief Stop sampling and close the stat files
+ */
+ProcessSampler::~ProcessSampler()
+{
+    stop();
+    for(const SampledProcess& Process : m_processes)
+    {
+        close(Process.statFileDescriptor);
+    }
+    if(-1 != m_server.statFileDescriptor)
+    {
+        close(m_server.statFileDescriptor);
+    }
+}
+/**
+ * @brief Take the first sample and start the sampler thread
+ */
+void ProcessSampler::start()
+{
+    std::lock_guard<std::mutex> Lock(m_samplerMutex);
+    if(m_isRunning)
+    {
+        return;
+    }
+    // Queries arriving before the first interval elapsed already see values
+    takeSample();
+    m_isRunning = true;
+    m_samplerThread = std::thread(&ProcessSampler::sampleProcesses, this);
+}
+/**
+ * @brief Stop the sampler thread, queries keep seeing the last sample
+ */
+void ProcessSampler::stop()
+{
+    {
+        std::lock_guard<std::mutex> Lock(m_samplerMutex);
+        m_isRunning = false;
+    }
+    m_samplerCondition.notify_one();
+    if(m_samplerThread.joinable())
+    {
+        m_samplerThread.join();
+    }
+}
+/**
+ * @brief Change the time between two samples, thread safe
+ */
+void ProcessSampler::setInterval(std::chrono::milliseconds interval)
+{
+    m_intervalMs.store(interval.count(), std::memory_order_relaxed);
+    m_samplerCondition.notify_one();
+}
+/**
+ * @brief Sample a child process until it exits, thread safe
+ * @param process Name of the process
+ * @param processID ID of the process
+ */
+void ProcessSampler::track(const std::string& process, pid_t processID)
+{
+    if(processID <= 0)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> Lock(m_samplerMutex);
+        m_pendingProcesses.push_back(SampledProcess{process, processID});
+    }
+    // Sample right away so the new child shows up before the next interval
+    m_samplerCondition.notify_one();
+}
+/**
+ * @brief Answer a query command from the last sample without a system call
+ * @param command Trimmed lowercase message
+ * @param reply Filled with the answer
+ * @return False if the message is no query command
+ */
+bool ProcessSampler::query(const std::string& command, std::string& reply) const
+{
+    auto Snapshot = m_snapshot.read();
+    if(QUERY_STATUS == command)
+    {
+        reply = Snapshot->status;
+    }
+    else if(QUERY_PS == command)
+    {
+        reply = Snapshot->processList;
+    }
+    else if((command.compare(0, QUERY_STATS.length(), QUERY_STATS) == 0) &&
+            ((command.length() == QUERY_STATS.length()) || (' ' == command[QUERY_STATS.length()])))
+    {
+        std::string_view Argument = std::string_view(command).substr(QUERY_STATS.length());
+        Argument.remove_prefix(std::min(Argument.find_first_not_of(' '), Argument.size()));
+        pid_t ProcessID = 0;
+        auto [End, Error] = std::from_chars(Argument.data(), Argument.data() + Argument.size(), ProcessID);
+        if(Argument.empty() || (std::errc{} != Error) || (End != (Argument.data() + Argument.size())))
+        {
+            reply = "Usage: stats <pid>\n";
+        }
+        else
+        {
+            auto StatsIterator = Snapshot->processStats.find(ProcessID);
+            reply = (StatsIterator != Snapshot->processStats.end()) ? StatsIterator->second
+                                                                     : "Unknown process: " + std::string(Argument) + "\n";
+        }
+    }
+    else
+    {
+        return false;
+    }
+    m_queryCount.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+/**
+ * @brief Print sampler statistics.
+ */
+void ProcessSampler::printStatistics() const
+{
+    std::cout << "\n=== PROCESS SAMPLER STATISTICS ===\n";
+    std::cout << "Sample interval: " << m_intervalMs.load(std::memory_order_relaxed) << " ms\n";
+    std::cout << "Samples taken: " << m_sampleCount << '\n';
+    std::cout << "Tracked processes: " << m_processes.size() << '\n';
+    std::cout << "Exited processes: " << m_exitedCount << '\n';
+    std::cout << "Queries answered: " << m_queryCount.load(std::memory_order_relaxed) << '\n';
+    std::cout << "==================================\n";
+}
+/**
+ * @brief Sampler thread loop taking a sample per interval
+ */
+void ProcessSampler::sampleProcesses()
+{
+    std::unique_lock<std::mutex> Lock(m_samplerMutex);
+    while(true)
+    {
+        // A new child or a new interval ends the wait early
+        m_samplerCondition.wait_for(Lock, std::chrono::milliseconds(m_intervalMs.load(std::memory_order_relaxed)));
+        if(!m_isRunning)
+        {
+            break;
+        }
+        takeSample();
+    }
+}
+/**
+ * @brief helper function to open the tracked children and sample every process once
+ */
+void ProcessSampler::takeSample()
+{
+    // Runs under the sampler mutex, only the pending list is shared
+    for(SampledProcess& Process : m_pendingProcesses)
+    {
+        Process.statFileDescriptor = openStatFile(Process.processID);
+        if(-1 == Process.statFileDescriptor)
+        {
+            EVENT_WARNING("Process " << Process.processID << " exited before it was sampled");
+            m_exitedCount++;
+            continue;
+        }
+        m_processes.push_back(std::move(Process));
+    }
+    m_pendingProcesses.clear();
+    int64_t NowNs = getBootTimeNs();
+    sampleProcess(m_server, NowNs);
+    auto ExitedBegin = std::remove_if(m_processes.begin(), m_processes.end(), [this, NowNs](SampledProcess& Process)
+    {
+        if(sampleProcess(Process, NowNs))
+        {
+            return false;
+        }
+        EVENT_INFO("Stopped sampling exited process " << Process.name << " (" << Process.processID << ")");
+        close(Process.statFileDescriptor);
+        m_exitedCount++;
+        return true;
+    });
+    m_processes.erase(ExitedBegin, m_processes.end());
+    publishSnapshot();
+    m_sampleCount++;
+}
+/**
+ * @brief helper function to reread the stat file of a process
+ * @param process The process, updated with the new values
+ * @param nowNs Boot time clock of the sample
+ * @return False if the process is gone or exited
+ */
+bool ProcessSampler::sampleProcess(SampledProcess& process, int64_t nowNs) const
+{
+    if(-1 == process.statFileDescriptor)
+    {
+        return false;
+    }
+    char Buffer[PROCESS_STAT_BUFFER_SIZE];
+    // Rereading from offset 0 regenerates the file, a reaped process fails with ESRCH
+    ssize_t NumberOfReadBytes = pread(process.statFileDescriptor, Buffer, sizeof(Buffer), 0);
+    if(NumberOfReadBytes <= 0)
+    {
+        return false;
+    }
+    std::string_view Line(Buffer, static_cast<size_t>(NumberOfReadBytes));
+    // The command name may hold spaces and parentheses, the fields start after its last ')'
+    size_t NameEnd = Line.rfind(')');
+    if((std::string_view::npos == NameEnd) || ((NameEnd + 2) >= Line.size()))
+    {
+        return false;
+    }
+    Line.remove_prefix(NameEnd + 2);
+    uint64_t Fields[STAT_RSS_FIELD + 1]{};
+    char State = Line[0];
+    // Field 3 is the state, the numbers follow it
+    size_t Field = 3;
+    size_t Position = Line.find(' ');
+    while((std::string_view::npos != Position) && (Field < STAT_RSS_FIELD))
+    {
+        Field++;
+        size_t Begin = Position + 1;
+        Position = Line.find(' ', Begin);
+        size_t End = (std::string_view::npos == Position) ? Line.size() : Position;
+        // Negative fields such as priority are left at 0, none of the sampled ones can be negative
+        std::from_chars(Line.data() + Begin, Line.data() + End, Fields[Field]);
+    }
+    if(Field < STAT_RSS_FIELD)
+    {
+        return false;
+    }
+    uint64_t CpuTicks = Fields[STAT_UTIME_FIELD] + Fields[STAT_STIME_FIELD];
+    if((0 != process.previousSampleNs) && (nowNs > process.previousSampleNs) && (m_clockTicksPerSecond > 0))
+    {
+        double CpuSeconds = static_cast<double>(CpuTicks - process.previousCpuTicks) / static_cast<double>(m_clockTicksPerSecond);
+        process.cpuPercent = 100.0 * CpuSeconds * 1e9 / static_cast<double>(nowNs - process.previousSampleNs);
+    }
+    process.previousCpuTicks = CpuTicks;
+    process.previousSampleNs = nowNs;
+    process.residentBytes = Fields[STAT_RSS_FIELD] * static_cast<uint64_t>(m_pageSize);
+    process.uptimeSeconds = (m_clockTicksPerSecond > 0)
+                          ? (static_cast<double>(nowNs) / 1e9) - (static_cast<double>(Fields[STAT_STARTTIME_FIELD]) / static_cast<double>(m_clockTicksPerSecond))
+                          : 0.0;
+    process.state = State;
+    // A zombie is no longer running, the parent only has not collected its status
+    return ('Z' != State) && ('X' != State);
+}
+/**
+ * @brief helper function to publish the replies of the current sample
+ */
+void ProcessSampler::publishSnapshot()
+{
+    auto NewSnapshot = std::make_unique<Snapshot>();
+    NewSnapshot->status = formatProcess(m_server);
+    NewSnapshot->status.insert(NewSnapshot->status.size() - 1, " children=" + std::to_string(m_processes.size()) +
+                               " interval_ms=" + std::to_string(m_intervalMs.load(std::memory_order_relaxed)));
+    NewSnapshot->processList.clear();
+    for(const SampledProcess& Process : m_processes)
+    {
+        std::string Line = formatProcess(Process);
+        NewSnapshot->processList += Line;
+        NewSnapshot->processStats.emplace(Process.processID, std::move(Line));
+    }
+    if(m_processes.empty())
+    {
+        NewSnapshot->processList = "No managed processes\n";
+    }
+    m_snapshot.update([&NewSnapshot](Snapshot& Current)
+    {
+        Current = std::move(*NewSnapshot);
+    });
+}
+/**
+ * @brief helper function to format the values of a process
+ */
+std::string ProcessSampler::formatProcess(const SampledProcess& process)
+{
+    char Line[256];
+    int Length = std::snprintf(Line, sizeof(Line), "%s pid=%d state=%c cpu=%.1f%% rss_kb=%llu uptime_s=%.1f\n",
+                               process.name.c_str(), static_cast<int>(process.processID), process.state, process.cpuPercent,
+                               static_cast<unsigned long long>(process.residentBytes / 1024), process.uptimeSeconds);
+    return std::string(Line, static_cast<size_t>(std::clamp(Length, 0, static_cast<int>(sizeof(Line) - 1))));
+}
+/**
+ * @brief helper function to open the stat file of a process
+ * @return The file descriptor, -1 if the process does not exist
+ */
+int ProcessSampler::openStatFile(pid_t processID)
+{
+    std::string Path = "/proc/" + std::to_string(processID) + "/stat";
+    return open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+} // namespace App
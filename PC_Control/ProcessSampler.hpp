@@ -0,0 +1,164 @@
+/**
+ * @file ProcessSampler.hpp
+ * @brief Header file for the sampled process status cache
+ *
+ * A background thread samples CPU usage, resident memory and uptime of the
+ * server and of the children PCControl started, rereading a /proc/<pid>/stat
+ * descriptor opened once per process. Every sample is published as ready
+ * replies, so the query commands are answered from memory:
+ *
+ *   status        the server itself and the number of tracked children
+ *   ps            one line per tracked child
+ *   stats <pid>   a single tracked child
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <atomic>                ///< For std::atomic counters
+#include <chrono>                ///< For std::chrono::milliseconds
+#include <condition_variable>    ///< For std::condition_variable
+#include <cstdint>               ///< For fixed width integer types
+#include <memory>                ///< For std::make_unique
+#include <mutex>                 ///< For std::mutex
+#include <string>                ///< For std::string class operations
+#include <thread>                ///< For std::thread
+#include <unordered_map>         ///< For std::unordered_map
+#include <vector>                ///< For std::vector
+#include <sys/types.h>           ///< For pid_t
+#include "Logger.hpp"
+#include "RcuPointer.hpp"
+
+constexpr uint32_t PROCESS_SAMPLE_INTERVAL_MS{1000};   ///< Default time between two samples
+constexpr size_t PROCESS_STAT_BUFFER_SIZE{1024};       ///< Holds a /proc/<pid>/stat line
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @class ProcessSampler
+ * @brief Samples the managed processes in the background and answers status queries from the last sample
+ */
+class ProcessSampler
+{
+    public:
+        /**
+         * @brief Constructor to open the stat file of the server itself
+         * @param interval Time between two samples
+         */
+        explicit ProcessSampler(std::chrono::milliseconds interval = std::chrono::milliseconds(PROCESS_SAMPLE_INTERVAL_MS));
+        ProcessSampler(const ProcessSampler&) = delete;             ///< Delete copy constructor
+        ProcessSampler& operator=(const ProcessSampler&) = delete;  ///< Delete copy assignment operator
+        ProcessSampler(ProcessSampler&&) = delete;                  ///< Delete move constructor
+        ProcessSampler& operator=(ProcessSampler&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Stop sampling and close the stat files
+         */
+        ~ProcessSampler();
+        /**
+         * @brief Take the first sample and start the sampler thread
+         */
+        void start();
+        /**
+         * @brief Stop the sampler thread, queries keep seeing the last sample
+         */
+        void stop();
+        /**
+         * @brief Change the time between two samples, thread safe
+         */
+        void setInterval(std::chrono::milliseconds interval);
+        /**
+         * @brief Sample a child process until it exits, thread safe
+         * @param process Name of the process
+         * @param processID ID of the process
+         */
+        void track(const std::string& process, pid_t processID);
+        /**
+         * @brief Answer a query command from the last sample without a system call
+         * @param command Trimmed lowercase message
+         * @param reply Filled with the answer
+         * @return False if the message is no query command
+         */
+        bool query(const std::string& command, std::string& reply) const;
+        /**
+         * @brief Print sampler statistics.
+         */
+        void printStatistics() const;
+    private:
+        /**
+         * @brief Ready replies of one sample, replaced as a whole
+         */
+        struct Snapshot
+        {
+            std::string status{"No sample taken yet\n"};          ///< Reply of "status"
+            std::string processList{"No sample taken yet\n"};     ///< Reply of "ps"
+            std::unordered_map<pid_t, std::string> processStats{};  ///< Reply of "stats <pid>" per tracked child
+        };
+        /**
+         * @brief A sampled process and its open stat file
+         */
+        struct SampledProcess
+        {
+            std::string name{};              ///< Name given by the handler
+            pid_t processID{-1};             ///< ID of the process
+            int statFileDescriptor{-1};      ///< /proc/<pid>/stat, stays bound to the process even if its ID is reused
+            uint64_t previousCpuTicks{};     ///< User and system time at the previous sample
+            int64_t previousSampleNs{};      ///< Boot time clock at the previous sample, 0 before the first one
+            double cpuPercent{};             ///< CPU usage since the previous sample, 100 is one full core
+            uint64_t residentBytes{};        ///< Resident set size
+            double uptimeSeconds{};          ///< Time since the process started
+            char state{'?'};                 ///< Scheduler state, see proc(5)
+        };
+        std::atomic<int64_t> m_intervalMs{};            ///< Time between two samples
+        SampledProcess m_server{};                      ///< The server process
+        std::vector<SampledProcess> m_processes{};      ///< Tracked children, owned by the sampler thread
+        std::mutex m_samplerMutex;                      ///< Protects the pending processes and the running flag
+        std::condition_variable m_samplerCondition;     ///< Wakes the sampler thread
+        std::vector<SampledProcess> m_pendingProcesses{};  ///< Children waiting to be opened by the sampler thread
+        bool m_isRunning{false};                        ///< Sampler thread is running
+        std::thread m_samplerThread{};                  ///< Takes the samples
+        long m_clockTicksPerSecond{};                   ///< Unit of the stat file times
+        long m_pageSize{};                              ///< Unit of the stat file resident set size
+        uint64_t m_sampleCount{};                       ///< Samples published
+        uint64_t m_exitedCount{};                       ///< Tracked children seen exiting
+        mutable std::atomic<uint64_t> m_queryCount{};   ///< Queries answered
+        // Create lock-free published replies, queries only read them
+        RcuPointer<Snapshot> m_snapshot{std::make_unique<Snapshot>()};
+        // Create Logger instance for sampler logging
+        Logger m_samplerLogger{Logger::Levels::ERROR, "SamplerLog.log", true};
+        /**
+         * @brief Sampler thread loop taking a sample per interval
+         */
+        void sampleProcesses();
+        /**
+         * @brief helper function to open the tracked children and sample every process once
+         */
+        void takeSample();
+        /**
+         * @brief helper function to reread the stat file of a process
+         * @param process The process, updated with the new values
+         * @param nowNs Boot time clock of the sample
+         * @return False if the process is gone or exited
+         */
+        bool sampleProcess(SampledProcess& process, int64_t nowNs) const;
+        /**
+         * @brief helper function to publish the replies of the current sample
+         */
+        void publishSnapshot();
+        /**
+         * @brief helper function to format the values of a process
+         */
+        static std::string formatProcess(const SampledProcess& process);
+        /**
+         * @brief helper function to open the stat file of a process
+         * @return The file descriptor, -1 if the process does not exist
+         */
+        static int openStatFile(pid_t processID);
+};
+} // namespace App
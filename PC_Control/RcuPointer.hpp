@@ -0,0 +1,124 @@
+/**
+ * @file RcuPointer.hpp
+ * @brief Header file for read-copy-update protected pointer
+ *
+ * Readers access the published object without taking a lock, writers publish a
+ * replacement and reclaim the old object once every reader that could still
+ * see it has left its read-side critical section
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <array>             ///< For std::array
+#include <atomic>            ///< For std::atomic
+#include <cstdint>           ///< For fixed width integer types
+#include <memory>            ///< For std::unique_ptr
+#include <mutex>             ///< For std::mutex and std::lock_guard
+#include <thread>            ///< For std::this_thread::yield
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @class RcuPointer
+ * @brief Pointer with lock-free readers and grace-period reclamation
+ *
+ * Readers announce themselves in one of two counters selected by the epoch parity.
+ * A writer swaps the pointer then flips the epoch twice, waiting each time for the
+ * counter of the previous parity to drain, so every reader that loaded the old
+ * pointer has finished before the old object is deleted.
+ * A writer must never be called from inside a read-side critical section.
+ */
+template <typename T>
+class RcuPointer
+{
+    public:
+        /**
+         * @brief Read-side critical section, the object stays alive while the guard exists
+         */
+        class ReadGuard
+        {
+            public:
+                ReadGuard(const RcuPointer& pointer) : m_readerCount{&pointer.m_readerCounts[pointer.m_epoch.load() & 1]}
+                {
+                    m_readerCount->fetch_add(1);
+                    m_object = pointer.m_current.load();
+                }
+                ReadGuard(const ReadGuard&) = delete;             ///< Delete copy constructor
+                ReadGuard& operator=(const ReadGuard&) = delete;  ///< Delete copy assignment operator
+                ~ReadGuard()
+                {
+                    m_readerCount->fetch_sub(1);
+                }
+                const T& operator*() const { return *m_object; }
+                const T* operator->() const { return m_object; }
+            private:
+                std::atomic<uint64_t>* m_readerCount{};   ///< Counter this reader is announced in
+                const T* m_object{};                      ///< Object published when the section started
+        };
+        /**
+         * @brief Constructor to publish the initial object
+         */
+        explicit RcuPointer(std::unique_ptr<T> initial) : m_current{initial.release()}
+        {
+        }
+        RcuPointer(const RcuPointer&) = delete;             ///< Delete copy constructor
+        RcuPointer& operator=(const RcuPointer&) = delete;  ///< Delete copy assignment operator
+        RcuPointer(RcuPointer&&) = delete;                  ///< Delete move constructor
+        RcuPointer& operator=(RcuPointer&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Destroy the published object, no reader may be active
+         */
+        ~RcuPointer()
+        {
+            delete m_current.load();
+        }
+        /**
+         * @brief Enter a read-side critical section
+         */
+        ReadGuard read() const
+        {
+            return ReadGuard(*this);
+        }
+        /**
+         * @brief Publish a copy of the current object changed by the updater and reclaim the old one
+         * @param updater Callable receiving the copy to change
+         */
+        template <typename Updater>
+        void update(Updater updater)
+        {
+            std::lock_guard<std::mutex> lock(m_writerMutex);
+            std::unique_ptr<T> Replacement = std::make_unique<T>(*m_current.load());
+            updater(*Replacement);
+            std::unique_ptr<T> Old{m_current.exchange(Replacement.release())};
+            synchronize();
+            // Old is deleted here, after the grace period
+        }
+    private:
+        std::atomic<T*> m_current{};                            ///< Published object
+        std::atomic<uint64_t> m_epoch{0};                       ///< Selects the counter new readers announce in
+        mutable std::array<std::atomic<uint64_t>, 2> m_readerCounts{};  ///< Active readers per epoch parity
+        std::mutex m_writerMutex;                               ///< Serializes writers
+        /**
+         * @brief Wait until every reader that started before the call has finished
+         */
+        void synchronize()
+        {
+            for(int Phase = 0; Phase < 2; Phase++)
+            {
+                uint64_t PreviousEpoch = m_epoch.fetch_add(1);
+                while(m_readerCounts[PreviousEpoch & 1].load() != 0)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+};
+} // namespace App
@@ -0,0 +1,67 @@
+/**
+ * @file Request.hpp
+ * @brief Header file for client request
+ *
+ * Provides the request passed from Server through the scheduling stages to
+ * PCControl, stamped with a monotonic timestamp at every stage
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <array>             ///< For std::array
+#include <chrono>            ///< For std::chrono::steady_clock
+#include <cstdint>           ///< For fixed width integer types
+#include <string>            ///< For std::string class operations
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @brief enum class RequestStage represents the points a request is stamped at
+ */
+enum class RequestStage : uint8_t
+{
+    RECEIVE  = UINT8_C(0),   ///< Bytes returned by recv in Server
+    ENQUEUE  = UINT8_C(1),   ///< Pushed to the server message queue
+    DEQUEUE  = UINT8_C(2),   ///< Taken from the server message queue by the app
+    DISPATCH = UINT8_C(3),   ///< Handed to PCControl::handleRequest
+    COMPLETE = UINT8_C(4)    ///< Handler returned
+};
+constexpr size_t REQUEST_STAGE_COUNT{5};   ///< Number of request stages
+
+/**
+ * @brief A client request and its stage timestamps
+ */
+struct Request
+{
+    uint64_t id{};                                          ///< Unique request identifier
+    std::string command{};                                  ///< Lowercased, trimmed request text
+    uint16_t commandID{};                                   ///< Registry ID of a binary request, 0 for text requests dispatched by name
+    uint32_t connectionID{};                                ///< Connection the result is sent to, 0 if nobody waits for it
+    uint32_t clientRequestID{};                             ///< Request ID a binary client chose, echoed in the response frame
+    uint64_t journalSequence{};                             ///< Journal record to await before the result is sent, 0 without journal
+    std::array<uint64_t, REQUEST_STAGE_COUNT> timestamps{};  ///< Monotonic nanoseconds per stage, zero if not reached
+    /**
+     * @brief Get the current monotonic time in nanoseconds
+     */
+    static uint64_t now()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    /**
+     * @brief Record the current time for a stage
+     */
+    void stamp(RequestStage stage)
+    {
+        timestamps[static_cast<size_t>(stage)] = now();
+    }
+};
+} // namespace App
@@ -0,0 +1,95 @@
+/**
+ * @file RequestCapture.cpp
+ * @brief Source file for request traffic capture
+ *
+ * Records the raw bytes received by the server with their arrival time and
+ * connection into a compact capture file that the replay tool fires back.
+ * Every receive is recorded as it arrived, before the server interprets it.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <cstring>           ///< For memcmp
+#include "RequestCapture.hpp"
+#include "Request.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+/**
+ * @brief Constructor to create the capture file
+ * @param fileName The capture file, replaced if it exists
+ */
+RequestCapture::RequestCapture(const std::string& fileName) : m_fileBuffer(CAPTURE_BUFFER_SIZE)
+{
+    // A large stream buffer keeps the receive path to a memory copy for most records
+    m_captureFile.rdbuf()->pubsetbuf(m_fileBuffer.data(), m_fileBuffer.size());
+    m_captureFile.open(fileName, std::ios::binary | std::ios::trunc);
+    if(!m_captureFile.is_open())
+    {
+        m_captureLogger.error("Unable to open capture file: " + fileName);
+        return;
+    }
+    m_captureFile.write(CAPTURE_FILE_MAGIC, sizeof(CAPTURE_FILE_MAGIC));
+    m_startTime = Request::now();
+}
+/**
+ * @brief Write the buffered records and close the capture file
+ */
+RequestCapture::~RequestCapture()
+{
+    if(m_captureFile.is_open())
+    {
+        m_captureFile.close();
+    }
+}
+/**
+ * @brief Record a received message, safe to call from any transport thread
+ * @param connectionID Connection the message arrived on
+ * @param type How the connection interprets the bytes
+ * @param data The raw received bytes
+ * @param length Number of received bytes
+ */
+void RequestCapture::record(uint32_t connectionID, CaptureRecordType type, const char* data, size_t length)
+{
+    std::lock_guard<std::mutex> lock(m_captureMutex);
+    if(!m_captureFile.is_open())
+    {
+        return;
+    }
+    CaptureRecordHeader Header{Request::now() - m_startTime, connectionID, static_cast<uint32_t>(length), static_cast<uint8_t>(type), {}};
+    m_captureFile.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+    m_captureFile.write(data, static_cast<std::streamsize>(length));
+    m_recordCount++;
+}
+/**
+ * @brief Read every message of a capture file
+ * @param fileName The capture file
+ * @param messages Filled with the messages in capture order
+ * @return False if the file is missing or not a capture file, a truncated last record is ignored
+ */
+bool RequestCapture::readFile(const std::string& fileName, std::vector<CapturedMessage>& messages)
+{
+    std::ifstream CaptureFile(fileName, std::ios::binary);
+    char Magic[sizeof(CAPTURE_FILE_MAGIC)]{};
+    if(!CaptureFile.read(Magic, sizeof(Magic)) || (0 != memcmp(Magic, CAPTURE_FILE_MAGIC, sizeof(Magic))))
+    {
+        return false;
+    }
+    CaptureRecordHeader Header;
+    while(CaptureFile.read(reinterpret_cast<char*>(&Header), sizeof(Header)))
+    {
+        CapturedMessage Message{Header.timestamp, Header.connectionID, static_cast<CaptureRecordType>(Header.type), std::string(Header.length, '\0')};
+        if(!CaptureFile.read(Message.data.data(), Header.length))
+        {
+            break;
+        }
+        messages.push_back(std::move(Message));
+    }
+    return true;
+}
+} // namespace App
@@ -0,0 +1,113 @@
+/**
+ * @file RequestCapture.hpp
+ * @brief Header file for request traffic capture
+ *
+ * Records the raw bytes received by the server with their arrival time and
+ * connection into a compact capture file that the replay tool fires back.
+ * Every receive is recorded as it arrived, before the server interprets it.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <cstdint>           ///< For fixed width integer types
+#include <fstream>           ///< For std::ofstream
+#include <mutex>             ///< For std::mutex
+#include <string>            ///< For std::string class operations
+#include <vector>            ///< For std::vector
+#include "Logger.hpp"
+
+constexpr char CAPTURE_FILE_MAGIC[8]{'P', 'C', 'C', 'A', 'P', '0', '2', '\n'};  ///< Identifies a capture file and its record layout
+constexpr size_t CAPTURE_BUFFER_SIZE{1024 * 1024};   ///< Bytes buffered before a write to the capture file
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @brief enum class CaptureRecordType represents how the connection interpreted the captured bytes
+ */
+enum class CaptureRecordType : uint8_t
+{
+    TEXT   = UINT8_C(0),   ///< A text message, including subscription commands, queries and the binary handshake
+    BINARY = UINT8_C(1)    ///< Bytes of binary frames, a frame may span records
+};
+
+/**
+ * @class RequestCapture
+ * @brief Appends received messages to a capture file
+ *
+ * File layout: the 8 byte magic, then one record per received message made of
+ * a CaptureRecordHeader followed by the raw bytes, in host byte order
+ */
+class RequestCapture
+{
+    public:
+        /**
+         * @brief Header in front of the bytes of every captured message
+         */
+        struct CaptureRecordHeader
+        {
+            uint64_t timestamp;       ///< Nanoseconds since the capture started
+            uint32_t connectionID;    ///< Connection the message arrived on
+            uint32_t length;          ///< Number of raw bytes
+            uint8_t type;             ///< CaptureRecordType of the bytes
+            uint8_t reserved[7];      ///< Zero, keeps the header 8 byte aligned
+        };
+        /**
+         * @brief A message read back from a capture file
+         */
+        struct CapturedMessage
+        {
+            uint64_t timestamp{};      ///< Nanoseconds since the capture started
+            uint32_t connectionID{};   ///< Connection the message arrived on
+            CaptureRecordType type{};  ///< How the connection interpreted the bytes
+            std::string data{};        ///< Raw received bytes
+        };
+        /**
+         * @brief Constructor to create the capture file
+         * @param fileName The capture file, replaced if it exists
+         */
+        explicit RequestCapture(const std::string& fileName);
+        RequestCapture(const RequestCapture&) = delete;             ///< Delete copy constructor
+        RequestCapture& operator=(const RequestCapture&) = delete;  ///< Delete copy assignment operator
+        RequestCapture(RequestCapture&&) = delete;                  ///< Delete move constructor
+        RequestCapture& operator=(RequestCapture&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Write the buffered records and close the capture file
+         */
+        ~RequestCapture();
+        /**
+         * @brief Record a received message, safe to call from any transport thread
+         * @param connectionID Connection the message arrived on
+         * @param type How the connection interprets the bytes
+         * @param data The raw received bytes
+         * @param length Number of received bytes
+         */
+        void record(uint32_t connectionID, CaptureRecordType type, const char* data, size_t length);
+        /**
+         * @brief Get the number of recorded messages
+         */
+        uint64_t getRecordCount() { std::lock_guard<std::mutex> lock(m_captureMutex); return m_recordCount; }
+        /**
+         * @brief Read every message of a capture file
+         * @param fileName The capture file
+         * @param messages Filled with the messages in capture order
+         * @return False if the file is missing or not a capture file, a truncated last record is ignored
+         */
+        static bool readFile(const std::string& fileName, std::vector<CapturedMessage>& messages);
+    private:
+        std::vector<char> m_fileBuffer;      ///< Stream buffer of the capture file, declared before the stream using it
+        std::ofstream m_captureFile{};       ///< Capture file
+        uint64_t m_startTime{};              ///< Monotonic start of the capture in nanoseconds
+        uint64_t m_recordCount{};            ///< Recorded messages
+        std::mutex m_captureMutex;           ///< Serializes the records of the transports
+        // Create Logger instance for capture logging
+        Logger m_captureLogger{Logger::Levels::ERROR, "CaptureLog.log", true};
+};
+} // namespace App
@@ -0,0 +1,116 @@
+/**
+ * @file RequestCoalescer.cpp
+ * @brief Source file for request coalescing stage
+ *
+ * Merges identical idempotent requests that are already pending so that each
+ * distinct command is executed once and all submitters share its result
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <iostream>              ///< For std::cout
+#include "RequestCoalescer.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+/**
+ * @brief Constructor to initialize the coalescing stage
+ * @param isEnabled Coalescing is opt-in, when disabled every request gets its own ticket
+ * @param window Maximum age of a pending request that new duplicates may be merged into
+ */
+RequestCoalescer::RequestCoalescer(bool isEnabled, std::chrono::milliseconds window)
+    : m_isEnabled{isEnabled}, m_window{window}
+{
+}
+/**
+ * @brief Submit a request to the coalescing stage
+ * @param request The client request, kept until the ticket completes if it is merged
+ * @param isIdempotent Only idempotent requests may be merged
+ * @return Ticket of the request, isCoalesced is set if the caller must not queue it again
+ */
+RequestCoalescer::Ticket RequestCoalescer::submit(const Request& request, bool isIdempotent)
+{
+    std::lock_guard<std::mutex> lock(m_coalescerMutex);
+    m_submittedCount.fetch_add(1, std::memory_order_relaxed);
+    auto Now = std::chrono::steady_clock::now();
+    bool IsMergeable = m_isEnabled && isIdempotent;
+    if(IsMergeable)
+    {
+        // Merge into the latest pending duplicate if it is still inside the window
+        auto LatestIterator = m_latestPendingTicket.find(request.command);
+        if(LatestIterator != m_latestPendingTicket.end())
+        {
+            PendingEntry& Entry = m_pendingTable.at(LatestIterator->second);
+            if((Now - Entry.firstSeen) <= m_window)
+            {
+                Entry.mergedRequests.push_back(request);
+                m_coalescedCount.fetch_add(1, std::memory_order_relaxed);
+                return Ticket{LatestIterator->second, request.command, true};
+            }
+        }
+    }
+    uint64_t TicketID = m_nextTicketID++;
+    PendingEntry& Entry = m_pendingTable[TicketID];
+    Entry.request = request.command;
+    Entry.firstSeen = Now;
+    if(IsMergeable)
+    {
+        m_latestPendingTicket[request.command] = TicketID;
+    }
+    return Ticket{TicketID, request.command, false};
+}
+/**
+ * @brief End a ticket once its request ran or expired
+ * @param ticketID The ticket returned by submit
+ * @return The requests merged into it, the caller hands each of them the shared result
+ */
+std::vector<Request> RequestCoalescer::complete(uint64_t ticketID)
+{
+    std::lock_guard<std::mutex> lock(m_coalescerMutex);
+    auto EntryIterator = m_pendingTable.find(ticketID);
+    if(EntryIterator == m_pendingTable.end())
+    {
+        return {};
+    }
+    std::vector<Request> MergedRequests = std::move(EntryIterator->second.mergedRequests);
+    // Later duplicates must start a new execution once this one has run
+    auto LatestIterator = m_latestPendingTicket.find(EntryIterator->second.request);
+    if((LatestIterator != m_latestPendingTicket.end()) && (LatestIterator->second == ticketID))
+    {
+        m_latestPendingTicket.erase(LatestIterator);
+    }
+    m_pendingTable.erase(EntryIterator);
+    return MergedRequests;
+}
+/**
+ * @brief Get the number of submitted requests
+ */
+uint64_t RequestCoalescer::getSubmittedCount() const
+{
+    return m_submittedCount.load(std::memory_order_relaxed);
+}
+/**
+ * @brief Get the number of requests merged into a pending one
+ */
+uint64_t RequestCoalescer::getCoalescedCount() const
+{
+    return m_coalescedCount.load(std::memory_order_relaxed);
+}
+/**
+ * @brief Print some statistics.
+ */
+void RequestCoalescer::printStatistics() const
+{
+    std::cout << "\n=== COALESCER STATISTICS ===\n";
+    std::cout << "Coalescing: " << (m_isEnabled ? "Enabled" : "Disabled") << '\n';
+    std::cout << "Window: " << m_window.count() << " ms\n";
+    std::cout << "Submitted requests: " << getSubmittedCount() << '\n';
+    std::cout << "Coalesced requests: " << getCoalescedCount() << '\n';
+    std::cout << "============================\n";
+}
+} // namespace App
@@ -0,0 +1,100 @@
+/**
+ * @file RequestCoalescer.hpp
+ * @brief Header file for request coalescing stage
+ *
+ * Merges identical idempotent requests that are already pending so that each
+ * distinct command is executed once and all submitters share its result
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <atomic>            ///< For std::atomic counters
+#include <chrono>            ///< For std::chrono time points and durations
+#include <cstdint>           ///< For fixed width integer types
+#include <mutex>             ///< For std::mutex and std::lock_guard
+#include <string>            ///< For std::string class operations
+#include <unordered_map>     ///< For std::unordered_map
+#include <vector>            ///< For std::vector
+#include "Request.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @class RequestCoalescer
+ * @brief Coalesces duplicate idempotent requests between Server and PCControl
+ */
+class RequestCoalescer
+{
+    public:
+        /**
+         * @brief Handle returned for every submitted request
+         */
+        struct Ticket
+        {
+            uint64_t id{};                      ///< Ticket the request must be completed with
+            std::string request{};              ///< The submitted request
+            bool isCoalesced{false};            ///< True if merged into an already pending request
+        };
+        /**
+         * @brief Constructor to initialize the coalescing stage
+         * @param isEnabled Coalescing is opt-in, when disabled every request gets its own ticket
+         * @param window Maximum age of a pending request that new duplicates may be merged into
+         */
+        RequestCoalescer(bool isEnabled, std::chrono::milliseconds window);
+        RequestCoalescer(const RequestCoalescer&) = delete;             ///< Delete copy constructor
+        RequestCoalescer& operator=(const RequestCoalescer&) = delete;  ///< Delete copy assignment operator
+        RequestCoalescer(RequestCoalescer&&) = delete;                  ///< Delete move constructor
+        RequestCoalescer& operator=(RequestCoalescer&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Submit a request to the coalescing stage
+         * @param request The client request, kept until the ticket completes if it is merged
+         * @param isIdempotent Only idempotent requests may be merged
+         * @return Ticket of the request, isCoalesced is set if the caller must not queue it again
+         */
+        Ticket submit(const Request& request, bool isIdempotent);
+        /**
+         * @brief End a ticket once its request ran or expired
+         * @param ticketID The ticket returned by submit
+         * @return The requests merged into it, the caller hands each of them the shared result
+         */
+        std::vector<Request> complete(uint64_t ticketID);
+        /**
+         * @brief Get the number of submitted requests
+         */
+        uint64_t getSubmittedCount() const;
+        /**
+         * @brief Get the number of requests merged into a pending one
+         */
+        uint64_t getCoalescedCount() const;
+        /**
+         * @brief Print some statistics.
+         */
+        void printStatistics() const;
+    private:
+        /**
+         * @brief Shared state of a pending request
+         */
+        struct PendingEntry
+        {
+            std::string request{};                                  ///< The pending request
+            std::chrono::steady_clock::time_point firstSeen{};      ///< Arrival time of the first submitter
+            std::vector<Request> mergedRequests{};                  ///< Merged duplicates waiting for the result
+        };
+        bool m_isEnabled{false};                                    ///< Coalescing enable flag
+        std::chrono::milliseconds m_window{};                       ///< Coalescing window
+        uint64_t m_nextTicketID{1};                                 ///< Next ticket to be handed out
+        std::unordered_map<uint64_t, PendingEntry> m_pendingTable{};        ///< Pending requests by ticket
+        std::unordered_map<std::string, uint64_t> m_latestPendingTicket{}; ///< Latest mergeable ticket by request
+        std::atomic<uint64_t> m_submittedCount{0};                  ///< Submitted requests counter
+        std::atomic<uint64_t> m_coalescedCount{0};                  ///< Coalesced requests counter
+        mutable std::mutex m_coalescerMutex;                        ///< Protects the pending tables
+};
+} // namespace App
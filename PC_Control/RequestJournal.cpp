@@ -0,0 +1,534 @@
+/**
+ * @file RequestJournal.cpp
+ * @brief Source file for write-ahead request journal
+ *
+ * Appends accepted requests and their completion markers as CRC-framed records
+ * to a memory-mapped, preallocated file, commits them in groups and replays
+ * the requests without a completion marker on startup
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <iostream>          ///< For std::cout
+#include <algorithm>         ///< For std::max
+#include <array>             ///< For std::array
+#include <cstring>           ///< For memcpy and memset
+#include <filesystem>        ///< For the journal directory
+#include <fcntl.h>           ///< For open and posix_fallocate
+#include <sys/eventfd.h>     ///< For eventfd
+#include <sys/mman.h>        ///< For mmap, msync and munmap
+#include <unistd.h>          ///< For close, fsync, read and write
+#include "RequestJournal.hpp"
+
+/**
+ * @brief helper function to build the CRC-32 (IEEE 802.3) lookup table
+ */
+static constexpr std::array<uint32_t, 256> makeCrcTable()
+{
+    std::array<uint32_t, 256> Table{};
+    for(uint32_t Index = 0; Index < 256; Index++)
+    {
+        uint32_t Value = Index;
+        for(int Bit = 0; Bit < 8; Bit++)
+        {
+            Value = (Value & 1U) ? (0xEDB88320U ^ (Value >> 1)) : (Value >> 1);
+        }
+        Table[Index] = Value;
+    }
+    return Table;
+}
+constexpr std::array<uint32_t, 256> CRC_TABLE{makeCrcTable()};
+
+/**
+ * @brief helper function to feed bytes into a running CRC-32, start with 0xFFFFFFFF and invert the result
+ */
+static uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t length)
+{
+    for(size_t Index = 0; Index < length; Index++)
+    {
+        crc = CRC_TABLE[(crc ^ data[Index]) & 0xFFU] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+/**
+ * @brief Constructor to map the journal file and recover its pending requests
+ * @param fileName The journal file, created if missing
+ * @param mode Durability mode, must not be NONE
+ */
+RequestJournal::RequestJournal(const std::string& fileName, DurabilityMode mode) : m_fileName{fileName}, m_mode{mode}
+{
+    m_commitEventFileDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_mapping = mapFile(m_fileName, m_fileDescriptor);
+    if((nullptr == m_mapping) || (-1 == m_commitEventFileDescriptor))
+    {
+        m_journalLogger.error("An error occurred while opening the request journal: " + m_fileName);
+        exit(EXIT_FAILURE);
+    }
+    recover();
+    std::cout << "Request journal " << m_fileName << " opened in " << convertModeToString(m_mode)
+              << " mode, " << m_pendingRequests.size() << " pending requests recovered\n";
+}
+/**
+ * @brief Commit the remaining records and unmap the journal
+ */
+RequestJournal::~RequestJournal()
+{
+    stop();
+    if(m_mapping != nullptr)
+    {
+        msync(m_mapping, JOURNAL_FILE_SIZE, MS_SYNC);
+        munmap(m_mapping, JOURNAL_FILE_SIZE);
+    }
+    if(m_fileDescriptor != -1)
+    {
+        close(m_fileDescriptor);
+    }
+    if(m_commitEventFileDescriptor != -1)
+    {
+        close(m_commitEventFileDescriptor);
+    }
+}
+/**
+ * @brief Start the group commit thread, does nothing in ASYNC mode
+ */
+void RequestJournal::start()
+{
+    std::lock_guard<std::mutex> lock(m_journalMutex);
+    if((m_mode != DurabilityMode::GROUP_COMMIT) || m_isRunning)
+    {
+        return;
+    }
+    m_isRunning = true;
+    m_commitThread = std::thread(&RequestJournal::commitRecords, this);
+}
+/**
+ * @brief Commit the remaining records and stop the group commit thread
+ */
+void RequestJournal::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_journalMutex);
+        if(!m_isRunning)
+        {
+            return;
+        }
+        m_isRunning = false;
+    }
+    m_commitCondition.notify_one();
+    m_commitThread.join();
+}
+/**
+ * @brief Get the requests journaled without a completion marker, in arrival order
+ */
+std::vector<Request> RequestJournal::getPendingRequests() const
+{
+    std::lock_guard<std::mutex> lock(m_journalMutex);
+    std::vector<Request> PendingRequests;
+    for(const auto& [RequestID, Command] : m_pendingRequests)
+    {
+        Request PendingRequest{};
+        PendingRequest.id = RequestID;
+        PendingRequest.command = Command;
+        PendingRequests.push_back(std::move(PendingRequest));
+    }
+    return PendingRequests;
+}
+/**
+ * @brief Append an accepted request
+ * @param request The request, its identifier must be set
+ * @param sequence Set to the sequence of the record, await it with waitDurable
+ * @return False if the journal is full of pending requests, the request must be refused
+ */
+bool RequestJournal::append(const Request& request, uint64_t& sequence)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_journalMutex);
+        m_largestRequestID = std::max(m_largestRequestID, request.id);
+        // Only a written record is pending, so a compaction always has room for every pending request
+        if(!appendRecord(RecordType::REQUEST, request.id, request.command))
+        {
+            m_refusedCount.fetch_add(1, std::memory_order_relaxed);
+            m_journalLogger.error("Request journal is full of pending requests, refusing request " + std::to_string(request.id));
+            sequence = 0;
+            return false;
+        }
+        m_pendingRequests[request.id] = request.command;
+        m_pendingBytes += getRecordSize(request.command.size());
+        sequence = m_appendedSequence;
+    }
+    m_commitCondition.notify_one();
+    return true;
+}
+/**
+ * @brief Append the completion marker of an executed request
+ */
+void RequestJournal::complete(uint64_t requestID)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_journalMutex);
+        auto PendingRequest = m_pendingRequests.find(requestID);
+        if(PendingRequest == m_pendingRequests.end())
+        {
+            // Never journaled or already completed
+            return;
+        }
+        m_pendingBytes -= getRecordSize(PendingRequest->second.size());
+        m_pendingRequests.erase(PendingRequest);
+        // A marker that does not fit is not needed, the compaction already dropped the completed request
+        appendRecord(RecordType::COMPLETION, requestID, "");
+    }
+    m_commitCondition.notify_one();
+}
+/**
+ * @brief Block until a record is committed, for transport threads without an event loop
+ */
+void RequestJournal::waitDurable(uint64_t sequence)
+{
+    std::unique_lock<std::mutex> lock(m_waitersMutex);
+    // stop commits the remaining records, so every wait ends
+    m_durableCondition.wait(lock, [this, sequence]() { return isDurable(sequence); });
+}
+/**
+ * @brief Resume the coroutines whose records were committed until the loop stops
+ */
+Task<void> RequestJournal::resumeCommitWaiters(EventLoop& loop)
+{
+    while(true)
+    {
+        bool IsReadable = co_await loop.waitReadable(m_commitEventFileDescriptor);
+        if(IsReadable)
+        {
+            uint64_t Value;
+            ssize_t NumberOfReadBytes = read(m_commitEventFileDescriptor, &Value, sizeof(Value));
+            (void)NumberOfReadBytes;
+        }
+        std::vector<std::coroutine_handle<>> ReadyHandles;
+        {
+            std::lock_guard<std::mutex> lock(m_waitersMutex);
+            // On stop every waiter is resumed and observes the stop
+            auto LastReady = IsReadable ? m_commitWaiters.upper_bound(m_durableSequence.load(std::memory_order_acquire))
+                                        : m_commitWaiters.end();
+            for(auto Iterator = m_commitWaiters.begin(); Iterator != LastReady; Iterator++)
+            {
+                ReadyHandles.push_back(Iterator->second);
+            }
+            m_commitWaiters.erase(m_commitWaiters.begin(), LastReady);
+        }
+        for(auto Handle : ReadyHandles)
+        {
+            Handle.resume();
+        }
+        if(!IsReadable)
+        {
+            co_return;
+        }
+    }
+}
+/**
+ * @brief Print journal statistics.
+ */
+void RequestJournal::printStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_journalMutex);
+    std::cout << "\n=== JOURNAL STATISTICS ===\n";
+    std::cout << "Mode: " << convertModeToString(m_mode) << '\n';
+    std::cout << "Journal file: " << m_fileName << '\n';
+    std::cout << "Used: " << m_writeOffset << " of " << JOURNAL_FILE_SIZE << " bytes\n";
+    std::cout << "Pending requests: " << m_pendingRequests.size() << '\n';
+    std::cout << "Records appended: " << m_appendedSequence << '\n';
+    std::cout << "Group commits: " << m_syncCount;
+    if(m_syncCount > 0)
+    {
+        std::cout << " (" << (static_cast<double>(m_durableSequence.load()) / m_syncCount) << " records per commit)";
+    }
+    std::cout << '\n';
+    std::cout << "Compactions: " << m_compactionCount << '\n';
+    std::cout << "Refused requests: " << getRefusedCount() << '\n';
+    std::cout << "==========================\n";
+}
+/**
+ * @brief helper function to convert enum value to string
+ */
+std::string RequestJournal::convertModeToString(DurabilityMode mode)
+{
+    switch(mode)
+    {
+        case DurabilityMode::NONE:         return "NONE";
+        case DurabilityMode::ASYNC:        return "ASYNC";
+        case DurabilityMode::GROUP_COMMIT: return "GROUP_COMMIT";
+        default:                           return "UNKNOWN";
+    }
+}
+/**
+ * @brief Check if a record is committed
+ */
+bool RequestJournal::isDurable(uint64_t sequence) const
+{
+    return (m_mode != DurabilityMode::GROUP_COMMIT) || (m_durableSequence.load(std::memory_order_acquire) >= sequence);
+}
+/**
+ * @brief Register a coroutine awaiting a commit
+ * @return False if the coroutine must not suspend
+ */
+bool RequestJournal::addCommitWaiter(uint64_t sequence, std::coroutine_handle<> handle)
+{
+    std::lock_guard<std::mutex> lock(m_waitersMutex);
+    // The commit may have happened since await_ready
+    if(isDurable(sequence))
+    {
+        return false;
+    }
+    m_commitWaiters.emplace(sequence, handle);
+    return true;
+}
+/**
+ * @brief Write a record at the write offset, compacting the journal if it is full
+ * @return False if the record does not fit even after compacting
+ */
+bool RequestJournal::appendRecord(RecordType type, uint64_t requestID, const std::string& payload)
+{
+    size_t RecordSize = getRecordSize(payload.size());
+    if((m_writeOffset + RecordSize) > JOURNAL_FILE_SIZE)
+    {
+        // Without completed requests to drop a compaction cannot make room, skip rewriting the file for nothing
+        if(((m_pendingBytes + RecordSize) > JOURNAL_FILE_SIZE) || !compact())
+        {
+            return false;
+        }
+    }
+    m_writeOffset += writeRecord(m_mapping + m_writeOffset, type, requestID, payload);
+    m_appendedSequence++;
+    return true;
+}
+/**
+ * @brief Scan the journal, keep the pending requests and clear everything after the last valid record
+ */
+void RequestJournal::recover()
+{
+    size_t Offset = 0;
+    while((Offset + sizeof(RecordHeader)) <= JOURNAL_FILE_SIZE)
+    {
+        RecordHeader Header;
+        memcpy(&Header, m_mapping + Offset, sizeof(Header));
+        if((Header.magic != JOURNAL_RECORD_MAGIC) || (Header.length > (JOURNAL_FILE_SIZE - Offset - sizeof(Header))))
+        {
+            break;
+        }
+        uint32_t StoredChecksum = Header.checksum;
+        Header.checksum = 0;
+        uint32_t Checksum = updateCrc(0xFFFFFFFFU, reinterpret_cast<const uint8_t*>(&Header), sizeof(Header));
+        Checksum = ~updateCrc(Checksum, m_mapping + Offset + sizeof(Header), Header.length);
+        if(Checksum != StoredChecksum)
+        {
+            // Torn write of the last record before a crash
+            break;
+        }
+        if(static_cast<RecordType>(Header.type) == RecordType::REQUEST)
+        {
+            m_pendingRequests[Header.requestID] = std::string(reinterpret_cast<const char*>(m_mapping + Offset + sizeof(Header)), Header.length);
+        }
+        else
+        {
+            m_pendingRequests.erase(Header.requestID);
+        }
+        m_largestRequestID = std::max(m_largestRequestID, Header.requestID);
+        Offset += getRecordSize(Header.length);
+    }
+    for(const auto& [RequestID, Command] : m_pendingRequests)
+    {
+        m_pendingBytes += getRecordSize(Command.size());
+    }
+    // Clear the torn tail and stale records of earlier runs so they are never read as valid.
+    // Only non-zero bytes are written, the pages of a clean tail stay untouched
+    for(size_t Index = Offset; Index < JOURNAL_FILE_SIZE; Index++)
+    {
+        if(m_mapping[Index] != 0)
+        {
+            m_mapping[Index] = 0;
+        }
+    }
+    msync(m_mapping, JOURNAL_FILE_SIZE, MS_SYNC);
+    m_writeOffset = Offset;
+    m_syncedOffset = Offset;
+}
+/**
+ * @brief Rewrite the pending requests into a fresh journal file that replaces the current one
+ * @return False if the journal was kept, e.g. the pending requests do not fit
+ */
+bool RequestJournal::compact()
+{
+    // The current journal stays valid until the compacted one is renamed over it
+    std::string CompactedFileName = m_fileName + ".compact";
+    unlink(CompactedFileName.c_str());
+    int CompactedFileDescriptor = -1;
+    uint8_t* CompactedMapping = mapFile(CompactedFileName, CompactedFileDescriptor);
+    if(nullptr == CompactedMapping)
+    {
+        m_journalLogger.error("An error occurred while compacting the request journal");
+        return false;
+    }
+    size_t Offset = 0;
+    for(const auto& [RequestID, Command] : m_pendingRequests)
+    {
+        if((Offset + getRecordSize(Command.size())) > JOURNAL_FILE_SIZE)
+        {
+            // Never drop an accepted request, the current journal still holds every one of them
+            m_journalLogger.error("Pending requests do not fit a compacted request journal, keeping the current one");
+            munmap(CompactedMapping, JOURNAL_FILE_SIZE);
+            close(CompactedFileDescriptor);
+            unlink(CompactedFileName.c_str());
+            return false;
+        }
+        Offset += writeRecord(CompactedMapping + Offset, RecordType::REQUEST, RequestID, Command);
+    }
+    msync(CompactedMapping, JOURNAL_FILE_SIZE, MS_SYNC);
+    if(-1 == rename(CompactedFileName.c_str(), m_fileName.c_str()))
+    {
+        m_journalLogger.error("An error occurred while replacing the request journal");
+        munmap(CompactedMapping, JOURNAL_FILE_SIZE);
+        close(CompactedFileDescriptor);
+        return false;
+    }
+    // Make the rename itself durable
+    std::filesystem::path Directory = std::filesystem::path(m_fileName).parent_path();
+    int DirectoryFileDescriptor = open(Directory.empty() ? "." : Directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(DirectoryFileDescriptor != -1)
+    {
+        fsync(DirectoryFileDescriptor);
+        close(DirectoryFileDescriptor);
+    }
+    munmap(m_mapping, JOURNAL_FILE_SIZE);
+    close(m_fileDescriptor);
+    m_mapping = CompactedMapping;
+    m_fileDescriptor = CompactedFileDescriptor;
+    m_writeOffset = Offset;
+    m_syncedOffset = Offset;
+    m_compactionCount++;
+    // Every record appended so far is either durable in the new journal or completed
+    m_durableSequence.store(m_appendedSequence, std::memory_order_release);
+    uint64_t Value = 1;
+    ssize_t NumberOfWrittenBytes = write(m_commitEventFileDescriptor, &Value, sizeof(Value));
+    (void)NumberOfWrittenBytes;
+    {
+        std::lock_guard<std::mutex> lock(m_waitersMutex);
+    }
+    m_durableCondition.notify_all();
+    return true;
+}
+/**
+ * @brief Group commit loop syncing the appended records
+ */
+void RequestJournal::commitRecords()
+{
+    long PageSize = sysconf(_SC_PAGESIZE);
+    while(true)
+    {
+        uint64_t Sequence = 0;
+        size_t BeginOffset = 0;
+        size_t EndOffset = 0;
+        uint8_t* Mapping = nullptr;
+        uint64_t Generation = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_journalMutex);
+            // Records appended while the previous sync ran form the next group
+            m_commitCondition.wait(lock, [this]() { return !m_isRunning || (m_appendedSequence > m_durableSequence.load()); });
+            if(m_appendedSequence == m_durableSequence.load())
+            {
+                break;
+            }
+            Sequence = m_appendedSequence;
+            BeginOffset = m_syncedOffset - (m_syncedOffset % static_cast<size_t>(PageSize));
+            EndOffset = m_writeOffset;
+            Mapping = m_mapping;
+            Generation = m_compactionCount;
+        }
+        if((EndOffset > BeginOffset) && (-1 == msync(Mapping + BeginOffset, EndOffset - BeginOffset, MS_SYNC)))
+        {
+            std::lock_guard<std::mutex> lock(m_journalMutex);
+            // A compaction replaced the mapping, its records are durable already
+            if(Generation == m_compactionCount)
+            {
+                m_journalLogger.error("An error occurred while syncing the request journal");
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_journalMutex);
+            if(Generation == m_compactionCount)
+            {
+                m_syncedOffset = EndOffset;
+            }
+            m_syncCount++;
+            if(Sequence > m_durableSequence.load())
+            {
+                m_durableSequence.store(Sequence, std::memory_order_release);
+            }
+        }
+        uint64_t Value = 1;
+        ssize_t NumberOfWrittenBytes = write(m_commitEventFileDescriptor, &Value, sizeof(Value));
+        (void)NumberOfWrittenBytes;
+        {
+            // Pairs with the predicate check of waitDurable so no wake-up is lost
+            std::lock_guard<std::mutex> lock(m_waitersMutex);
+        }
+        m_durableCondition.notify_all();
+    }
+}
+/**
+ * @brief helper function to create, size and map a journal file
+ * @return The mapping, nullptr on error
+ */
+uint8_t* RequestJournal::mapFile(const std::string& fileName, int& fileDescriptor)
+{
+    fileDescriptor = open(fileName.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if(-1 == fileDescriptor)
+    {
+        return nullptr;
+    }
+    // Preallocate so appends never extend the file or fail for lack of space
+    if(0 != posix_fallocate(fileDescriptor, 0, JOURNAL_FILE_SIZE))
+    {
+        close(fileDescriptor);
+        return nullptr;
+    }
+    void* Mapping = mmap(nullptr, JOURNAL_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    if(MAP_FAILED == Mapping)
+    {
+        close(fileDescriptor);
+        return nullptr;
+    }
+    return static_cast<uint8_t*>(Mapping);
+}
+/**
+ * @brief helper function to frame a record into a mapping
+ * @return Size of the record including its alignment padding
+ */
+size_t RequestJournal::writeRecord(uint8_t* destination, RecordType type, uint64_t requestID, const std::string& payload)
+{
+    RecordHeader Header{};
+    Header.magic = JOURNAL_RECORD_MAGIC;
+    Header.length = static_cast<uint32_t>(payload.size());
+    Header.type = static_cast<uint8_t>(type);
+    Header.requestID = requestID;
+    uint32_t Checksum = updateCrc(0xFFFFFFFFU, reinterpret_cast<const uint8_t*>(&Header), sizeof(Header));
+    Header.checksum = ~updateCrc(Checksum, reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+    memcpy(destination + sizeof(Header), payload.data(), payload.size());
+    memcpy(destination, &Header, sizeof(Header));
+    return getRecordSize(payload.size());
+}
+/**
+ * @brief helper function to get the size of a record including its alignment padding
+ */
+size_t RequestJournal::getRecordSize(size_t payloadLength)
+{
+    size_t Size = sizeof(RecordHeader) + payloadLength;
+    return (Size + JOURNAL_RECORD_ALIGNMENT - 1) & ~(JOURNAL_RECORD_ALIGNMENT - 1);
+}
+} // namespace App
@@ -0,0 +1,230 @@
+/**
+ * @file RequestJournal.hpp
+ * @brief Header file for write-ahead request journal
+ *
+ * Appends accepted requests and their completion markers as CRC-framed records
+ * to a memory-mapped, preallocated file, commits them in groups and replays
+ * the requests without a completion marker on startup
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <atomic>                ///< For std::atomic
+#include <condition_variable>    ///< For std::condition_variable
+#include <coroutine>             ///< For std::coroutine_handle
+#include <cstdint>               ///< For fixed width integer types
+#include <map>                   ///< For std::map and std::multimap
+#include <mutex>                 ///< For std::mutex
+#include <string>                ///< For std::string class operations
+#include <thread>                ///< For std::thread
+#include <vector>                ///< For std::vector
+#include "EventLoop.hpp"
+#include "Logger.hpp"
+#include "Request.hpp"
+#include "Task.hpp"
+
+constexpr size_t JOURNAL_FILE_SIZE{4 * 1024 * 1024};   ///< Preallocated journal size, compacted when full
+constexpr uint32_t JOURNAL_RECORD_MAGIC{0x4A524E4CU};  ///< Marks the start of a record
+constexpr size_t JOURNAL_RECORD_ALIGNMENT{8};          ///< Records start at multiples of this
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @brief enum class DurabilityMode represents when journaled requests are on stable storage
+ */
+enum class DurabilityMode : uint8_t
+{
+    NONE         = UINT8_C(0),   ///< No journal
+    ASYNC        = UINT8_C(1),   ///< Records survive a process crash, the kernel writes them back
+    GROUP_COMMIT = UINT8_C(2)    ///< Records are synced in groups, clients are acknowledged after the sync
+};
+
+/**
+ * @class RequestJournal
+ * @brief Append-only journal of accepted requests with crash recovery
+ */
+class RequestJournal
+{
+    public:
+        /**
+         * @brief Suspends until a record is on stable storage
+         */
+        class CommitAwaiter
+        {
+            public:
+                CommitAwaiter(RequestJournal& journal, EventLoop& loop, uint64_t sequence)
+                    : m_journal{journal}, m_loop{loop}, m_sequence{sequence} {}
+                bool await_ready() const noexcept { return m_loop.isStopping() || m_journal.isDurable(m_sequence); }
+                bool await_suspend(std::coroutine_handle<> handle) { return m_journal.addCommitWaiter(m_sequence, handle); }
+                bool await_resume() const noexcept { return !m_loop.isStopping(); }   ///< False if the loop is stopping
+            private:
+                RequestJournal& m_journal;  ///< Journal committing the record
+                EventLoop& m_loop;          ///< Loop resuming the coroutine
+                uint64_t m_sequence{};      ///< Awaited record
+        };
+        /**
+         * @brief Constructor to map the journal file and recover its pending requests
+         * @param fileName The journal file, created if missing
+         * @param mode Durability mode, must not be NONE
+         */
+        RequestJournal(const std::string& fileName, DurabilityMode mode);
+        RequestJournal(const RequestJournal&) = delete;             ///< Delete copy constructor
+        RequestJournal& operator=(const RequestJournal&) = delete;  ///< Delete copy assignment operator
+        RequestJournal(RequestJournal&&) = delete;                  ///< Delete move constructor
+        RequestJournal& operator=(RequestJournal&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Commit the remaining records and unmap the journal
+         */
+        ~RequestJournal();
+        /**
+         * @brief Start the group commit thread, does nothing in ASYNC mode
+         */
+        void start();
+        /**
+         * @brief Commit the remaining records and stop the group commit thread
+         */
+        void stop();
+        /**
+         * @brief Get the requests journaled without a completion marker, in arrival order
+         */
+        std::vector<Request> getPendingRequests() const;
+        /**
+         * @brief Get the largest request identifier found in the journal
+         */
+        uint64_t getLargestRequestID() const { return m_largestRequestID; }
+        /**
+         * @brief Append an accepted request
+         * @param request The request, its identifier must be set
+         * @param sequence Set to the sequence of the record, await it with waitDurable
+         * @return False if the journal is full of pending requests, the request must be refused
+         */
+        bool append(const Request& request, uint64_t& sequence);
+        /**
+         * @brief Append the completion marker of an executed request
+         */
+        void complete(uint64_t requestID);
+        /**
+         * @brief Await the commit of a record, immediate in ASYNC mode
+         * @return False if the loop is stopping
+         */
+        CommitAwaiter waitDurable(EventLoop& loop, uint64_t sequence) { return CommitAwaiter(*this, loop, sequence); }
+        /**
+         * @brief Block until a record is committed, for transport threads without an event loop
+         */
+        void waitDurable(uint64_t sequence);
+        /**
+         * @brief Resume the coroutines whose records were committed until the loop stops
+         */
+        Task<void> resumeCommitWaiters(EventLoop& loop);
+        /**
+         * @brief Get the number of requests refused because the pending ones filled the journal
+         */
+        uint64_t getRefusedCount() const { return m_refusedCount.load(std::memory_order_relaxed); }
+        /**
+         * @brief Get the durability mode
+         */
+        DurabilityMode getMode() const { return m_mode; }
+        /**
+         * @brief Print journal statistics.
+         */
+        void printStatistics() const;
+        /**
+         * @brief helper function to convert enum value to string
+         */
+        static std::string convertModeToString(DurabilityMode mode);
+    private:
+        /**
+         * @brief Record types
+         */
+        enum class RecordType : uint8_t
+        {
+            REQUEST    = UINT8_C(1),   ///< Accepted request, the payload is the command
+            COMPLETION = UINT8_C(2)    ///< Request executed, no payload
+        };
+        /**
+         * @brief Header in front of every record payload
+         */
+        struct RecordHeader
+        {
+            uint32_t magic;         ///< JOURNAL_RECORD_MAGIC
+            uint32_t checksum;      ///< CRC-32 of the header with a zero checksum and the payload
+            uint32_t length;        ///< Payload length
+            uint8_t type;           ///< RecordType
+            uint8_t reserved[3];    ///< Zero
+            uint64_t requestID;     ///< Request the record belongs to
+        };
+        std::string m_fileName{};                          ///< Journal file
+        DurabilityMode m_mode{DurabilityMode::ASYNC};      ///< Durability mode
+        int m_fileDescriptor{-1};                          ///< Journal file descriptor
+        uint8_t* m_mapping{nullptr};                       ///< Mapped journal file
+        size_t m_writeOffset{};                            ///< End of the last record
+        size_t m_syncedOffset{};                           ///< Records before this offset are committed
+        uint64_t m_appendedSequence{};                     ///< Records appended
+        std::atomic<uint64_t> m_durableSequence{0};        ///< Records committed
+        uint64_t m_largestRequestID{};                     ///< Largest request identifier seen
+        std::map<uint64_t, std::string> m_pendingRequests{};  ///< Journaled requests without completion marker
+        size_t m_pendingBytes{};                           ///< Size of the records of the pending requests, what a compaction keeps
+        mutable std::mutex m_journalMutex;                 ///< Protects the mapping and the offsets
+        std::condition_variable m_commitCondition;         ///< Wakes the group commit thread
+        bool m_isRunning{false};                           ///< Group commit thread is running
+        std::thread m_commitThread{};                      ///< Syncs the records in groups
+        int m_commitEventFileDescriptor{-1};               ///< Signals the loop that records were committed
+        std::mutex m_waitersMutex;                         ///< Protects the commit waiters
+        std::multimap<uint64_t, std::coroutine_handle<>> m_commitWaiters{};  ///< Coroutines by awaited sequence
+        std::condition_variable m_durableCondition;        ///< Wakes threads blocked in waitDurable
+        uint64_t m_syncCount{};                            ///< Performed syncs
+        uint64_t m_compactionCount{};                      ///< Performed compactions
+        std::atomic<uint64_t> m_refusedCount{0};           ///< Requests refused for lack of space
+        // Create Logger instance for journal logging
+        Logger m_journalLogger{Logger::Levels::ERROR, "JournalLog.log", true};
+        /**
+         * @brief Check if a record is committed
+         */
+        bool isDurable(uint64_t sequence) const;
+        /**
+         * @brief Register a coroutine awaiting a commit
+         * @return False if the coroutine must not suspend
+         */
+        bool addCommitWaiter(uint64_t sequence, std::coroutine_handle<> handle);
+        /**
+         * @brief Write a record at the write offset, compacting the journal if it is full
+         * @return False if the record does not fit even after compacting
+         */
+        bool appendRecord(RecordType type, uint64_t requestID, const std::string& payload);
+        /**
+         * @brief Scan the journal, keep the pending requests and clear everything after the last valid record
+         */
+        void recover();
+        /**
+         * @brief Rewrite the pending requests into a fresh journal file that replaces the current one
+         * @return False if the journal was kept, e.g. the pending requests do not fit
+         */
+        bool compact();
+        /**
+         * @brief Group commit loop syncing the appended records
+         */
+        void commitRecords();
+        /**
+         * @brief helper function to create, size and map a journal file
+         * @return The mapping, nullptr on error
+         */
+        uint8_t* mapFile(const std::string& fileName, int& fileDescriptor);
+        /**
+         * @brief helper function to frame a record into a mapping
+         * @return Size of the record including its alignment padding
+         */
+        static size_t writeRecord(uint8_t* destination, RecordType type, uint64_t requestID, const std::string& payload);
+        /**
+         * @brief helper function to get the size of a record including its alignment padding
+         */
+        static size_t getRecordSize(size_t payloadLength);
+};
+} // namespace App
@@ -0,0 +1,226 @@
+/**
+ * @file RequestScheduler.cpp
+ * @brief Source file for priority and deadline aware request scheduler
+ *
+ * Orders pending requests by priority class, expires requests that missed
+ * their deadline and ages waiting requests so low priority work is not starved
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <iostream>              ///< For std::cout
+#include <algorithm>             ///< For std::stable_partition and std::max
+#include <charconv>              ///< For std::from_chars
+#include "RequestScheduler.hpp"
+#include "Metrics.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+/**
+ * @brief Constructor to initialize the scheduler
+ * @param agingThreshold Waiting time after which a request is served regardless of its class
+ */
+RequestScheduler::RequestScheduler(std::chrono::milliseconds agingThreshold) : m_agingThreshold{agingThreshold}
+{
+}
+/**
+ * @brief Add a request to its priority class
+ * @param ticketID Ticket of the request in the previous stage
+ * @param request The client request
+ * @param priority Priority class of the request
+ * @param deadline Maximum queueing time, zero means no deadline
+ */
+void RequestScheduler::push(uint64_t ticketID, const Request& request, RequestPriority priority, std::chrono::milliseconds deadline)
+{
+    ScheduledRequest Scheduled{ticketID, request, priority, Clock::now()};
+    if(deadline.count() > 0)
+    {
+        Scheduled.deadline = Scheduled.enqueueTime + deadline;
+    }
+    m_queues[static_cast<size_t>(priority)].push_back(std::move(Scheduled));
+}
+/**
+ * @brief Remove expired requests and get the next request to run
+ * @param request Filled with the next request
+ * @return False if no request is ready
+ */
+bool RequestScheduler::pop(ScheduledRequest& request)
+{
+    auto Now = Clock::now();
+    expireOverdueRequests(Now);
+    size_t SelectedClass = REQUEST_PRIORITY_COUNT;
+    bool IsAged = false;
+    // A lower class request that waited past the aging threshold is served first,
+    // the longest waiting one wins
+    Clock::duration LongestWait{m_agingThreshold};
+    for(size_t Class = 1; Class < REQUEST_PRIORITY_COUNT; Class++)
+    {
+        if(!m_queues[Class].empty())
+        {
+            Clock::duration Wait = Now - m_queues[Class].front().enqueueTime;
+            if(Wait > LongestWait)
+            {
+                LongestWait = Wait;
+                SelectedClass = Class;
+                IsAged = true;
+            }
+        }
+    }
+    // Otherwise serve the highest priority non-empty class
+    for(size_t Class = 0; (Class < REQUEST_PRIORITY_COUNT) && (SelectedClass == REQUEST_PRIORITY_COUNT); Class++)
+    {
+        if(!m_queues[Class].empty())
+        {
+            SelectedClass = Class;
+        }
+    }
+    if(SelectedClass == REQUEST_PRIORITY_COUNT)
+    {
+        return false;
+    }
+    request = m_queues[SelectedClass].front();
+    m_queues[SelectedClass].pop_front();
+    // Account the queueing latency of the class
+    ClassStatistics& Statistics = m_statistics[SelectedClass];
+    auto WaitedTime = Now - request.enqueueTime;
+    auto Latency = std::chrono::duration_cast<std::chrono::microseconds>(WaitedTime);
+    Statistics.dispatchedCount++;
+    Statistics.totalLatency += Latency;
+    Statistics.maxLatency = std::max(Statistics.maxLatency, Latency);
+    Metrics::observeQueueing(request.priority, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(WaitedTime).count()));
+    if(IsAged)
+    {
+        Statistics.agedCount++;
+    }
+    return true;
+}
+/**
+ * @brief Get and clear the requests that expired before they ran
+ */
+std::vector<RequestScheduler::ScheduledRequest> RequestScheduler::takeExpiredRequests()
+{
+    std::vector<ScheduledRequest> ExpiredRequests;
+    ExpiredRequests.swap(m_expiredRequests);
+    return ExpiredRequests;
+}
+/**
+ * @brief Get the number of waiting requests
+ */
+size_t RequestScheduler::size() const
+{
+    size_t Size = 0;
+    for(const auto& Queue : m_queues)
+    {
+        Size += Queue.size();
+    }
+    return Size;
+}
+/**
+ * @brief Print per class queueing statistics.
+ */
+void RequestScheduler::printStatistics() const
+{
+    std::cout << "\n=== SCHEDULER STATISTICS ===\n";
+    for(size_t Class = 0; Class < REQUEST_PRIORITY_COUNT; Class++)
+    {
+        const ClassStatistics& Statistics = m_statistics[Class];
+        auto MeanLatency = (Statistics.dispatchedCount == 0) ? 0 : (Statistics.totalLatency.count() / Statistics.dispatchedCount);
+        std::cout << convertPriorityToString(static_cast<RequestPriority>(Class))
+                  << ": waiting " << m_queues[Class].size()
+                  << ", dispatched " << Statistics.dispatchedCount
+                  << ", expired " << Statistics.expiredCount
+                  << ", aged " << Statistics.agedCount
+                  << ", mean latency " << MeanLatency << " us"
+                  << ", max latency " << Statistics.maxLatency.count() << " us\n";
+    }
+    std::cout << "============================\n";
+}
+/**
+ * @brief Split the options prefix "[priority,deadline_ms] command" from a request
+ * @param request The client request, the prefix is removed in place
+ * @return The parsed options
+ */
+RequestScheduler::RequestOptions RequestScheduler::parseRequestOptions(std::string& request)
+{
+    RequestOptions Options;
+    if(request.empty() || (request.front() != '['))
+    {
+        return Options;
+    }
+    size_t ClosingBracket = request.find(']');
+    if(ClosingBracket == std::string::npos)
+    {
+        return Options;
+    }
+    std::string OptionsText = request.substr(1, ClosingBracket - 1);
+    size_t Comma = OptionsText.find(',');
+    std::string PriorityText = OptionsText.substr(0, Comma);
+    if("high" == PriorityText)
+    {
+        Options.hasPriority = true;
+        Options.priority = RequestPriority::HIGH;
+    }
+    else if("normal" == PriorityText)
+    {
+        Options.hasPriority = true;
+        Options.priority = RequestPriority::NORMAL;
+    }
+    else if("low" == PriorityText)
+    {
+        Options.hasPriority = true;
+        Options.priority = RequestPriority::LOW;
+    }
+    if(Comma != std::string::npos)
+    {
+        std::string DeadlineText = OptionsText.substr(Comma + 1);
+        DeadlineText.erase(0, DeadlineText.find_first_not_of(' '));  // left trim
+        DeadlineText.erase(DeadlineText.find_last_not_of(' ') + 1);  // right trim
+        uint32_t DeadlineMs = 0;
+        auto [End, Error] = std::from_chars(DeadlineText.data(), DeadlineText.data() + DeadlineText.size(), DeadlineMs);
+        // A sign, trailing characters or a value beyond 32 bits make the deadline malformed, the request then runs without one
+        if((std::errc{} == Error) && (End == (DeadlineText.data() + DeadlineText.size())))
+        {
+            Options.deadline = std::chrono::milliseconds(DeadlineMs);
+        }
+    }
+    request.erase(0, ClosingBracket + 1);
+    request.erase(0, request.find_first_not_of(" \n\r\t"));  // left trim
+    return Options;
+}
+/**
+ * @brief helper function to convert enum value to string
+ */
+std::string RequestScheduler::convertPriorityToString(RequestPriority priority)
+{
+    switch(priority)
+    {
+        case RequestPriority::HIGH:   return "HIGH";
+        case RequestPriority::NORMAL: return "NORMAL";
+        case RequestPriority::LOW:    return "LOW";
+        default:                      return "UNKNOWN";
+    }
+}
+/**
+ * @brief helper function to move requests past their deadline out of the queues
+ */
+void RequestScheduler::expireOverdueRequests(Clock::time_point now)
+{
+    for(size_t Class = 0; Class < REQUEST_PRIORITY_COUNT; Class++)
+    {
+        auto& Queue = m_queues[Class];
+        auto FirstExpired = std::stable_partition(Queue.begin(), Queue.end(),
+                                                  [now](const ScheduledRequest& Scheduled) { return Scheduled.deadline >= now; });
+        for(auto Iterator = FirstExpired; Iterator != Queue.end(); Iterator++)
+        {
+            m_expiredRequests.push_back(*Iterator);
+            m_statistics[Class].expiredCount++;
+        }
+        Queue.erase(FirstExpired, Queue.end());
+    }
+}
+} // namespace App
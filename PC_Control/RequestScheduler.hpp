@@ -0,0 +1,134 @@
+/**
+ * @file RequestScheduler.hpp
+ * @brief Header file for priority and deadline aware request scheduler
+ *
+ * Orders pending requests by priority class, expires requests that missed
+ * their deadline and ages waiting requests so low priority work is not starved
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <array>             ///< For std::array
+#include <chrono>            ///< For std::chrono time points and durations
+#include <cstdint>           ///< For fixed width integer types
+#include <deque>             ///< For std::deque container
+#include <string>            ///< For std::string class operations
+#include <vector>            ///< For std::vector container
+#include "Request.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @brief enum class RequestPriority represents request priority classes, lower value runs first
+ */
+enum class RequestPriority : uint8_t
+{
+    HIGH   = UINT8_C(0),
+    NORMAL = UINT8_C(1),
+    LOW    = UINT8_C(2)
+};
+constexpr size_t REQUEST_PRIORITY_COUNT{3};   ///< Number of priority classes
+
+/**
+ * @class RequestScheduler
+ * @brief Schedules requests by priority class and deadline
+ */
+class RequestScheduler
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+        /**
+         * @brief A request waiting in the scheduler
+         */
+        struct ScheduledRequest
+        {
+            uint64_t ticketID{};                          ///< Ticket of the request in the previous stage
+            Request request{};                            ///< The client request and its stage timestamps
+            RequestPriority priority{RequestPriority::NORMAL};  ///< Priority class
+            Clock::time_point enqueueTime{};              ///< Time the request entered the scheduler
+            Clock::time_point deadline{Clock::time_point::max()};  ///< Request is expired after this time
+        };
+        /**
+         * @brief Options a client may carry in front of a request
+         */
+        struct RequestOptions
+        {
+            bool hasPriority{false};                          ///< True if the request carries a priority
+            RequestPriority priority{RequestPriority::NORMAL};  ///< Carried priority
+            std::chrono::milliseconds deadline{0};            ///< Carried deadline, zero means none
+        };
+        /**
+         * @brief Constructor to initialize the scheduler
+         * @param agingThreshold Waiting time after which a request is served regardless of its class
+         */
+        explicit RequestScheduler(std::chrono::milliseconds agingThreshold);
+        RequestScheduler(const RequestScheduler&) = delete;             ///< Delete copy constructor
+        RequestScheduler& operator=(const RequestScheduler&) = delete;  ///< Delete copy assignment operator
+        RequestScheduler(RequestScheduler&&) = delete;                  ///< Delete move constructor
+        RequestScheduler& operator=(RequestScheduler&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Add a request to its priority class
+         * @param ticketID Ticket of the request in the previous stage
+         * @param request The client request
+         * @param priority Priority class of the request
+         * @param deadline Maximum queueing time, zero means no deadline
+         */
+        void push(uint64_t ticketID, const Request& request, RequestPriority priority, std::chrono::milliseconds deadline);
+        /**
+         * @brief Remove expired requests and get the next request to run
+         * @param request Filled with the next request
+         * @return False if no request is ready
+         */
+        bool pop(ScheduledRequest& request);
+        /**
+         * @brief Get and clear the requests that expired before they ran
+         */
+        std::vector<ScheduledRequest> takeExpiredRequests();
+        /**
+         * @brief Get the number of waiting requests
+         */
+        size_t size() const;
+        /**
+         * @brief Print per class queueing statistics.
+         */
+        void printStatistics() const;
+        /**
+         * @brief Split the options prefix "[priority,deadline_ms] command" from a request
+         * @param request The client request, the prefix is removed in place
+         * @return The parsed options
+         */
+        static RequestOptions parseRequestOptions(std::string& request);
+        /**
+         * @brief helper function to convert enum value to string
+         */
+        static std::string convertPriorityToString(RequestPriority priority);
+    private:
+        /**
+         * @brief Statistics of a priority class
+         */
+        struct ClassStatistics
+        {
+            uint64_t dispatchedCount{};                  ///< Requests handed out
+            uint64_t expiredCount{};                     ///< Requests dropped after their deadline
+            uint64_t agedCount{};                        ///< Requests served early because of aging
+            std::chrono::microseconds totalLatency{};    ///< Sum of queueing latencies
+            std::chrono::microseconds maxLatency{};      ///< Worst queueing latency
+        };
+        std::chrono::milliseconds m_agingThreshold{};                              ///< Starvation limit
+        std::array<std::deque<ScheduledRequest>, REQUEST_PRIORITY_COUNT> m_queues{};  ///< Queue per class
+        std::array<ClassStatistics, REQUEST_PRIORITY_COUNT> m_statistics{};        ///< Statistics per class
+        std::vector<ScheduledRequest> m_expiredRequests{};                         ///< Expired, not yet reported
+        /**
+         * @brief helper function to move requests past their deadline out of the queues
+         */
+        void expireOverdueRequests(Clock::time_point now);
+};
+} // namespace App
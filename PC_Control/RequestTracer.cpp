@@ -0,0 +1,256 @@
+/**
+ * @file RequestTracer.cpp
+ * @brief Source file for end-to-end request latency tracing
+ *
+ * Collects the stage timestamps of finished requests into lock-free per-thread
+ * buffers, exports them as Chrome trace JSON and summarizes stage latencies
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <iostream>          ///< For std::cout
+#include <iomanip>           ///< For std::setw
+#include <fstream>           ///< For std::ofstream
+#include <algorithm>         ///< For std::sort and std::min
+#include <cmath>             ///< For std::ceil
+#include <cstring>           ///< For strncpy
+#include <map>               ///< For std::map
+#include "RequestTracer.hpp"
+
+/**
+ * @brief A traced interval between two request stages
+ */
+struct TraceSpan
+{
+    const char* name;            ///< Span name in the trace and summary
+    App::RequestStage begin;     ///< Stage opening the span
+    App::RequestStage end;       ///< Stage closing the span
+};
+constexpr TraceSpan TRACE_SPANS[]{
+    {"receive",  App::RequestStage::RECEIVE,  App::RequestStage::ENQUEUE},
+    {"queue",    App::RequestStage::ENQUEUE,  App::RequestStage::DEQUEUE},
+    {"schedule", App::RequestStage::DEQUEUE,  App::RequestStage::DISPATCH},
+    {"handler",  App::RequestStage::DISPATCH, App::RequestStage::COMPLETE},
+};
+
+/**
+ * @brief helper function to get the duration of a span, zero if a stage was not reached
+ */
+static uint64_t getSpanDuration(const App::TraceRecord& record, App::RequestStage begin, App::RequestStage end)
+{
+    uint64_t Begin = record.timestamps[static_cast<size_t>(begin)];
+    uint64_t End = record.timestamps[static_cast<size_t>(end)];
+    return ((Begin == 0) || (End < Begin)) ? 0 : (End - Begin);
+}
+
+/**
+ * @brief helper function to print the percentiles of a sorted set of durations
+ */
+static void printPercentiles(const std::string& name, std::vector<uint64_t>& durations)
+{
+    if(durations.empty())
+    {
+        return;
+    }
+    std::sort(durations.begin(), durations.end());
+    auto Percentile = [&durations](double Quantile)
+    {
+        size_t Index = static_cast<size_t>(std::ceil(Quantile * durations.size()));
+        return durations[std::min(durations.size() - 1, (Index == 0) ? 0 : (Index - 1))] / 1000.0;
+    };
+    std::cout << std::left << std::setw(24) << name << std::right
+              << std::setw(8) << durations.size()
+              << std::setw(12) << Percentile(0.50)
+              << std::setw(12) << Percentile(0.99)
+              << std::setw(12) << Percentile(0.999) << '\n';
+}
+
+/**
+ * @brief helper function to escape a string for JSON output
+ */
+static std::string escapeJson(const char* text)
+{
+    std::string Escaped;
+    for(const char* Character = text; *Character != '\0'; Character++)
+    {
+        if((*Character == '"') || (*Character == '\\'))
+        {
+            Escaped += '\\';
+            Escaped += *Character;
+        }
+        else if(static_cast<unsigned char>(*Character) < 0x20)
+        {
+            Escaped += ' ';
+        }
+        else
+        {
+            Escaped += *Character;
+        }
+    }
+    return Escaped;
+}
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+std::atomic<bool> RequestTracer::s_isEnabled{false};
+std::mutex RequestTracer::s_registryMutex;
+std::vector<std::unique_ptr<RequestTracer::ThreadBuffer>> RequestTracer::s_threadBuffers;
+
+/**
+ * @brief Enable or disable recording
+ */
+void RequestTracer::setEnabled(bool enabled)
+{
+    s_isEnabled.store(enabled, std::memory_order_relaxed);
+}
+/**
+ * @brief Check if recording is enabled
+ */
+bool RequestTracer::isEnabled()
+{
+    return s_isEnabled.load(std::memory_order_relaxed);
+}
+/**
+ * @brief Record a finished request into the buffer of the calling thread, never blocks
+ */
+void RequestTracer::record(const Request& request)
+{
+    if(!isEnabled())
+    {
+        return;
+    }
+    ThreadBuffer& Buffer = getThreadBuffer();
+    uint64_t WriteIndex = Buffer.writeIndex.load(std::memory_order_relaxed);
+    TraceRecord& Record = Buffer.records[WriteIndex % TRACE_BUFFER_CAPACITY];
+    Record.requestID = request.id;
+    strncpy(Record.command, request.command.c_str(), TRACE_COMMAND_LENGTH - 1);
+    Record.command[TRACE_COMMAND_LENGTH - 1] = '\0';
+    Record.timestamps = request.timestamps;
+    // Publish the record to collectors
+    Buffer.writeIndex.store(WriteIndex + 1, std::memory_order_release);
+}
+/**
+ * @brief Copy the records of every thread
+ */
+std::vector<TraceRecord> RequestTracer::collect()
+{
+    std::vector<TraceRecord> Records;
+    std::lock_guard<std::mutex> lock(s_registryMutex);
+    for(const auto& Buffer : s_threadBuffers)
+    {
+        uint64_t EndIndex = Buffer->writeIndex.load(std::memory_order_acquire);
+        uint64_t BeginIndex = (EndIndex > TRACE_BUFFER_CAPACITY) ? (EndIndex - TRACE_BUFFER_CAPACITY) : 0;
+        size_t FirstCopied = Records.size();
+        for(uint64_t Index = BeginIndex; Index < EndIndex; Index++)
+        {
+            Records.push_back(Buffer->records[Index % TRACE_BUFFER_CAPACITY]);
+        }
+        // Drop the records the writer may have overwritten while they were copied
+        uint64_t LatestIndex = Buffer->writeIndex.load(std::memory_order_acquire);
+        uint64_t OverwrittenCount = (LatestIndex > (BeginIndex + TRACE_BUFFER_CAPACITY)) ? (LatestIndex - BeginIndex - TRACE_BUFFER_CAPACITY) : 0;
+        OverwrittenCount = std::min<uint64_t>(OverwrittenCount, Records.size() - FirstCopied);
+        Records.erase(Records.begin() + FirstCopied, Records.begin() + FirstCopied + OverwrittenCount);
+    }
+    return Records;
+}
+/**
+ * @brief Export the records as Chrome trace JSON, one lane per stage
+ * @param fileName The output file, loadable in chrome://tracing or Perfetto
+ * @return False if the file could not be written
+ */
+bool RequestTracer::exportChromeTrace(const std::string& fileName)
+{
+    std::ofstream TraceFile(fileName);
+    if(!TraceFile.is_open())
+    {
+        std::cerr << "Failed to open file for trace export: " << fileName << '\n';
+        return false;
+    }
+    TraceFile << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool IsFirstEvent = true;
+    // Name the lanes after the spans
+    for(size_t SpanIndex = 0; SpanIndex < std::size(TRACE_SPANS); SpanIndex++)
+    {
+        TraceFile << (IsFirstEvent ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << SpanIndex
+                  << ",\"args\":{\"name\":\"" << TRACE_SPANS[SpanIndex].name << "\"}}";
+        IsFirstEvent = false;
+    }
+    TraceFile << std::fixed << std::setprecision(3);
+    for(const auto& Record : collect())
+    {
+        std::string Command = escapeJson(Record.command);
+        for(size_t SpanIndex = 0; SpanIndex < std::size(TRACE_SPANS); SpanIndex++)
+        {
+            const TraceSpan& Span = TRACE_SPANS[SpanIndex];
+            uint64_t Begin = Record.timestamps[static_cast<size_t>(Span.begin)];
+            if((Begin == 0) || (Record.timestamps[static_cast<size_t>(Span.end)] == 0))
+            {
+                continue;
+            }
+            TraceFile << ",\n{\"name\":\"" << Command << "\",\"cat\":\"" << Span.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << SpanIndex
+                      << ",\"ts\":" << (Begin / 1000.0)
+                      << ",\"dur\":" << (getSpanDuration(Record, Span.begin, Span.end) / 1000.0)
+                      << ",\"args\":{\"id\":" << Record.requestID << "}}";
+        }
+    }
+    TraceFile << "\n]}\n";
+    std::cout << "Request trace exported to: " << fileName << '\n';
+    return TraceFile.good();
+}
+/**
+ * @brief Print p50/p99/p999 latency per stage and per command
+ */
+void RequestTracer::printSummary()
+{
+    std::vector<TraceRecord> Records = collect();
+    std::cout << "\n=== REQUEST LATENCY (us) ===\n";
+    std::cout << std::left << std::setw(24) << "stage/command" << std::right
+              << std::setw(8) << "count" << std::setw(12) << "p50" << std::setw(12) << "p99" << std::setw(12) << "p999" << '\n';
+    for(const auto& Span : TRACE_SPANS)
+    {
+        std::vector<uint64_t> Durations;
+        for(const auto& Record : Records)
+        {
+            if((Record.timestamps[static_cast<size_t>(Span.begin)] != 0) && (Record.timestamps[static_cast<size_t>(Span.end)] != 0))
+            {
+                Durations.push_back(getSpanDuration(Record, Span.begin, Span.end));
+            }
+        }
+        printPercentiles(Span.name, Durations);
+    }
+    // End-to-end latency of the requests that ran, per command
+    std::map<std::string, std::vector<uint64_t>> CommandDurations;
+    for(const auto& Record : Records)
+    {
+        if(Record.timestamps[static_cast<size_t>(RequestStage::COMPLETE)] != 0)
+        {
+            CommandDurations[Record.command].push_back(getSpanDuration(Record, RequestStage::RECEIVE, RequestStage::COMPLETE));
+        }
+    }
+    for(auto& [Command, Durations] : CommandDurations)
+    {
+        printPercentiles("total " + Command, Durations);
+    }
+    std::cout << "============================\n";
+}
+/**
+ * @brief Get the buffer of the calling thread, registered on first use
+ */
+RequestTracer::ThreadBuffer& RequestTracer::getThreadBuffer()
+{
+    thread_local ThreadBuffer* Buffer = nullptr;
+    if(nullptr == Buffer)
+    {
+        // Buffers outlive their threads so their records can still be exported
+        std::lock_guard<std::mutex> lock(s_registryMutex);
+        s_threadBuffers.push_back(std::make_unique<ThreadBuffer>());
+        Buffer = s_threadBuffers.back().get();
+    }
+    return *Buffer;
+}
+} // namespace App
@@ -0,0 +1,93 @@
+/**
+ * @file RequestTracer.hpp
+ * @brief Header file for end-to-end request latency tracing
+ *
+ * Collects the stage timestamps of finished requests into lock-free per-thread
+ * buffers, exports them as Chrome trace JSON and summarizes stage latencies
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <array>             ///< For std::array
+#include <atomic>            ///< For std::atomic
+#include <cstdint>           ///< For fixed width integer types
+#include <memory>            ///< For std::unique_ptr
+#include <mutex>             ///< For std::mutex
+#include <string>            ///< For std::string class operations
+#include <vector>            ///< For std::vector
+#include "Request.hpp"
+
+constexpr size_t TRACE_BUFFER_CAPACITY{8192};     ///< Records kept per thread, the oldest are overwritten
+constexpr size_t TRACE_COMMAND_LENGTH{32};        ///< Command characters kept per record
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @brief Stage timestamps of a finished request
+ */
+struct TraceRecord
+{
+    uint64_t requestID{};                                   ///< Request identifier
+    char command[TRACE_COMMAND_LENGTH]{};                   ///< Truncated, null-terminated command
+    std::array<uint64_t, REQUEST_STAGE_COUNT> timestamps{};  ///< Monotonic nanoseconds per stage
+};
+
+/**
+ * @class RequestTracer
+ * @brief Process wide request tracer with a single-writer ring buffer per thread
+ */
+class RequestTracer
+{
+    public:
+        /**
+         * @brief Enable or disable recording
+         */
+        static void setEnabled(bool enabled);
+        /**
+         * @brief Check if recording is enabled
+         */
+        static bool isEnabled();
+        /**
+         * @brief Record a finished request into the buffer of the calling thread, never blocks
+         */
+        static void record(const Request& request);
+        /**
+         * @brief Copy the records of every thread
+         */
+        static std::vector<TraceRecord> collect();
+        /**
+         * @brief Export the records as Chrome trace JSON, one lane per stage
+         * @param fileName The output file, loadable in chrome://tracing or Perfetto
+         * @return False if the file could not be written
+         */
+        static bool exportChromeTrace(const std::string& fileName);
+        /**
+         * @brief Print p50/p99/p999 latency per stage and per command
+         */
+        static void printSummary();
+    private:
+        /**
+         * @brief Ring buffer written only by its owning thread
+         */
+        struct ThreadBuffer
+        {
+            std::array<TraceRecord, TRACE_BUFFER_CAPACITY> records{};  ///< Recorded requests
+            std::atomic<uint64_t> writeIndex{0};                        ///< Records ever written
+        };
+        static std::atomic<bool> s_isEnabled;                               ///< Recording enable flag
+        static std::mutex s_registryMutex;                                  ///< Protects the buffer registry
+        static std::vector<std::unique_ptr<ThreadBuffer>> s_threadBuffers;  ///< Buffers of every thread that recorded
+        /**
+         * @brief Get the buffer of the calling thread, registered on first use
+         */
+        static ThreadBuffer& getThreadBuffer();
+};
+} // namespace App
@@ -0,0 +1,368 @@
+/**
+ * @file RestartHandoff.cpp
+ * @brief Source file for zero-downtime restart by socket handoff
+ *
+ * Lets a new binary take over from the running one without a connection
+ * refusal. The running server waits for its successor on a Unix domain
+ * socket and passes its listening sockets, the idle client connections and
+ * the requests it did not run over SCM_RIGHTS, then it finishes shutting
+ * down. The listening socket never closes, so connects queue in its backlog
+ * while the successor starts.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <algorithm>         ///< For std::min
+#include <cstring>           ///< For std::memcpy
+#include <fcntl.h>           ///< For fcntl
+#include <iostream>          ///< For std::cout
+#include <sys/socket.h>      ///< For sendmsg, recvmsg and SCM_RIGHTS
+#include <sys/time.h>        ///< For struct timeval
+#include <sys/un.h>          ///< For sockaddr_un
+#include <unistd.h>          ///< For close, unlink and getuid
+#include "RestartHandoff.hpp"
+#include "Server.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+/**
+ * @brief enum class HandoffMessage represents the messages of a handoff, sent in this order
+ */
+enum class HandoffMessage : uint32_t
+{
+    LISTENERS   = UINT32_C(0),   ///< TCP and Unix domain listening sockets, payload is the Unix socket file
+    CONNECTIONS = UINT32_C(1),   ///< Batch of client sockets, payload is one ConnectionRecord per socket
+    REQUEST     = UINT32_C(2),   ///< Pending request, value is its identifier, count its connection and payload its command
+    DONE        = UINT32_C(3)    ///< Value is the next request ID and count the next connection ID
+};
+/**
+ * @brief Header leading every handoff message
+ */
+struct HandoffHeader
+{
+    uint32_t magic{HANDOFF_MAGIC};  ///< Marks a handoff message
+    uint32_t type{};                ///< HandoffMessage
+    uint64_t value{};               ///< Meaning depends on the type
+    uint32_t count{};               ///< Meaning depends on the type
+    uint32_t reserved{};            ///< Zero
+};
+/**
+ * @brief Client socket description in a CONNECTIONS message
+ */
+struct ConnectionRecord
+{
+    uint32_t connectionID{};        ///< Identifier of the connection
+    uint32_t topicMask{};           ///< Subscribed topics
+};
+static_assert(sizeof(HandoffHeader) + (HANDOFF_MAX_DESCRIPTORS * sizeof(ConnectionRecord)) <= HANDOFF_MESSAGE_SIZE,
+              "A full connection batch must fit one message");
+
+/**
+ * @brief Constructor to set the loop waiting for the successor
+ */
+RestartHandoff::RestartHandoff(EventLoop& loop) : m_loop{loop}
+{
+}
+/**
+ * @brief Close the handoff sockets
+ */
+RestartHandoff::~RestartHandoff()
+{
+    stop();
+    if(-1 != m_successorfileDescriptor)
+    {
+        close(m_successorfileDescriptor);
+    }
+}
+/**
+ * @brief Take the state over from a running server, blocks until it finished shutting down
+ * @param path Handoff socket of the running server
+ * @param state Filled with the passed sockets and requests, the caller owns the descriptors
+ * @return False if no server handed off, e.g. none is running
+ */
+bool RestartHandoff::takeOver(const std::string& path, State& state)
+{
+    sockaddr_un UnixAddress{};
+    UnixAddress.sun_family = AF_UNIX;
+    if(path.empty() || (path.size() >= sizeof(UnixAddress.sun_path)))
+    {
+        return false;
+    }
+    std::memcpy(UnixAddress.sun_path, path.c_str(), path.size());
+    int HandofffileDescriptor = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(-1 == HandofffileDescriptor)
+    {
+        return false;
+    }
+    if(-1 == connect(HandofffileDescriptor, reinterpret_cast<sockaddr*>(&UnixAddress), sizeof(UnixAddress)))
+    {
+        close(HandofffileDescriptor);
+        return false;
+    }
+    std::cout << "Taking over from the running server on: " << path << '\n';
+    // The running server first finishes the handler in progress, a hung one must not hang the start
+    timeval Timeout{HANDOFF_TIMEOUT_MS / 1000, (HANDOFF_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(HandofffileDescriptor, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+    State ReceivedState{};
+    std::vector<int> ReceivedFileDescriptors;
+    bool IsDone = false;
+    bool IsValid = true;
+    alignas(HandoffHeader) char Buffer[HANDOFF_MESSAGE_SIZE];
+    alignas(cmsghdr) char Control[CMSG_SPACE(HANDOFF_MAX_DESCRIPTORS * sizeof(int))];
+    while(IsValid && !IsDone)
+    {
+        iovec Vector{Buffer, sizeof(Buffer)};
+        msghdr Message{};
+        Message.msg_iov = &Vector;
+        Message.msg_iovlen = 1;
+        Message.msg_control = Control;
+        Message.msg_controllen = sizeof(Control);
+        ssize_t NumberOfReceivedBytes = recvmsg(HandofffileDescriptor, &Message, MSG_CMSG_CLOEXEC);
+        // Collect the passed descriptors first, they are closed again if the handoff fails
+        std::vector<int> MessageFileDescriptors;
+        for(cmsghdr* Header = CMSG_FIRSTHDR(&Message); (NumberOfReceivedBytes > 0) && (nullptr != Header); Header = CMSG_NXTHDR(&Message, Header))
+        {
+            if((SOL_SOCKET == Header->cmsg_level) && (SCM_RIGHTS == Header->cmsg_type))
+            {
+                size_t Count = (Header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                for(size_t Index = 0; Index < Count; Index++)
+                {
+                    int FileDescriptor = -1;
+                    std::memcpy(&FileDescriptor, CMSG_DATA(Header) + (Index * sizeof(int)), sizeof(int));
+                    MessageFileDescriptors.push_back(FileDescriptor);
+                }
+            }
+        }
+        ReceivedFileDescriptors.insert(ReceivedFileDescriptors.end(), MessageFileDescriptors.begin(), MessageFileDescriptors.end());
+        HandoffHeader Header{};
+        if((NumberOfReceivedBytes < static_cast<ssize_t>(sizeof(Header))) || (0 != (Message.msg_flags & (MSG_TRUNC | MSG_CTRUNC))))
+        {
+            IsValid = false;
+            break;
+        }
+        std::memcpy(&Header, Buffer, sizeof(Header));
+        const char* Payload = Buffer + sizeof(Header);
+        size_t PayloadSize = static_cast<size_t>(NumberOfReceivedBytes) - sizeof(Header);
+        if(HANDOFF_MAGIC != Header.magic)
+        {
+            IsValid = false;
+            break;
+        }
+        switch(static_cast<HandoffMessage>(Header.type))
+        {
+            case HandoffMessage::LISTENERS:
+                IsValid = (MessageFileDescriptors.size() == Header.count) && (Header.count >= 1) && (Header.count <= 2);
+                if(IsValid)
+                {
+                    ReceivedState.listeningFileDescriptor = MessageFileDescriptors[0];
+                    ReceivedState.unixfileDescriptor = (2 == Header.count) ? MessageFileDescriptors[1] : -1;
+                    ReceivedState.unixSocketPath.assign(Payload, PayloadSize);
+                }
+                break;
+            case HandoffMessage::CONNECTIONS:
+                IsValid = (MessageFileDescriptors.size() == Header.count) && (PayloadSize == (Header.count * sizeof(ConnectionRecord)));
+                for(size_t Index = 0; IsValid && (Index < Header.count); Index++)
+                {
+                    ConnectionRecord Record{};
+                    std::memcpy(&Record, Payload + (Index * sizeof(Record)), sizeof(Record));
+                    ReceivedState.connections.push_back(Connection{MessageFileDescriptors[Index], Record.connectionID, Record.topicMask});
+                }
+                break;
+            case HandoffMessage::REQUEST:
+            {
+                Request PendingRequest{};
+                PendingRequest.id = Header.value;
+                // The successor sends the result if it continues the connection
+                PendingRequest.connectionID = Header.count;
+                PendingRequest.command.assign(Payload, PayloadSize);
+                ReceivedState.requests.push_back(std::move(PendingRequest));
+                break;
+            }
+            case HandoffMessage::DONE:
+                ReceivedState.nextRequestID = Header.value;
+                ReceivedState.nextConnectionID = Header.count;
+                IsDone = true;
+                break;
+            default:
+                IsValid = false;
+                break;
+        }
+    }
+    close(HandofffileDescriptor);
+    if(!IsValid || (-1 == ReceivedState.listeningFileDescriptor))
+    {
+        // Without the listening socket nothing can be served, the caller starts from scratch
+        for(int FileDescriptor : ReceivedFileDescriptors)
+        {
+            close(FileDescriptor);
+        }
+        return false;
+    }
+    state = std::move(ReceivedState);
+    std::cout << "Took over " << state.connections.size() << " connections and " << state.requests.size() << " pending requests\n";
+    return true;
+}
+/**
+ * @brief Listen for a successor on the handoff socket, only the owner of the process may connect
+ * @return False if the socket could not be set up
+ */
+bool RestartHandoff::listen(const std::string& path)
+{
+    m_listeningFileDescriptor = Server::openUnixListener(path, SOCK_SEQPACKET, 0600);
+    if(-1 == m_listeningFileDescriptor)
+    {
+        m_handoffLogger.error("An error occurred while binding handoff socket: " + path);
+        return false;
+    }
+    m_socketPath = path;
+    std::cout << "Restart handoff waits for a successor on: " << path << '\n';
+    return true;
+}
+/**
+ * @brief Wait until a successor of the same user connects
+ * @return True once a successor waits for the state, false if the loop stops first
+ */
+Task<bool> RestartHandoff::waitForSuccessor()
+{
+    while(!m_loop.isStopping() && (-1 != m_listeningFileDescriptor))
+    {
+        int SuccessorfileDescriptor = co_await m_loop.accept(m_listeningFileDescriptor);
+        if(-1 == SuccessorfileDescriptor)
+        {
+            if(!m_loop.isStopping())
+            {
+                m_handoffLogger.error("An error occurred while accepting successor");
+                co_await m_loop.sleepFor(std::chrono::milliseconds(SERVER_ACCEPT_RETRY_MS));
+            }
+            continue;
+        }
+        if(!isSameUser(SuccessorfileDescriptor))
+        {
+            // The successor receives every client socket, the file permissions are not the only check
+            m_handoffLogger.error("Refused handoff to a process of another user");
+            close(SuccessorfileDescriptor);
+            continue;
+        }
+        m_successorfileDescriptor = SuccessorfileDescriptor;
+        // The successor listens on the same file once it took over
+        stop();
+        co_return true;
+    }
+    co_return false;
+}
+/**
+ * @brief Pass the state to the waiting successor, call after the loop stopped
+ * @param state Sockets and requests, the descriptors stay open in this process
+ * @return False if the successor did not receive everything
+ */
+bool RestartHandoff::handOff(const State& state)
+{
+    if(-1 == m_successorfileDescriptor)
+    {
+        return false;
+    }
+    // The loop no longer runs, send blocking and give up on a successor that stopped reading
+    int Flags = fcntl(m_successorfileDescriptor, F_GETFL);
+    fcntl(m_successorfileDescriptor, F_SETFL, Flags & ~O_NONBLOCK);
+    timeval Timeout{HANDOFF_TIMEOUT_MS / 1000, (HANDOFF_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(m_successorfileDescriptor, SOL_SOCKET, SO_SNDTIMEO, &Timeout, sizeof(Timeout));
+    int Listeners[2]{state.listeningFileDescriptor, state.unixfileDescriptor};
+    uint32_t ListenerCount = (-1 == state.unixfileDescriptor) ? 1 : 2;
+    bool IsSent = sendMessage(m_successorfileDescriptor, static_cast<uint32_t>(HandoffMessage::LISTENERS), 0, ListenerCount,
+                              state.unixSocketPath.data(), state.unixSocketPath.size(), Listeners, ListenerCount);
+    // Client sockets go in batches, one message carries a limited number of descriptors
+    for(size_t First = 0; IsSent && (First < state.connections.size()); First += HANDOFF_MAX_DESCRIPTORS)
+    {
+        size_t Count = std::min(HANDOFF_MAX_DESCRIPTORS, state.connections.size() - First);
+        std::vector<int> FileDescriptors(Count);
+        std::vector<ConnectionRecord> Records(Count);
+        for(size_t Index = 0; Index < Count; Index++)
+        {
+            const Connection& PassedConnection = state.connections[First + Index];
+            FileDescriptors[Index] = PassedConnection.fileDescriptor;
+            Records[Index] = ConnectionRecord{PassedConnection.connectionID, PassedConnection.topicMask};
+        }
+        IsSent = sendMessage(m_successorfileDescriptor, static_cast<uint32_t>(HandoffMessage::CONNECTIONS), 0, static_cast<uint32_t>(Count),
+                             Records.data(), Count * sizeof(ConnectionRecord), FileDescriptors.data(), Count);
+    }
+    for(size_t Index = 0; IsSent && (Index < state.requests.size()); Index++)
+    {
+        const Request& PendingRequest = state.requests[Index];
+        IsSent = sendMessage(m_successorfileDescriptor, static_cast<uint32_t>(HandoffMessage::REQUEST), PendingRequest.id, PendingRequest.connectionID,
+                             PendingRequest.command.data(), PendingRequest.command.size(), nullptr, 0);
+    }
+    IsSent = IsSent && sendMessage(m_successorfileDescriptor, static_cast<uint32_t>(HandoffMessage::DONE), state.nextRequestID,
+                                   state.nextConnectionID, nullptr, 0, nullptr, 0);
+    close(m_successorfileDescriptor);
+    m_successorfileDescriptor = -1;
+    if(!IsSent)
+    {
+        m_handoffLogger.error("An error occurred while handing off to the successor");
+        return false;
+    }
+    std::cout << "Handed off " << state.connections.size() << " connections and " << state.requests.size() << " pending requests\n";
+    return true;
+}
+/**
+ * @brief Close the handoff socket and remove its file
+ */
+void RestartHandoff::stop()
+{
+    if(-1 != m_listeningFileDescriptor)
+    {
+        m_loop.closeFileDescriptor(m_listeningFileDescriptor);
+        unlink(m_socketPath.c_str());
+        m_listeningFileDescriptor = -1;
+    }
+}
+/**
+ * @brief helper function to check that the peer of a socket runs as the same user
+ */
+bool RestartHandoff::isSameUser(int socketFileDescriptor)
+{
+    ucred Credentials{};
+    socklen_t CredentialsSize = sizeof(Credentials);
+    if(-1 == getsockopt(socketFileDescriptor, SOL_SOCKET, SO_PEERCRED, &Credentials, &CredentialsSize))
+    {
+        return false;
+    }
+    return Credentials.uid == getuid();
+}
+/**
+ * @brief helper function to send one handoff message with descriptors attached
+ */
+bool RestartHandoff::sendMessage(int socketFileDescriptor, uint32_t type, uint64_t value, uint32_t count,
+                                 const void* payload, size_t payloadSize, const int* fileDescriptors, size_t fileDescriptorCount)
+{
+    if((sizeof(HandoffHeader) + payloadSize > HANDOFF_MESSAGE_SIZE) || (fileDescriptorCount > HANDOFF_MAX_DESCRIPTORS))
+    {
+        return false;
+    }
+    HandoffHeader Header{};
+    Header.type = type;
+    Header.value = value;
+    Header.count = count;
+    iovec Vectors[2]{{&Header, sizeof(Header)}, {const_cast<void*>(payload), payloadSize}};
+    alignas(cmsghdr) char Control[CMSG_SPACE(HANDOFF_MAX_DESCRIPTORS * sizeof(int))]{};
+    msghdr Message{};
+    Message.msg_iov = Vectors;
+    Message.msg_iovlen = (payloadSize > 0) ? 2 : 1;
+    if(fileDescriptorCount > 0)
+    {
+        Message.msg_control = Control;
+        Message.msg_controllen = CMSG_SPACE(fileDescriptorCount * sizeof(int));
+        cmsghdr* ControlHeader = CMSG_FIRSTHDR(&Message);
+        ControlHeader->cmsg_level = SOL_SOCKET;
+        ControlHeader->cmsg_type = SCM_RIGHTS;
+        ControlHeader->cmsg_len = CMSG_LEN(fileDescriptorCount * sizeof(int));
+        std::memcpy(CMSG_DATA(ControlHeader), fileDescriptors, fileDescriptorCount * sizeof(int));
+    }
+    // A seqpacket message is sent whole or not at all
+    return static_cast<ssize_t>(sizeof(Header) + payloadSize) == sendmsg(socketFileDescriptor, &Message, MSG_NOSIGNAL);
+}
+} // namespace App
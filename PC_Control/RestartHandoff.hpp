@@ -0,0 +1,127 @@
+/**
+ * @file RestartHandoff.hpp
+ * @brief Header file for zero-downtime restart by socket handoff
+ *
+ * Lets a new binary take over from the running one without a connection
+ * refusal. The running server waits for its successor on a Unix domain
+ * socket and passes its listening sockets, the idle client connections and
+ * the requests it did not run over SCM_RIGHTS, then it finishes shutting
+ * down. The listening socket never closes, so connects queue in its backlog
+ * while the successor starts.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <cstdint>               ///< For fixed width integer types
+#include <string>                ///< For std::string class operations
+#include <vector>                ///< For std::vector
+#include "EventLoop.hpp"
+#include "Logger.hpp"
+#include "Request.hpp"
+#include "Task.hpp"
+
+constexpr uint32_t HANDOFF_MAGIC{0x50434846};          ///< "PCHF", marks every handoff message
+constexpr size_t HANDOFF_MAX_DESCRIPTORS{250};         ///< Descriptors passed per message, the kernel allows 253
+constexpr size_t HANDOFF_MESSAGE_SIZE{4096};           ///< Largest handoff message
+constexpr int HANDOFF_TIMEOUT_MS{30000};               ///< Time the successor waits for the running handlers to finish
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @class RestartHandoff
+ * @brief Passes the sockets and pending requests of a server to its successor
+ */
+class RestartHandoff
+{
+    public:
+        /**
+         * @brief A client connection passed to the successor
+         */
+        struct Connection
+        {
+            int fileDescriptor{-1};     ///< Client socket
+            uint32_t connectionID{};    ///< Identifier of the connection, kept across the restart
+            uint32_t topicMask{};       ///< Subscribed topics, bit n for topic n
+        };
+        /**
+         * @brief Everything a server hands to its successor
+         */
+        struct State
+        {
+            int listeningFileDescriptor{-1};      ///< TCP listening socket
+            int unixfileDescriptor{-1};           ///< Unix domain listening socket, -1 if none
+            std::string unixSocketPath{};         ///< File of the Unix domain listening socket
+            std::vector<Connection> connections{};  ///< Idle client connections
+            std::vector<Request> requests{};      ///< Received requests that did not run, oldest first
+            uint64_t nextRequestID{1};            ///< Identifier of the next received request
+            uint32_t nextConnectionID{1};         ///< Identifier of the next accepted connection
+        };
+        /**
+         * @brief Constructor to set the loop waiting for the successor
+         */
+        explicit RestartHandoff(EventLoop& loop);
+        RestartHandoff(const RestartHandoff&) = delete;             ///< Delete copy constructor
+        RestartHandoff& operator=(const RestartHandoff&) = delete;  ///< Delete copy assignment operator
+        RestartHandoff(RestartHandoff&&) = delete;                  ///< Delete move constructor
+        RestartHandoff& operator=(RestartHandoff&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Close the handoff sockets
+         */
+        ~RestartHandoff();
+        /**
+         * @brief Take the state over from a running server, blocks until it finished shutting down
+         * @param path Handoff socket of the running server
+         * @param state Filled with the passed sockets and requests, the caller owns the descriptors
+         * @return False if no server handed off, e.g. none is running
+         */
+        static bool takeOver(const std::string& path, State& state);
+        /**
+         * @brief Listen for a successor on the handoff socket, only the owner of the process may connect
+         * @return False if the socket could not be set up
+         */
+        bool listen(const std::string& path);
+        /**
+         * @brief Wait until a successor of the same user connects
+         * @return True once a successor waits for the state, false if the loop stops first
+         */
+        Task<bool> waitForSuccessor();
+        /**
+         * @brief Check if a successor waits for the state
+         */
+        bool isRequested() const { return -1 != m_successorfileDescriptor; }
+        /**
+         * @brief Pass the state to the waiting successor, call after the loop stopped
+         * @param state Sockets and requests, the descriptors stay open in this process
+         * @return False if the successor did not receive everything
+         */
+        bool handOff(const State& state);
+        /**
+         * @brief Close the handoff socket and remove its file
+         */
+        void stop();
+    private:
+        EventLoop& m_loop;                          ///< Loop waiting for the successor
+        int m_listeningFileDescriptor{-1};          ///< Handoff socket, -1 if not listening
+        int m_successorfileDescriptor{-1};          ///< Connection of the successor, -1 until one connects
+        std::string m_socketPath{};                 ///< Handoff socket file
+        // Create Logger instance for handoff logging
+        Logger m_handoffLogger{Logger::Levels::ERROR, "HandoffLog.log", true};
+        /**
+         * @brief helper function to check that the peer of a socket runs as the same user
+         */
+        static bool isSameUser(int socketFileDescriptor);
+        /**
+         * @brief helper function to send one handoff message with descriptors attached
+         */
+        static bool sendMessage(int socketFileDescriptor, uint32_t type, uint64_t value, uint32_t count,
+                                const void* payload, size_t payloadSize, const int* fileDescriptors, size_t fileDescriptorCount);
+};
+} // namespace App
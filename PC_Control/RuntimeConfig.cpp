@@ -0,0 +1,342 @@
+/**
+ * @file RuntimeConfig.cpp
+ * @brief Source file for the runtime configuration
+ *
+ * Reads the tunable server settings from a file of "key = value" lines and
+ * rejects a file with an unknown key or an invalid value as a whole
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <algorithm>             ///< For std::transform
+#include <cctype>                ///< For std::toupper and std::isspace
+#include <charconv>              ///< For std::from_chars
+#include <climits>               ///< For INT_MAX and LLONG_MAX
+#include <fstream>               ///< For std::ifstream
+#include <iostream>              ///< For std::cout
+#include <sched.h>               ///< For CPU_SETSIZE
+#include <sstream>               ///< For std::istringstream
+#include "RuntimeConfig.hpp"
+#include "LogArchive.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+namespace
+{
+/**
+ * @brief helper function to strip leading and trailing white space
+ */
+std::string trim(const std::string& text)
+{
+    size_t Begin = 0;
+    size_t End = text.size();
+    while((Begin < End) && std::isspace(static_cast<unsigned char>(text[Begin])))
+    {
+        Begin++;
+    }
+    while((End > Begin) && std::isspace(static_cast<unsigned char>(text[End - 1])))
+    {
+        End--;
+    }
+    return text.substr(Begin, End - Begin);
+}
+} // namespace
+
+/**
+ * @brief Constructor to set the file and the settings used for missing keys
+ * @param fileName Configuration file, a missing file keeps the defaults
+ * @param defaults Settings of the keys the file does not set
+ */
+RuntimeConfig::RuntimeConfig(const std::string& fileName, const Settings& defaults)
+    : m_fileName{fileName}, m_defaults{defaults}, m_settings{defaults}
+{
+}
+/**
+ * @brief Read the file, keys it does not set get their defaults
+ * @return False if the file was rejected, the previous settings stay in force
+ */
+bool RuntimeConfig::load()
+{
+    std::ifstream ConfigFile(m_fileName);
+    if(!ConfigFile.is_open())
+    {
+        // Running without a file is the default set-up, removing it reverts to the defaults
+        m_settings = m_defaults;
+        m_loadCount++;
+        return true;
+    }
+    Settings LoadedSettings = m_defaults;
+    std::string Line;
+    size_t LineNumber = 0;
+    while(std::getline(ConfigFile, Line))
+    {
+        LineNumber++;
+        Line = trim(Line.substr(0, Line.find('#')));
+        if(Line.empty())
+        {
+            continue;
+        }
+        size_t Separator = Line.find('=');
+        std::string Error;
+        if(std::string::npos == Separator)
+        {
+            Error = "expected \"key = value\"";
+        }
+        else
+        {
+            Error = applySetting(LoadedSettings, trim(Line.substr(0, Separator)), trim(Line.substr(Separator + 1)));
+        }
+        if(!Error.empty())
+        {
+            m_configLogger.error(m_fileName + ":" + std::to_string(LineNumber) + ": " + Error + ", configuration not applied");
+            m_rejectedCount++;
+            return false;
+        }
+    }
+    m_settings = LoadedSettings;
+    m_loadCount++;
+    return true;
+}
+/**
+ * @brief Print configuration statistics.
+ */
+void RuntimeConfig::printStatistics() const
+{
+    std::cout << "\n=== CONFIGURATION STATISTICS ===\n";
+    std::cout << "Configuration file: " << m_fileName << '\n';
+    std::cout << "Loads applied: " << m_loadCount << '\n';
+    std::cout << "Loads rejected: " << m_rejectedCount << '\n';
+    std::cout << "Listen backlog: " << m_settings.listenBacklog << '\n';
+    std::cout << "Loop CPUs: ";
+    if(m_settings.loopCpus.empty())
+    {
+        std::cout << "any";
+    }
+    for(size_t Index = 0; Index < m_settings.loopCpus.size(); Index++)
+    {
+        std::cout << ((0 == Index) ? "" : ",") << m_settings.loopCpus[Index];
+    }
+    std::cout << '\n';
+    std::cout << "================================\n";
+}
+/**
+ * @brief helper function to set one key of the settings
+ * @return An error description, empty if the key and value are valid
+ */
+std::string RuntimeConfig::applySetting(Settings& settings, const std::string& key, const std::string& value)
+{
+    long long Number = 0;
+    Logger::Levels Level{};
+    if("port" == key || "metrics_port" == key)
+    {
+        if(!parseNumber(value, 1, 65535, Number))
+        {
+            return key + " must be a port number";
+        }
+        (("port" == key) ? settings.port : settings.metricsPort) = static_cast<int>(Number);
+    }
+    else if("receive_buffer_size" == key)
+    {
+        if(!parseNumber(value, CONFIG_MIN_RECEIVE_BUFFER_SIZE, CONFIG_MAX_RECEIVE_BUFFER_SIZE, Number))
+        {
+            return key + " must be between " + std::to_string(CONFIG_MIN_RECEIVE_BUFFER_SIZE) + " and " + std::to_string(CONFIG_MAX_RECEIVE_BUFFER_SIZE);
+        }
+        settings.receiveBufferSize = static_cast<size_t>(Number);
+    }
+    else if("journal_durability" == key)
+    {
+        if(!parseDurability(value, settings.journalDurability))
+        {
+            return key + " must be NONE, ASYNC or GROUP_COMMIT";
+        }
+    }
+    else if("listen_backlog" == key)
+    {
+        // The kernel silently caps larger values at net.core.somaxconn
+        if(!parseNumber(value, 1, INT_MAX, Number))
+        {
+            return key + " must be a positive number";
+        }
+        settings.listenBacklog = static_cast<int>(Number);
+    }
+    else if("socket_receive_buffer" == key || "socket_send_buffer" == key)
+    {
+        if(!parseNumber(value, 0, INT_MAX / 2, Number))
+        {
+            return key + " must be a number of bytes";
+        }
+        (("socket_receive_buffer" == key) ? settings.socketReceiveBufferBytes : settings.socketSendBufferBytes) = static_cast<int>(Number);
+    }
+    else if("loop_cpus" == key)
+    {
+        if(!parseCpuList(value, settings.loopCpus))
+        {
+            return key + " must be a list of CPUs such as 0,2-3";
+        }
+    }
+    else if("subscriber_queue_limit" == key || "message_queue_limit" == key || "event_channel_capacity" == key)
+    {
+        if(!parseNumber(value, 1, INT_MAX, Number))
+        {
+            return key + " must be a positive number";
+        }
+        if("subscriber_queue_limit" == key)
+        {
+            settings.subscriberQueueLimit = static_cast<size_t>(Number);
+        }
+        else if("message_queue_limit" == key)
+        {
+            settings.messageQueueLimit = static_cast<size_t>(Number);
+        }
+        else
+        {
+            settings.eventChannelCapacity = static_cast<size_t>(Number);
+        }
+    }
+    else if("log_level" == key || "server_log_level" == key || "pccontrol_log_level" == key || "event_level" == key)
+    {
+        if(!parseLevel(value, Level))
+        {
+            return key + " must be DEBUG, INFO, WARNING, ERROR or CRITICAL";
+        }
+        if("log_level" == key)
+        {
+            settings.logLevel = Level;
+        }
+        else if("server_log_level" == key)
+        {
+            settings.serverLogLevel = Level;
+        }
+        else if("pccontrol_log_level" == key)
+        {
+            settings.pcControlLogLevel = Level;
+        }
+        else
+        {
+            settings.eventLevel = Level;
+        }
+    }
+    else if("log_flush_interval_ms" == key)
+    {
+        if(!parseNumber(value, 1, 3600000, Number))
+        {
+            return key + " must be between 1 and 3600000";
+        }
+        settings.logFlushIntervalMs = static_cast<uint32_t>(Number);
+    }
+    else if("log_segment_bytes" == key)
+    {
+        // Tiny segments would turn every few records into an archive
+        if(!parseNumber(value, 0, LLONG_MAX, Number) || ((Number > 0) && (static_cast<size_t>(Number) < LOG_ARCHIVE_BLOCK_SIZE)))
+        {
+            return key + " must be 0 or at least " + std::to_string(LOG_ARCHIVE_BLOCK_SIZE);
+        }
+        settings.logSegmentBytes = static_cast<size_t>(Number);
+    }
+    else if("sample_interval_ms" == key)
+    {
+        // Each sample rereads every stat file, shorter intervals only cost CPU
+        if(!parseNumber(value, 10, 3600000, Number))
+        {
+            return key + " must be between 10 and 3600000";
+        }
+        settings.sampleIntervalMs = static_cast<uint32_t>(Number);
+    }
+    else
+    {
+        return "unknown key \"" + key + "\"";
+    }
+    return {};
+}
+/**
+ * @brief helper function to parse a log level name, case-insensitive
+ */
+bool RuntimeConfig::parseLevel(const std::string& text, Logger::Levels& level)
+{
+    std::string Name = text;
+    std::transform(Name.begin(), Name.end(), Name.begin(), [](unsigned char Character) { return static_cast<char>(std::toupper(Character)); });
+    constexpr std::pair<const char*, Logger::Levels> LEVEL_NAMES[]{
+        {"DEBUG", Logger::Levels::DEBUG}, {"INFO", Logger::Levels::INFO}, {"WARNING", Logger::Levels::WARNING},
+        {"ERROR", Logger::Levels::ERROR}, {"CRITICAL", Logger::Levels::CRITICAL}};
+    for(const auto& [LevelName, Level] : LEVEL_NAMES)
+    {
+        if(Name == LevelName)
+        {
+            level = Level;
+            return true;
+        }
+    }
+    return false;
+}
+/**
+ * @brief helper function to parse a journal durability mode name, case-insensitive
+ */
+bool RuntimeConfig::parseDurability(const std::string& text, DurabilityMode& mode)
+{
+    std::string Name = text;
+    std::transform(Name.begin(), Name.end(), Name.begin(), [](unsigned char Character) { return static_cast<char>(std::toupper(Character)); });
+    for(DurabilityMode Mode : {DurabilityMode::NONE, DurabilityMode::ASYNC, DurabilityMode::GROUP_COMMIT})
+    {
+        if(Name == RequestJournal::convertModeToString(Mode))
+        {
+            mode = Mode;
+            return true;
+        }
+    }
+    return false;
+}
+/**
+ * @brief helper function to parse a list of CPUs such as "0,2-3"
+ */
+bool RuntimeConfig::parseCpuList(const std::string& text, std::vector<int>& cpus)
+{
+    std::vector<int> ParsedCpus;
+    std::istringstream ListStream(text);
+    std::string Range;
+    while(std::getline(ListStream, Range, ','))
+    {
+        Range = trim(Range);
+        if(Range.empty())
+        {
+            continue;
+        }
+        size_t Dash = Range.find('-');
+        long long First = 0;
+        long long Last = 0;
+        if(!parseNumber(trim(Range.substr(0, Dash)), 0, CPU_SETSIZE - 1, First))
+        {
+            return false;
+        }
+        Last = First;
+        if((std::string::npos != Dash) && (!parseNumber(trim(Range.substr(Dash + 1)), First, CPU_SETSIZE - 1, Last)))
+        {
+            return false;
+        }
+        for(long long Cpu = First; Cpu <= Last; Cpu++)
+        {
+            ParsedCpus.push_back(static_cast<int>(Cpu));
+        }
+    }
+    cpus = std::move(ParsedCpus);
+    return true;
+}
+/**
+ * @brief helper function to parse a whole decimal number within a range
+ */
+bool RuntimeConfig::parseNumber(const std::string& text, long long minimum, long long maximum, long long& number)
+{
+    long long Parsed = 0;
+    auto [End, Error] = std::from_chars(text.data(), text.data() + text.size(), Parsed);
+    if((std::errc{} != Error) || (End != (text.data() + text.size())) || (Parsed < minimum) || (Parsed > maximum))
+    {
+        return false;
+    }
+    number = Parsed;
+    return true;
+}
+} // namespace App
@@ -0,0 +1,143 @@
+/**
+ * @file RuntimeConfig.hpp
+ * @brief Header file for the runtime configuration
+ *
+ * Reads the tunable server settings from a file of "key = value" lines, '#'
+ * starts a comment. The file is read at start-up and again on SIGHUP. A file
+ * with an unknown key or an invalid value is rejected as a whole, so the
+ * running server never sees half of an edit. Keys:
+ *
+ *   port, metrics_port, receive_buffer_size   take effect after a restart
+ *   journal_durability                        NONE, ASYNC or GROUP_COMMIT, takes effect after a restart
+ *   listen_backlog                            pending connection limit
+ *   socket_receive_buffer, socket_send_buffer SO_RCVBUF and SO_SNDBUF in bytes, 0 keeps the kernel default
+ *   loop_cpus                                 CPUs of the event loop thread, e.g. "0,2-3", empty for every CPU
+ *   subscriber_queue_limit                    publications waiting per subscriber
+ *   message_queue_limit                       requests waiting for a handler before new ones are answered busy
+ *   event_channel_capacity                    diagnostic events waiting for the writer
+ *   log_level, server_log_level, pccontrol_log_level, event_level   DEBUG, INFO, WARNING, ERROR or CRITICAL
+ *   log_flush_interval_ms                     longest time a batched log record waits
+ *   log_segment_bytes                         log size at which it is sealed and compressed, 0 never seals
+ *   sample_interval_ms                        time between two samples of the status, ps and stats queries
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <cstddef>           ///< For size_t
+#include <cstdint>           ///< For fixed width integer types
+#include <optional>          ///< For std::optional
+#include <string>            ///< For std::string class operations
+#include <vector>            ///< For std::vector
+#include "Logger.hpp"
+#include "RequestJournal.hpp"
+
+constexpr size_t CONFIG_MIN_RECEIVE_BUFFER_SIZE{64};         ///< Smallest receive buffer, holds a binary frame header
+constexpr size_t CONFIG_MAX_RECEIVE_BUFFER_SIZE{1024 * 1024};  ///< Largest receive buffer, shared by every connection
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @class RuntimeConfig
+ * @brief Loads the server settings from a file and reloads them on request
+ */
+class RuntimeConfig
+{
+    public:
+        /**
+         * @brief Every setting of the configuration file
+         */
+        struct Settings
+        {
+            int port{};                                        ///< TCP port, applies after a restart
+            int metricsPort{};                                 ///< Metrics port, applies after a restart
+            size_t receiveBufferSize{};                        ///< Bytes a single receive reads, applies after a restart
+            DurabilityMode journalDurability{DurabilityMode::NONE};  ///< Request journal mode, applies after a restart
+            int listenBacklog{};                               ///< Pending connection limit of the listeners
+            int socketReceiveBufferBytes{};                    ///< SO_RCVBUF of new connections, 0 keeps the kernel default
+            int socketSendBufferBytes{};                       ///< SO_SNDBUF of new connections, 0 keeps the kernel default
+            std::vector<int> loopCpus{};                       ///< CPUs of the event loop thread, empty for every CPU
+            size_t subscriberQueueLimit{};                     ///< Publications waiting per subscriber before the topic policy applies
+            size_t messageQueueLimit{};                        ///< Requests waiting for a handler before new ones are answered busy
+            size_t eventChannelCapacity{};                     ///< Diagnostic events waiting for the writer
+            Logger::Levels logLevel{Logger::Levels::ERROR};    ///< Level of every log file
+            std::optional<Logger::Levels> serverLogLevel{};    ///< Level of the server log, logLevel if unset
+            std::optional<Logger::Levels> pcControlLogLevel{}; ///< Level of the handler log, logLevel if unset
+            Logger::Levels eventLevel{Logger::Levels::DEBUG};  ///< Minimum level of diagnostic events
+            uint32_t logFlushIntervalMs{};                     ///< Longest time a batched log record waits for its write
+            size_t logSegmentBytes{};                          ///< Log size at which it is sealed and compressed, 0 never seals
+            uint32_t sampleIntervalMs{};                       ///< Time between two samples of the managed processes
+            /**
+             * @brief Check if a setting that only applies after a restart differs
+             */
+            bool isRestartNeeded(const Settings& other) const
+            {
+                return (port != other.port) || (metricsPort != other.metricsPort) || (receiveBufferSize != other.receiveBufferSize) ||
+                       (journalDurability != other.journalDurability);
+            }
+        };
+        /**
+         * @brief Constructor to set the file and the settings used for missing keys
+         * @param fileName Configuration file, a missing file keeps the defaults
+         * @param defaults Settings of the keys the file does not set
+         */
+        RuntimeConfig(const std::string& fileName, const Settings& defaults);
+        RuntimeConfig(const RuntimeConfig&) = delete;             ///< Delete copy constructor
+        RuntimeConfig& operator=(const RuntimeConfig&) = delete;  ///< Delete copy assignment operator
+        RuntimeConfig(RuntimeConfig&&) = delete;                  ///< Delete move constructor
+        RuntimeConfig& operator=(RuntimeConfig&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Read the file, keys it does not set get their defaults
+         * @return False if the file was rejected, the previous settings stay in force
+         */
+        bool load();
+        /**
+         * @brief Get the settings in force
+         */
+        const Settings& get() const { return m_settings; }
+        /**
+         * @brief Get the configuration file
+         */
+        const std::string& getFileName() const { return m_fileName; }
+        /**
+         * @brief Print configuration statistics.
+         */
+        void printStatistics() const;
+    private:
+        std::string m_fileName{};          ///< Configuration file
+        Settings m_defaults{};             ///< Settings of the keys the file does not set
+        Settings m_settings{};             ///< Settings in force
+        uint64_t m_loadCount{};            ///< Files accepted
+        uint64_t m_rejectedCount{};        ///< Files rejected
+        // Create Logger instance for configuration logging
+        Logger m_configLogger{Logger::Levels::ERROR, "ConfigLog.log", true};
+        /**
+         * @brief helper function to set one key of the settings
+         * @return An error description, empty if the key and value are valid
+         */
+        static std::string applySetting(Settings& settings, const std::string& key, const std::string& value);
+        /**
+         * @brief helper function to parse a log level name, case-insensitive
+         */
+        static bool parseLevel(const std::string& text, Logger::Levels& level);
+        /**
+         * @brief helper function to parse a journal durability mode name, case-insensitive
+         */
+        static bool parseDurability(const std::string& text, DurabilityMode& mode);
+        /**
+         * @brief helper function to parse a list of CPUs such as "0,2-3"
+         */
+        static bool parseCpuList(const std::string& text, std::vector<int>& cpus);
+        /**
+         * @brief helper function to parse a whole decimal number within a range
+         */
+        static bool parseNumber(const std::string& text, long long minimum, long long maximum, long long& number);
+};
+} // namespace App
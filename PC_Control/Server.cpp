@@ -9,10 +9,14 @@
  */
 
 #include <iostream>       ///< For input/output operations (std::cout, std::cerr)
-#include <algorithm>      ///< For std::transform
+#include <algorithm>      ///< For std::transform and std::max
 #include <cctype>         ///< For std::tolower
+#include <sys/un.h>       ///< For sockaddr_un
+#include <netinet/tcp.h>  ///< For the TCP keepalive options
 #include "Logger.hpp"
 #include "Server.hpp"
+#include "Metrics.hpp"
+#include "EventChannel.hpp"
 
 /**
  * @namespace App
@@ -22,13 +26,24 @@ namespace App
 {
 /**
  * @brief Constructor to initialize and set up the server
+ * @param loop The event loop driving the server sockets
  * @param port The port number on which the server will listen for incoming connections
+ * @param inheritedfileDescriptor Listening socket taken over from the previous process, -1 to bind a new one
+ * @param receiveBufferSize Bytes a single receive reads, bounds the length of a text command
  */
-Server::Server(int port)
+Server::Server(EventLoop& loop, int port, int inheritedfileDescriptor, size_t receiveBufferSize) : m_loop{loop}, m_receiveBuffer(receiveBufferSize)
 {
+    if(-1 != inheritedfileDescriptor)
+    {
+        // Connects queued in the backlog of the inherited socket while the previous process handed off
+        m_serverfileDescriptor = inheritedfileDescriptor;
+        std::cout << "=== STEP 1-3: TAKING OVER LISTENING SOCKET ===\n";
+        std::cout << "Server is listening to client on port: " << port << " with inherited file descriptor: " << m_serverfileDescriptor << '\n';
+        return;
+    }
     std::cout << "=== STEP 1: CREATING SOCKET ===\n";
-    // Create socket with IP:IPv4 and Protocol:TCP
-    m_serverfileDescriptor = socket(SERVER_SOCKET_DOMAIN, SERVER_SOCKET_TYPE, SERVER_SOCKET_PROTOCOL);
+    // Create non-blocking socket with IP:IPv4 and Protocol:TCP, the event loop waits for readiness
+    m_serverfileDescriptor = socket(SERVER_SOCKET_DOMAIN, SERVER_SOCKET_TYPE | SOCK_NONBLOCK | SOCK_CLOEXEC, SERVER_SOCKET_PROTOCOL);
     // Check if socket creation is successful
     if(-1 == m_serverfileDescriptor)
     {
@@ -38,6 +53,9 @@ Server::Server(int port)
     }
     std::cout << "Socket created successfully with file descriptor: " << m_serverfileDescriptor << '\n';
     std::cout << "=== STEP 2: BINDING SOCKET TO IP/PORT ===\n";
+    // Allow an immediate restart while connections of the previous run are in TIME_WAIT
+    int ReuseAddress = 1;
+    setsockopt(m_serverfileDescriptor, SOL_SOCKET, SO_REUSEADDR, &ReuseAddress, sizeof(ReuseAddress));
     // Bind socket to IP/Port
     m_serverStuctAddress.sin_family = SERVER_SOCKET_DOMAIN;          ///< IPv4
     m_serverStuctAddress.sin_addr.s_addr = INADDR_ANY;        ///< Accept connections from any IP address (IPv4 or IPv6)
@@ -55,7 +73,7 @@ Server::Server(int port)
     std::cout << "Socket bound to IP/Port successfully\n";
     std::cout << "=== STEP 3: LISTENING TO CLIENT ===\n";
     // Listen to client
-    int ListenToClientState = listen(m_serverfileDescriptor, BACKLOG);
+    int ListenToClientState = listen(m_serverfileDescriptor, m_listenBacklog);
     if(-1 == ListenToClientState)
     {
         // Log error
@@ -65,124 +83,896 @@ Server::Server(int port)
         exit(EXIT_FAILURE);
     }
     std::cout << "Server is listening to client on port: " << port << '\n';
-    std::cout << "Maximum pending connections: " << BACKLOG << "\n";
+    std::cout << "Maximum pending connections: " << m_listenBacklog << "\n";
 }
 /**
- * @brief Accepts a client connection
+ * @brief Additionally listen on a Unix domain socket for clients on the same host
+ * @param path Socket file, a stale socket left by a previous run is replaced
+ * @param socketType SOCK_SEQPACKET or SOCK_STREAM
+ * @param permissions Access to the socket file, connecting requires write permission
+ * @return False if the listener could not be set up, the TCP listener keeps working
  */
-void Server::acceptClientConnection()
+bool Server::listenOnUnixSocket(const std::string& path, int socketType, mode_t permissions)
 {
-    std::cout << "\n=== STEP 5: ACCEPTING CLIENT CONNECTION ===\n";
-    m_clientStuctAddressLength = sizeof(m_clientStuctAddress);
-    // Accept client connection
-    m_clientfileDescriptor = accept(m_serverfileDescriptor, (struct sockaddr*)&m_clientStuctAddress, &m_clientStuctAddressLength);
-    // check if accepting client connection is successful
-    if(-1 == m_clientfileDescriptor)
+    int UnixfileDescriptor = openUnixListener(path, socketType, permissions);
+    if(-1 == UnixfileDescriptor)
     {
-        // Log error
-        m_serverLogger.error("An error occurred while accepting client connection");
-        // Close the server socket before exiting
-        close(m_serverfileDescriptor);
-        exit(EXIT_FAILURE);
+        m_serverLogger.error("An error occurred while binding Unix socket: " + path);
+        return false;
+    }
+    m_unixfileDescriptor = UnixfileDescriptor;
+    m_unixSocketPath = path;
+    std::cout << "Server is listening to local clients on: " << path
+              << ((SOCK_SEQPACKET == socketType) ? " (seqpacket)" : " (stream)") << '\n';
+    return true;
+}
+/**
+ * @brief Create a non-blocking listening Unix domain socket whose file has the given permissions
+ * @param path Socket file, a stale socket left by a previous run is replaced
+ * @param socketType SOCK_SEQPACKET or SOCK_STREAM
+ * @param permissions Access to the socket file, connecting requires write permission
+ * @return The listening socket, -1 on error
+ */
+int Server::openUnixListener(const std::string& path, int socketType, mode_t permissions)
+{
+    sockaddr_un UnixAddress{};
+    UnixAddress.sun_family = AF_UNIX;
+    if(path.empty() || (path.size() >= sizeof(UnixAddress.sun_path)))
+    {
+        return -1;
+    }
+    std::memcpy(UnixAddress.sun_path, path.c_str(), path.size());
+    // Replace a socket left behind by a crashed run, but never any other file
+    struct stat PathStatus{};
+    if((0 == lstat(path.c_str(), &PathStatus)) && S_ISSOCK(PathStatus.st_mode))
+    {
+        unlink(path.c_str());
+    }
+    int UnixfileDescriptor = socket(AF_UNIX, socketType | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(-1 == UnixfileDescriptor)
+    {
+        return -1;
+    }
+    // Create the socket file with its final permissions so no client can slip in before a chmod
+    mode_t PreviousMask = umask(static_cast<mode_t>(~permissions & 0777));
+    int SockBindState = bind(UnixfileDescriptor, reinterpret_cast<sockaddr*>(&UnixAddress), sizeof(UnixAddress));
+    umask(PreviousMask);
+    if((-1 == SockBindState) || (-1 == listen(UnixfileDescriptor, BACKLOG)))
+    {
+        close(UnixfileDescriptor);
+        return -1;
+    }
+    return UnixfileDescriptor;
+}
+/**
+ * @brief Change the pending connection limit of every listener, takes effect immediately
+ */
+void Server::setListenBacklog(int backlog)
+{
+    m_listenBacklog = backlog;
+    // listen() on a listening socket only replaces its limit, the queued connects stay
+    for(int ListeningFileDescriptor : {m_serverfileDescriptor, m_unixfileDescriptor})
+    {
+        if((-1 != ListeningFileDescriptor) && (-1 == listen(ListeningFileDescriptor, backlog)))
+        {
+            m_serverLogger.error("An error occurred while changing the listen backlog");
+        }
+    }
+}
+/**
+ * @brief Set SO_RCVBUF and SO_SNDBUF on the listeners, connections accepted afterwards inherit them
+ * @param receiveBytes Kernel receive buffer, 0 keeps the current size
+ * @param sendBytes Kernel send buffer, 0 keeps the current size
+ */
+void Server::setSocketBufferSizes(int receiveBytes, int sendBytes)
+{
+    // Set on the listener so the receive buffer is known before the handshake and the window scale fits it
+    for(int ListeningFileDescriptor : {m_serverfileDescriptor, m_unixfileDescriptor})
+    {
+        if(-1 == ListeningFileDescriptor)
+        {
+            continue;
+        }
+        if((receiveBytes > 0) && (-1 == setsockopt(ListeningFileDescriptor, SOL_SOCKET, SO_RCVBUF, &receiveBytes, sizeof(receiveBytes))))
+        {
+            m_serverLogger.error("An error occurred while setting the socket receive buffer");
+        }
+        if((sendBytes > 0) && (-1 == setsockopt(ListeningFileDescriptor, SOL_SOCKET, SO_SNDBUF, &sendBytes, sizeof(sendBytes))))
+        {
+            m_serverLogger.error("An error occurred while setting the socket send buffer");
+        }
     }
-    std::cout << "Client connected successfully with file descriptor: " << m_clientfileDescriptor << '\n';
 }
 /**
- * @brief Save client requests to message queue
+ * @brief Accepts client connections on every listener and serves each one on its own coroutine until the loop stops
  */
-void Server::saveClientRequests()
+Task<void> Server::acceptClientConnections()
 {
-    std::cout << "\n=== STEP 6: HANDLING CLIENT COMMUNICATION ===\n";
-    char Buffer[SERVER_BUFFER_SIZE]{};
-    // Clear the buffer before receiving new data
-    memset(Buffer, 0, sizeof(Buffer));
-    ssize_t NumberOfReceivedBytes = recv(m_clientfileDescriptor, Buffer, sizeof(Buffer) - 1, SERVER_RECEIVE_FLAG);
-    // Check if receiving data is successful
-    if(-1 == NumberOfReceivedBytes)
+    std::cout << "\n=== STEP 5: ACCEPTING CLIENT CONNECTIONS ===\n";
+    // One coroutine drives the timeouts of every connection
+    m_loop.spawn(m_connectionTimers.run());
+    if(-1 != m_unixfileDescriptor)
     {
-        // // Log error
-        // m_serverLogger.error("An error occurred while receiving data from client");
-        // // Close the sockets before exiting
-        // close(m_clientfileDescriptor);
-        // close(m_serverfileDescriptor);
+        m_loop.spawn(acceptConnections(m_unixfileDescriptor));
     }
-    else if(0 == NumberOfReceivedBytes)
+    co_await acceptConnections(m_serverfileDescriptor);
+}
+/**
+ * @brief Accepts the connections of one listener until the loop stops
+ * @param listeningFileDescriptor TCP or Unix domain listening socket
+ */
+Task<void> Server::acceptConnections(int listeningFileDescriptor)
+{
+    while(!m_loop.isStopping())
     {
-        std::cout << "Client disconnected gracefully.\n";
-        // Close the client socket
-        close(m_clientfileDescriptor);
-        //break;
+        // Accept client connection, both listeners share the client handling
+        int ClientfileDescriptor = co_await m_loop.accept(listeningFileDescriptor);
+        // check if accepting client connection is successful
+        if(-1 == ClientfileDescriptor)
+        {
+            if(!m_loop.isStopping())
+            {
+                // Log error and back off, the server keeps serving the connected clients
+                m_serverLogger.error("An error occurred while accepting client connection");
+                co_await m_loop.sleepFor(std::chrono::milliseconds(SERVER_ACCEPT_RETRY_MS));
+            }
+            continue;
+        }
+        EVENT_INFO("Client connected successfully with file descriptor: " << ClientfileDescriptor);
+        if(m_loop.getBusyPoll().count() > 0)
+        {
+            // Let the kernel poll the device queue of the client as long as the loop spins, needs CAP_NET_ADMIN above net.core.busy_read
+            int BusyPollUs = static_cast<int>(m_loop.getBusyPoll().count());
+            setsockopt(ClientfileDescriptor, SOL_SOCKET, SO_BUSY_POLL, &BusyPollUs, sizeof(BusyPollUs));
+        }
+        if(listeningFileDescriptor == m_serverfileDescriptor)
+        {
+            enableKeepalive(ClientfileDescriptor);
+        }
+        m_clientfileDescriptors.insert(ClientfileDescriptor);
+        Metrics::increment(MetricCounter::CONNECTIONS_ACCEPTED);
+        m_loop.spawn(saveClientRequests(ClientfileDescriptor, allocateConnectionID()));
+    }
+}
+/**
+ * @brief Save the requests of a client to the message queue until it disconnects
+ * @param clientfileDescriptor Client file descriptor
+ * @param connectionID Identifier of the connection, unlike the descriptor never reused
+ * @param subscription Subscriber state of a connection taken over with its subscriptions, nullptr otherwise
+ */
+Task<void> Server::saveClientRequests(int clientfileDescriptor, uint32_t connectionID, std::shared_ptr<SubscriptionHub::Subscriber> subscription)
+{
+    EVENT_DEBUG("=== STEP 6: HANDLING CLIENT COMMUNICATION ===");
+    // An expired timeout shuts the socket down, the pending operation then fails and the connection unwinds
+    bool IsTimedOut = false;
+    TimerWheel::Timer ConnectionTimer;
+    ConnectionTimer.setCallback([clientfileDescriptor, &IsTimedOut]()
+    {
+        IsTimedOut = true;
+        shutdown(clientfileDescriptor, SHUT_RDWR);
+    });
+    m_connectionTimers.schedule(ConnectionTimer, std::chrono::milliseconds(SERVER_READ_TIMEOUT_MS));
+    std::shared_ptr<SubscriptionHub::Subscriber> Subscription = std::move(subscription);
+    bool IsHandedOff = false;
+    // Both protocols share the timeouts, journal wait and reply path below, they differ in how a receive becomes requests
+    bool IsBinary = false;
+    std::string PendingFrameBytes;
+    while(true)
+    {
+        ssize_t NumberOfReceivedBytes = co_await m_loop.receive(clientfileDescriptor, m_receiveBuffer.data(), m_receiveBuffer.size() - 1);
+        if(IsTimedOut)
+        {
+            break;
+        }
+        // Check if receiving data is successful
+        if(-1 == NumberOfReceivedBytes)
+        {
+            // Stopped between two requests, nothing of the next one was read and the successor continues the connection;
+            // binary connections reconnect instead, the command IDs of the successor may differ
+            IsHandedOff = m_isHandingOff && m_loop.isStopping() && !IsBinary;
+            if(!m_loop.isStopping())
+            {
+                // Log error
+                m_serverLogger.error("An error occurred while receiving data from client");
+            }
+            break;
+        }
+        else if(0 == NumberOfReceivedBytes)
+        {
+            EVENT_INFO("Client disconnected gracefully.");
+            break;
+        }
+        // Every receive is counted and captured, also the ones answered without a request
+        recordReceivedBytes(connectionID, IsBinary ? CaptureRecordType::BINARY : CaptureRecordType::TEXT,
+                            m_receiveBuffer.data(), static_cast<size_t>(NumberOfReceivedBytes));
+        std::string Reply;
+        uint64_t JournalSequence = 0;
+        bool IsExit = false;
+        if(IsBinary)
+        {
+            if(!handleBinaryFrames(connectionID, PendingFrameBytes, m_receiveBuffer.data(), static_cast<size_t>(NumberOfReceivedBytes),
+                                   Subscription, clientfileDescriptor, Reply, JournalSequence))
+            {
+                m_serverLogger.error("Malformed binary frame, closing connection");
+                break;
+            }
+        }
+        else
+        {
+            std::string NormalizedMessage = normalizeMessage(m_receiveBuffer.data(), static_cast<size_t>(NumberOfReceivedBytes));
+            if((nullptr != m_subscriptionHub) && handleSubscriptionCommand(Subscription, clientfileDescriptor, NormalizedMessage))
+            {
+                m_connectionTimers.schedule(ConnectionTimer, std::chrono::milliseconds(SERVER_IDLE_TIMEOUT_MS));
+                continue;
+            }
+            if((nullptr != m_processSampler) && m_processSampler->query(NormalizedMessage, Reply))
+            {
+                // Read-only, answered from the last sample without a handler, journal or system call
+                EVENT_DEBUG("Answered query: " << NormalizedMessage);
+            }
+            else if((nullptr != m_commandRegistry) && isReplyQueueIdle(connectionID, Subscription) && (BINARY_HANDSHAKE_COMMAND == NormalizedMessage))
+            {
+                // Replied with the command table, every later byte is framed
+                Reply = encodeCommandTable();
+                IsBinary = true;
+                EVENT_INFO("Connection " << connectionID << " switched to the binary protocol");
+            }
+            else
+            {
+                bool IsRejected = false;
+                std::string ReceivedMessageInLowerCase = submitMessage(connectionID, m_receiveBuffer.data(), static_cast<size_t>(NumberOfReceivedBytes),
+                                                                       JournalSequence, IsRejected);
+                if(!ReceivedMessageInLowerCase.empty())
+                {
+                    IsExit = ("exit" == ReceivedMessageInLowerCase) || ("quit" == ReceivedMessageInLowerCase);
+                    if(IsRejected)
+                    {
+                        Reply = SERVER_BUSY_REPLY;
+                    }
+                    else if(IsExit || (nullptr == m_subscriptionHub))
+                    {
+                        // Nobody waits for the result, the connection closes or has no queue to send it through
+                        Reply = SERVER_ACKNOWLEDGMENT;
+                    }
+                    else
+                    {
+                        expectResult(connectionID, Subscription, clientfileDescriptor);
+                    }
+                }
+            }
+        }
+        if(Reply.empty())
+        {
+            m_connectionTimers.schedule(ConnectionTimer, std::chrono::milliseconds(SERVER_IDLE_TIMEOUT_MS));
+            continue;
+        }
+        m_connectionTimers.schedule(ConnectionTimer, std::chrono::milliseconds(SERVER_WRITE_TIMEOUT_MS));
+        if(nullptr != m_journal)
+        {
+            // In group commit mode the client is acknowledged once the request is on stable storage
+            bool IsDurable = co_await m_journal->waitDurable(m_loop, JournalSequence);
+            if(!IsDurable)
+            {
+                break;
+            }
+        }
+        if(Subscription)
+        {
+            // Queued behind the publications already waiting, the subscriber writer sends both
+            m_subscriptionHub->send(Subscription, Reply);
+        }
+        else
+        {
+            // Send acknowledgment back to the client
+            bool IsSent = co_await m_loop.send(clientfileDescriptor, Reply.data(), Reply.length());
+            if(!IsSent)
+            {
+                if(!m_loop.isStopping() && !IsTimedOut)
+                {
+                    // Log error
+                    m_serverLogger.error("An error occurred while sending acknowledgment to client");
+                }
+                break;
+            }
+            Metrics::increment(MetricCounter::BYTES_SENT, Reply.length());
+        }
+        EVENT_DEBUG("Sent " << Reply.length() << " reply bytes to client");
+        if(IsExit)
+        {
+            EVENT_INFO("Exit command received. Closing connection.");
+            break;
+        }
+        m_connectionTimers.schedule(ConnectionTimer, std::chrono::milliseconds(SERVER_IDLE_TIMEOUT_MS));
+    }
+    if(IsTimedOut)
+    {
+        EVENT_WARNING("Closing connection " << connectionID << " after a timeout.");
+        Metrics::increment(MetricCounter::CONNECTIONS_TIMED_OUT);
+    }
+    uint32_t TopicMask = 0;
+    for(size_t TopicIndex = 0; Subscription && (TopicIndex < TOPIC_COUNT); TopicIndex++)
+    {
+        TopicMask |= Subscription->topics[TopicIndex] ? (UINT32_C(1) << TopicIndex) : 0;
+    }
+    // A subscriber writer still flushing owns the socket, it closes it when done
+    bool IsSocketOwner = !Subscription || m_subscriptionHub->close(Subscription);
+    if(IsHandedOff && IsSocketOwner)
+    {
+        // Stays open for the successor, this copy is closed with the server after the handoff
+        m_handoffConnections.push_back(RestartHandoff::Connection{clientfileDescriptor, connectionID, TopicMask});
+        co_return;
+    }
+    // Results of requests still running are dropped
+    m_replyRoutes.erase(connectionID);
+    // Close the client socket
+    m_clientfileDescriptors.erase(clientfileDescriptor);
+    if(IsSocketOwner)
+    {
+        m_loop.closeFileDescriptor(clientfileDescriptor);
+    }
+    Metrics::increment(MetricCounter::CONNECTIONS_CLOSED);
+}
+
+/**
+ * @brief Send the result of an executed request to the connection it arrived on, call from the loop thread
+ * @param request The executed request
+ * @param isExecuted True if a handler was found and executed
+ * @param result Result text of the handler, one line
+ */
+void Server::completeRequest(const Request& request, bool isExecuted, const std::string& result)
+{
+    auto RouteIterator = m_replyRoutes.find(request.connectionID);
+    // Closed connections, replayed journal records and other transports have nobody to tell
+    if(RouteIterator == m_replyRoutes.end())
+    {
+        return;
+    }
+    ReplyRoute& Route = RouteIterator->second;
+    if(Route.pendingCount > 0)
+    {
+        Route.pendingCount--;
+    }
+    std::string Reply;
+    if(0 != request.commandID)
+    {
+        // Binary clients match the response to their request by its ID and read the status from the flags
+        uint16_t Flags = static_cast<uint16_t>(BINARY_FLAG_RESPONSE | (isExecuted ? 0 : BINARY_FLAG_ERROR));
+        appendBinaryFrame(Reply, BinaryFrameHeader{request.commandID, Flags, request.clientRequestID, 0}, result.data(), result.size());
     }
     else
     {
-        // Null-terminate the received data to make it a valid C-string
-        Buffer[NumberOfReceivedBytes] = '\0';
-        std::string ReceivedMessage(Buffer);
-        // Create a lowercase version of the message for case-insensitive comparison
-        std::string ReceivedMessageInLowerCase = ReceivedMessage;  // Initialize with same size
-        // Convert the message to lowercase for case-insensitive comparison
-        std::transform(ReceivedMessage.begin(), ReceivedMessage.end(),
-                         ReceivedMessageInLowerCase.begin(),
-                         [](unsigned char Letter) { return std::tolower(Letter); });
-        // Save the lowercase version to the message queue for consistent comparison
-        m_messageQueue.push_back(ReceivedMessageInLowerCase);
-        std::cout << "Received message: " << ReceivedMessage << " (stored as: " << ReceivedMessageInLowerCase << ")\n";
-        std::string Acknowledgment = "Message received\n";
-        // Send acknowledgment back to the client
-        ssize_t NumberOfSentBytes = send(m_clientfileDescriptor, Acknowledgment.c_str(), Acknowledgment.length(), 0);
-        if(-1 == NumberOfSentBytes)
+        Reply = (result.empty() ? (isExecuted ? "ok" : "failed") : result) + '\n';
+    }
+    if(nullptr != m_journal)
+    {
+        m_loop.spawn(sendReplyWhenDurable(Route.writer, std::move(Reply), request.journalSequence));
+        return;
+    }
+    m_subscriptionHub->send(Route.writer, Reply);
+}
+
+/**
+ * @brief helper function to route the result of a queued request back to its connection
+ * @param connectionID Connection the request arrived on
+ * @param subscription Reply queue of the connection, created on the first request
+ * @param clientfileDescriptor Client file descriptor
+ */
+void Server::expectResult(uint32_t connectionID, std::shared_ptr<SubscriptionHub::Subscriber>& subscription, int clientfileDescriptor)
+{
+    if(!subscription)
+    {
+        // The result arrives after the handler ran, it shares the queue with every other reply to stay in order
+        subscription = m_subscriptionHub->createSubscriber(clientfileDescriptor);
+    }
+    ReplyRoute& Route = m_replyRoutes[connectionID];
+    Route.writer = subscription;
+    Route.pendingCount++;
+}
+
+/**
+ * @brief helper function to check that no publication or result can follow a protocol switch
+ */
+bool Server::isReplyQueueIdle(uint32_t connectionID, const std::shared_ptr<SubscriptionHub::Subscriber>& subscription) const
+{
+    if(!subscription)
+    {
+        return true;
+    }
+    auto RouteIterator = m_replyRoutes.find(connectionID);
+    return !subscription->isSubscribed() && ((RouteIterator == m_replyRoutes.end()) || (0 == RouteIterator->second.pendingCount));
+}
+
+/**
+ * @brief Send a result once its request is on stable storage
+ */
+Task<void> Server::sendReplyWhenDurable(std::shared_ptr<SubscriptionHub::Subscriber> writer, std::string reply, uint64_t journalSequence)
+{
+    // In group commit mode the client learns of a request only once a crash cannot lose it
+    bool IsDurable = co_await m_journal->waitDurable(m_loop, journalSequence);
+    if(IsDurable)
+    {
+        m_subscriptionHub->send(writer, reply);
+    }
+}
+
+/**
+ * @brief helper function to enable TCP keepalive so half-open connections are detected
+ */
+void Server::enableKeepalive(int clientfileDescriptor)
+{
+    int IsEnabled = 1;
+    int IdleSeconds = SERVER_KEEPALIVE_IDLE_S;
+    int IntervalSeconds = SERVER_KEEPALIVE_INTERVAL_S;
+    int ProbeCount = SERVER_KEEPALIVE_COUNT;
+    // Unacknowledged data gives up after as long as the write timeout, instead of the retransmission limit of minutes.
+    // TCP only, on every socket type the write timeouts of the connection and its subscriber writer apply as well
+    unsigned int UserTimeoutMs = SERVER_WRITE_TIMEOUT_MS;
+    setsockopt(clientfileDescriptor, SOL_SOCKET, SO_KEEPALIVE, &IsEnabled, sizeof(IsEnabled));
+    setsockopt(clientfileDescriptor, IPPROTO_TCP, TCP_KEEPIDLE, &IdleSeconds, sizeof(IdleSeconds));
+    setsockopt(clientfileDescriptor, IPPROTO_TCP, TCP_KEEPINTVL, &IntervalSeconds, sizeof(IntervalSeconds));
+    setsockopt(clientfileDescriptor, IPPROTO_TCP, TCP_KEEPCNT, &ProbeCount, sizeof(ProbeCount));
+    setsockopt(clientfileDescriptor, IPPROTO_TCP, TCP_USER_TIMEOUT, &UserTimeoutMs, sizeof(UserTimeoutMs));
+}
+
+/**
+ * @brief Count and capture received bytes before they are interpreted, safe to call from any thread
+ * @param connectionID Connection the bytes arrived on
+ * @param type How the connection interprets the bytes
+ * @param data The raw received bytes
+ * @param length Number of received bytes
+ */
+void Server::recordReceivedBytes(uint32_t connectionID, CaptureRecordType type, const char* data, size_t length)
+{
+    Metrics::increment(MetricCounter::BYTES_RECEIVED, static_cast<uint64_t>(length));
+    if(nullptr != m_capture)
+    {
+        m_capture->record(connectionID, type, data, length);
+    }
+}
+
+/**
+ * @brief Normalize a received message and queue it as a request, safe to call from any thread
+ * @param connectionID Connection the message arrived on
+ * @param data The raw received bytes
+ * @param length Number of received bytes
+ * @param journalSequence Set to the journal record to await before acknowledging, 0 without journal
+ * @param isRejected Set if the request was not queued and the client must be answered busy
+ * @return The lowercase command, empty if the message was blank and nothing was queued
+ */
+std::string Server::submitMessage(uint32_t connectionID, const char* data, size_t length, uint64_t& journalSequence, bool& isRejected)
+{
+    Request ReceivedRequest{};
+    ReceivedRequest.stamp(RequestStage::RECEIVE);
+    journalSequence = 0;
+    isRejected = false;
+    std::string ReceivedMessageInLowerCase = normalizeMessage(data, length);
+    if(ReceivedMessageInLowerCase.empty())
+    {
+        return ReceivedMessageInLowerCase;
+    }
+    // Save the lowercase version to the message queue for consistent comparison
+    ReceivedRequest.command = ReceivedMessageInLowerCase;
+    ReceivedRequest.connectionID = connectionID;
+    isRejected = !queueRequest(ReceivedRequest, journalSequence);
+    return ReceivedMessageInLowerCase;
+}
+
+/**
+ * @brief helper function to number, journal and queue a received request
+ * @param journalSequence Set to the journal record to await before acknowledging, 0 without journal
+ * @return False if the request was rejected, the message queue or the journal is full
+ */
+bool Server::queueRequest(Request& request, uint64_t& journalSequence)
+{
+    journalSequence = 0;
+    // Shed load at the door, a request that would wait behind the limit is answered before it costs a journal record
+    if(m_messageQueue.size() >= m_messageQueueLimit.load(std::memory_order_relaxed))
+    {
+        EVENT_WARNING("Rejected message, the message queue is full: " << request.command);
+        Metrics::increment(MetricCounter::REQUESTS_REJECTED);
+        return false;
+    }
+    request.id = m_nextRequestID.fetch_add(1, std::memory_order_relaxed);
+    // Journal the request before it can run so a crash cannot lose it
+    if((nullptr != m_journal) && !m_journal->append(request, journalSequence))
+    {
+        EVENT_WARNING("Rejected message: " << request.command);
+        Metrics::increment(MetricCounter::REQUESTS_REJECTED);
+        return false;
+    }
+    request.journalSequence = journalSequence;
+    request.stamp(RequestStage::ENQUEUE);
+    EVENT_DEBUG("Received message: " << request.command);
+    m_messageQueue.push(std::move(request));
+    return true;
+}
+
+/**
+ * @brief helper function to queue binary requests, frames may span receives
+ * @param connectionID Connection the frames arrived on
+ * @param pendingBytes Partial frame of the connection left from the previous receive
+ * @param data The received bytes
+ * @param length Number of received bytes
+ * @param subscription Reply queue of the connection the results are sent through, created on the first request
+ * @param clientfileDescriptor Client file descriptor
+ * @param responses Filled with the frames answered right away, handshakes and unknown command IDs
+ * @param journalSequence Set to the last journal record to await before responding
+ * @return False if a frame is malformed and the connection must close
+ */
+bool Server::handleBinaryFrames(uint32_t connectionID, std::string& pendingBytes, const char* data, size_t length,
+                                std::shared_ptr<SubscriptionHub::Subscriber>& subscription, int clientfileDescriptor,
+                                std::string& responses, uint64_t& journalSequence)
+{
+    // Without a partial frame left over the frames are parsed straight from the receive buffer
+    if(!pendingBytes.empty())
+    {
+        pendingBytes.append(data, length);
+        data = pendingBytes.data();
+        length = pendingBytes.size();
+    }
+    size_t Offset = 0;
+    while((length - Offset) >= BINARY_HEADER_SIZE)
+    {
+        BinaryFrameHeader Header = decodeBinaryHeader(data + Offset);
+        if((Header.payloadLength > BINARY_MAX_PAYLOAD) || ((0 != Header.flags) && (BINARY_FLAG_HANDSHAKE != Header.flags)))
+        {
+            return false;
+        }
+        if((length - Offset - BINARY_HEADER_SIZE) < Header.payloadLength)
+        {
+            break;
+        }
+        // The payload is reserved for command arguments, the registered commands take none
+        Offset += BINARY_HEADER_SIZE + Header.payloadLength;
+        if(BINARY_FLAG_HANDSHAKE == Header.flags)
         {
-            // Log error
-            m_serverLogger.error("An error occurred while sending acknowledgment to client");
-            // Close the sockets before exiting
-            close(m_clientfileDescriptor);
-            close(m_serverfileDescriptor);
-                //break;
+            // A client may fetch the table again, e.g. after a plugin reload added commands
+            responses += encodeCommandTable();
+            continue;
         }
-        std::cout << "Sent acknowledgment to client: " << Acknowledgment << '\n';
-        if(("exit" == ReceivedMessage) || ("quit" == ReceivedMessage))
+        BinaryFrameHeader Response{Header.commandID, BINARY_FLAG_RESPONSE, Header.requestID, 0};
+        Request ReceivedRequest{};
+        ReceivedRequest.stamp(RequestStage::RECEIVE);
+        // No trimming, lowercasing or hashing, the ID indexes the registry
+        ReceivedRequest.command = m_commandRegistry->getCommandName(Header.commandID);
+        if(ReceivedRequest.command.empty())
         {
-            std::cout << "Exit command received. Closing connection.\n";
-            // Close the client socket
-            close(m_clientfileDescriptor);
-            //break;
+            EVENT_WARNING("Unknown command ID " << Header.commandID << " on connection " << connectionID);
+            Response.flags |= BINARY_FLAG_ERROR;
+            appendBinaryFrame(responses, Response);
+            continue;
         }
+        ReceivedRequest.commandID = Header.commandID;
+        ReceivedRequest.connectionID = connectionID;
+        ReceivedRequest.clientRequestID = Header.requestID;
+        uint64_t JournalSequence = 0;
+        if(!queueRequest(ReceivedRequest, JournalSequence))
+        {
+            // Answered right away, the client may retry later
+            Response.flags |= BINARY_FLAG_ERROR;
+            appendBinaryFrame(responses, Response);
+            continue;
+        }
+        journalSequence = std::max(journalSequence, JournalSequence);
+        if(nullptr == m_subscriptionHub)
+        {
+            // Without a reply queue the frame only acknowledges the request
+            appendBinaryFrame(responses, Response);
+            continue;
+        }
+        // Answered with the handler result once it ran, possibly before requests sent earlier
+        expectResult(connectionID, subscription, clientfileDescriptor);
+    }
+    // Keep the partial frame for the next receive
+    if(data != pendingBytes.data())
+    {
+        pendingBytes.assign(data + Offset, length - Offset);
+    }
+    else
+    {
+        pendingBytes.erase(0, Offset);
+    }
+    return true;
+}
+
+/**
+ * @brief helper function to encode the command table sent in the binary handshake
+ */
+std::string Server::encodeCommandTable() const
+{
+    std::string CommandTable;
+    for(const auto& [CommandID, Command] : m_commandRegistry->getCommandIDs())
+    {
+        CommandTable += std::to_string(CommandID) + ' ' + Command + '\n';
+    }
+    std::string Reply;
+    appendBinaryFrame(Reply, BinaryFrameHeader{0, BINARY_FLAG_RESPONSE | BINARY_FLAG_HANDSHAKE, 0, 0}, CommandTable.data(), CommandTable.size());
+    return Reply;
+}
+
+/**
+ * @brief Trim a received message and convert it to lowercase so identical commands compare equal
+ */
+std::string Server::normalizeMessage(const char* data, size_t length)
+{
+    // Stop at an embedded terminator like the C-string the message used to be
+    std::string ReceivedMessage(data, strnlen(data, length));
+    // Remove any whitespace or newlines so identical commands compare equal
+    ReceivedMessage.erase(0, ReceivedMessage.find_first_not_of(" \n\r\t"));  // left trim
+    ReceivedMessage.erase(ReceivedMessage.find_last_not_of(" \n\r\t") + 1);  // right trim
+    // Convert the message to lowercase for case-insensitive comparison
+    std::transform(ReceivedMessage.begin(), ReceivedMessage.end(), ReceivedMessage.begin(),
+                   [](unsigned char Letter) { return std::tolower(Letter); });
+    return ReceivedMessage;
+}
+
+/**
+ * @brief helper function to run a subscription command of a connection
+ * @param subscription Subscriber state of the connection, created on the first subscription
+ * @param clientfileDescriptor Client file descriptor
+ * @param command Trimmed lowercase message
+ * @return False if the message is no subscription command
+ */
+bool Server::handleSubscriptionCommand(std::shared_ptr<SubscriptionHub::Subscriber>& subscription, int clientfileDescriptor,
+                                       const std::string& command)
+{
+    bool IsSubscribe = false;
+    std::string TopicName;
+    if(!SubscriptionHub::parseCommand(command, IsSubscribe, TopicName))
+    {
+        return false;
     }
+    if(!subscription)
+    {
+        // From now on every reply goes through the subscriber queue to stay in order with the publications
+        subscription = m_subscriptionHub->createSubscriber(clientfileDescriptor);
+    }
+    Topic RequestedTopic{};
+    if(!SubscriptionHub::parseTopic(TopicName, RequestedTopic))
+    {
+        m_subscriptionHub->send(subscription, "Unknown topic: " + TopicName + "\n");
+    }
+    else if(IsSubscribe)
+    {
+        m_subscriptionHub->subscribe(subscription, RequestedTopic);
+        m_subscriptionHub->send(subscription, "Subscribed to " + TopicName + "\n");
+    }
+    else
+    {
+        m_subscriptionHub->unsubscribe(subscription, RequestedTopic);
+        m_subscriptionHub->send(subscription, "Unsubscribed from " + TopicName + "\n");
+    }
+    EVENT_INFO("Subscription command on file descriptor " << clientfileDescriptor << ": " << command);
+    return true;
 }
 
-std::string Server::getNextRequest()
+/**
+ * @brief Get an identifier for a new connection of any transport, safe to call from any thread
+ */
+uint32_t Server::allocateConnectionID()
+{
+    return m_nextConnectionID.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Waits for and removes the next request from the queue
+ * @return The next request, or a request with an empty command if the loop is stopping
+ */
+Task<Request> Server::getNextRequest()
 {
-    if (m_messageQueue.empty())
+    std::optional<Request> NextRequest = co_await m_messageQueue.pop(m_loop);
+    co_return NextRequest.value_or(Request{});
+}
+
+/**
+ * @brief Removes the next request from the queue without waiting
+ * @param request Filled with the next request
+ * @return False if the queue is empty
+ */
+bool Server::tryGetNextRequest(Request& request)
+{
+    std::optional<Request> NextRequest = m_messageQueue.tryPop();
+    if(!NextRequest)
     {
-        return "";
+        return false;
     }
-    std::string request = m_messageQueue.front();
-    m_messageQueue.pop_front();
-    return request;
+    request = std::move(*NextRequest);
+    return true;
+}
+
+/**
+ * @brief Journal every accepted request and queue the requests recovered from the journal
+ * @param journal The journal, must outlive the server
+ */
+void Server::attachJournal(RequestJournal& journal)
+{
+    m_journal = &journal;
+    m_nextRequestID.store(std::max(m_nextRequestID.load(), journal.getLargestRequestID() + 1));
+    for(auto& RecoveredRequest : journal.getPendingRequests())
+    {
+        EVENT_INFO("Replaying journaled request: " << RecoveredRequest.command);
+        RecoveredRequest.stamp(RequestStage::RECEIVE);
+        RecoveredRequest.stamp(RequestStage::ENQUEUE);
+        m_messageQueue.push(std::move(RecoveredRequest));
+    }
+}
+
+/**
+ * @brief Record every received message into a capture file
+ * @param capture The capture, must outlive the server
+ */
+void Server::attachCapture(RequestCapture& capture)
+{
+    m_capture = &capture;
+}
+
+/**
+ * @brief Let clients subscribe to topics with "subscribe <topic>" and "unsubscribe <topic>"
+ * @param hub The hub, must outlive the server
+ */
+void Server::attachSubscriptionHub(SubscriptionHub& hub)
+{
+    m_subscriptionHub = &hub;
+}
+
+/**
+ * @brief Keep the idle connections open once the loop stops so a successor can continue them
+ */
+void Server::beginHandoff()
+{
+    m_isHandingOff = true;
+}
+
+/**
+ * @brief Collect what the successor continues with, call after the loop stopped
+ * @return Listening sockets, idle connections and queued requests, the descriptors stay open until destruction
+ */
+RestartHandoff::State Server::releaseForHandoff()
+{
+    RestartHandoff::State HandoffState{};
+    HandoffState.listeningFileDescriptor = m_serverfileDescriptor;
+    HandoffState.unixfileDescriptor = m_unixfileDescriptor;
+    HandoffState.unixSocketPath = m_unixSocketPath;
+    HandoffState.connections = m_handoffConnections;
+    Request PendingRequest;
+    while(tryGetNextRequest(PendingRequest))
+    {
+        HandoffState.requests.push_back(std::move(PendingRequest));
+    }
+    HandoffState.nextRequestID = m_nextRequestID.load();
+    HandoffState.nextConnectionID = m_nextConnectionID.load();
+    return HandoffState;
+}
+
+/**
+ * @brief Continue the connections and requests handed off by the previous process, call after attaching journal and hub
+ * @param state The taken over state, the server owns its descriptors afterwards
+ */
+void Server::adoptHandoff(RestartHandoff::State& state)
+{
+    if(-1 != state.unixfileDescriptor)
+    {
+        // Bound by the previous process, the socket file stays in place
+        m_unixfileDescriptor = state.unixfileDescriptor;
+        m_unixSocketPath = state.unixSocketPath;
+        std::cout << "Server is listening to local clients on inherited socket: " << m_unixSocketPath << '\n';
+    }
+    // Identifiers continue where the previous process stopped
+    m_nextRequestID.store(std::max(m_nextRequestID.load(), state.nextRequestID));
+    m_nextConnectionID.store(std::max(m_nextConnectionID.load(), state.nextConnectionID));
+    std::vector<Request> PendingRequests;
+    if(nullptr != m_journal)
+    {
+        // The journal replay queued the requests already, the handed off ones only tell which connection waits for them
+        std::unordered_map<uint64_t, uint32_t> ConnectionIDs;
+        for(const auto& PendingRequest : state.requests)
+        {
+            ConnectionIDs[PendingRequest.id] = PendingRequest.connectionID;
+        }
+        Request RecoveredRequest;
+        while(tryGetNextRequest(RecoveredRequest))
+        {
+            auto ConnectionIterator = ConnectionIDs.find(RecoveredRequest.id);
+            RecoveredRequest.connectionID = (ConnectionIterator != ConnectionIDs.end()) ? ConnectionIterator->second : 0;
+            PendingRequests.push_back(std::move(RecoveredRequest));
+        }
+    }
+    else
+    {
+        for(auto& PendingRequest : state.requests)
+        {
+            EVENT_INFO("Continuing handed off request: " << PendingRequest.command);
+            PendingRequest.stamp(RequestStage::RECEIVE);
+            PendingRequest.stamp(RequestStage::ENQUEUE);
+            PendingRequests.push_back(std::move(PendingRequest));
+        }
+    }
+    // Every request of a continued connection is answered on it once the handler ran
+    std::unordered_map<uint32_t, uint32_t> PendingResultCounts;
+    for(auto& PendingRequest : PendingRequests)
+    {
+        PendingResultCounts[PendingRequest.connectionID]++;
+        m_messageQueue.push(std::move(PendingRequest));
+    }
+    for(const auto& PassedConnection : state.connections)
+    {
+        std::shared_ptr<SubscriptionHub::Subscriber> Subscription;
+        if((0 != PassedConnection.topicMask) && (nullptr != m_subscriptionHub))
+        {
+            Subscription = m_subscriptionHub->createSubscriber(PassedConnection.fileDescriptor);
+            for(size_t TopicIndex = 0; TopicIndex < TOPIC_COUNT; TopicIndex++)
+            {
+                if(0 != (PassedConnection.topicMask & (UINT32_C(1) << TopicIndex)))
+                {
+                    m_subscriptionHub->subscribe(Subscription, static_cast<Topic>(TopicIndex));
+                }
+            }
+        }
+        auto CountIterator = PendingResultCounts.find(PassedConnection.connectionID);
+        for(uint32_t Count = (CountIterator != PendingResultCounts.end()) ? CountIterator->second : 0; (Count > 0) && (nullptr != m_subscriptionHub); Count--)
+        {
+            expectResult(PassedConnection.connectionID, Subscription, PassedConnection.fileDescriptor);
+        }
+        m_clientfileDescriptors.insert(PassedConnection.fileDescriptor);
+        Metrics::increment(MetricCounter::CONNECTIONS_ACCEPTED);
+        m_loop.spawn(saveClientRequests(PassedConnection.fileDescriptor, PassedConnection.connectionID, std::move(Subscription)));
+    }
+    state = RestartHandoff::State{};
+}
+
+/**
+ * @brief Let clients switch to binary frames with "protocol binary", command IDs come from the registry
+ * @param registry The registry, must outlive the server
+ */
+void Server::attachCommandRegistry(PCControl& registry)
+{
+    m_commandRegistry = &registry;
+}
+
+/**
+ * @brief Answer "status", "ps" and "stats <pid>" from the sampled values instead of queuing them
+ * @param sampler The sampler, must outlive the server
+ */
+void Server::attachProcessSampler(ProcessSampler& sampler)
+{
+    m_processSampler = &sampler;
 }
 
 /**
  * @brief Returns the message queue
  * @return The message queue
  */
-const std::deque<std::string>& Server::getMessageQueue() const
+AsyncQueue<Request>& Server::getMessageQueue()
 {
     return m_messageQueue;
 }
 
+/**
+ * @brief Destroy the Server object
+ */
 Server::~Server()
 {
     std::cout << "\n=== STEP 7: CLOSING SOCKETS ===\n";
-    // Close the client socket if it's open
-    if(m_clientfileDescriptor != -1)
+    // Close the client sockets that are still open
+    for(int ClientfileDescriptor : m_clientfileDescriptors)
     {
-        close(m_clientfileDescriptor);
+        m_loop.closeFileDescriptor(ClientfileDescriptor);
         std::cout << "Client socket closed successfully\n";
     }
+    // Close the Unix domain socket and remove its file, unless the successor listens on it
+    if(m_unixfileDescriptor != -1)
+    {
+        m_loop.closeFileDescriptor(m_unixfileDescriptor);
+        if(!m_isHandingOff)
+        {
+            unlink(m_unixSocketPath.c_str());
+        }
+        std::cout << "Unix socket closed successfully\n";
+    }
     // Close the server socket
     if(m_serverfileDescriptor != -1)
     {
-        close(m_serverfileDescriptor);
+        m_loop.closeFileDescriptor(m_serverfileDescriptor);
         std::cout << "Server socket closed successfully\n";
     }
     std::cout << "Server shutdown complete.\n";
@@ -11,21 +11,49 @@
 
 #pragma once
 
-#include <deque>             ///< For std::deque container
+#include <atomic>            ///< For std::atomic
 #include <string>            ///< For std::string class operations
+#include <unordered_map>     ///< For std::unordered_map
+#include <unordered_set>     ///< For std::unordered_set
+#include <vector>            ///< For std::vector
 #include <cstring>           ///< C string manipulation functions (memset, strlen)
 #include <sys/socket.h>      ///< Core socket programming functions (socket, bind, listen, accept)
 #include <netinet/in.h>      ///< Internet address family structures (sockaddr_in, INADDR_ANY)
+#include <sys/stat.h>        ///< For mode_t and the permission bits of the Unix socket file
 #include <unistd.h>          ///< POSIX operating system API (close function, read/write)
 #include "Logger.hpp"        ///< Custom logger class for logging messages
+#include "EventLoop.hpp"     ///< Coroutine event loop driving the sockets
+#include "AsyncQueue.hpp"    ///< Awaitable queue handing requests to the app
+#include "Task.hpp"          ///< Coroutine task type
+#include "Request.hpp"       ///< Client request with stage timestamps
+#include "RequestJournal.hpp"  ///< Write-ahead journal of accepted requests
+#include "RequestCapture.hpp"  ///< Capture of the received traffic
+#include "TimerWheel.hpp"    ///< Timeouts of the client connections
+#include "SubscriptionHub.hpp"  ///< Topic subscriptions of the client connections
+#include "RestartHandoff.hpp"   ///< Handoff of the sockets to a restarted server
+#include "BinaryProtocol.hpp"   ///< Binary framing negotiated by a connection
+#include "PCControl.hpp"        ///< Command registry assigning the binary command IDs
+#include "ProcessSampler.hpp"   ///< Sampled status of the managed processes
 
 // Configurable parameters
 constexpr int SERVER_SOCKET_DOMAIN{AF_INET};    ///< Socket domain: IPv4
 constexpr int SERVER_SOCKET_TYPE{SOCK_STREAM};  /// Socket type: TCP
 constexpr int SERVER_SOCKET_PROTOCOL{0};        /// Socket protocol: TCP
-constexpr int BACKLOG{5};                       ///< Maximum number of pending connections
+constexpr int BACKLOG{SOMAXCONN};               ///< Maximum number of pending connections, bursts of thousands of connects
 constexpr int SERVER_BUFFER_SIZE{1024};         ///< Size of the buffer for receiving data
-constexpr int SERVER_RECEIVE_FLAG{0};           ///< Standard blocking receive
+constexpr int SERVER_ACCEPT_RETRY_MS{100};      ///< Back-off after a failed accept, e.g. out of descriptors
+constexpr size_t SERVER_MESSAGE_QUEUE_LIMIT{65536};  ///< Requests waiting for a handler before new ones are answered busy
+constexpr int UNIX_SOCKET_TYPE{SOCK_SEQPACKET}; ///< Unix socket type: SOCK_SEQPACKET keeps message boundaries, or SOCK_STREAM
+constexpr mode_t UNIX_SOCKET_PERMISSIONS{0660}; ///< Only the owner and group of the socket file may connect
+constexpr char SERVER_ACKNOWLEDGMENT[]{"Message received\n"};  ///< Sent for a queued request whose result nobody waits for, e.g. exit
+constexpr char SERVER_BUSY_REPLY[]{"busy\n"};  ///< Sent instead of the result when a request could not be queued
+constexpr int SERVER_READ_TIMEOUT_MS{10000};    ///< Time a new connection has to send its first request
+constexpr int SERVER_IDLE_TIMEOUT_MS{300000};   ///< Time a connection may stay silent between requests, subscribers included
+constexpr int SERVER_WRITE_TIMEOUT_MS{10000};   ///< Time an acknowledgment may wait for a client that does not read
+constexpr int SERVER_TIMER_TICK_MS{100};        ///< Resolution of the connection timeouts
+constexpr int SERVER_KEEPALIVE_IDLE_S{60};      ///< Silence before TCP keepalive probes start
+constexpr int SERVER_KEEPALIVE_INTERVAL_S{10};  ///< Time between TCP keepalive probes
+constexpr int SERVER_KEEPALIVE_COUNT{3};        ///< Unanswered probes after which a half-open connection is dropped
 
 
 /**
@@ -44,9 +72,12 @@ class Server
     public:
         /** 
          * @brief Constructor to initialize and set up the server
+         * @param loop The event loop driving the server sockets
          * @param port The port number on which the server will listen for incoming connections
+         * @param inheritedfileDescriptor Listening socket taken over from the previous process, -1 to bind a new one
+         * @param receiveBufferSize Bytes a single receive reads, bounds the length of a text command
          */
-        Server(int port);
+        Server(EventLoop& loop, int port, int inheritedfileDescriptor = -1, size_t receiveBufferSize = SERVER_BUFFER_SIZE);
         Server(const Server&) = delete;             ///< Delete copy constructor
         Server& operator=(const Server&) = delete;  ///< Delete copy assignment operator
         Server( Server&&) = delete;                 ///< Delete move constructor
@@ -56,31 +87,232 @@ class Server
          */
         ~Server();
         /**
-         * @brief Accepts a client connection
+         * @brief Additionally listen on a Unix domain socket for clients on the same host
+         * @param path Socket file, a stale socket left by a previous run is replaced
+         * @param socketType SOCK_SEQPACKET or SOCK_STREAM
+         * @param permissions Access to the socket file, connecting requires write permission
+         * @return False if the listener could not be set up, the TCP listener keeps working
          */
-        void acceptClientConnection();
+        bool listenOnUnixSocket(const std::string& path, int socketType = UNIX_SOCKET_TYPE, mode_t permissions = UNIX_SOCKET_PERMISSIONS);
         /**
-         * @brief Save client requests to message queue
+         * @brief Create a non-blocking listening Unix domain socket whose file has the given permissions
+         * @param path Socket file, a stale socket left by a previous run is replaced
+         * @param socketType SOCK_SEQPACKET or SOCK_STREAM
+         * @param permissions Access to the socket file, connecting requires write permission
+         * @return The listening socket, -1 on error
          */
-        void saveClientRequests();
+        static int openUnixListener(const std::string& path, int socketType, mode_t permissions);
+        /**
+         * @brief Change the pending connection limit of every listener, takes effect immediately
+         */
+        void setListenBacklog(int backlog);
+        /**
+         * @brief Set SO_RCVBUF and SO_SNDBUF on the listeners, connections accepted afterwards inherit them
+         * @param receiveBytes Kernel receive buffer, 0 keeps the current size
+         * @param sendBytes Kernel send buffer, 0 keeps the current size
+         */
+        void setSocketBufferSizes(int receiveBytes, int sendBytes);
+        /**
+         * @brief Set the requests waiting in the message queue before new ones are answered busy, takes effect immediately
+         */
+        void setMessageQueueLimit(size_t limit) { m_messageQueueLimit.store(limit, std::memory_order_relaxed); }
+        /**
+         * @brief Set the level of the server log
+         */
+        void setLogLevel(Logger::Levels level) { m_serverLogger.setLogLevel(level); }
+        /**
+         * @brief Accepts client connections on every listener and serves each one on its own coroutine until the loop stops
+         */
+        Task<void> acceptClientConnections();
         /**
          * @brief Returns the message queue
          * @return The message queue
          */
-        const std::deque<std::string>& getMessageQueue() const;
+        AsyncQueue<Request>& getMessageQueue();
+        /**
+         * @brief Waits for and removes the next request from the queue
+         * @return The next request, or a request with an empty command if the loop is stopping
+         */
+        Task<Request> getNextRequest();
+        /**
+         * @brief Removes the next request from the queue without waiting
+         * @param request Filled with the next request
+         * @return False if the queue is empty
+         */
+        bool tryGetNextRequest(Request& request);
+        /**
+         * @brief Count and capture received bytes before they are interpreted, safe to call from any thread
+         * @param connectionID Connection the bytes arrived on
+         * @param type How the connection interprets the bytes
+         * @param data The raw received bytes
+         * @param length Number of received bytes
+         */
+        void recordReceivedBytes(uint32_t connectionID, CaptureRecordType type, const char* data, size_t length);
+        /**
+         * @brief Normalize a received message and queue it as a request, safe to call from any thread
+         * @param connectionID Connection the message arrived on
+         * @param data The raw received bytes
+         * @param length Number of received bytes
+         * @param journalSequence Set to the journal record to await before acknowledging, 0 without journal
+         * @param isRejected Set if the request was not queued and the client must be answered busy
+         * @return The lowercase command, empty if the message was blank and nothing was queued
+         */
+        std::string submitMessage(uint32_t connectionID, const char* data, size_t length, uint64_t& journalSequence, bool& isRejected);
+        /**
+         * @brief Send the result of an executed request to the connection it arrived on, call from the loop thread
+         * @param request The executed request
+         * @param isExecuted True if a handler was found and executed
+         * @param result Result text of the handler, one line
+         */
+        void completeRequest(const Request& request, bool isExecuted, const std::string& result);
+        /**
+         * @brief Get an identifier for a new connection of any transport, safe to call from any thread
+         */
+        uint32_t allocateConnectionID();
+        /**
+         * @brief Get the journal of accepted requests, nullptr if none is attached
+         */
+        RequestJournal* getJournal() const { return m_journal; }
+        /**
+         * @brief Journal every accepted request and queue the requests recovered from the journal
+         * @param journal The journal, must outlive the server
+         */
+        void attachJournal(RequestJournal& journal);
+        /**
+         * @brief Let clients subscribe to topics with "subscribe <topic>" and "unsubscribe <topic>"
+         * @param hub The hub, must outlive the server
+         */
+        void attachSubscriptionHub(SubscriptionHub& hub);
+        /**
+         * @brief Let clients switch to binary frames with "protocol binary", command IDs come from the registry
+         * @param registry The registry, must outlive the server
+         */
+        void attachCommandRegistry(PCControl& registry);
+        /**
+         * @brief Answer "status", "ps" and "stats <pid>" from the sampled values instead of queuing them
+         * @param sampler The sampler, must outlive the server
+         */
+        void attachProcessSampler(ProcessSampler& sampler);
+        /**
+         * @brief Trim a received message and convert it to lowercase so identical commands compare equal
+         */
+        static std::string normalizeMessage(const char* data, size_t length);
+        /**
+         * @brief Record every received message into a capture file
+         * @param capture The capture, must outlive the server
+         */
+        void attachCapture(RequestCapture& capture);
+        /**
+         * @brief Keep the idle connections open once the loop stops so a successor can continue them
+         */
+        void beginHandoff();
+        /**
+         * @brief Collect what the successor continues with, call after the loop stopped
+         * @return Listening sockets, idle connections and queued requests, the descriptors stay open until destruction
+         */
+        RestartHandoff::State releaseForHandoff();
         /**
-         * @brief Gets and removes the next request from the queue
-         * @return The next request, or empty string if queue is empty
+         * @brief Continue the connections and requests handed off by the previous process, call after attaching journal and hub
+         * @param state The taken over state, the server owns its descriptors afterwards
          */
-        std::string getNextRequest();   
+        void adoptHandoff(RestartHandoff::State& state);
     private:
-        int m_serverfileDescriptor{};                 ///< Server file descriptor
-        int m_clientfileDescriptor{};                 ///< Client file descriptor
+        EventLoop& m_loop;                            ///< Event loop driving the sockets
+        int m_serverfileDescriptor{-1};               ///< Server file descriptor
+        std::unordered_set<int> m_clientfileDescriptors{};  ///< Connected client file descriptors
         struct sockaddr_in m_serverStuctAddress{};    ///< Server address structure
-        struct sockaddr_in m_clientStuctAddress{};    ///< Client address structure
-        socklen_t m_clientStuctAddressLength{};       ///< Length of client address structure
-        std::deque<std::string> m_messageQueue{};     ///< Queue to store messages
+        int m_unixfileDescriptor{-1};                 ///< Unix domain socket file descriptor, -1 if not listening
+        std::string m_unixSocketPath{};               ///< Unix domain socket file, removed on shutdown
+        AsyncQueue<Request> m_messageQueue{};         ///< Queue to store messages
+        std::atomic<size_t> m_messageQueueLimit{SERVER_MESSAGE_QUEUE_LIMIT};  ///< Requests waiting before new ones are answered busy
+        TimerWheel m_connectionTimers{m_loop, std::chrono::milliseconds(SERVER_TIMER_TICK_MS)};  ///< Timeouts of every connection
+        std::vector<char> m_receiveBuffer{};          ///< Shared by the connections, a message is consumed before its coroutine suspends again
+        int m_listenBacklog{BACKLOG};                 ///< Pending connection limit of the listeners
+        std::atomic<uint64_t> m_nextRequestID{1};     ///< Identifier of the next received request
+        RequestJournal* m_journal{nullptr};           ///< Journal of accepted requests, none if null
+        RequestCapture* m_capture{nullptr};           ///< Capture of the received traffic, none if null
+        SubscriptionHub* m_subscriptionHub{nullptr};  ///< Topic subscriptions, none if null
+        PCControl* m_commandRegistry{nullptr};        ///< Command IDs of the binary protocol, text only if null
+        ProcessSampler* m_processSampler{nullptr};    ///< Answers the query commands, queued as requests if null
+        std::atomic<uint32_t> m_nextConnectionID{1};  ///< Identifier of the next accepted connection
+        bool m_isHandingOff{false};                   ///< A successor takes the sockets over
+        /**
+         * @brief Where the results of a connection's requests go
+         */
+        struct ReplyRoute
+        {
+            std::shared_ptr<SubscriptionHub::Subscriber> writer{};  ///< Reply queue of the connection
+            uint32_t pendingCount{};                                 ///< Queued requests whose result was not sent yet
+        };
+        std::unordered_map<uint32_t, ReplyRoute> m_replyRoutes{};  ///< Open connections waiting for results, by connection ID
+        std::vector<RestartHandoff::Connection> m_handoffConnections{};  ///< Connections kept open for the successor
         // Create Logger instance for server logging
         Logger m_serverLogger{Logger::Levels::ERROR, "ServerLog.log", true}; 
+        /**
+         * @brief Accepts the connections of one listener until the loop stops
+         * @param listeningFileDescriptor TCP or Unix domain listening socket
+         */
+        Task<void> acceptConnections(int listeningFileDescriptor);
+        /**
+         * @brief Save the requests of a client to the message queue until it disconnects
+         * @param clientfileDescriptor Client file descriptor
+         * @param connectionID Identifier of the connection, unlike the descriptor never reused
+         * @param subscription Subscriber state of a connection taken over with its subscriptions, nullptr otherwise
+         */
+        Task<void> saveClientRequests(int clientfileDescriptor, uint32_t connectionID,
+                                      std::shared_ptr<SubscriptionHub::Subscriber> subscription = nullptr);
+        /**
+         * @brief helper function to run a subscription command of a connection
+         * @param subscription Subscriber state of the connection, created on the first subscription
+         * @param clientfileDescriptor Client file descriptor
+         * @param command Trimmed lowercase message
+         * @return False if the message is no subscription command
+         */
+        bool handleSubscriptionCommand(std::shared_ptr<SubscriptionHub::Subscriber>& subscription, int clientfileDescriptor,
+                                       const std::string& command);
+        /**
+         * @brief helper function to route the result of a queued request back to its connection
+         * @param connectionID Connection the request arrived on
+         * @param subscription Reply queue of the connection, created on the first request
+         * @param clientfileDescriptor Client file descriptor
+         */
+        void expectResult(uint32_t connectionID, std::shared_ptr<SubscriptionHub::Subscriber>& subscription, int clientfileDescriptor);
+        /**
+         * @brief helper function to check that no publication or result can follow a protocol switch
+         */
+        bool isReplyQueueIdle(uint32_t connectionID, const std::shared_ptr<SubscriptionHub::Subscriber>& subscription) const;
+        /**
+         * @brief Send a result once its request is on stable storage
+         */
+        Task<void> sendReplyWhenDurable(std::shared_ptr<SubscriptionHub::Subscriber> writer, std::string reply, uint64_t journalSequence);
+        /**
+         * @brief helper function to queue binary requests, frames may span receives
+         * @param connectionID Connection the frames arrived on
+         * @param pendingBytes Partial frame of the connection left from the previous receive
+         * @param data The received bytes
+         * @param length Number of received bytes
+         * @param subscription Reply queue of the connection the results are sent through, created on the first request
+         * @param clientfileDescriptor Client file descriptor
+         * @param responses Filled with the frames answered right away, handshakes and unknown command IDs
+         * @param journalSequence Set to the last journal record to await before responding
+         * @return False if a frame is malformed and the connection must close
+         */
+        bool handleBinaryFrames(uint32_t connectionID, std::string& pendingBytes, const char* data, size_t length,
+                                std::shared_ptr<SubscriptionHub::Subscriber>& subscription, int clientfileDescriptor,
+                                std::string& responses, uint64_t& journalSequence);
+        /**
+         * @brief helper function to encode the command table sent in the binary handshake
+         */
+        std::string encodeCommandTable() const;
+        /**
+         * @brief helper function to number, journal and queue a received request
+         * @param journalSequence Set to the journal record to await before acknowledging, 0 without journal
+         * @return False if the request was rejected, the message queue or the journal is full
+         */
+        bool queueRequest(Request& request, uint64_t& journalSequence);
+        /**
+         * @brief helper function to enable TCP keepalive so half-open connections are detected
+         */
+        static void enableKeepalive(int clientfileDescriptor);
 };
 } // namespace App
\ No newline at end of file
@@ -0,0 +1,237 @@
+/**
+ * @file SharedMemoryChannel.hpp
+ * @brief Header file for the shared memory channel layout
+ *
+ * Defines the memory shared by the server and one local client: a request
+ * ring and an acknowledgment ring, each a lock-free single producer single
+ * consumer ring. A side that finds its ring empty spins briefly and then
+ * sleeps on a futex, the other side only makes the wake-up system call when
+ * it sees that flag set. Used by the server transport and the client library.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <algorithm>             ///< For std::min
+#include <atomic>                ///< For std::atomic and std::atomic_thread_fence
+#include <climits>               ///< For INT_MAX
+#include <cstdint>               ///< For fixed width integer types
+#include <cstring>               ///< For memcpy
+#include <ctime>                 ///< For struct timespec
+#include <linux/futex.h>         ///< For FUTEX_WAIT and FUTEX_WAKE
+#include <string>                ///< For std::string class operations
+#include <sys/syscall.h>         ///< For SYS_futex
+#include <unistd.h>              ///< For syscall and sysconf
+
+constexpr uint32_t SHM_CHANNEL_MAGIC{0x5043534DU};   ///< Marks an initialized channel
+constexpr uint32_t SHM_CHANNEL_VERSION{1};           ///< Layout version, bumped on incompatible changes
+constexpr uint32_t SHM_RING_SLOT_COUNT{512};         ///< Messages a ring holds, a power of two
+constexpr uint32_t SHM_SLOT_SIZE{256};               ///< Bytes per slot including the length
+constexpr uint32_t SHM_SPIN_COUNT{4096};             ///< Empty polls before a side sleeps on the futex
+constexpr uint32_t SHM_WAIT_TIMEOUT_MS{100};         ///< Longest futex sleep before the closed flag is checked again
+constexpr size_t SHM_CACHE_LINE_SIZE{64};            ///< Keeps the indices of both sides apart
+
+static_assert(0 == (SHM_RING_SLOT_COUNT & (SHM_RING_SLOT_COUNT - 1)), "Slot count must be a power of two");
+static_assert(std::atomic<uint32_t>::is_always_lock_free && (sizeof(std::atomic<uint32_t>) == sizeof(uint32_t)),
+              "Futex words must be plain 32 bit integers");
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @brief helper function to sleep while a shared futex word holds a value
+ */
+inline void waitOnFutex(std::atomic<uint32_t>& word, uint32_t expected, uint32_t timeoutMs)
+{
+    timespec Timeout{static_cast<time_t>(timeoutMs / 1000), static_cast<long>((timeoutMs % 1000) * 1000000L)};
+    // Not FUTEX_PRIVATE, the word is shared with another process
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &Timeout, nullptr, 0);
+}
+
+/**
+ * @brief helper function to wake every sleeper of a shared futex word
+ */
+inline void wakeFutex(std::atomic<uint32_t>& word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+/**
+ * @brief helper function to get the empty polls before sleeping, none on a single CPU where the peer needs the core
+ */
+inline uint32_t getSpinCount()
+{
+    static const uint32_t s_spinCount = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? SHM_SPIN_COUNT : 0;
+    return s_spinCount;
+}
+
+/**
+ * @brief helper function to relax the core while spinning
+ */
+inline void pauseCore()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/**
+ * @class SharedMemoryRing
+ * @brief Single producer single consumer ring of short messages placed in shared memory
+ *
+ * Either side may be another process, so every index and length read from the
+ * ring is validated before use
+ */
+class SharedMemoryRing
+{
+    public:
+        /**
+         * @brief One message
+         */
+        struct Slot
+        {
+            uint32_t length;                          ///< Bytes used in data
+            char data[SHM_SLOT_SIZE - sizeof(uint32_t)];  ///< Message bytes
+        };
+        static constexpr size_t MAX_MESSAGE_SIZE{sizeof(Slot::data)};  ///< Longest message a slot holds
+        /**
+         * @brief Add a message without waiting, producer side only
+         * @return False if the ring is full or the message too long
+         */
+        bool tryPush(const char* data, size_t length)
+        {
+            uint32_t Tail = m_tail.load(std::memory_order_relaxed);
+            if((length > MAX_MESSAGE_SIZE) || ((Tail - m_head.load(std::memory_order_acquire)) >= SHM_RING_SLOT_COUNT))
+            {
+                return false;
+            }
+            Slot& Destination = m_slots[Tail & (SHM_RING_SLOT_COUNT - 1)];
+            Destination.length = static_cast<uint32_t>(length);
+            std::memcpy(Destination.data, data, length);
+            m_tail.store(Tail + 1, std::memory_order_release);
+            // Order the publish before reading the sleep flag, pairs with the fence in pop
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(0 != m_isConsumerWaiting.load(std::memory_order_relaxed))
+            {
+                m_isConsumerWaiting.store(0, std::memory_order_relaxed);
+                wakeFutex(m_isConsumerWaiting);
+            }
+            return true;
+        }
+        /**
+         * @brief Remove a message without waiting, consumer side only
+         * @return False if the ring is empty
+         */
+        bool tryPop(std::string& message)
+        {
+            uint32_t Head = m_head.load(std::memory_order_relaxed);
+            if(Head == m_tail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            const Slot& Source = m_slots[Head & (SHM_RING_SLOT_COUNT - 1)];
+            message.assign(Source.data, std::min<size_t>(Source.length, MAX_MESSAGE_SIZE));
+            m_head.store(Head + 1, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(0 != m_isProducerWaiting.load(std::memory_order_relaxed))
+            {
+                m_isProducerWaiting.store(0, std::memory_order_relaxed);
+                wakeFutex(m_isProducerWaiting);
+            }
+            return true;
+        }
+        /**
+         * @brief Add a message, spinning and then sleeping while the ring is full
+         * @param isClosed Channel flag ending the wait
+         * @return False if the channel closed or the message is too long
+         */
+        bool push(const char* data, size_t length, const std::atomic<uint32_t>& isClosed)
+        {
+            if(length > MAX_MESSAGE_SIZE)
+            {
+                return false;
+            }
+            return waitFor([&]() { return tryPush(data, length); }, m_isProducerWaiting, isClosed);
+        }
+        /**
+         * @brief Remove a message, spinning and then sleeping while the ring is empty
+         * @param isClosed Channel flag ending the wait
+         * @return False if the channel closed
+         */
+        bool pop(std::string& message, const std::atomic<uint32_t>& isClosed)
+        {
+            return waitFor([&]() { return tryPop(message); }, m_isConsumerWaiting, isClosed);
+        }
+        /**
+         * @brief Check if the producer overran the consumer, only possible with a misbehaving peer
+         */
+        bool isCorrupt() const
+        {
+            return (m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_relaxed)) > SHM_RING_SLOT_COUNT;
+        }
+        /**
+         * @brief Wake both sides, used when the channel closes
+         */
+        void wakeAll()
+        {
+            m_isConsumerWaiting.store(0, std::memory_order_relaxed);
+            m_isProducerWaiting.store(0, std::memory_order_relaxed);
+            wakeFutex(m_isConsumerWaiting);
+            wakeFutex(m_isProducerWaiting);
+        }
+    private:
+        alignas(SHM_CACHE_LINE_SIZE) std::atomic<uint32_t> m_head;               ///< Next slot to consume
+        alignas(SHM_CACHE_LINE_SIZE) std::atomic<uint32_t> m_tail;               ///< Next slot to produce
+        alignas(SHM_CACHE_LINE_SIZE) std::atomic<uint32_t> m_isConsumerWaiting;  ///< Futex word, consumer sleeps on an empty ring
+        alignas(SHM_CACHE_LINE_SIZE) std::atomic<uint32_t> m_isProducerWaiting;  ///< Futex word, producer sleeps on a full ring
+        alignas(SHM_CACHE_LINE_SIZE) Slot m_slots[SHM_RING_SLOT_COUNT];          ///< Message slots
+        /**
+         * @brief helper function to retry an operation, spinning first and sleeping on a futex after
+         */
+        template <typename Operation>
+        bool waitFor(Operation operation, std::atomic<uint32_t>& waitWord, const std::atomic<uint32_t>& isClosed)
+        {
+            while(0 == isClosed.load(std::memory_order_acquire))
+            {
+                for(uint32_t Spin = 0, SpinCount = getSpinCount(); Spin < SpinCount; Spin++)
+                {
+                    if(operation())
+                    {
+                        return true;
+                    }
+                    pauseCore();
+                }
+                // Announce the sleep, then check once more so a concurrent publish is not missed
+                waitWord.store(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if(operation())
+                {
+                    waitWord.store(0, std::memory_order_relaxed);
+                    return true;
+                }
+                waitOnFutex(waitWord, 1, SHM_WAIT_TIMEOUT_MS);
+            }
+            return false;
+        }
+};
+
+/**
+ * @brief Memory shared by the server and one client
+ */
+struct SharedMemoryChannelLayout
+{
+    uint32_t magic;                                             ///< SHM_CHANNEL_MAGIC once initialized
+    uint32_t version;                                           ///< SHM_CHANNEL_VERSION
+    alignas(SHM_CACHE_LINE_SIZE) std::atomic<uint32_t> isClosed;  ///< Set by either side to end the channel
+    SharedMemoryRing requests;                                  ///< Client to server
+    SharedMemoryRing acknowledgments;                           ///< Server to client
+};
+} // namespace App
@@ -0,0 +1,165 @@
+/**
+ * @file SharedMemoryClient.hpp
+ * @brief Client library for the shared memory transport of PC Control
+ *
+ * Header only, a local client connects to the transport socket once, receives
+ * the shared memory channel over it and from then on sends commands and
+ * receives acknowledgments without a system call while the server is busy
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <string>                ///< For std::string class operations
+#include <string_view>           ///< For std::string_view
+#include <sys/mman.h>            ///< For mmap and munmap
+#include <sys/socket.h>          ///< For socket, connect and recvmsg
+#include <sys/stat.h>            ///< For fstat
+#include <sys/un.h>              ///< For sockaddr_un
+#include <unistd.h>              ///< For close
+#include "SharedMemoryChannel.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @class SharedMemoryClient
+ * @brief Sends commands to the server through a shared memory channel
+ *
+ * Not thread safe, the rings have a single producer and a single consumer
+ */
+class SharedMemoryClient
+{
+    public:
+        SharedMemoryClient() = default;
+        SharedMemoryClient(const SharedMemoryClient&) = delete;             ///< Delete copy constructor
+        SharedMemoryClient& operator=(const SharedMemoryClient&) = delete;  ///< Delete copy assignment operator
+        SharedMemoryClient(SharedMemoryClient&&) = delete;                  ///< Delete move constructor
+        SharedMemoryClient& operator=(SharedMemoryClient&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Close the channel
+         */
+        ~SharedMemoryClient()
+        {
+            disconnect();
+        }
+        /**
+         * @brief Connect to the transport socket and map the channel it hands out
+         * @param socketPath Transport socket of the server
+         * @return False if the server is unreachable or sent no valid channel
+         */
+        bool connect(const std::string& socketPath)
+        {
+            disconnect();
+            sockaddr_un Address{};
+            Address.sun_family = AF_UNIX;
+            if(socketPath.size() >= sizeof(Address.sun_path))
+            {
+                return false;
+            }
+            socketPath.copy(Address.sun_path, socketPath.size());
+            m_socketFileDescriptor = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+            if((-1 == m_socketFileDescriptor) ||
+               (-1 == ::connect(m_socketFileDescriptor, reinterpret_cast<sockaddr*>(&Address), sizeof(Address))))
+            {
+                disconnect();
+                return false;
+            }
+            // The server answers with one byte carrying the channel memory descriptor
+            char Byte = 0;
+            iovec Vector{&Byte, sizeof(Byte)};
+            alignas(cmsghdr) char Control[CMSG_SPACE(sizeof(int))]{};
+            msghdr Message{};
+            Message.msg_iov = &Vector;
+            Message.msg_iovlen = 1;
+            Message.msg_control = Control;
+            Message.msg_controllen = sizeof(Control);
+            cmsghdr* Header = (recvmsg(m_socketFileDescriptor, &Message, MSG_CMSG_CLOEXEC) > 0) ? CMSG_FIRSTHDR(&Message) : nullptr;
+            if((nullptr == Header) || (SOL_SOCKET != Header->cmsg_level) || (SCM_RIGHTS != Header->cmsg_type))
+            {
+                disconnect();
+                return false;
+            }
+            int MemoryFileDescriptor = -1;
+            std::memcpy(&MemoryFileDescriptor, CMSG_DATA(Header), sizeof(MemoryFileDescriptor));
+            struct stat MemoryStatus{};
+            void* Mapping = MAP_FAILED;
+            if((0 == fstat(MemoryFileDescriptor, &MemoryStatus)) && (static_cast<size_t>(MemoryStatus.st_size) >= sizeof(SharedMemoryChannelLayout)))
+            {
+                Mapping = mmap(nullptr, sizeof(SharedMemoryChannelLayout), PROT_READ | PROT_WRITE, MAP_SHARED, MemoryFileDescriptor, 0);
+            }
+            close(MemoryFileDescriptor);
+            if(MAP_FAILED == Mapping)
+            {
+                disconnect();
+                return false;
+            }
+            m_channel = static_cast<SharedMemoryChannelLayout*>(Mapping);
+            if((SHM_CHANNEL_MAGIC != m_channel->magic) || (SHM_CHANNEL_VERSION != m_channel->version))
+            {
+                disconnect();
+                return false;
+            }
+            return true;
+        }
+        /**
+         * @brief Close the channel, the server notices through the transport socket
+         */
+        void disconnect()
+        {
+            if(nullptr != m_channel)
+            {
+                m_channel->isClosed.store(1, std::memory_order_release);
+                m_channel->requests.wakeAll();
+                m_channel->acknowledgments.wakeAll();
+                munmap(m_channel, sizeof(SharedMemoryChannelLayout));
+                m_channel = nullptr;
+            }
+            if(-1 != m_socketFileDescriptor)
+            {
+                close(m_socketFileDescriptor);
+                m_socketFileDescriptor = -1;
+            }
+        }
+        /**
+         * @brief Check if the channel is usable
+         */
+        bool isConnected() const
+        {
+            return (nullptr != m_channel) && (0 == m_channel->isClosed.load(std::memory_order_acquire));
+        }
+        /**
+         * @brief Queue a command, waits while the request ring is full
+         * @return False if the channel closed or the command is longer than a slot
+         */
+        bool send(std::string_view command)
+        {
+            return isConnected() && m_channel->requests.push(command.data(), command.size(), m_channel->isClosed);
+        }
+        /**
+         * @brief Wait for the acknowledgment of the oldest unacknowledged command
+         * @return False if the channel closed
+         */
+        bool receiveAcknowledgment()
+        {
+            return isConnected() && m_channel->acknowledgments.pop(m_acknowledgment, m_channel->isClosed);
+        }
+        /**
+         * @brief Send a command and wait for its acknowledgment
+         */
+        bool request(std::string_view command)
+        {
+            return send(command) && receiveAcknowledgment();
+        }
+    private:
+        int m_socketFileDescriptor{-1};                   ///< Transport socket, kept open while connected
+        SharedMemoryChannelLayout* m_channel{nullptr};    ///< Mapped channel
+        std::string m_acknowledgment{};                   ///< Reused acknowledgment buffer
+};
+} // namespace App
@@ -0,0 +1,291 @@
+/**
+ * @file SharedMemoryTransport.cpp
+ * @brief Source file for the shared memory transport
+ *
+ * Serves local clients through a memfd-backed pair of lock-free rings per
+ * client. A Unix domain socket hands out the channels and tells the server
+ * when a client is gone, the requests themselves never touch a socket and
+ * enter the same dispatch path as the requests received by the Server.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <algorithm>         ///< For std::max
+#include <fcntl.h>           ///< For fcntl and the memfd seals
+#include <iostream>          ///< For std::cout
+#include <sys/mman.h>        ///< For memfd_create, mmap and munmap
+#include <string_view>       ///< For std::string_view
+#include <sys/socket.h>      ///< For sendmsg and shutdown
+#include <unistd.h>          ///< For ftruncate, close and unlink
+#include <vector>            ///< For std::vector
+#include "SharedMemoryTransport.hpp"
+#include "EventChannel.hpp"
+#include "Metrics.hpp"
+#include "RequestJournal.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+/**
+ * @brief Constructor to set the loop accepting channels and the server queueing their requests
+ */
+SharedMemoryTransport::SharedMemoryTransport(EventLoop& loop, Server& server) : m_loop{loop}, m_server{server}
+{
+}
+/**
+ * @brief Close the remaining channels and the transport socket
+ */
+SharedMemoryTransport::~SharedMemoryTransport()
+{
+    stop();
+}
+/**
+ * @brief Listen for clients on the transport socket
+ * @param path Socket file, connecting requires write permission
+ * @param permissions Access to the socket file
+ * @return False if the socket could not be set up
+ */
+bool SharedMemoryTransport::listen(const std::string& path, mode_t permissions)
+{
+    m_listeningFileDescriptor = Server::openUnixListener(path, SOCK_SEQPACKET, permissions);
+    if(-1 == m_listeningFileDescriptor)
+    {
+        m_transportLogger.error("An error occurred while binding shared memory transport socket: " + path);
+        return false;
+    }
+    m_socketPath = path;
+    std::cout << "Shared memory channels are handed out on: " << path << '\n';
+    return true;
+}
+/**
+ * @brief Hand out a channel to every connecting client until the loop stops
+ */
+Task<void> SharedMemoryTransport::acceptChannels()
+{
+    while(!m_loop.isStopping())
+    {
+        int ClientfileDescriptor = co_await m_loop.accept(m_listeningFileDescriptor);
+        if(-1 == ClientfileDescriptor)
+        {
+            if(!m_loop.isStopping())
+            {
+                m_transportLogger.error("An error occurred while accepting shared memory client");
+                co_await m_loop.sleepFor(std::chrono::milliseconds(SERVER_ACCEPT_RETRY_MS));
+            }
+            continue;
+        }
+        int MemoryFileDescriptor = -1;
+        SharedMemoryChannelLayout* Layout = createChannelMemory(MemoryFileDescriptor);
+        bool IsSent = (nullptr != Layout) && sendFileDescriptor(ClientfileDescriptor, MemoryFileDescriptor);
+        if(-1 != MemoryFileDescriptor)
+        {
+            // The client holds its own reference once the descriptor was passed
+            close(MemoryFileDescriptor);
+        }
+        if(!IsSent)
+        {
+            m_transportLogger.error("An error occurred while creating shared memory channel");
+            if(nullptr != Layout)
+            {
+                munmap(Layout, sizeof(SharedMemoryChannelLayout));
+            }
+            m_loop.closeFileDescriptor(ClientfileDescriptor);
+            continue;
+        }
+        auto NewChannel = std::make_unique<Channel>();
+        NewChannel->socketFileDescriptor = ClientfileDescriptor;
+        NewChannel->layout = Layout;
+        NewChannel->connectionID = m_server.allocateConnectionID();
+        Channel& AcceptedChannel = *NewChannel;
+        m_channels.push_back(std::move(NewChannel));
+        m_acceptedCount++;
+        Metrics::increment(MetricCounter::CONNECTIONS_ACCEPTED);
+        EVENT_INFO("Shared memory client connected with connection ID: " << AcceptedChannel.connectionID);
+        AcceptedChannel.serviceThread = std::thread(&SharedMemoryTransport::serveChannel, this, std::ref(AcceptedChannel));
+        m_loop.spawn(watchChannel(AcceptedChannel));
+    }
+}
+/**
+ * @brief Close the remaining channels and the transport socket
+ */
+void SharedMemoryTransport::stop()
+{
+    while(!m_channels.empty())
+    {
+        closeChannel(*m_channels.front());
+    }
+    if(-1 != m_listeningFileDescriptor)
+    {
+        m_loop.closeFileDescriptor(m_listeningFileDescriptor);
+        unlink(m_socketPath.c_str());
+        m_listeningFileDescriptor = -1;
+    }
+}
+/**
+ * @brief Print transport statistics.
+ */
+void SharedMemoryTransport::printStatistics() const
+{
+    std::cout << "\n=== SHARED MEMORY TRANSPORT STATISTICS ===\n";
+    std::cout << "Transport socket: " << m_socketPath << '\n';
+    std::cout << "Channels accepted: " << m_acceptedCount << '\n';
+    std::cout << "Requests received: " << m_requestCount.load(std::memory_order_relaxed) << '\n';
+    std::cout << "==========================================\n";
+}
+/**
+ * @brief Close a channel once its client closed the transport socket
+ */
+Task<void> SharedMemoryTransport::watchChannel(Channel& channel)
+{
+    char Byte = 0;
+    // Clients never write to the socket, it only reports their end; stop ends the wait as well
+    ssize_t NumberOfReceivedBytes = 1;
+    while(NumberOfReceivedBytes > 0)
+    {
+        NumberOfReceivedBytes = co_await m_loop.receive(channel.socketFileDescriptor, &Byte, sizeof(Byte));
+    }
+    for(const auto& OpenChannel : m_channels)
+    {
+        if(OpenChannel.get() == &channel)
+        {
+            closeChannel(channel);
+            break;
+        }
+    }
+}
+/**
+ * @brief Service loop moving the requests of a channel into the server queue
+ */
+void SharedMemoryTransport::serveChannel(Channel& channel)
+{
+    SharedMemoryChannelLayout& Layout = *channel.layout;
+    RequestJournal* Journal = m_server.getJournal();
+    std::string Message;
+    bool IsOpen = true;
+    while(IsOpen && Layout.requests.pop(Message, Layout.isClosed))
+    {
+        // Take every request already in the ring so one journal commit covers the batch
+        uint64_t LastJournalSequence = 0;
+        size_t AcknowledgmentCount = 0;
+        std::vector<std::string_view> Replies;
+        do
+        {
+            if(Layout.requests.isCorrupt())
+            {
+                m_transportLogger.error("Shared memory client overran its request ring, closing channel");
+                IsOpen = false;
+                break;
+            }
+            m_server.recordReceivedBytes(channel.connectionID, CaptureRecordType::TEXT, Message.data(), Message.size());
+            uint64_t JournalSequence = 0;
+            bool IsRejected = false;
+            std::string Command = m_server.submitMessage(channel.connectionID, Message.data(), Message.size(), JournalSequence, IsRejected);
+            if(Command.empty())
+            {
+                continue;
+            }
+            // Replies keep the order of the requests, rejected ones are answered busy
+            Replies.emplace_back(IsRejected ? SERVER_BUSY_REPLY : SERVER_ACKNOWLEDGMENT);
+            AcknowledgmentCount += IsRejected ? 0 : 1;
+            LastJournalSequence = std::max(LastJournalSequence, JournalSequence);
+            if(("exit" == Command) || ("quit" == Command))
+            {
+                EVENT_INFO("Exit command received. Closing shared memory channel.");
+                IsOpen = false;
+                break;
+            }
+        } while(Layout.requests.tryPop(Message));
+        m_requestCount.fetch_add(AcknowledgmentCount, std::memory_order_relaxed);
+        if((nullptr != Journal) && (AcknowledgmentCount > 0))
+        {
+            // Same guarantee as the socket clients, acknowledged once the requests are on stable storage
+            Journal->waitDurable(LastJournalSequence);
+        }
+        for(const auto& Reply : Replies)
+        {
+            if(!Layout.acknowledgments.push(Reply.data(), Reply.size(), Layout.isClosed))
+            {
+                IsOpen = false;
+                break;
+            }
+            Metrics::increment(MetricCounter::BYTES_SENT, Reply.size());
+        }
+    }
+    Layout.isClosed.store(1, std::memory_order_release);
+    Layout.acknowledgments.wakeAll();
+    // Ends the watch of the loop, which joins this thread
+    shutdown(channel.socketFileDescriptor, SHUT_RDWR);
+}
+/**
+ * @brief Close a channel, join its thread and unmap it
+ */
+void SharedMemoryTransport::closeChannel(Channel& channel)
+{
+    channel.layout->isClosed.store(1, std::memory_order_release);
+    channel.layout->requests.wakeAll();
+    channel.layout->acknowledgments.wakeAll();
+    if(channel.serviceThread.joinable())
+    {
+        channel.serviceThread.join();
+    }
+    munmap(channel.layout, sizeof(SharedMemoryChannelLayout));
+    m_loop.closeFileDescriptor(channel.socketFileDescriptor);
+    Metrics::increment(MetricCounter::CONNECTIONS_CLOSED);
+    EVENT_INFO("Shared memory client disconnected with connection ID: " << channel.connectionID);
+    m_channels.remove_if([&channel](const std::unique_ptr<Channel>& OpenChannel) { return OpenChannel.get() == &channel; });
+}
+/**
+ * @brief helper function to create and map a sealed channel memory file
+ * @param memoryFileDescriptor Set to the memory file, to be passed to the client
+ * @return The mapping, nullptr on error
+ */
+SharedMemoryChannelLayout* SharedMemoryTransport::createChannelMemory(int& memoryFileDescriptor)
+{
+    memoryFileDescriptor = memfd_create("pccontrol-channel", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(-1 == memoryFileDescriptor)
+    {
+        return nullptr;
+    }
+    // A client must not shrink the file under the server, that would fault the server on access
+    if((-1 == ftruncate(memoryFileDescriptor, sizeof(SharedMemoryChannelLayout))) ||
+       (-1 == fcntl(memoryFileDescriptor, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)))
+    {
+        return nullptr;
+    }
+    void* Mapping = mmap(nullptr, sizeof(SharedMemoryChannelLayout), PROT_READ | PROT_WRITE, MAP_SHARED, memoryFileDescriptor, 0);
+    if(MAP_FAILED == Mapping)
+    {
+        return nullptr;
+    }
+    // The memory file starts zeroed, which is the empty state of both rings
+    SharedMemoryChannelLayout* Layout = static_cast<SharedMemoryChannelLayout*>(Mapping);
+    Layout->version = SHM_CHANNEL_VERSION;
+    Layout->magic = SHM_CHANNEL_MAGIC;
+    return Layout;
+}
+/**
+ * @brief helper function to pass a descriptor over a Unix domain socket
+ */
+bool SharedMemoryTransport::sendFileDescriptor(int socketFileDescriptor, int fileDescriptor)
+{
+    char Byte = 0;
+    iovec Vector{&Byte, sizeof(Byte)};
+    alignas(cmsghdr) char Control[CMSG_SPACE(sizeof(int))]{};
+    msghdr Message{};
+    Message.msg_iov = &Vector;
+    Message.msg_iovlen = 1;
+    Message.msg_control = Control;
+    Message.msg_controllen = sizeof(Control);
+    cmsghdr* Header = CMSG_FIRSTHDR(&Message);
+    Header->cmsg_level = SOL_SOCKET;
+    Header->cmsg_type = SCM_RIGHTS;
+    Header->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(Header), &fileDescriptor, sizeof(fileDescriptor));
+    // The new socket has an empty send buffer, so the non-blocking send completes at once
+    return sizeof(Byte) == sendmsg(socketFileDescriptor, &Message, MSG_NOSIGNAL);
+}
+} // namespace App
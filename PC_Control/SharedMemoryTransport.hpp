@@ -0,0 +1,116 @@
+/**
+ * @file SharedMemoryTransport.hpp
+ * @brief Header file for the shared memory transport
+ *
+ * Serves local clients through a memfd-backed pair of lock-free rings per
+ * client. A Unix domain socket hands out the channels and tells the server
+ * when a client is gone, the requests themselves never touch a socket and
+ * enter the same dispatch path as the requests received by the Server.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <atomic>                ///< For std::atomic
+#include <cstdint>               ///< For fixed width integer types
+#include <list>                  ///< For std::list
+#include <memory>                ///< For std::unique_ptr
+#include <string>                ///< For std::string class operations
+#include <thread>                ///< For std::thread
+#include "EventLoop.hpp"
+#include "Logger.hpp"
+#include "Server.hpp"
+#include "SharedMemoryChannel.hpp"
+#include "Task.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @class SharedMemoryTransport
+ * @brief Hands out shared memory channels and serves each on its own thread
+ */
+class SharedMemoryTransport
+{
+    public:
+        /**
+         * @brief Constructor to set the loop accepting channels and the server queueing their requests
+         */
+        SharedMemoryTransport(EventLoop& loop, Server& server);
+        SharedMemoryTransport(const SharedMemoryTransport&) = delete;             ///< Delete copy constructor
+        SharedMemoryTransport& operator=(const SharedMemoryTransport&) = delete;  ///< Delete copy assignment operator
+        SharedMemoryTransport(SharedMemoryTransport&&) = delete;                  ///< Delete move constructor
+        SharedMemoryTransport& operator=(SharedMemoryTransport&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Close the remaining channels and the transport socket
+         */
+        ~SharedMemoryTransport();
+        /**
+         * @brief Listen for clients on the transport socket
+         * @param path Socket file, connecting requires write permission
+         * @param permissions Access to the socket file
+         * @return False if the socket could not be set up
+         */
+        bool listen(const std::string& path, mode_t permissions = UNIX_SOCKET_PERMISSIONS);
+        /**
+         * @brief Hand out a channel to every connecting client until the loop stops
+         */
+        Task<void> acceptChannels();
+        /**
+         * @brief Close the remaining channels and the transport socket
+         */
+        void stop();
+        /**
+         * @brief Print transport statistics.
+         */
+        void printStatistics() const;
+    private:
+        /**
+         * @brief A client and its mapped channel
+         */
+        struct Channel
+        {
+            int socketFileDescriptor{-1};                  ///< Transport socket of the client
+            SharedMemoryChannelLayout* layout{nullptr};    ///< Mapped channel
+            uint32_t connectionID{};                       ///< Identifier shared with the other transports
+            std::thread serviceThread{};                   ///< Moves the requests into the server queue
+        };
+        EventLoop& m_loop;                                 ///< Loop accepting and watching the clients
+        Server& m_server;                                  ///< Queues the requests
+        int m_listeningFileDescriptor{-1};                 ///< Transport socket
+        std::string m_socketPath{};                        ///< Transport socket file, removed on stop
+        std::list<std::unique_ptr<Channel>> m_channels{};  ///< Open channels, loop thread only
+        uint64_t m_acceptedCount{};                        ///< Channels handed out
+        std::atomic<uint64_t> m_requestCount{0};           ///< Requests received over all channels
+        // Create Logger instance for transport logging
+        Logger m_transportLogger{Logger::Levels::ERROR, "SharedMemoryLog.log", true};
+        /**
+         * @brief Close a channel once its client closed the transport socket
+         */
+        Task<void> watchChannel(Channel& channel);
+        /**
+         * @brief Service loop moving the requests of a channel into the server queue
+         */
+        void serveChannel(Channel& channel);
+        /**
+         * @brief Close a channel, join its thread and unmap it
+         */
+        void closeChannel(Channel& channel);
+        /**
+         * @brief helper function to create and map a sealed channel memory file
+         * @param memoryFileDescriptor Set to the memory file, to be passed to the client
+         * @return The mapping, nullptr on error
+         */
+        static SharedMemoryChannelLayout* createChannelMemory(int& memoryFileDescriptor);
+        /**
+         * @brief helper function to pass a descriptor over a Unix domain socket
+         */
+        static bool sendFileDescriptor(int socketFileDescriptor, int fileDescriptor);
+};
+} // namespace App
@@ -0,0 +1,376 @@
+/**
+ * @file SubscriptionHub.cpp
+ * @brief Source file for topic publish/subscribe fan-out
+ *
+ * Lets clients subscribe to topics on their connection. A publication is
+ * formatted once into an immutable, reference-counted buffer that every
+ * subscriber queue shares, and each subscriber is written with vectored
+ * sends. A subscriber that falls behind loses publications by the policy of
+ * the topic, publishers never wait for a subscriber. A connection that stops
+ * reading is closed, by a write timeout or when its replies pile up.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <algorithm>         ///< For std::find, std::find_if and std::iter_swap
+#include <iostream>          ///< For std::cout
+#include <sys/socket.h>      ///< For shutdown
+#include "SubscriptionHub.hpp"
+#include "EventChannel.hpp"
+#include "Metrics.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+constexpr std::string_view TOPIC_NAMES[]{"completions", "processes", "events"};   ///< Indexed by Topic
+static_assert(std::size(TOPIC_NAMES) == TOPIC_COUNT, "Every topic needs a name");
+
+/**
+ * @brief Constructor to set the loop writing to the subscribers
+ */
+SubscriptionHub::SubscriptionHub(EventLoop& loop) : m_loop{loop}
+{
+    // Results are a history, the newest matter most; process state is a value per process
+    setPolicy(Topic::COMPLETIONS, SlowSubscriberPolicy::DROP_OLDEST);
+    setPolicy(Topic::PROCESS_STATE, SlowSubscriberPolicy::CONFLATE);
+    setPolicy(Topic::EVENTS, SlowSubscriberPolicy::DROP_NEWEST);
+}
+/**
+ * @brief Parse a "subscribe <topic>" or "unsubscribe <topic>" command
+ * @param command Trimmed lowercase command
+ * @param isSubscribe Set to false for unsubscribe
+ * @param topicName Set to the topic word, may name no topic
+ * @return False if the command is no subscription command
+ */
+bool SubscriptionHub::parseCommand(std::string_view command, bool& isSubscribe, std::string& topicName)
+{
+    size_t Separator = command.find(' ');
+    std::string_view Verb = command.substr(0, Separator);
+    if(("subscribe" != Verb) && ("unsubscribe" != Verb))
+    {
+        return false;
+    }
+    isSubscribe = ("subscribe" == Verb);
+    std::string_view Argument = (Separator == std::string_view::npos) ? std::string_view{} : command.substr(Separator + 1);
+    size_t ArgumentStart = Argument.find_first_not_of(' ');
+    topicName = (ArgumentStart == std::string_view::npos) ? std::string{} : std::string(Argument.substr(ArgumentStart));
+    return true;
+}
+/**
+ * @brief Look up a topic by name
+ * @return False if no topic has the name
+ */
+bool SubscriptionHub::parseTopic(std::string_view topicName, Topic& topic)
+{
+    for(size_t Index = 0; Index < TOPIC_COUNT; Index++)
+    {
+        if(TOPIC_NAMES[Index] == topicName)
+        {
+            topic = static_cast<Topic>(Index);
+            return true;
+        }
+    }
+    return false;
+}
+/**
+ * @brief Set what a slow subscriber of a topic gives up, call before run()
+ */
+void SubscriptionHub::setPolicy(Topic topic, SlowSubscriberPolicy policy)
+{
+    m_policies[static_cast<size_t>(topic)] = policy;
+}
+/**
+ * @brief Check if any connection subscribed to a topic, lets publishers skip formatting, thread safe
+ */
+bool SubscriptionHub::hasSubscribers(Topic topic) const
+{
+    return m_subscriberCounts[static_cast<size_t>(topic)].load(std::memory_order_relaxed) > 0;
+}
+/**
+ * @brief Publish a line to every subscriber of a topic, never blocks on a subscriber, thread safe
+ * @param topic Topic to publish to
+ * @param text Line without trailing newline
+ * @param key Conflation key for topics with the CONFLATE policy
+ */
+void SubscriptionHub::publish(Topic topic, std::string text, std::string key)
+{
+    // Formatted once, every subscriber queue holds a reference to the same buffer
+    auto NewPublication = std::make_shared<Publication>();
+    NewPublication->topic = topic;
+    NewPublication->key = std::move(key);
+    NewPublication->text.reserve(TOPIC_NAMES[static_cast<size_t>(topic)].size() + text.size() + 2);
+    NewPublication->text.append(TOPIC_NAMES[static_cast<size_t>(topic)]).append(1, ' ').append(text).append(1, '\n');
+    m_publications.push(std::move(NewPublication));
+}
+/**
+ * @brief Fan the publications out until the loop stops
+ */
+Task<void> SubscriptionHub::run()
+{
+    m_loop.spawn(m_writeTimers.run());
+    while(true)
+    {
+        std::optional<SharedPublication> NextPublication = co_await m_publications.pop(m_loop);
+        if(!NextPublication)
+        {
+            co_return;
+        }
+        fanOut(*NextPublication);
+        while((NextPublication = m_publications.tryPop()))
+        {
+            fanOut(*NextPublication);
+        }
+    }
+}
+/**
+ * @brief Create the subscriber state of a connection
+ */
+std::shared_ptr<SubscriptionHub::Subscriber> SubscriptionHub::createSubscriber(int fileDescriptor)
+{
+    auto NewSubscriber = std::make_shared<Subscriber>();
+    NewSubscriber->fileDescriptor = fileDescriptor;
+    return NewSubscriber;
+}
+/**
+ * @brief Subscribe a connection to a topic
+ */
+void SubscriptionHub::subscribe(const std::shared_ptr<Subscriber>& subscriber, Topic topic)
+{
+    size_t TopicIndex = static_cast<size_t>(topic);
+    if(subscriber->topics[TopicIndex] || subscriber->isClosed)
+    {
+        return;
+    }
+    subscriber->topics[TopicIndex] = true;
+    m_subscribers[TopicIndex].push_back(subscriber);
+    m_subscriberCounts[TopicIndex].store(m_subscribers[TopicIndex].size(), std::memory_order_relaxed);
+}
+/**
+ * @brief Unsubscribe a connection from a topic
+ */
+void SubscriptionHub::unsubscribe(const std::shared_ptr<Subscriber>& subscriber, Topic topic)
+{
+    size_t TopicIndex = static_cast<size_t>(topic);
+    if(!subscriber->topics[TopicIndex])
+    {
+        return;
+    }
+    subscriber->topics[TopicIndex] = false;
+    auto& Subscribers = m_subscribers[TopicIndex];
+    auto SubscriberIterator = std::find(Subscribers.begin(), Subscribers.end(), subscriber);
+    if(SubscriberIterator != Subscribers.end())
+    {
+        // Order among subscribers does not matter, swap with the last instead of shifting
+        std::iter_swap(SubscriberIterator, Subscribers.end() - 1);
+        Subscribers.pop_back();
+    }
+    m_subscriberCounts[TopicIndex].store(Subscribers.size(), std::memory_order_relaxed);
+}
+/**
+ * @brief Queue a line that no policy discards, keeps it in order with the publications
+ * @param text Line including its newline, the connection is closed instead if too many replies wait
+ */
+void SubscriptionHub::send(const std::shared_ptr<Subscriber>& subscriber, std::string_view text)
+{
+    if(subscriber->isBroken || subscriber->isClosed)
+    {
+        return;
+    }
+    if((subscriber->queue.size() - subscriber->droppableCount) >= SUBSCRIBER_REPLY_LIMIT)
+    {
+        // The client keeps sending requests without reading the results, replies are never dropped so they cannot wait without bound
+        EVENT_WARNING("Closing connection with " << SUBSCRIBER_REPLY_LIMIT << " unread replies");
+        m_overflowCount++;
+        subscriber->isBroken = true;
+        shutdown(subscriber->fileDescriptor, SHUT_RDWR);
+        return;
+    }
+    // Acknowledgments repeat the same text, share one buffer for them
+    if(!m_lastDirectLine || (m_lastDirectLine->text != text))
+    {
+        auto NewLine = std::make_shared<Publication>();
+        NewLine->text = text;
+        NewLine->isDroppable = false;
+        m_lastDirectLine = std::move(NewLine);
+    }
+    subscriber->queue.push_back(m_lastDirectLine);
+    wakeWriter(subscriber);
+}
+/**
+ * @brief End a connection's subscriptions
+ * @return True if the caller closes the socket, false if the running writer closes it
+ */
+bool SubscriptionHub::close(const std::shared_ptr<Subscriber>& subscriber)
+{
+    for(size_t TopicIndex = 0; TopicIndex < TOPIC_COUNT; TopicIndex++)
+    {
+        unsubscribe(subscriber, static_cast<Topic>(TopicIndex));
+    }
+    subscriber->isClosed = true;
+    // A running writer still flushes the queue, e.g. the acknowledgment of an exit command
+    return !subscriber->isWriting;
+}
+/**
+ * @brief Print fan-out statistics.
+ */
+void SubscriptionHub::printStatistics() const
+{
+    std::cout << "\n=== SUBSCRIPTION STATISTICS ===\n";
+    std::cout << "Publications: " << m_publicationCount << '\n';
+    std::cout << "Deliveries queued: " << m_deliveryCount << '\n';
+    std::cout << "Dropped for slow subscribers: " << m_droppedCount << '\n';
+    std::cout << "Conflated for slow subscribers: " << m_conflatedCount << '\n';
+    std::cout << "Vectored sends: " << m_sendCount << '\n';
+    std::cout << "Closed by the write timeout: " << m_timedOutCount << '\n';
+    std::cout << "Closed for unread replies: " << m_overflowCount << '\n';
+    std::cout << "===============================\n";
+}
+/**
+ * @brief helper function to queue a publication for every subscriber of its topic
+ */
+void SubscriptionHub::fanOut(const SharedPublication& publication)
+{
+    m_publicationCount++;
+    for(const auto& CurrentSubscriber : m_subscribers[static_cast<size_t>(publication->topic)])
+    {
+        enqueue(CurrentSubscriber, publication);
+    }
+}
+/**
+ * @brief helper function to queue a publication for a subscriber by the policy of its topic
+ */
+void SubscriptionHub::enqueue(const std::shared_ptr<Subscriber>& subscriber, const SharedPublication& publication)
+{
+    if(subscriber->isBroken || subscriber->isClosed)
+    {
+        return;
+    }
+    m_deliveryCount++;
+    SlowSubscriberPolicy Policy = m_policies[static_cast<size_t>(publication->topic)];
+    auto& Queue = subscriber->queue;
+    if((SlowSubscriberPolicy::CONFLATE == Policy) && !publication->key.empty())
+    {
+        // A waiting publication of the same key is stale, the new one takes its place in line
+        for(auto QueueIterator = Queue.rbegin(); QueueIterator != Queue.rend(); ++QueueIterator)
+        {
+            const Publication& Waiting = **QueueIterator;
+            if(Waiting.isDroppable && (Waiting.topic == publication->topic) && (Waiting.key == publication->key))
+            {
+                *QueueIterator = publication;
+                m_conflatedCount++;
+                return;
+            }
+        }
+    }
+    if(subscriber->droppableCount >= m_queueLimit)
+    {
+        m_droppedCount++;
+        if(SlowSubscriberPolicy::DROP_NEWEST == Policy)
+        {
+            return;
+        }
+        auto OldestIterator = std::find_if(Queue.begin(), Queue.end(), [](const SharedPublication& Waiting) { return Waiting->isDroppable; });
+        Queue.erase(OldestIterator);
+        subscriber->droppableCount--;
+    }
+    Queue.push_back(publication);
+    subscriber->droppableCount++;
+    wakeWriter(subscriber);
+}
+/**
+ * @brief helper function to start the writer of a subscriber unless it is running
+ */
+void SubscriptionHub::wakeWriter(const std::shared_ptr<Subscriber>& subscriber)
+{
+    if(!subscriber->isWriting)
+    {
+        subscriber->isWriting = true;
+        m_loop.spawn(writeSubscriber(subscriber));
+    }
+}
+/**
+ * @brief Write the queue of a subscriber until it is empty
+ */
+Task<void> SubscriptionHub::writeSubscriber(std::shared_ptr<Subscriber> subscriber)
+{
+    // Let the current loop iteration queue more, so one send carries everything published meanwhile
+    bool IsRunning = co_await m_loop.yield();
+    // Publications taken out of the queue are no longer touched by the policies
+    std::vector<SharedPublication> InFlight;
+    InFlight.reserve(SUBSCRIBER_MAX_VECTORS);
+    struct iovec Vectors[SUBSCRIBER_MAX_VECTORS];
+    // Bytes of the first in-flight publication already sent
+    size_t SentOffset = 0;
+    // A send without progress for too long shuts the socket down, the send then fails like on a broken connection
+    bool IsTimedOut = false;
+    TimerWheel::Timer WriteTimer;
+    WriteTimer.setCallback([fileDescriptor = subscriber->fileDescriptor, &IsTimedOut]()
+    {
+        IsTimedOut = true;
+        shutdown(fileDescriptor, SHUT_RDWR);
+    });
+    while(IsRunning && !subscriber->isBroken && (!InFlight.empty() || !subscriber->queue.empty()))
+    {
+        while((InFlight.size() < SUBSCRIBER_MAX_VECTORS) && !subscriber->queue.empty())
+        {
+            if(subscriber->queue.front()->isDroppable)
+            {
+                subscriber->droppableCount--;
+            }
+            InFlight.push_back(std::move(subscriber->queue.front()));
+            subscriber->queue.pop_front();
+        }
+        for(size_t Index = 0; Index < InFlight.size(); Index++)
+        {
+            size_t Skipped = (0 == Index) ? SentOffset : 0;
+            Vectors[Index].iov_base = const_cast<char*>(InFlight[Index]->text.data() + Skipped);
+            Vectors[Index].iov_len = InFlight[Index]->text.size() - Skipped;
+        }
+        m_writeTimers.schedule(WriteTimer, std::chrono::milliseconds(SUBSCRIBER_WRITE_TIMEOUT_MS));
+        ssize_t NumberOfSentBytes = co_await m_loop.sendVector(subscriber->fileDescriptor, Vectors, InFlight.size());
+        WriteTimer.cancel();
+        m_sendCount++;
+        if(NumberOfSentBytes < 0)
+        {
+            subscriber->isBroken = true;
+            break;
+        }
+        Metrics::increment(MetricCounter::BYTES_SENT, static_cast<uint64_t>(NumberOfSentBytes));
+        // Release the fully sent publications, a partly sent one stays first with its offset
+        size_t Remaining = static_cast<size_t>(NumberOfSentBytes) + SentOffset;
+        size_t SentCount = 0;
+        while((SentCount < InFlight.size()) && (Remaining >= InFlight[SentCount]->text.size()))
+        {
+            Remaining -= InFlight[SentCount]->text.size();
+            SentCount++;
+        }
+        InFlight.erase(InFlight.begin(), InFlight.begin() + static_cast<std::ptrdiff_t>(SentCount));
+        SentOffset = Remaining;
+    }
+    if(IsTimedOut)
+    {
+        EVENT_WARNING("Closing connection after a write timeout.");
+        m_timedOutCount++;
+        Metrics::increment(MetricCounter::CONNECTIONS_TIMED_OUT);
+    }
+    if(subscriber->isBroken)
+    {
+        subscriber->queue.clear();
+        subscriber->droppableCount = 0;
+    }
+    subscriber->isWriting = false;
+    if(subscriber->isClosed)
+    {
+        m_loop.closeFileDescriptor(subscriber->fileDescriptor);
+    }
+    else if(subscriber->isBroken)
+    {
+        // Ends the reading side of the connection as well
+        shutdown(subscriber->fileDescriptor, SHUT_RDWR);
+    }
+}
+} // namespace App
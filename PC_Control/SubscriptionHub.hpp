@@ -0,0 +1,206 @@
+/**
+ * @file SubscriptionHub.hpp
+ * @brief Header file for topic publish/subscribe fan-out
+ *
+ * Lets clients subscribe to topics on their connection. A publication is
+ * formatted once into an immutable, reference-counted buffer that every
+ * subscriber queue shares, and each subscriber is written with vectored
+ * sends. A subscriber that falls behind loses publications by the policy of
+ * the topic, publishers never wait for a subscriber. A connection that stops
+ * reading is closed, by a write timeout or when its replies pile up.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <algorithm>             ///< For std::find
+#include <array>                 ///< For std::array
+#include <atomic>                ///< For std::atomic
+#include <cstdint>               ///< For fixed width integer types
+#include <deque>                 ///< For std::deque
+#include <memory>                ///< For std::shared_ptr
+#include <string>                ///< For std::string class operations
+#include <string_view>           ///< For std::string_view
+#include <vector>                ///< For std::vector
+#include "AsyncQueue.hpp"
+#include "EventLoop.hpp"
+#include "Task.hpp"
+#include "TimerWheel.hpp"
+
+constexpr size_t SUBSCRIBER_QUEUE_LIMIT{256};    ///< Publications waiting per subscriber before the topic policy applies
+constexpr size_t SUBSCRIBER_REPLY_LIMIT{1024};   ///< Replies waiting per connection before it is closed as not reading
+constexpr size_t SUBSCRIBER_MAX_VECTORS{64};     ///< Buffers gathered into one vectored send
+constexpr int SUBSCRIBER_WRITE_TIMEOUT_MS{10000};  ///< Time a send may make no progress before the connection is closed
+constexpr int SUBSCRIBER_TIMER_TICK_MS{100};     ///< Resolution of the write timeouts
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @brief enum class Topic represents what a client can subscribe to
+ */
+enum class Topic : uint8_t
+{
+    COMPLETIONS   = UINT8_C(0),   ///< Result of every executed request
+    PROCESS_STATE = UINT8_C(1),   ///< Processes started and stopped by PCControl
+    EVENTS        = UINT8_C(2)    ///< Diagnostic events written by the event channel
+};
+constexpr size_t TOPIC_COUNT{3};   ///< Number of topics
+
+/**
+ * @brief enum class SlowSubscriberPolicy represents what a full subscriber queue gives up
+ */
+enum class SlowSubscriberPolicy : uint8_t
+{
+    DROP_NEWEST = UINT8_C(0),   ///< Discard the new publication
+    DROP_OLDEST = UINT8_C(1),   ///< Discard the oldest waiting publication
+    CONFLATE    = UINT8_C(2)    ///< Replace the waiting publication with the same key, drop the oldest when none
+};
+
+/**
+ * @class SubscriptionHub
+ * @brief Fans publications out to the subscribed connections
+ *
+ * publish() is thread safe, everything else runs on the loop thread
+ */
+class SubscriptionHub
+{
+    public:
+        /**
+         * @brief An immutable publication shared by every subscriber queue
+         */
+        struct Publication
+        {
+            Topic topic{};                ///< Topic published to
+            std::string key{};            ///< Conflation key, publications with equal keys supersede each other
+            std::string text{};           ///< Line sent to the subscribers
+            bool isDroppable{true};       ///< False for lines sent to one connection, e.g. acknowledgments
+        };
+        using SharedPublication = std::shared_ptr<const Publication>;
+        /**
+         * @brief A subscribed connection, shared by the connection and its writer
+         */
+        struct Subscriber
+        {
+            int fileDescriptor{-1};                          ///< Client socket
+            std::array<bool, TOPIC_COUNT> topics{};          ///< Subscribed topics
+            std::deque<SharedPublication> queue{};           ///< Waiting publications, acknowledgments included
+            size_t droppableCount{};                         ///< Waiting publications a policy may discard
+            bool isWriting{false};                           ///< A writer coroutine is running
+            bool isClosed{false};                            ///< The connection ended, the last user closes the socket
+            bool isBroken{false};                            ///< A send failed, nothing more is queued
+            /**
+             * @brief Check if the connection subscribed to any topic
+             */
+            bool isSubscribed() const { return std::find(topics.begin(), topics.end(), true) != topics.end(); }
+        };
+        /**
+         * @brief Constructor to set the loop writing to the subscribers
+         */
+        explicit SubscriptionHub(EventLoop& loop);
+        SubscriptionHub(const SubscriptionHub&) = delete;             ///< Delete copy constructor
+        SubscriptionHub& operator=(const SubscriptionHub&) = delete;  ///< Delete copy assignment operator
+        SubscriptionHub(SubscriptionHub&&) = delete;                  ///< Delete move constructor
+        SubscriptionHub& operator=(SubscriptionHub&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Parse a "subscribe <topic>" or "unsubscribe <topic>" command
+         * @param command Trimmed lowercase command
+         * @param isSubscribe Set to false for unsubscribe
+         * @param topicName Set to the topic word, may name no topic
+         * @return False if the command is no subscription command
+         */
+        static bool parseCommand(std::string_view command, bool& isSubscribe, std::string& topicName);
+        /**
+         * @brief Look up a topic by name
+         * @return False if no topic has the name
+         */
+        static bool parseTopic(std::string_view topicName, Topic& topic);
+        /**
+         * @brief Set what a slow subscriber of a topic gives up, call before run()
+         */
+        void setPolicy(Topic topic, SlowSubscriberPolicy policy);
+        /**
+         * @brief Set the publications waiting per subscriber before the topic policy applies, call from the loop thread
+         */
+        void setQueueLimit(size_t queueLimit) { m_queueLimit = queueLimit; }
+        /**
+         * @brief Check if any connection subscribed to a topic, lets publishers skip formatting, thread safe
+         */
+        bool hasSubscribers(Topic topic) const;
+        /**
+         * @brief Publish a line to every subscriber of a topic, never blocks on a subscriber, thread safe
+         * @param topic Topic to publish to
+         * @param text Line without trailing newline
+         * @param key Conflation key for topics with the CONFLATE policy
+         */
+        void publish(Topic topic, std::string text, std::string key = {});
+        /**
+         * @brief Fan the publications out until the loop stops
+         */
+        Task<void> run();
+        /**
+         * @brief Create the subscriber state of a connection
+         */
+        std::shared_ptr<Subscriber> createSubscriber(int fileDescriptor);
+        /**
+         * @brief Subscribe a connection to a topic
+         */
+        void subscribe(const std::shared_ptr<Subscriber>& subscriber, Topic topic);
+        /**
+         * @brief Unsubscribe a connection from a topic
+         */
+        void unsubscribe(const std::shared_ptr<Subscriber>& subscriber, Topic topic);
+        /**
+         * @brief Queue a line that no policy discards, keeps it in order with the publications
+         * @param text Line including its newline, the connection is closed instead if too many replies wait
+         */
+        void send(const std::shared_ptr<Subscriber>& subscriber, std::string_view text);
+        /**
+         * @brief End a connection's subscriptions
+         * @return True if the caller closes the socket, false if the running writer closes it
+         */
+        bool close(const std::shared_ptr<Subscriber>& subscriber);
+        /**
+         * @brief Print fan-out statistics.
+         */
+        void printStatistics() const;
+    private:
+        EventLoop& m_loop;                                                  ///< Loop writing to the subscribers
+        AsyncQueue<SharedPublication> m_publications{};                     ///< Publications from any thread
+        std::array<SlowSubscriberPolicy, TOPIC_COUNT> m_policies{};         ///< Policy of each topic
+        std::array<std::vector<std::shared_ptr<Subscriber>>, TOPIC_COUNT> m_subscribers{};  ///< Subscribers of each topic
+        std::array<std::atomic<size_t>, TOPIC_COUNT> m_subscriberCounts{};  ///< Mirror of the subscriber counts for publishers
+        SharedPublication m_lastDirectLine{};                               ///< Last line queued by send(), reused while unchanged
+        size_t m_queueLimit{SUBSCRIBER_QUEUE_LIMIT};                        ///< Publications waiting per subscriber before the topic policy applies
+        uint64_t m_publicationCount{};                                      ///< Publications fanned out
+        uint64_t m_deliveryCount{};                                         ///< Publications queued to subscribers
+        uint64_t m_droppedCount{};                                          ///< Publications discarded by a policy
+        uint64_t m_conflatedCount{};                                        ///< Publications superseded by a newer one
+        uint64_t m_sendCount{};                                             ///< Vectored send calls
+        uint64_t m_timedOutCount{};                                         ///< Connections closed by the write timeout
+        uint64_t m_overflowCount{};                                         ///< Connections closed for too many waiting replies
+        TimerWheel m_writeTimers{m_loop, std::chrono::milliseconds(SUBSCRIBER_TIMER_TICK_MS)};  ///< Write timeouts of the running writers
+        /**
+         * @brief helper function to queue a publication for every subscriber of its topic
+         */
+        void fanOut(const SharedPublication& publication);
+        /**
+         * @brief helper function to queue a publication for a subscriber by the policy of its topic
+         */
+        void enqueue(const std::shared_ptr<Subscriber>& subscriber, const SharedPublication& publication);
+        /**
+         * @brief helper function to start the writer of a subscriber unless it is running
+         */
+        void wakeWriter(const std::shared_ptr<Subscriber>& subscriber);
+        /**
+         * @brief Write the queue of a subscriber until it is empty
+         */
+        Task<void> writeSubscriber(std::shared_ptr<Subscriber> subscriber);
+};
+} // namespace App
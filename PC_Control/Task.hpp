@@ -0,0 +1,165 @@
+/**
+ * @file Task.hpp
+ * @brief Header file for coroutine task type
+ *
+ * Provides a lazily started, awaitable C++20 coroutine returning a value
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <coroutine>         ///< For std::coroutine_handle and suspend types
+#include <exception>         ///< For std::exception_ptr
+#include <optional>          ///< For std::optional
+#include <utility>           ///< For std::move and std::exchange
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+template <typename T = void>
+class Task;
+
+namespace Detail
+{
+    /**
+     * @brief Promise part shared by every task, resumes the awaiting coroutine on completion
+     */
+    struct TaskPromiseBase
+    {
+        /**
+         * @brief Transfers control back to the awaiting coroutine when the task finishes
+         */
+        struct FinalAwaiter
+        {
+            bool await_ready() const noexcept { return false; }
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+            {
+                return handle.promise().m_continuation;
+            }
+            void await_resume() const noexcept {}
+        };
+        std::coroutine_handle<> m_continuation{std::noop_coroutine()};  ///< Coroutine awaiting the task
+        std::exception_ptr m_exception{};                                ///< Exception escaping the task body
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+        void unhandled_exception() noexcept { m_exception = std::current_exception(); }
+    };
+} // namespace Detail
+
+/**
+ * @class Task
+ * @brief Coroutine that starts when awaited and hands its result to the awaiting coroutine
+ */
+template <typename T>
+class Task
+{
+    public:
+        /**
+         * @brief Coroutine promise storing the returned value
+         */
+        struct promise_type : Detail::TaskPromiseBase
+        {
+            std::optional<T> m_value{};   ///< Value passed to co_return
+            Task get_return_object() noexcept { return Task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+            void return_value(T value) { m_value.emplace(std::move(value)); }
+        };
+        Task(Task&& other) noexcept : m_handle{std::exchange(other.m_handle, nullptr)} {}  ///< Move constructor
+        Task& operator=(Task&& other) noexcept                                             ///< Move assignment operator
+        {
+            if(this != &other)
+            {
+                destroy();
+                m_handle = std::exchange(other.m_handle, nullptr);
+            }
+            return *this;
+        }
+        Task(const Task&) = delete;             ///< Delete copy constructor
+        Task& operator=(const Task&) = delete;  ///< Delete copy assignment operator
+        ~Task() { destroy(); }
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaitingHandle) noexcept
+        {
+            m_handle.promise().m_continuation = awaitingHandle;
+            return m_handle;
+        }
+        T await_resume()
+        {
+            if(m_handle.promise().m_exception)
+            {
+                std::rethrow_exception(m_handle.promise().m_exception);
+            }
+            return std::move(*m_handle.promise().m_value);
+        }
+    private:
+        explicit Task(std::coroutine_handle<promise_type> handle) noexcept : m_handle{handle} {}
+        void destroy()
+        {
+            if(m_handle)
+            {
+                m_handle.destroy();
+            }
+        }
+        std::coroutine_handle<promise_type> m_handle{};   ///< Owned coroutine frame
+};
+
+/**
+ * @class Task
+ * @brief Coroutine that starts when awaited and returns nothing
+ */
+template <>
+class Task<void>
+{
+    public:
+        /**
+         * @brief Coroutine promise of a task without value
+         */
+        struct promise_type : Detail::TaskPromiseBase
+        {
+            Task get_return_object() noexcept { return Task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+            void return_void() const noexcept {}
+        };
+        Task(Task&& other) noexcept : m_handle{std::exchange(other.m_handle, nullptr)} {}  ///< Move constructor
+        Task& operator=(Task&& other) noexcept                                             ///< Move assignment operator
+        {
+            if(this != &other)
+            {
+                destroy();
+                m_handle = std::exchange(other.m_handle, nullptr);
+            }
+            return *this;
+        }
+        Task(const Task&) = delete;             ///< Delete copy constructor
+        Task& operator=(const Task&) = delete;  ///< Delete copy assignment operator
+        ~Task() { destroy(); }
+        bool await_ready() const noexcept { return false; }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaitingHandle) noexcept
+        {
+            m_handle.promise().m_continuation = awaitingHandle;
+            return m_handle;
+        }
+        void await_resume()
+        {
+            if(m_handle.promise().m_exception)
+            {
+                std::rethrow_exception(m_handle.promise().m_exception);
+            }
+        }
+    private:
+        explicit Task(std::coroutine_handle<promise_type> handle) noexcept : m_handle{handle} {}
+        void destroy()
+        {
+            if(m_handle)
+            {
+                m_handle.destroy();
+            }
+        }
+        std::coroutine_handle<promise_type> m_handle{};   ///< Owned coroutine frame
+};
+} // namespace App
@@ -0,0 +1,154 @@
+/**
+ * @file BinaryProtocolTest.cpp
+ * @brief Checks the frame encoding, the command IDs and a binary session with the server
+ *
+ * Headers round-trip in network byte order. A client on a loopback connection
+ * switches to the binary protocol, looks its command up in the handshake
+ * table, sends a frame split across two writes followed by one with an
+ * unknown command ID, and gets an acknowledgment and an error back. A frame
+ * with unknown flags closes the connection.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <chrono>                ///< For std::chrono::milliseconds
+#include <netinet/in.h>          ///< For sockaddr_in
+#include <sstream>               ///< For std::istringstream
+#include <string>                ///< For std::string class operations
+#include <sys/socket.h>          ///< For socket, bind, listen and connect
+#include <sys/time.h>            ///< For timeval
+#include <thread>                ///< For std::thread
+#include <unistd.h>              ///< For close
+#include "TestCheck.hpp"
+#include "BinaryProtocol.hpp"
+#include "EventLoop.hpp"
+#include "PCControl.hpp"
+#include "Server.hpp"
+
+using namespace App;
+constexpr uint16_t UNKNOWN_COMMAND_ID{9999};   ///< Never handed out by the registry
+
+/**
+ * @brief Open a listening socket on a free loopback port
+ * @param port Set to the chosen port
+ */
+int openListeningSocket(uint16_t& port)
+{
+    int ListeningFileDescriptor = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    sockaddr_in Address{};
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(ListeningFileDescriptor, reinterpret_cast<sockaddr*>(&Address), sizeof(Address));
+    listen(ListeningFileDescriptor, 1);
+    socklen_t AddressLength = sizeof(Address);
+    getsockname(ListeningFileDescriptor, reinterpret_cast<sockaddr*>(&Address), &AddressLength);
+    port = ntohs(Address.sin_port);
+    return ListeningFileDescriptor;
+}
+
+/**
+ * @brief Read exactly the requested number of bytes
+ * @return The bytes, shorter if the connection closed or the receive timed out
+ */
+std::string readExactly(int fileDescriptor, size_t length)
+{
+    std::string Bytes(length, '\0');
+    size_t Offset = 0;
+    while(Offset < length)
+    {
+        ssize_t NumberOfReceivedBytes = recv(fileDescriptor, Bytes.data() + Offset, length - Offset, 0);
+        if(NumberOfReceivedBytes <= 0)
+        {
+            break;
+        }
+        Offset += static_cast<size_t>(NumberOfReceivedBytes);
+    }
+    Bytes.resize(Offset);
+    return Bytes;
+}
+
+/**
+ * @brief Headers survive encoding and are sent in network byte order
+ */
+void checkEncoding()
+{
+    std::string Frame;
+    appendBinaryFrame(Frame, BinaryFrameHeader{0x0102, BINARY_FLAG_RESPONSE, 0x03040506, 0}, "ok", 2);
+    CHECK((BINARY_HEADER_SIZE + 2) == Frame.size());
+    CHECK(std::string("\x01\x02\x00\x01\x03\x04\x05\x06\x00\x00\x00\x02ok", 14) == Frame);
+    BinaryFrameHeader Header = decodeBinaryHeader(Frame.data());
+    CHECK((0x0102 == Header.commandID) && (BINARY_FLAG_RESPONSE == Header.flags) && (0x03040506 == Header.requestID) &&
+          (2 == Header.payloadLength));
+}
+
+/**
+ * @brief A client negotiates the protocol, sends split and unknown frames, then a malformed one
+ */
+void checkSession()
+{
+    EventLoop Loop;
+    PCControl Control;
+    Control.insertRequestHandle("probe", []() {});
+    uint16_t Port = 0;
+    Server TestServer(Loop, 0, openListeningSocket(Port));
+    TestServer.attachCommandRegistry(Control);
+    Loop.spawn(TestServer.acceptClientConnections());
+    std::thread LoopThread([&Loop]() { Loop.run(); });
+    int ClientFileDescriptor = socket(AF_INET, SOCK_STREAM, 0);
+    timeval ReceiveTimeout{2, 0};
+    setsockopt(ClientFileDescriptor, SOL_SOCKET, SO_RCVTIMEO, &ReceiveTimeout, sizeof(ReceiveTimeout));
+    sockaddr_in Address{};
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Address.sin_port = htons(Port);
+    CHECK(0 == connect(ClientFileDescriptor, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)));
+    send(ClientFileDescriptor, BINARY_HANDSHAKE_COMMAND, sizeof(BINARY_HANDSHAKE_COMMAND) - 1, 0);
+    std::string HeaderBytes = readExactly(ClientFileDescriptor, BINARY_HEADER_SIZE);
+    BinaryFrameHeader Handshake = decodeBinaryHeader(HeaderBytes.data());
+    CHECK((BINARY_HEADER_SIZE == HeaderBytes.size()) && ((BINARY_FLAG_RESPONSE | BINARY_FLAG_HANDSHAKE) == Handshake.flags));
+    std::istringstream CommandTable(readExactly(ClientFileDescriptor, Handshake.payloadLength));
+    uint16_t ProbeID = UNKNOWN_COMMAND_ID;
+    uint16_t CommandID = 0;
+    std::string Command;
+    while(CommandTable >> CommandID >> Command)
+    {
+        ProbeID = ("probe" == Command) ? CommandID : ProbeID;
+    }
+    CHECK((UNKNOWN_COMMAND_ID != ProbeID) && ("probe" == Control.getCommandName(ProbeID)));
+    // The header of the first frame is cut in the middle, the server keeps the partial bytes
+    std::string Frames;
+    appendBinaryFrame(Frames, BinaryFrameHeader{ProbeID, 0, 7, 0});
+    appendBinaryFrame(Frames, BinaryFrameHeader{UNKNOWN_COMMAND_ID, 0, 8, 0});
+    send(ClientFileDescriptor, Frames.data(), 5, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    send(ClientFileDescriptor, Frames.data() + 5, Frames.size() - 5, 0);
+    std::string Responses = readExactly(ClientFileDescriptor, 2 * BINARY_HEADER_SIZE);
+    CHECK((2 * BINARY_HEADER_SIZE) == Responses.size());
+    if((2 * BINARY_HEADER_SIZE) == Responses.size())
+    {
+        BinaryFrameHeader Acknowledgment = decodeBinaryHeader(Responses.data());
+        BinaryFrameHeader Error = decodeBinaryHeader(Responses.data() + BINARY_HEADER_SIZE);
+        CHECK((ProbeID == Acknowledgment.commandID) && (BINARY_FLAG_RESPONSE == Acknowledgment.flags) && (7 == Acknowledgment.requestID));
+        CHECK(((BINARY_FLAG_RESPONSE | BINARY_FLAG_ERROR) == Error.flags) && (8 == Error.requestID));
+    }
+    Request QueuedRequest;
+    CHECK(TestServer.tryGetNextRequest(QueuedRequest) && ("probe" == QueuedRequest.command) && (7 == QueuedRequest.clientRequestID));
+    CHECK(!TestServer.tryGetNextRequest(QueuedRequest));
+    // Flags a client never sends
+    std::string Malformed;
+    appendBinaryFrame(Malformed, BinaryFrameHeader{ProbeID, BINARY_FLAG_ERROR, 9, 0});
+    send(ClientFileDescriptor, Malformed.data(), Malformed.size(), 0);
+    char Byte;
+    CHECK(0 == recv(ClientFileDescriptor, &Byte, 1, 0));
+    close(ClientFileDescriptor);
+    Loop.stop();
+    LoopThread.join();
+}
+
+int main()
+{
+    checkEncoding();
+    checkSession();
+    return reportChecks("BinaryProtocolTest");
+}
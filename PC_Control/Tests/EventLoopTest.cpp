@@ -0,0 +1,141 @@
+/**
+ * @file EventLoopTest.cpp
+ * @brief Checks how the event loop schedules, resumes and stops coroutines
+ *
+ * Coroutines record the order they ran in: yields interleave them, timers
+ * resume them by expiry, awaited tasks hand back their result, a queue pop
+ * resumes on a push from another thread, and stop wakes every waiter with a
+ * failed await so the loop returns.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <chrono>                ///< For std::chrono::milliseconds
+#include <optional>              ///< For std::optional
+#include <string>                ///< For std::string class operations
+#include <thread>                ///< For std::thread
+#include <vector>                ///< For std::vector
+#include "TestCheck.hpp"
+#include "AsyncQueue.hpp"
+#include "EventLoop.hpp"
+
+using namespace App;
+
+/**
+ * @brief Record a step, yield, then record a second step
+ */
+Task<void> yieldTwice(EventLoop& loop, std::string name, std::vector<std::string>& order)
+{
+    order.push_back(name + "1");
+    bool IsRunning = co_await loop.yield();
+    if(!IsRunning)
+    {
+        co_return;
+    }
+    order.push_back(name + "2");
+}
+
+/**
+ * @brief Record the name once the delay has passed
+ */
+Task<void> sleepThenRecord(EventLoop& loop, std::chrono::milliseconds delay, std::string name, std::vector<std::string>& order)
+{
+    bool IsRunning = co_await loop.sleepFor(delay);
+    if(IsRunning)
+    {
+        order.push_back(name);
+    }
+}
+
+/**
+ * @brief Compute a value after a yield, awaited by another coroutine
+ */
+Task<int> computeValue(EventLoop& loop, int value)
+{
+    co_await loop.yield();
+    co_return value * 2;
+}
+
+/**
+ * @brief Await two computed values and store their sum
+ */
+Task<void> sumValues(EventLoop& loop, int& sum)
+{
+    int First = co_await computeValue(loop, 3);
+    int Second = co_await computeValue(loop, 4);
+    sum = First + Second;
+}
+
+/**
+ * @brief Pop items until the loop stops
+ */
+Task<void> consumeQueue(EventLoop& loop, AsyncQueue<int>& queue, std::vector<int>& items, bool& isStopSeen)
+{
+    while(true)
+    {
+        std::optional<int> Item = co_await queue.pop(loop);
+        if(!Item)
+        {
+            isStopSeen = true;
+            co_return;
+        }
+        items.push_back(*Item);
+    }
+}
+
+/**
+ * @brief Yields interleave coroutines, timers resume them by expiry and awaited tasks return their value
+ */
+void checkScheduling()
+{
+    EventLoop Loop;
+    std::vector<std::string> Order;
+    int Sum = 0;
+    Loop.spawn(yieldTwice(Loop, "a", Order));
+    Loop.spawn(yieldTwice(Loop, "b", Order));
+    Loop.spawn(sleepThenRecord(Loop, std::chrono::milliseconds(30), "late", Order));
+    Loop.spawn(sleepThenRecord(Loop, std::chrono::milliseconds(10), "early", Order));
+    Loop.spawn(sumValues(Loop, Sum));
+    // Returns once every spawned coroutine has finished
+    Loop.run();
+    CHECK((std::vector<std::string>{"a1", "b1", "a2", "b2", "early", "late"} == Order));
+    CHECK(14 == Sum);
+}
+
+/**
+ * @brief A pop resumes on pushes from another thread and ends with the loop
+ */
+void checkQueueAndStop()
+{
+    EventLoop Loop;
+    AsyncQueue<int> Queue;
+    std::vector<int> Items;
+    std::vector<std::string> Order;
+    bool IsStopSeen = false;
+    Loop.spawn(consumeQueue(Loop, Queue, Items, IsStopSeen));
+    Loop.spawn(sleepThenRecord(Loop, std::chrono::hours(1), "never", Order));
+    std::thread Producer([&Loop, &Queue]()
+    {
+        for(int Item = 1; Item <= 3; Item++)
+        {
+            Queue.push(Item);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        Loop.stop();
+    });
+    Loop.run();
+    Producer.join();
+    CHECK((std::vector<int>{1, 2, 3} == Items));
+    CHECK(IsStopSeen);
+    CHECK(Order.empty());
+    CHECK(0 == Queue.size());
+}
+
+int main()
+{
+    checkScheduling();
+    checkQueueAndStop();
+    return reportChecks("EventLoopTest");
+}
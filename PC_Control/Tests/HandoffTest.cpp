@@ -0,0 +1,141 @@
+/**
+ * @file HandoffTest.cpp
+ * @brief Checks that a successor answers the requests handed off with their connections
+ *
+ * A socket pair stands in for a client connection of the previous process.
+ * The successor adopts it together with the pending requests, completes
+ * them and the client end must read every result, with and without a
+ * journal replaying the requests.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <cstdio>                ///< For std::remove
+#include <string>                ///< For std::string class operations
+#include <netinet/in.h>          ///< For sockaddr_in
+#include <sys/socket.h>          ///< For socket, socketpair and listen
+#include <unistd.h>              ///< For close
+#include "TestCheck.hpp"
+#include "EventLoop.hpp"
+#include "RequestJournal.hpp"
+#include "RestartHandoff.hpp"
+#include "Server.hpp"
+#include "SubscriptionHub.hpp"
+
+using namespace App;
+constexpr uint32_t HANDED_OFF_CONNECTION_ID{7};    ///< Connection continued by the successor
+constexpr uint32_t CLOSED_CONNECTION_ID{9};        ///< Connection the previous process closed before the handoff
+const std::string JOURNAL_FILE{"HandoffTest.wal"};  ///< Journal replaying the handed off requests
+const std::string EXPECTED_REPLIES{"open_browser: ok\nclose_browser: ok\n"};
+
+/**
+ * @brief Open a listening socket on a free port, stands in for the inherited one
+ */
+int openListeningSocket()
+{
+    int ListeningFileDescriptor = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    sockaddr_in Address{};
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(ListeningFileDescriptor, reinterpret_cast<sockaddr*>(&Address), sizeof(Address));
+    listen(ListeningFileDescriptor, 1);
+    return ListeningFileDescriptor;
+}
+
+/**
+ * @brief Complete every queued request and read the replies on the client end
+ */
+Task<void> completeHandedOffRequests(EventLoop& loop, Server& server, int clientFileDescriptor, std::string& received)
+{
+    Request HandedOffRequest;
+    while(server.tryGetNextRequest(HandedOffRequest))
+    {
+        server.completeRequest(HandedOffRequest, true, HandedOffRequest.command + ": ok");
+    }
+    char Buffer[256];
+    while(received.size() < EXPECTED_REPLIES.size())
+    {
+        ssize_t NumberOfReceivedBytes = co_await loop.receive(clientFileDescriptor, Buffer, sizeof(Buffer));
+        if(NumberOfReceivedBytes <= 0)
+        {
+            break;
+        }
+        received.append(Buffer, static_cast<size_t>(NumberOfReceivedBytes));
+    }
+    loop.stop();
+}
+
+/**
+ * @brief Stop the loop if the replies never arrive
+ */
+Task<void> stopAfterTimeout(EventLoop& loop)
+{
+    bool IsRunning = co_await loop.sleepFor(std::chrono::seconds(2));
+    if(IsRunning)
+    {
+        loop.stop();
+    }
+}
+
+/**
+ * @brief Hand a connection with pending requests to a new server and collect what its client reads
+ * @param isJournaled The requests reach the successor through its journal instead of the handoff
+ */
+std::string continueHandedOffConnection(bool isJournaled)
+{
+    std::vector<Request> PendingRequests(3);
+    PendingRequests[0].id = 1;
+    PendingRequests[0].command = "open_browser";
+    PendingRequests[0].connectionID = HANDED_OFF_CONNECTION_ID;
+    PendingRequests[1].id = 2;
+    PendingRequests[1].command = "open_browser";
+    PendingRequests[1].connectionID = CLOSED_CONNECTION_ID;
+    PendingRequests[2].id = 3;
+    PendingRequests[2].command = "close_browser";
+    PendingRequests[2].connectionID = HANDED_OFF_CONNECTION_ID;
+    std::remove(JOURNAL_FILE.c_str());
+    if(isJournaled)
+    {
+        // The previous process journaled the requests before it handed off
+        RequestJournal PreviousJournal(JOURNAL_FILE, DurabilityMode::ASYNC);
+        for(const auto& PendingRequest : PendingRequests)
+        {
+            uint64_t Sequence = 0;
+            PreviousJournal.append(PendingRequest, Sequence);
+        }
+    }
+    int SocketPair[2];
+    socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, SocketPair);
+    RestartHandoff::State State{};
+    State.connections.push_back(RestartHandoff::Connection{SocketPair[0], HANDED_OFF_CONNECTION_ID, 0});
+    State.requests = PendingRequests;
+    std::string Received;
+    {
+        EventLoop Loop;
+        SubscriptionHub Hub(Loop);
+        Server SuccessorServer(Loop, 0, openListeningSocket());
+        SuccessorServer.attachSubscriptionHub(Hub);
+        std::unique_ptr<RequestJournal> Journal;
+        if(isJournaled)
+        {
+            Journal = std::make_unique<RequestJournal>(JOURNAL_FILE, DurabilityMode::ASYNC);
+            SuccessorServer.attachJournal(*Journal);
+        }
+        SuccessorServer.adoptHandoff(State);
+        Loop.spawn(Hub.run());
+        Loop.spawn(completeHandedOffRequests(Loop, SuccessorServer, SocketPair[1], Received));
+        Loop.spawn(stopAfterTimeout(Loop));
+        Loop.run();
+    }
+    close(SocketPair[1]);
+    std::remove(JOURNAL_FILE.c_str());
+    return Received;
+}
+
+int main()
+{
+    CHECK(EXPECTED_REPLIES == continueHandedOffConnection(false));
+    CHECK(EXPECTED_REPLIES == continueHandedOffConnection(true));
+    return reportChecks("HandoffTest");
+}
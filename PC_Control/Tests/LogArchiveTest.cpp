@@ -0,0 +1,153 @@
+/**
+ * @file LogArchiveTest.cpp
+ * @brief Checks the LZ block round-trip and reading archived segments back by time range
+ *
+ * Blocks of text, runs and random bytes decompress to their input and
+ * damaged blocks are refused. A segment spanning several frames is archived,
+ * read back whole and by time range through the index, and still read after
+ * a crash cut off the index.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <cstdio>                ///< For std::remove
+#include <filesystem>            ///< For std::filesystem::exists, resize_file and file_size
+#include <fstream>               ///< For std::ofstream
+#include <limits>                ///< For std::numeric_limits
+#include <random>                ///< For std::mt19937
+#include <sstream>               ///< For std::ostringstream
+#include <string>                ///< For std::string class operations
+#include <string_view>           ///< For std::string_view
+#include <vector>                ///< For std::vector
+#include "TestCheck.hpp"
+#include "LogArchive.hpp"
+
+using namespace App;
+const std::string SEGMENT_FILE{"LogArchiveTest.log"};   ///< Segment archived by the test
+constexpr int SEGMENT_MINUTES{60};                      ///< Minutes of records in the segment
+constexpr int RECORDS_PER_MINUTE{60};                   ///< One record per second
+constexpr int RANGE_LINE_COUNT{RECORDS_PER_MINUTE + 3}; ///< Lines of a minute, three of its records span two lines
+
+/**
+ * @brief Compress and decompress a block
+ * @return True if the block came back unchanged
+ */
+bool roundTrip(const std::string& block, size_t& compressedSize)
+{
+    std::string Compressed;
+    LogArchive::compressBlock(block.data(), block.size(), Compressed);
+    compressedSize = Compressed.size();
+    std::string Decompressed;
+    return LogArchive::decompressBlock(Compressed.data(), Compressed.size(), block.size(), Decompressed) && (block == Decompressed);
+}
+
+/**
+ * @brief Text, runs, random and empty blocks round-trip, damaged blocks are refused
+ */
+void checkBlocks()
+{
+    size_t CompressedSize = 0;
+    std::string Text;
+    while(Text.size() < LOG_ARCHIVE_BLOCK_SIZE)
+    {
+        Text += "[2025-01-01 12:00:00] [INFO] Received message: open_browser\n";
+    }
+    Text.resize(LOG_ARCHIVE_BLOCK_SIZE);
+    CHECK(roundTrip(Text, CompressedSize) && (CompressedSize < (Text.size() / 4)));
+    // A match overlapping the bytes it copies
+    CHECK(roundTrip(std::string(1000, 'a'), CompressedSize));
+    std::mt19937 Generator{42};
+    std::string Random(LOG_ARCHIVE_BLOCK_SIZE, '\0');
+    for(char& Byte : Random)
+    {
+        Byte = static_cast<char>(Generator());
+    }
+    CHECK(roundTrip(Random, CompressedSize));
+    CHECK(roundTrip("abc", CompressedSize) && roundTrip("", CompressedSize));
+    std::string Compressed;
+    LogArchive::compressBlock(Text.data(), Text.size(), Compressed);
+    std::string Decompressed;
+    CHECK(!LogArchive::decompressBlock(Compressed.data(), Compressed.size(), Text.size() - 1, Decompressed));
+    CHECK(!LogArchive::decompressBlock(Compressed.data(), Compressed.size() / 2, Text.size(), Decompressed));
+}
+
+/**
+ * @brief Only a leading "YYYY-MM-DD HH:MM:SS" is a timestamp
+ */
+void checkTimestamps()
+{
+    CHECK(20250102030405 == LogArchive::parseTimestamp("2025-01-02 03:04:05] [INFO] text"));
+    CHECK(LOG_ARCHIVE_NO_TIMESTAMP == LogArchive::parseTimestamp("2025-01-02T03:04:05"));
+    CHECK(LOG_ARCHIVE_NO_TIMESTAMP == LogArchive::parseTimestamp("continued line"));
+}
+
+/**
+ * @brief Read the records of a time range
+ */
+std::vector<std::string> readRecords(const LogArchiveReader& reader, int64_t from, int64_t to, bool& isRead)
+{
+    std::vector<std::string> Records;
+    isRead = reader.readRange(from, to, [&Records](std::string_view record) { Records.emplace_back(record); });
+    return Records;
+}
+
+/**
+ * @brief An archived segment reads back whole, by range and without its index
+ */
+void checkSegment()
+{
+    std::vector<std::string> Lines;
+    std::vector<std::string> RangeLines;
+    for(int Minute = 0; Minute < SEGMENT_MINUTES; Minute++)
+    {
+        for(int Second = 0; Second < RECORDS_PER_MINUTE; Second++)
+        {
+            std::ostringstream Line;
+            Line << "[2025-01-01 10:" << (Minute < 10 ? "0" : "") << Minute << ':' << (Second < 10 ? "0" : "") << Second
+                 << "] [INFO] Request " << (Minute * RECORDS_PER_MINUTE + Second) << " handled in " << (Second * 37 % 101) << " us";
+            Lines.push_back(Line.str());
+            // A record spanning two lines, the second one has no timestamp
+            if(0 == (Second % 20))
+            {
+                Lines.push_back("    continued by a line without timestamp");
+            }
+        }
+        if((30 == Minute) || (31 == Minute))
+        {
+            RangeLines.insert(RangeLines.end(), Lines.end() - RANGE_LINE_COUNT, Lines.end());
+        }
+    }
+    {
+        std::ofstream Segment(SEGMENT_FILE, std::ios::binary | std::ios::trunc);
+        for(const std::string& Line : Lines)
+        {
+            Segment << Line << '\n';
+        }
+    }
+    std::string ArchivePath = SEGMENT_FILE + LOG_ARCHIVE_EXTENSION;
+    CHECK(LogArchive::compressSegment(SEGMENT_FILE));
+    CHECK(!std::filesystem::exists(SEGMENT_FILE) && std::filesystem::exists(ArchivePath));
+    LogArchiveReader Reader(ArchivePath);
+    CHECK(Reader.open() && (Reader.getFrameCount() > 1));
+    bool IsRead = false;
+    CHECK((Lines == readRecords(Reader, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), IsRead)) && IsRead);
+    // Minutes 30 to 31 inclusive
+    std::vector<std::string> Range = readRecords(Reader, 20250101103000, 20250101103159, IsRead);
+    CHECK(IsRead && (RangeLines == Range));
+    // Cut into the index, the frames are found by scanning
+    std::filesystem::resize_file(ArchivePath, std::filesystem::file_size(ArchivePath) - 4);
+    LogArchiveReader ScanningReader(ArchivePath);
+    CHECK(ScanningReader.open() && (Reader.getFrameCount() == ScanningReader.getFrameCount()));
+    CHECK((Lines == readRecords(ScanningReader, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), IsRead)) && IsRead);
+    std::remove(ArchivePath.c_str());
+    CHECK(!LogArchiveReader("LogArchiveTest.cpp").open());
+}
+
+int main()
+{
+    checkBlocks();
+    checkTimestamps();
+    checkSegment();
+    return reportChecks("LogArchiveTest");
+}
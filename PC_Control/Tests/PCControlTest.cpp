@@ -0,0 +1,52 @@
+/**
+ * @file PCControlTest.cpp
+ * @brief Checks the order, results and error handling of batch requests
+ *
+ * Test commands record the order they ran in and the thread they ran on.
+ * Steps run in order, every command of a step runs on the calling thread,
+ * and --stop-on-error skips the steps after a failed one.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <string>                ///< For std::string class operations
+#include <thread>                ///< For std::this_thread::get_id
+#include <vector>                ///< For std::vector
+#include "TestCheck.hpp"
+#include "PCControl.hpp"
+
+using namespace App;
+
+int main()
+{
+    PCControl Control;
+    std::vector<std::string> ExecutedCommands;
+    bool IsOnCallingThread = true;
+    std::thread::id CallingThread = std::this_thread::get_id();
+    for(const std::string Command : {"first", "second", "third"})
+    {
+        Control.insertRequestHandle(Command, [Command, &ExecutedCommands, &IsOnCallingThread, CallingThread]()
+        {
+            ExecutedCommands.push_back(Command);
+            IsOnCallingThread = IsOnCallingThread && (std::this_thread::get_id() == CallingThread);
+        });
+    }
+    std::string Result;
+    CHECK(Control.handleRequest("  second\n", Result) && ("ok" == Result));
+    ExecutedCommands.clear();
+    CHECK(Control.handleRequest("batch first & second; third", Result));
+    CHECK("first: ok; second: ok; third: ok" == Result);
+    CHECK((std::vector<std::string>{"first", "second", "third"} == ExecutedCommands));
+    CHECK(IsOnCallingThread);
+    // A failed command does not stop the rest of its step, only the later steps with --stop-on-error
+    ExecutedCommands.clear();
+    CHECK(!Control.handleRequest("batch --stop-on-error missing & first; second", Result));
+    CHECK("missing: failed; first: ok; second: skipped" == Result);
+    CHECK((std::vector<std::string>{"first"} == ExecutedCommands));
+    ExecutedCommands.clear();
+    CHECK(!Control.handleRequest("batch missing; second", Result));
+    CHECK("missing: failed; second: ok" == Result);
+    CHECK(!Control.handleRequest("batch  ;  ", Result));
+    return reportChecks("PCControlTest");
+}
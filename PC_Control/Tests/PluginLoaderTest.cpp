@@ -0,0 +1,57 @@
+/**
+ * @file PluginLoaderTest.cpp
+ * @brief Checks loading, reloading and unloading of handler plugins
+ *
+ * Loads the example plugin built by "make test" into Plugins/ of the build
+ * directory. Every version is loaded from an anonymous copy, so no file of
+ * it may appear in the temporary directory.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <filesystem>            ///< For the temporary directory
+#include <string>                ///< For std::string class operations
+#include <unistd.h>              ///< For getpid
+#include "TestCheck.hpp"
+#include "PCControl.hpp"
+#include "PluginLoader.hpp"
+
+using namespace App;
+const std::string PLUGIN_DIRECTORY{"Plugins"};      ///< Holds the example plugin
+const std::string PLUGIN_FILE{"HelloPlugin.so"};    ///< The example plugin
+const std::string PLUGIN_COMMAND{"say_hello"};      ///< Command the example plugin registers
+
+/**
+ * @brief Check if a loaded copy of the plugin was left in the shared temporary directory
+ */
+bool isCopyInTemporaryDirectory()
+{
+    std::string CopyPrefix = "HelloPlugin." + std::to_string(getpid()) + ".";
+    std::error_code ErrorCode;
+    for(const auto& Entry : std::filesystem::directory_iterator(std::filesystem::temp_directory_path(), ErrorCode))
+    {
+        if(0 == Entry.path().filename().string().rfind(CopyPrefix, 0))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main()
+{
+    PCControl Control;
+    PluginLoader Loader(Control, PLUGIN_DIRECTORY);
+    CHECK(!Control.handleRequest(PLUGIN_COMMAND));
+    CHECK(Loader.loadPlugin(PLUGIN_FILE));
+    CHECK(Control.handleRequest(PLUGIN_COMMAND));
+    // A reload maps a new copy while the old one may still run
+    CHECK(Loader.loadPlugin(PLUGIN_FILE));
+    CHECK(Control.handleRequest(PLUGIN_COMMAND));
+    CHECK(!isCopyInTemporaryDirectory());
+    CHECK(!Loader.loadPlugin("MissingPlugin.so"));
+    Loader.unloadPlugin(PLUGIN_FILE);
+    CHECK(!Control.handleRequest(PLUGIN_COMMAND));
+    return reportChecks("PluginLoaderTest");
+}
@@ -0,0 +1,98 @@
+/**
+ * @file RcuPointerTest.cpp
+ * @brief Checks that RCU readers keep their object alive while writers publish replacements
+ *
+ * A reader holding a guard keeps seeing the object it started with after an
+ * update, the writer waits for that reader before reclaiming the object, and
+ * readers racing a stream of updates only ever see fully built objects.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <atomic>                ///< For std::atomic
+#include <chrono>                ///< For std::chrono::milliseconds
+#include <memory>                ///< For std::make_unique
+#include <thread>                ///< For std::thread
+#include <vector>                ///< For std::vector
+#include "TestCheck.hpp"
+#include "RcuPointer.hpp"
+
+using namespace App;
+constexpr int UPDATE_COUNT{2000};   ///< Updates published while the readers race them
+
+/**
+ * @brief Object whose two fields must always match, a torn read would show a mismatch
+ */
+struct Pair
+{
+    int first{0};
+    int second{0};
+};
+
+/**
+ * @brief A guard keeps its object while an update waits for it to finish
+ */
+void checkGracePeriod()
+{
+    RcuPointer<Pair> Pointer{std::make_unique<Pair>()};
+    std::atomic<bool> IsUpdated{false};
+    std::thread Writer;
+    {
+        RcuPointer<Pair>::ReadGuard Guard = Pointer.read();
+        Writer = std::thread([&Pointer, &IsUpdated]()
+        {
+            Pointer.update([](Pair& object) { object.first = object.second = 1; });
+            IsUpdated = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        CHECK(!IsUpdated);
+        CHECK((0 == Guard->first) && (0 == Guard->second));
+    }
+    Writer.join();
+    CHECK(IsUpdated);
+    CHECK(1 == Pointer.read()->first);
+}
+
+/**
+ * @brief Readers racing a writer never see a half updated object
+ */
+void checkConcurrentReaders()
+{
+    RcuPointer<Pair> Pointer{std::make_unique<Pair>()};
+    std::atomic<bool> IsDone{false};
+    std::atomic<int> TornReadCount{0};
+    std::vector<std::thread> Readers;
+    for(int Index = 0; Index < 4; Index++)
+    {
+        Readers.emplace_back([&Pointer, &IsDone, &TornReadCount]()
+        {
+            while(!IsDone)
+            {
+                RcuPointer<Pair>::ReadGuard Guard = Pointer.read();
+                if(Guard->first != Guard->second)
+                {
+                    TornReadCount++;
+                }
+            }
+        });
+    }
+    for(int Update = 1; Update <= UPDATE_COUNT; Update++)
+    {
+        Pointer.update([Update](Pair& object) { object.first = object.second = Update; });
+    }
+    IsDone = true;
+    for(std::thread& Reader : Readers)
+    {
+        Reader.join();
+    }
+    CHECK(0 == TornReadCount);
+    CHECK(UPDATE_COUNT == Pointer.read()->second);
+}
+
+int main()
+{
+    checkGracePeriod();
+    checkConcurrentReaders();
+    return reportChecks("RcuPointerTest");
+}
@@ -0,0 +1,49 @@
+/**
+ * @file RequestCaptureTest.cpp
+ * @brief Checks that captured receives read back with their connection, type and bytes
+ *
+ * Text messages and binary frames are recorded, the capture file is read
+ * back in order, and a record cut short by a crash is ignored.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <cstdio>                ///< For std::remove
+#include <filesystem>            ///< For std::filesystem::resize_file and file_size
+#include <string>                ///< For std::string class operations
+#include "TestCheck.hpp"
+#include "RequestCapture.hpp"
+
+using namespace App;
+const std::string CAPTURE_FILE{"RequestCaptureTest.cap"};  ///< Capture of every test case
+const std::string BINARY_FRAME{"\x00\x01\x00\x00\x00\x00\x00\x07\x00\x00\x00\x00", 12};  ///< Frame bytes with zeros
+
+int main()
+{
+    std::remove(CAPTURE_FILE.c_str());
+    {
+        RequestCapture Capture(CAPTURE_FILE);
+        Capture.record(3, CaptureRecordType::TEXT, "subscribe completions\n", 22);
+        Capture.record(4, CaptureRecordType::BINARY, BINARY_FRAME.data(), BINARY_FRAME.size());
+        Capture.record(3, CaptureRecordType::TEXT, "status", 6);
+        CHECK(3 == Capture.getRecordCount());
+    }
+    std::vector<RequestCapture::CapturedMessage> Messages;
+    CHECK(RequestCapture::readFile(CAPTURE_FILE, Messages));
+    CHECK(3 == Messages.size());
+    CHECK((3 == Messages.size()) && (3 == Messages[0].connectionID) && (CaptureRecordType::TEXT == Messages[0].type) &&
+          ("subscribe completions\n" == Messages[0].data));
+    CHECK((3 == Messages.size()) && (4 == Messages[1].connectionID) && (CaptureRecordType::BINARY == Messages[1].type) &&
+          (BINARY_FRAME == Messages[1].data));
+    CHECK((3 == Messages.size()) && ("status" == Messages[2].data) && (Messages[2].timestamp >= Messages[0].timestamp));
+    // A crash in the middle of the last record leaves it incomplete
+    std::filesystem::resize_file(CAPTURE_FILE, std::filesystem::file_size(CAPTURE_FILE) - 2);
+    Messages.clear();
+    CHECK(RequestCapture::readFile(CAPTURE_FILE, Messages));
+    CHECK(2 == Messages.size());
+    // Not a capture file
+    CHECK(!RequestCapture::readFile("RequestCaptureTest.cpp", Messages));
+    std::remove(CAPTURE_FILE.c_str());
+    return reportChecks("RequestCaptureTest");
+}
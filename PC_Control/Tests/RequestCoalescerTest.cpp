@@ -0,0 +1,78 @@
+/**
+ * @file RequestCoalescerTest.cpp
+ * @brief Checks which duplicates the coalescer merges and that they get the shared result
+ *
+ * Idempotent duplicates of a pending request are merged into its ticket and
+ * handed back on completion, so every merged client receives the result.
+ * Other requests, duplicates beyond the window and requests of a disabled
+ * coalescer get their own tickets.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <chrono>                ///< For std::chrono::milliseconds
+#include <string>                ///< For std::string class operations
+#include <thread>                ///< For std::this_thread::sleep_for
+#include <vector>                ///< For std::vector
+#include "TestCheck.hpp"
+#include "RequestCoalescer.hpp"
+
+using namespace App;
+constexpr std::chrono::milliseconds TEST_WINDOW{50};   ///< Short enough for the test to wait past it
+
+/**
+ * @brief Build a request of a connection
+ */
+Request makeRequest(const std::string& command, uint32_t connectionID)
+{
+    Request NewRequest{};
+    NewRequest.command = command;
+    NewRequest.connectionID = connectionID;
+    return NewRequest;
+}
+
+/**
+ * @brief Idempotent duplicates share the first ticket and come back with its completion
+ */
+void checkMergedResults()
+{
+    RequestCoalescer Coalescer(true, TEST_WINDOW);
+    RequestCoalescer::Ticket First = Coalescer.submit(makeRequest("status", 1), true);
+    RequestCoalescer::Ticket Second = Coalescer.submit(makeRequest("status", 2), true);
+    RequestCoalescer::Ticket Third = Coalescer.submit(makeRequest("status", 3), true);
+    RequestCoalescer::Ticket Other = Coalescer.submit(makeRequest("open_browser", 4), true);
+    CHECK(!First.isCoalesced && Second.isCoalesced && Third.isCoalesced && !Other.isCoalesced);
+    CHECK((First.id == Second.id) && (First.id == Third.id) && (First.id != Other.id));
+    CHECK((4 == Coalescer.getSubmittedCount()) && (2 == Coalescer.getCoalescedCount()));
+    std::vector<Request> MergedRequests = Coalescer.complete(First.id);
+    CHECK((2 == MergedRequests.size()) && (2 == MergedRequests[0].connectionID) && (3 == MergedRequests[1].connectionID));
+    CHECK(Coalescer.complete(Other.id).empty());
+    // A completed ticket takes no more duplicates
+    CHECK(!Coalescer.submit(makeRequest("status", 5), true).isCoalesced);
+}
+
+/**
+ * @brief Requests that are not idempotent, too old to join or submitted while disabled run on their own
+ */
+void checkSeparateTickets()
+{
+    RequestCoalescer Coalescer(true, TEST_WINDOW);
+    RequestCoalescer::Ticket First = Coalescer.submit(makeRequest("open_browser", 1), false);
+    CHECK(!Coalescer.submit(makeRequest("open_browser", 2), false).isCoalesced);
+    RequestCoalescer::Ticket Old = Coalescer.submit(makeRequest("status", 3), true);
+    std::this_thread::sleep_for(TEST_WINDOW * 2);
+    RequestCoalescer::Ticket Late = Coalescer.submit(makeRequest("status", 4), true);
+    CHECK(!Late.isCoalesced && (Late.id != Old.id) && (Late.id != First.id));
+    RequestCoalescer DisabledCoalescer(false, TEST_WINDOW);
+    DisabledCoalescer.submit(makeRequest("status", 1), true);
+    CHECK(!DisabledCoalescer.submit(makeRequest("status", 2), true).isCoalesced);
+    CHECK(0 == DisabledCoalescer.getCoalescedCount());
+}
+
+int main()
+{
+    checkMergedResults();
+    checkSeparateTickets();
+    return reportChecks("RequestCoalescerTest");
+}
@@ -0,0 +1,126 @@
+/**
+ * @file RequestJournalTest.cpp
+ * @brief Checks the recovery, CRC check and overflow handling of the request journal
+ *
+ * Requests are journaled, some completed, and a second journal opened on
+ * the same file must recover exactly the pending ones. A record whose bytes
+ * were damaged ends the recovery, and a journal full of pending requests
+ * refuses new ones instead of losing accepted ones.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <cstdio>                ///< For std::remove
+#include <fstream>               ///< For std::fstream
+#include <iterator>              ///< For std::istreambuf_iterator
+#include <string>                ///< For std::string class operations
+#include "TestCheck.hpp"
+#include "RequestJournal.hpp"
+
+using namespace App;
+const std::string JOURNAL_FILE{"RequestJournalTest.wal"};  ///< Journal of every test case
+constexpr size_t LARGE_COMMAND_SIZE{1000};                 ///< Command length that fills the journal in a few thousand records
+
+/**
+ * @brief Journal a request with the given identifier and command
+ */
+bool appendRequest(RequestJournal& journal, uint64_t requestID, const std::string& command)
+{
+    Request JournaledRequest{};
+    JournaledRequest.id = requestID;
+    JournaledRequest.command = command;
+    uint64_t Sequence = 0;
+    return journal.append(JournaledRequest, Sequence);
+}
+
+/**
+ * @brief Only the requests without a completion marker are recovered, in arrival order
+ */
+void checkRecovery()
+{
+    std::remove(JOURNAL_FILE.c_str());
+    {
+        RequestJournal Journal(JOURNAL_FILE, DurabilityMode::ASYNC);
+        CHECK(appendRequest(Journal, 1, "open_browser"));
+        CHECK(appendRequest(Journal, 2, "status"));
+        CHECK(appendRequest(Journal, 3, "close_browser"));
+        Journal.complete(2);
+    }
+    RequestJournal RecoveredJournal(JOURNAL_FILE, DurabilityMode::ASYNC);
+    std::vector<Request> PendingRequests = RecoveredJournal.getPendingRequests();
+    CHECK(2 == PendingRequests.size());
+    CHECK((2 == PendingRequests.size()) && (1 == PendingRequests[0].id) && ("open_browser" == PendingRequests[0].command));
+    CHECK((2 == PendingRequests.size()) && (3 == PendingRequests[1].id) && ("close_browser" == PendingRequests[1].command));
+    CHECK(3 == RecoveredJournal.getLargestRequestID());
+}
+
+/**
+ * @brief A damaged record fails its CRC and ends the recovery, the records before it survive
+ */
+void checkDamagedRecord()
+{
+    std::remove(JOURNAL_FILE.c_str());
+    {
+        RequestJournal Journal(JOURNAL_FILE, DurabilityMode::ASYNC);
+        CHECK(appendRequest(Journal, 1, "open_browser"));
+        CHECK(appendRequest(Journal, 2, "close_browser"));
+    }
+    {
+        // Damage one payload byte of the second record, as a torn write would
+        std::fstream JournalFile(JOURNAL_FILE, std::ios::in | std::ios::out | std::ios::binary);
+        std::string Contents{std::istreambuf_iterator<char>(JournalFile), std::istreambuf_iterator<char>()};
+        size_t PayloadOffset = Contents.find("close_browser");
+        CHECK(std::string::npos != PayloadOffset);
+        JournalFile.seekp(static_cast<std::streamoff>(PayloadOffset));
+        JournalFile.put('C');
+    }
+    RequestJournal RecoveredJournal(JOURNAL_FILE, DurabilityMode::ASYNC);
+    std::vector<Request> PendingRequests = RecoveredJournal.getPendingRequests();
+    CHECK((1 == PendingRequests.size()) && (1 == PendingRequests[0].id));
+}
+
+/**
+ * @brief A journal full of pending requests refuses new ones, completions make room again
+ */
+void checkOverflow()
+{
+    std::remove(JOURNAL_FILE.c_str());
+    std::string LargeCommand(LARGE_COMMAND_SIZE, 'x');
+    uint64_t AcceptedCount = 0;
+    {
+        RequestJournal Journal(JOURNAL_FILE, DurabilityMode::ASYNC);
+        while(appendRequest(Journal, AcceptedCount + 1, LargeCommand))
+        {
+            AcceptedCount++;
+        }
+        CHECK(AcceptedCount > 0);
+        CHECK(1 == Journal.getRefusedCount());
+        // Still refused, nothing completed
+        CHECK(!appendRequest(Journal, AcceptedCount + 1, LargeCommand));
+        CHECK(2 == Journal.getRefusedCount());
+    }
+    {
+        // Every accepted request survives, none was dropped by a compaction
+        RequestJournal Journal(JOURNAL_FILE, DurabilityMode::ASYNC);
+        CHECK(AcceptedCount == Journal.getPendingRequests().size());
+        Journal.complete(1);
+        Journal.complete(2);
+        // The compaction drops the completed requests and the new one fits
+        CHECK(appendRequest(Journal, AcceptedCount + 1, "status"));
+        CHECK(0 == Journal.getRefusedCount());
+    }
+    RequestJournal RecoveredJournal(JOURNAL_FILE, DurabilityMode::ASYNC);
+    std::vector<Request> PendingRequests = RecoveredJournal.getPendingRequests();
+    CHECK((AcceptedCount - 1) == PendingRequests.size());
+    CHECK(!PendingRequests.empty() && (3 == PendingRequests.front().id) && ("status" == PendingRequests.back().command));
+}
+
+int main()
+{
+    checkRecovery();
+    checkDamagedRecord();
+    checkOverflow();
+    std::remove(JOURNAL_FILE.c_str());
+    return reportChecks("RequestJournalTest");
+}
@@ -0,0 +1,121 @@
+/**
+ * @file RequestSchedulerTest.cpp
+ * @brief Checks the priority order, aging, deadlines and options parsing of the scheduler
+ *
+ * Requests are pushed in classes and popped back: higher classes run first,
+ * a request waiting past the aging threshold overtakes them, a request past
+ * its deadline expires instead of running, and every dispatch shows up in
+ * the queueing histogram of its class.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <chrono>                ///< For std::chrono::milliseconds
+#include <string>                ///< For std::string class operations
+#include <thread>                ///< For std::this_thread::sleep_for
+#include <vector>                ///< For std::vector
+#include "TestCheck.hpp"
+#include "Metrics.hpp"
+#include "RequestScheduler.hpp"
+
+using namespace App;
+constexpr std::chrono::milliseconds TEST_AGING_THRESHOLD{50};   ///< Short enough for the test to wait past it
+
+/**
+ * @brief Push a request with the given command
+ */
+void push(RequestScheduler& scheduler, uint64_t ticketID, const std::string& command, RequestPriority priority,
+          std::chrono::milliseconds deadline = std::chrono::milliseconds(0))
+{
+    Request PushedRequest{};
+    PushedRequest.command = command;
+    scheduler.push(ticketID, PushedRequest, priority, deadline);
+}
+
+/**
+ * @brief Pop the next request
+ * @return Its command, empty if none is ready
+ */
+std::string pop(RequestScheduler& scheduler)
+{
+    RequestScheduler::ScheduledRequest Scheduled;
+    return scheduler.pop(Scheduled) ? Scheduled.request.command : std::string{};
+}
+
+/**
+ * @brief Higher classes run first, a class keeps its arrival order
+ */
+void checkPriorityOrder()
+{
+    RequestScheduler Scheduler{TEST_AGING_THRESHOLD};
+    push(Scheduler, 1, "low", RequestPriority::LOW);
+    push(Scheduler, 2, "normal first", RequestPriority::NORMAL);
+    push(Scheduler, 3, "high", RequestPriority::HIGH);
+    push(Scheduler, 4, "normal second", RequestPriority::NORMAL);
+    CHECK(4 == Scheduler.size());
+    CHECK("high" == pop(Scheduler));
+    CHECK("normal first" == pop(Scheduler));
+    CHECK("normal second" == pop(Scheduler));
+    CHECK("low" == pop(Scheduler));
+    CHECK(pop(Scheduler).empty());
+}
+
+/**
+ * @brief A request waiting past the aging threshold overtakes the higher classes
+ */
+void checkAging()
+{
+    RequestScheduler Scheduler{TEST_AGING_THRESHOLD};
+    push(Scheduler, 1, "starved", RequestPriority::LOW);
+    std::this_thread::sleep_for(TEST_AGING_THRESHOLD * 2);
+    push(Scheduler, 2, "high", RequestPriority::HIGH);
+    CHECK("starved" == pop(Scheduler));
+    CHECK("high" == pop(Scheduler));
+}
+
+/**
+ * @brief A request past its deadline is reported as expired and never runs
+ */
+void checkDeadline()
+{
+    RequestScheduler Scheduler{TEST_AGING_THRESHOLD};
+    push(Scheduler, 1, "overdue", RequestPriority::HIGH, std::chrono::milliseconds(1));
+    push(Scheduler, 2, "patient", RequestPriority::NORMAL, std::chrono::milliseconds(60000));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK("patient" == pop(Scheduler));
+    std::vector<RequestScheduler::ScheduledRequest> ExpiredRequests = Scheduler.takeExpiredRequests();
+    CHECK((1 == ExpiredRequests.size()) && (1 == ExpiredRequests[0].ticketID));
+    CHECK(Scheduler.takeExpiredRequests().empty());
+}
+
+/**
+ * @brief The options prefix sets the class and deadline, a malformed deadline is ignored
+ */
+void checkRequestOptions()
+{
+    std::string Command = "[high,250] open_browser";
+    RequestScheduler::RequestOptions Options = RequestScheduler::parseRequestOptions(Command);
+    CHECK(Options.hasPriority && (RequestPriority::HIGH == Options.priority) && (std::chrono::milliseconds(250) == Options.deadline));
+    CHECK("open_browser" == Command);
+    Command = "[low,-5] close_browser";
+    Options = RequestScheduler::parseRequestOptions(Command);
+    CHECK(Options.hasPriority && (RequestPriority::LOW == Options.priority) && (0 == Options.deadline.count()));
+    Command = "status";
+    Options = RequestScheduler::parseRequestOptions(Command);
+    CHECK(!Options.hasPriority && ("status" == Command));
+}
+
+int main()
+{
+    checkPriorityOrder();
+    checkAging();
+    checkDeadline();
+    checkRequestOptions();
+    // Every class is exported, with the dispatches of the checks above
+    std::string Snapshot = Metrics::formatPrometheus();
+    CHECK(std::string::npos != Snapshot.find("pccontrol_queueing_latency_seconds_count{class=\"high\"} 2\n"));
+    CHECK(std::string::npos != Snapshot.find("pccontrol_queueing_latency_seconds_count{class=\"normal\"} 3\n"));
+    CHECK(std::string::npos != Snapshot.find("pccontrol_queueing_latency_seconds_count{class=\"low\"} 2\n"));
+    return reportChecks("RequestSchedulerTest");
+}
@@ -0,0 +1,66 @@
+/**
+ * @file ServerTest.cpp
+ * @brief Checks how the server turns received messages into queued requests
+ *
+ * Messages are submitted as a transport would after a receive. Blank
+ * messages queue nothing, commands are queued lowercase and a full message
+ * queue answers new requests busy until a handler takes one.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <cstring>               ///< For strlen
+#include <netinet/in.h>          ///< For sockaddr_in
+#include <string>                ///< For std::string class operations
+#include <sys/socket.h>          ///< For socket, bind and listen
+#include "TestCheck.hpp"
+#include "EventLoop.hpp"
+#include "Metrics.hpp"
+#include "Server.hpp"
+
+using namespace App;
+
+/**
+ * @brief Open a listening socket on a free port so the server never binds the real one
+ */
+int openListeningSocket()
+{
+    int ListeningFileDescriptor = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    sockaddr_in Address{};
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(ListeningFileDescriptor, reinterpret_cast<sockaddr*>(&Address), sizeof(Address));
+    listen(ListeningFileDescriptor, 1);
+    return ListeningFileDescriptor;
+}
+
+/**
+ * @brief Submit a message the way a transport does after a receive
+ * @return The queued command, "busy" if the request was rejected
+ */
+std::string submit(Server& server, const char* message)
+{
+    uint64_t JournalSequence = 0;
+    bool IsRejected = false;
+    std::string Command = server.submitMessage(1, message, strlen(message), JournalSequence, IsRejected);
+    return IsRejected ? std::string{"busy"} : Command;
+}
+
+int main()
+{
+    EventLoop Loop;
+    Server TestServer(Loop, 0, openListeningSocket());
+    CHECK(submit(TestServer, "  \r\n").empty());
+    CHECK("open_browser" == submit(TestServer, "  Open_Browser\r\n"));
+    CHECK(1 == TestServer.getMessageQueue().size());
+    // The limit applies to requests arriving afterwards, the waiting ones stay queued
+    TestServer.setMessageQueueLimit(1);
+    CHECK("busy" == submit(TestServer, "status"));
+    CHECK(std::string::npos != Metrics::formatPrometheus().find("pccontrol_rejected_requests_total 1\n"));
+    Request NextRequest;
+    CHECK(TestServer.tryGetNextRequest(NextRequest) && ("open_browser" == NextRequest.command));
+    CHECK("close_browser" == submit(TestServer, "close_browser"));
+    CHECK(TestServer.tryGetNextRequest(NextRequest) && ("close_browser" == NextRequest.command) && (NextRequest.id > 1));
+    return reportChecks("ServerTest");
+}
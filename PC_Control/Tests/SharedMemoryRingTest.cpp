@@ -0,0 +1,128 @@
+/**
+ * @file SharedMemoryRingTest.cpp
+ * @brief Checks ordering, capacity, closing and corruption detection of the shared memory rings
+ *
+ * A ring is zeroed the way a fresh mapping is. Messages come out in the order
+ * they went in, a full ring and an oversized message are refused, a producer
+ * and consumer on two threads pass more messages than the ring holds through
+ * the futex waits, a closed channel ends a waiting side, and indices scribbled
+ * by a peer are reported as corrupt.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <atomic>                ///< For std::atomic
+#include <chrono>                ///< For std::chrono::milliseconds
+#include <memory>                ///< For std::unique_ptr
+#include <string>                ///< For std::string class operations
+#include <thread>                ///< For std::thread
+#include "TestCheck.hpp"
+#include "SharedMemoryChannel.hpp"
+
+using namespace App;
+constexpr uint32_t TRANSFER_COUNT{SHM_RING_SLOT_COUNT * 8};   ///< Messages passed between the threads
+
+/**
+ * @brief Messages come out in order, a full ring and an oversized message are refused
+ */
+void checkCapacity()
+{
+    std::unique_ptr<SharedMemoryRing> Ring = std::make_unique<SharedMemoryRing>();
+    std::string Message;
+    CHECK(!Ring->tryPop(Message));
+    for(uint32_t Index = 0; Index < SHM_RING_SLOT_COUNT; Index++)
+    {
+        std::string Text = std::to_string(Index);
+        if(!Ring->tryPush(Text.data(), Text.size()))
+        {
+            break;
+        }
+    }
+    CHECK(!Ring->tryPush("full", 4));
+    CHECK(Ring->tryPop(Message) && ("0" == Message));
+    std::string Oversized(SharedMemoryRing::MAX_MESSAGE_SIZE + 1, 'x');
+    CHECK(!Ring->tryPush(Oversized.data(), Oversized.size()));
+    std::string Largest(SharedMemoryRing::MAX_MESSAGE_SIZE, 'y');
+    CHECK(Ring->tryPush(Largest.data(), Largest.size()));
+    uint32_t PoppedCount = 1;
+    bool IsOrdered = true;
+    while(Ring->tryPop(Message))
+    {
+        IsOrdered = IsOrdered && ((PoppedCount < SHM_RING_SLOT_COUNT) ? (std::to_string(PoppedCount) == Message) : (Largest == Message));
+        PoppedCount++;
+    }
+    CHECK(IsOrdered && ((SHM_RING_SLOT_COUNT + 1) == PoppedCount));
+    CHECK(!Ring->isCorrupt());
+}
+
+/**
+ * @brief Blocking push and pop pass more messages than the ring holds, in order
+ */
+void checkTransfer()
+{
+    std::unique_ptr<SharedMemoryRing> Ring = std::make_unique<SharedMemoryRing>();
+    std::atomic<uint32_t> IsClosed{0};
+    std::thread Producer([&Ring, &IsClosed]()
+    {
+        for(uint32_t Index = 0; Index < TRANSFER_COUNT; Index++)
+        {
+            std::string Text = std::to_string(Index);
+            Ring->push(Text.data(), Text.size(), IsClosed);
+        }
+    });
+    std::string Message;
+    uint32_t ReceivedCount = 0;
+    bool IsOrdered = true;
+    while((ReceivedCount < TRANSFER_COUNT) && Ring->pop(Message, IsClosed))
+    {
+        IsOrdered = IsOrdered && (std::to_string(ReceivedCount) == Message);
+        ReceivedCount++;
+    }
+    Producer.join();
+    CHECK(IsOrdered && (TRANSFER_COUNT == ReceivedCount));
+}
+
+/**
+ * @brief Closing the channel ends a consumer waiting on an empty ring
+ */
+void checkClose()
+{
+    std::unique_ptr<SharedMemoryRing> Ring = std::make_unique<SharedMemoryRing>();
+    std::atomic<uint32_t> IsClosed{0};
+    bool IsPopped = true;
+    std::thread Consumer([&Ring, &IsClosed, &IsPopped]()
+    {
+        std::string Message;
+        IsPopped = Ring->pop(Message, IsClosed);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    IsClosed.store(1, std::memory_order_release);
+    Ring->wakeAll();
+    Consumer.join();
+    CHECK(!IsPopped);
+    CHECK(!Ring->push("late", 4, IsClosed));
+}
+
+/**
+ * @brief A tail more than a ring ahead of the head can only come from a misbehaving peer
+ */
+void checkCorruption()
+{
+    std::unique_ptr<SharedMemoryRing> Ring = std::make_unique<SharedMemoryRing>();
+    // The tail index starts the second cache line of the mapping
+    auto* Tail = reinterpret_cast<std::atomic<uint32_t>*>(reinterpret_cast<char*>(Ring.get()) + SHM_CACHE_LINE_SIZE);
+    Tail->store(SHM_RING_SLOT_COUNT);
+    CHECK(!Ring->isCorrupt());
+    Tail->store(SHM_RING_SLOT_COUNT + 1);
+    CHECK(Ring->isCorrupt());
+}
+
+int main()
+{
+    checkCapacity();
+    checkTransfer();
+    checkClose();
+    checkCorruption();
+    return reportChecks("SharedMemoryRingTest");
+}
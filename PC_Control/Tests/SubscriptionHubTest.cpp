@@ -0,0 +1,119 @@
+/**
+ * @file SubscriptionHubTest.cpp
+ * @brief Checks the fan-out policies and the reply limit of the subscription hub
+ *
+ * A socket pair stands in for a subscribed connection. Publications beyond
+ * the queue limit are dropped by the policy of their topic, replies are
+ * never dropped, and a connection whose replies pile up is closed.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <string>                ///< For std::string class operations
+#include <sys/socket.h>          ///< For socketpair and recv
+#include <unistd.h>              ///< For close
+#include <utility>               ///< For std::pair
+#include <vector>                ///< For std::vector
+#include "TestCheck.hpp"
+#include "EventLoop.hpp"
+#include "SubscriptionHub.hpp"
+
+using namespace App;
+constexpr size_t TEST_QUEUE_LIMIT{4};   ///< Small queue limit so the policies apply after a few publications
+
+/**
+ * @brief Read everything the hub wrote until the writer is idle, then stop the loop
+ */
+Task<void> readUntilIdle(EventLoop& loop, SubscriptionHub& hub, const std::shared_ptr<SubscriptionHub::Subscriber>& subscriber,
+                         int clientFileDescriptor, std::string& received)
+{
+    // Let the hub fan the publications out and the writer send them
+    bool IsRunning = co_await loop.sleepFor(std::chrono::milliseconds(50));
+    char Buffer[4096];
+    while(IsRunning)
+    {
+        ssize_t NumberOfReceivedBytes = recv(clientFileDescriptor, Buffer, sizeof(Buffer), MSG_DONTWAIT);
+        if(NumberOfReceivedBytes <= 0)
+        {
+            break;
+        }
+        received.append(Buffer, static_cast<size_t>(NumberOfReceivedBytes));
+    }
+    if(hub.close(subscriber))
+    {
+        close(subscriber->fileDescriptor);
+    }
+    loop.stop();
+}
+
+/**
+ * @brief Publish more than the queue limit before the writer runs and collect what the client reads
+ */
+std::string publishBeyondLimit(Topic topic, const std::vector<std::pair<std::string, std::string>>& publications)
+{
+    int SocketPair[2];
+    socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, SocketPair);
+    std::string Received;
+    {
+        EventLoop Loop;
+        SubscriptionHub Hub(Loop);
+        Hub.setQueueLimit(TEST_QUEUE_LIMIT);
+        auto Subscriber = Hub.createSubscriber(SocketPair[0]);
+        Hub.subscribe(Subscriber, topic);
+        for(const auto& [Text, Key] : publications)
+        {
+            Hub.publish(topic, Text, Key);
+        }
+        // A reply queued meanwhile is never dropped
+        Hub.send(Subscriber, "reply\n");
+        Loop.spawn(Hub.run());
+        Loop.spawn(readUntilIdle(Loop, Hub, Subscriber, SocketPair[1], Received));
+        Loop.run();
+    }
+    close(SocketPair[1]);
+    return Received;
+}
+
+/**
+ * @brief A connection whose replies exceed the limit is closed instead of buffering them
+ */
+void checkReplyLimit()
+{
+    int SocketPair[2];
+    socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, SocketPair);
+    {
+        EventLoop Loop;
+        SubscriptionHub Hub(Loop);
+        auto Subscriber = Hub.createSubscriber(SocketPair[0]);
+        // Queued before the writer runs, as for a client pipelining requests without reading
+        for(size_t Index = 0; Index < SUBSCRIBER_REPLY_LIMIT; Index++)
+        {
+            Hub.send(Subscriber, "ok\n");
+        }
+        CHECK(!Subscriber->isBroken);
+        Hub.send(Subscriber, "ok\n");
+        CHECK(Subscriber->isBroken);
+        // The client end sees the connection end
+        char Buffer[16];
+        CHECK(0 == recv(SocketPair[1], Buffer, sizeof(Buffer), MSG_DONTWAIT));
+        CHECK(Hub.close(Subscriber) == !Subscriber->isWriting);
+    }
+    close(SocketPair[0]);
+    close(SocketPair[1]);
+}
+
+int main()
+{
+    // Results are a history, the oldest waiting ones make room
+    CHECK("reply\ncompletions c\ncompletions d\ncompletions e\ncompletions f\n" ==
+          publishBeyondLimit(Topic::COMPLETIONS, {{"a", ""}, {"b", ""}, {"c", ""}, {"d", ""}, {"e", ""}, {"f", ""}}));
+    // Events beyond the limit are dropped
+    CHECK("reply\nevents a\nevents b\nevents c\nevents d\n" ==
+          publishBeyondLimit(Topic::EVENTS, {{"a", ""}, {"b", ""}, {"c", ""}, {"d", ""}, {"e", ""}, {"f", ""}}));
+    // A newer state of a process replaces the waiting one in its place
+    CHECK("reply\nprocesses p1 stopped\nprocesses p2 started\n" ==
+          publishBeyondLimit(Topic::PROCESS_STATE, {{"p1 started", "p1"}, {"p2 started", "p2"}, {"p1 stopped", "p1"}}));
+    checkReplyLimit();
+    return reportChecks("SubscriptionHubTest");
+}
@@ -0,0 +1,40 @@
+/**
+ * @file TestCheck.hpp
+ * @brief Header file for the checks shared by the unit tests
+ *
+ * Every test is a program of its own. CHECK records a failed condition with
+ * its location and carries on, reportChecks prints the summary and gives the
+ * exit status "make test" stops on.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <iostream>              ///< For std::cout and std::cerr
+
+/**
+ * @namespace Test
+ * @brief Counters of the checks of a test program.
+ */
+namespace Test
+{
+inline int s_checkCount{0};      ///< Checks evaluated
+inline int s_failureCount{0};    ///< Checks that failed
+} // namespace Test
+
+/// Record a failed condition and continue with the next check
+#define CHECK(condition) \
+    do { ::Test::s_checkCount++; if(!(condition)) { ::Test::s_failureCount++; std::cerr << __FILE__ << ':' << __LINE__ << ": CHECK failed: " #condition "\n"; } } while(0)
+
+/**
+ * @brief Print the result of a test program
+ * @param testName Name printed with the result
+ * @return Exit status, 0 if every check passed
+ */
+inline int reportChecks(const char* testName)
+{
+    std::cout << testName << ": " << (Test::s_checkCount - Test::s_failureCount) << '/' << Test::s_checkCount << " checks passed\n";
+    return (0 == Test::s_failureCount) ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file TimerWheelTest.cpp
+ * @brief Checks expiry, cancellation and rescheduling of timers on the wheel
+ *
+ * Timers on the first level and timers cascading down from the coarser ones
+ * fire in deadline order and never early, cancelled timers never fire, a
+ * timer moved later or earlier fires at its new deadline, and a callback may
+ * reschedule its own timer.
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <chrono>                ///< For std::chrono::milliseconds
+#include <string>                ///< For std::string class operations
+#include <vector>                ///< For std::vector
+#include "TestCheck.hpp"
+#include "EventLoop.hpp"
+#include "TimerWheel.hpp"
+
+using namespace App;
+constexpr std::chrono::milliseconds TEST_TICK{1};          ///< Wheel resolution
+constexpr std::chrono::milliseconds TEST_DURATION{400};    ///< Past every deadline of the test
+
+/**
+ * @brief Expiry seen by a callback
+ */
+struct Expiry
+{
+    std::string name;                           ///< Timer that fired
+    std::chrono::milliseconds elapsed{};        ///< Time since the timers were scheduled
+};
+
+/**
+ * @brief Stop the loop once every timer had its chance to fire
+ */
+Task<void> stopAfter(EventLoop& loop, std::chrono::milliseconds delay)
+{
+    co_await loop.sleepFor(delay);
+    loop.stop();
+}
+
+int main()
+{
+    EventLoop Loop;
+    TimerWheel Wheel(Loop, TEST_TICK);
+    std::vector<Expiry> Expiries;
+    EventLoop::Clock::time_point StartTime = EventLoop::Clock::now();
+    auto record = [&Expiries, StartTime](const std::string& name)
+    {
+        Expiries.push_back({name, std::chrono::duration_cast<std::chrono::milliseconds>(EventLoop::Clock::now() - StartTime)});
+    };
+    TimerWheel::Timer Short, Cascaded, Cancelled, Postponed, Advanced, Periodic;
+    int PeriodicCount = 0;
+    Short.setCallback([&record]() { record("short"); });
+    Cascaded.setCallback([&record]() { record("cascaded"); });
+    Cancelled.setCallback([&record]() { record("cancelled"); });
+    Postponed.setCallback([&record]() { record("postponed"); });
+    Advanced.setCallback([&record]() { record("advanced"); });
+    Periodic.setCallback([&Wheel, &Periodic, &PeriodicCount]()
+    {
+        if(++PeriodicCount < 3)
+        {
+            Wheel.schedule(Periodic, std::chrono::milliseconds(10));
+        }
+    });
+    Wheel.schedule(Short, std::chrono::milliseconds(5));
+    // Beyond the first level, it reaches its slot through the coarser wheels
+    Wheel.schedule(Cascaded, std::chrono::milliseconds(200));
+    Wheel.schedule(Cancelled, std::chrono::milliseconds(10));
+    Wheel.schedule(Postponed, std::chrono::milliseconds(10));
+    Wheel.schedule(Postponed, std::chrono::milliseconds(100));
+    Wheel.schedule(Advanced, std::chrono::milliseconds(300));
+    Wheel.schedule(Advanced, std::chrono::milliseconds(20));
+    Wheel.schedule(Periodic, std::chrono::milliseconds(10));
+    CHECK(6 == Wheel.size());
+    Cancelled.cancel();
+    CHECK(!Cancelled.isScheduled() && (5 == Wheel.size()));
+    Loop.spawn(Wheel.run());
+    Loop.spawn(stopAfter(Loop, TEST_DURATION));
+    Loop.run();
+    CHECK(4 == Expiries.size());
+    CHECK((4 == Expiries.size()) && ("short" == Expiries[0].name) && ("advanced" == Expiries[1].name) &&
+          ("postponed" == Expiries[2].name) && ("cascaded" == Expiries[3].name));
+    std::vector<std::chrono::milliseconds> Deadlines{std::chrono::milliseconds(5), std::chrono::milliseconds(20),
+                                                     std::chrono::milliseconds(100), std::chrono::milliseconds(200)};
+    bool IsNeverEarly = true;
+    for(size_t Index = 0; Index < Expiries.size() && Index < Deadlines.size(); Index++)
+    {
+        IsNeverEarly = IsNeverEarly && (Expiries[Index].elapsed >= Deadlines[Index]);
+    }
+    CHECK(IsNeverEarly);
+    CHECK(3 == PeriodicCount);
+    CHECK((0 == Wheel.size()) && (7 == Wheel.getExpiredCount()));
+    return reportChecks("TimerWheelTest");
+}
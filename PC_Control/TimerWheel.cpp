@@ -0,0 +1,203 @@
+/**
+ * @file TimerWheel.cpp
+ * @brief Source file for hierarchical timer wheel
+ *
+ * Provides coarse timers for large numbers of connections: scheduling,
+ * rescheduling and cancelling are O(1) and the wheel is advanced by a
+ * single coroutine on the event loop instead of one loop timer per timer
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <algorithm>         ///< For std::max and std::min
+#include "TimerWheel.hpp"
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+/**
+ * @brief Cancel the timer if it is scheduled
+ */
+void TimerWheel::Timer::cancel()
+{
+    if(nullptr != m_wheel)
+    {
+        m_wheel->m_timerCount--;
+        unlink(*this);
+        m_wheel = nullptr;
+    }
+}
+/**
+ * @brief Constructor to set the loop and the resolution of the wheel
+ * @param loop Loop advancing the wheel
+ * @param tick Resolution, timers expire up to one tick late
+ */
+TimerWheel::TimerWheel(EventLoop& loop, std::chrono::milliseconds tick)
+    : m_loop{loop}, m_tick{std::max<Clock::duration>(tick, std::chrono::milliseconds(1))}, m_startTime{Clock::now()}
+{
+    for(auto& Level : m_slots)
+    {
+        for(auto& CurrentSlot : Level)
+        {
+            CurrentSlot.head.m_previous = &CurrentSlot.head;
+            CurrentSlot.head.m_next = &CurrentSlot.head;
+        }
+    }
+}
+/**
+ * @brief Unlink the remaining timers
+ */
+TimerWheel::~TimerWheel()
+{
+    for(auto& Level : m_slots)
+    {
+        for(auto& CurrentSlot : Level)
+        {
+            while(CurrentSlot.head.m_next != &CurrentSlot.head)
+            {
+                CurrentSlot.head.m_next->cancel();
+            }
+        }
+    }
+}
+/**
+ * @brief Schedule or reschedule a timer
+ * @param timer The timer, must be unscheduled or belong to this wheel
+ * @param delay Time until expiry, rounded up to whole ticks
+ */
+void TimerWheel::schedule(Timer& timer, Clock::duration delay)
+{
+    // Rounded up from now, the wheel may lag behind the clock by a tick; at least one tick ahead,
+    // so a callback rescheduling itself never lands in the slot being run
+    Clock::duration Elapsed = (Clock::now() - m_startTime) + std::max(delay, Clock::duration::zero());
+    uint64_t DeadlineTick = std::max(m_currentTick + 1, static_cast<uint64_t>((Elapsed + m_tick - Clock::duration(1)) / m_tick));
+    if(nullptr != timer.m_wheel)
+    {
+        if(DeadlineTick >= timer.m_slotTick)
+        {
+            // Later deadline, the timer moves once its current slot comes up
+            timer.m_deadlineTick = DeadlineTick;
+            return;
+        }
+        unlink(timer);
+    }
+    else
+    {
+        timer.m_wheel = this;
+        m_timerCount++;
+    }
+    timer.m_deadlineTick = DeadlineTick;
+    link(timer);
+}
+/**
+ * @brief Advance the wheel every tick until the loop stops
+ */
+Task<void> TimerWheel::run()
+{
+    while(true)
+    {
+        bool IsRunning = co_await m_loop.sleepUntil(m_startTime + (m_tick * static_cast<Clock::rep>(m_currentTick + 1)));
+        if(!IsRunning)
+        {
+            co_return;
+        }
+        // Catch up on ticks missed while the loop was busy
+        uint64_t TargetTick = static_cast<uint64_t>((Clock::now() - m_startTime) / m_tick);
+        while(m_currentTick < TargetTick)
+        {
+            advance();
+        }
+    }
+}
+/**
+ * @brief helper function to link a timer into the slot of its deadline
+ */
+void TimerWheel::link(Timer& timer)
+{
+    // Pick the finest level whose range covers the remaining ticks, the last level clamps
+    uint64_t DeadlineTick = timer.m_deadlineTick;
+    uint64_t Remaining = DeadlineTick - m_currentTick;
+    size_t Level = 0;
+    while((Level + 1 < TIMER_WHEEL_LEVELS) && (Remaining >= (uint64_t{1} << (TIMER_WHEEL_SLOT_BITS * (Level + 1)))))
+    {
+        Level++;
+    }
+    uint64_t LevelRange = uint64_t{1} << (TIMER_WHEEL_SLOT_BITS * (Level + 1));
+    uint64_t SlotTick = std::min(DeadlineTick, m_currentTick + LevelRange - 1);
+    if(Level > 0)
+    {
+        // Coarser slots are cascaded at their first tick, always ahead as the deadline is a whole slot away
+        uint64_t LevelTick = uint64_t{1} << (TIMER_WHEEL_SLOT_BITS * Level);
+        SlotTick &= ~(LevelTick - 1);
+    }
+    size_t SlotIndex = static_cast<size_t>((SlotTick >> (TIMER_WHEEL_SLOT_BITS * Level)) & (TIMER_WHEEL_SLOT_COUNT - 1));
+    Timer& Head = m_slots[Level][SlotIndex].head;
+    timer.m_slotTick = SlotTick;
+    timer.m_previous = Head.m_previous;
+    timer.m_next = &Head;
+    Head.m_previous->m_next = &timer;
+    Head.m_previous = &timer;
+}
+/**
+ * @brief helper function to unlink a timer from its slot
+ */
+void TimerWheel::unlink(Timer& timer)
+{
+    timer.m_previous->m_next = timer.m_next;
+    timer.m_next->m_previous = timer.m_previous;
+    timer.m_previous = nullptr;
+    timer.m_next = nullptr;
+}
+/**
+ * @brief helper function to process one tick, cascading coarser slots and running expired timers
+ */
+void TimerWheel::advance()
+{
+    m_currentTick++;
+    // Move the timers of every coarser slot starting at this tick one level down
+    for(size_t Level = TIMER_WHEEL_LEVELS - 1; Level > 0; Level--)
+    {
+        uint64_t LevelTick = uint64_t{1} << (TIMER_WHEEL_SLOT_BITS * Level);
+        if(0 != (m_currentTick & (LevelTick - 1)))
+        {
+            continue;
+        }
+        Timer& Head = m_slots[Level][(m_currentTick >> (TIMER_WHEEL_SLOT_BITS * Level)) & (TIMER_WHEEL_SLOT_COUNT - 1)].head;
+        Timer* Current = Head.m_next;
+        while(Current != &Head)
+        {
+            Timer* Next = Current->m_next;
+            if(Current->m_slotTick <= m_currentTick)
+            {
+                unlink(*Current);
+                link(*Current);
+            }
+            Current = Next;
+        }
+    }
+    Timer& Head = m_slots[0][m_currentTick & (TIMER_WHEEL_SLOT_COUNT - 1)].head;
+    while(Head.m_next != &Head)
+    {
+        Timer& Expired = *Head.m_next;
+        unlink(Expired);
+        if(Expired.m_deadlineTick > m_currentTick)
+        {
+            // Pushed back since it was linked
+            link(Expired);
+            continue;
+        }
+        Expired.m_wheel = nullptr;
+        m_timerCount--;
+        m_expiredCount++;
+        // The callback may reschedule the timer or destroy its owner
+        if(Expired.m_callback)
+        {
+            Expired.m_callback();
+        }
+    }
+}
+} // namespace App
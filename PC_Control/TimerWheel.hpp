@@ -0,0 +1,143 @@
+/**
+ * @file TimerWheel.hpp
+ * @brief Header file for hierarchical timer wheel
+ *
+ * Provides coarse timers for large numbers of connections: scheduling,
+ * rescheduling and cancelling are O(1) and the wheel is advanced by a
+ * single coroutine on the event loop instead of one loop timer per timer
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <array>             ///< For std::array
+#include <chrono>            ///< For std::chrono durations
+#include <cstddef>           ///< For size_t
+#include <cstdint>           ///< For fixed width integer types
+#include <functional>        ///< For std::function
+#include "EventLoop.hpp"
+#include "Task.hpp"
+
+constexpr size_t TIMER_WHEEL_LEVELS{4};         ///< Wheels, each one SLOT_COUNT times coarser than the one below
+constexpr size_t TIMER_WHEEL_SLOT_BITS{6};      ///< log2 of the slots per wheel
+constexpr size_t TIMER_WHEEL_SLOT_COUNT{size_t{1} << TIMER_WHEEL_SLOT_BITS};  ///< Slots per wheel
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @class TimerWheel
+ * @brief Hashed hierarchical timer wheel driven by an event loop
+ *
+ * Timers are intrusive, a timer lives inside the object it guards and costs
+ * two pointers and two ticks. Pushing a deadline back only updates the timer,
+ * it is moved once it reaches the front of the wheel, so touching a timer on
+ * every request is cheap. Loop thread only.
+ */
+class TimerWheel
+{
+    public:
+        using Clock = EventLoop::Clock;
+        /**
+         * @brief A timer, unlinked from the wheel when destroyed
+         */
+        class Timer
+        {
+            public:
+                Timer() = default;
+                Timer(const Timer&) = delete;             ///< Delete copy constructor
+                Timer& operator=(const Timer&) = delete;  ///< Delete copy assignment operator
+                Timer(Timer&&) = delete;                  ///< Delete move constructor
+                Timer& operator=(Timer&&) = delete;       ///< Delete move assignment operator
+                /**
+                 * @brief Cancel the timer
+                 */
+                ~Timer() { cancel(); }
+                /**
+                 * @brief Set the function run on expiry, at most once per schedule
+                 */
+                void setCallback(std::function<void()> callback) { m_callback = std::move(callback); }
+                /**
+                 * @brief Check if the timer is scheduled
+                 */
+                bool isScheduled() const { return nullptr != m_wheel; }
+                /**
+                 * @brief Cancel the timer if it is scheduled
+                 */
+                void cancel();
+            private:
+                friend class TimerWheel;
+                Timer* m_previous{nullptr};          ///< Previous timer in the slot, the slot head for the first
+                Timer* m_next{nullptr};              ///< Next timer in the slot
+                TimerWheel* m_wheel{nullptr};        ///< Wheel holding the timer, nullptr if not scheduled
+                uint64_t m_slotTick{};               ///< Tick of the slot the timer is linked into
+                uint64_t m_deadlineTick{};           ///< Tick the timer expires at, may lie after m_slotTick
+                std::function<void()> m_callback{};  ///< Run on expiry
+        };
+        /**
+         * @brief Constructor to set the loop and the resolution of the wheel
+         * @param loop Loop advancing the wheel
+         * @param tick Resolution, timers expire up to one tick late
+         */
+        TimerWheel(EventLoop& loop, std::chrono::milliseconds tick);
+        TimerWheel(const TimerWheel&) = delete;             ///< Delete copy constructor
+        TimerWheel& operator=(const TimerWheel&) = delete;  ///< Delete copy assignment operator
+        TimerWheel(TimerWheel&&) = delete;                  ///< Delete move constructor
+        TimerWheel& operator=(TimerWheel&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Unlink the remaining timers
+         */
+        ~TimerWheel();
+        /**
+         * @brief Schedule or reschedule a timer
+         * @param timer The timer, must be unscheduled or belong to this wheel
+         * @param delay Time until expiry, rounded up to whole ticks
+         */
+        void schedule(Timer& timer, Clock::duration delay);
+        /**
+         * @brief Advance the wheel every tick until the loop stops
+         */
+        Task<void> run();
+        /**
+         * @brief Get the number of scheduled timers
+         */
+        size_t size() const { return m_timerCount; }
+        /**
+         * @brief Get the number of expired timers
+         */
+        uint64_t getExpiredCount() const { return m_expiredCount; }
+    private:
+        /**
+         * @brief Head of the circular list of a slot
+         */
+        struct Slot
+        {
+            Timer head{};   ///< Sentinel, never scheduled itself
+        };
+        EventLoop& m_loop;                                  ///< Loop advancing the wheel
+        Clock::duration m_tick;                             ///< Resolution
+        Clock::time_point m_startTime;                      ///< Time of tick 0
+        uint64_t m_currentTick{};                           ///< Last processed tick
+        size_t m_timerCount{};                              ///< Scheduled timers
+        uint64_t m_expiredCount{};                          ///< Timers whose callback ran
+        std::array<std::array<Slot, TIMER_WHEEL_SLOT_COUNT>, TIMER_WHEEL_LEVELS> m_slots{};  ///< Slots of every level
+        /**
+         * @brief helper function to link a timer into the slot of its deadline
+         */
+        void link(Timer& timer);
+        /**
+         * @brief helper function to unlink a timer from its slot
+         */
+        static void unlink(Timer& timer);
+        /**
+         * @brief helper function to process one tick, cascading coarser slots and running expired timers
+         */
+        void advance();
+};
+} // namespace App
@@ -0,0 +1,383 @@
+/**
+ * @file LoadDriver.hpp
+ * @brief Header file for the client load driver of the benchmark tools
+ *
+ * Drives many client connections against the server from a single epoll
+ * thread, every connection sends one message at a time and waits for its
+ * acknowledgment, latencies are measured from the intended send time so a
+ * stalled server cannot hide its queueing delay (coordinated omission)
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#pragma once
+
+#include <algorithm>             ///< For std::sort and std::max
+#include <arpa/inet.h>           ///< For inet_pton
+#include <chrono>                ///< For std::chrono::steady_clock
+#include <cstdint>               ///< For fixed width integer types
+#include <cstdio>                ///< For std::printf
+#include <ctime>                 ///< For struct timespec
+#include <functional>            ///< For std::function
+#include <netinet/in.h>          ///< For sockaddr_in
+#include <netinet/tcp.h>         ///< For TCP_NODELAY
+#include <queue>                 ///< For std::priority_queue
+#include <string>                ///< For std::string class operations
+#include <sys/epoll.h>           ///< For epoll_create1, epoll_ctl and epoll_pwait2
+#include <sys/prctl.h>           ///< For PR_SET_TIMERSLACK
+#include <sys/resource.h>        ///< For setrlimit
+#include <sys/socket.h>          ///< For socket, connect, send and recv
+#include <sys/un.h>              ///< For sockaddr_un
+#include <unistd.h>              ///< For close
+#include <utility>               ///< For std::pair
+#include <vector>                ///< For std::vector
+
+constexpr size_t LOAD_RECEIVE_BUFFER_SIZE{4096};    ///< Bytes read from a connection at once
+constexpr int LOAD_MAX_EVENTS{256};                 ///< Readiness events handled per wait
+constexpr char LOAD_UNIX_PREFIX[]{"unix:"};         ///< Host prefix selecting a Unix seqpacket socket path
+
+/**
+ * @namespace App
+ * @brief A collection of various application utilities.
+ */
+namespace App
+{
+
+/**
+ * @brief A message a connection sends at its intended time
+ */
+struct ScheduledMessage
+{
+    uint64_t intendedTime{};    ///< Monotonic nanoseconds the message should leave at
+    std::string payload{};      ///< Bytes sent in one write
+};
+
+/**
+ * @brief Outcome of a load run
+ */
+struct LoadResult
+{
+    uint64_t sentCount{};                      ///< Messages sent
+    uint64_t acknowledgedCount{};              ///< Messages acknowledged
+    uint64_t failedConnections{};              ///< Connections closed or broken during the run
+    double elapsedSeconds{};                   ///< First send to last acknowledgment
+    std::vector<uint64_t> responseLatencies{}; ///< Intended send to acknowledgment in nanoseconds
+    std::vector<uint64_t> serviceLatencies{};  ///< Actual send to acknowledgment in nanoseconds
+};
+
+/**
+ * @class LoadDriver
+ * @brief Sends messages over many connections and measures their acknowledgment latency
+ *
+ * Every acknowledgment of the server ends with a newline, a connection asks the
+ * message source for its next message once the previous one was acknowledged
+ */
+class LoadDriver
+{
+    public:
+        /**
+         * @brief Supplies the next message of a connection
+         * @return False once the connection has nothing more to send
+         */
+        using MessageSource = std::function<bool(size_t connection, uint64_t now, ScheduledMessage& message)>;
+        /**
+         * @brief Constructor to set the target server
+         * @param host IPv4 address, or unix:<path> for the Unix domain listener
+         */
+        LoadDriver(const std::string& host, int port) : m_host{host}, m_port{port} {}
+        LoadDriver(const LoadDriver&) = delete;             ///< Delete copy constructor
+        LoadDriver& operator=(const LoadDriver&) = delete;  ///< Delete copy assignment operator
+        LoadDriver(LoadDriver&&) = delete;                  ///< Delete move constructor
+        LoadDriver& operator=(LoadDriver&&) = delete;       ///< Delete move assignment operator
+        /**
+         * @brief Close the connections
+         */
+        ~LoadDriver()
+        {
+            for(const auto& DriverConnection : m_connections)
+            {
+                close(DriverConnection.fileDescriptor);
+            }
+            if(-1 != m_epollFileDescriptor)
+            {
+                close(m_epollFileDescriptor);
+            }
+        }
+        /**
+         * @brief Open the connections, raising the open file limit as far as allowed
+         * @return False if any connection failed
+         */
+        bool connect(size_t connectionCount)
+        {
+            rlimit FileLimit{};
+            if(0 == getrlimit(RLIMIT_NOFILE, &FileLimit))
+            {
+                FileLimit.rlim_cur = FileLimit.rlim_max;
+                setrlimit(RLIMIT_NOFILE, &FileLimit);
+            }
+            m_epollFileDescriptor = epoll_create1(EPOLL_CLOEXEC);
+            sockaddr_in ServerAddress{};
+            ServerAddress.sin_family = AF_INET;
+            ServerAddress.sin_port = htons(static_cast<uint16_t>(m_port));
+            sockaddr_un UnixAddress{};
+            UnixAddress.sun_family = AF_UNIX;
+            bool IsUnix = (0 == m_host.rfind(LOAD_UNIX_PREFIX, 0));
+            std::string UnixPath = IsUnix ? m_host.substr(sizeof(LOAD_UNIX_PREFIX) - 1) : std::string();
+            if((-1 == m_epollFileDescriptor) || (UnixPath.size() >= sizeof(UnixAddress.sun_path)) ||
+               (!IsUnix && (1 != inet_pton(AF_INET, m_host.c_str(), &ServerAddress.sin_addr))))
+            {
+                return false;
+            }
+            UnixPath.copy(UnixAddress.sun_path, UnixPath.size());
+            sockaddr* Address = IsUnix ? reinterpret_cast<sockaddr*>(&UnixAddress) : reinterpret_cast<sockaddr*>(&ServerAddress);
+            socklen_t AddressLength = IsUnix ? sizeof(UnixAddress) : sizeof(ServerAddress);
+            for(size_t Index = 0; Index < connectionCount; Index++)
+            {
+                // Connect blocking one after another so the server accept queue never overflows
+                int FileDescriptor = IsUnix ? socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0) : socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if((-1 == FileDescriptor) || (-1 == ::connect(FileDescriptor, Address, AddressLength)))
+                {
+                    std::perror("connect");
+                    if(-1 != FileDescriptor)
+                    {
+                        close(FileDescriptor);
+                    }
+                    return false;
+                }
+                if(!IsUnix)
+                {
+                    int NoDelay = 1;
+                    setsockopt(FileDescriptor, IPPROTO_TCP, TCP_NODELAY, &NoDelay, sizeof(NoDelay));
+                }
+                epoll_event Event{};
+                Event.events = EPOLLIN;
+                Event.data.u64 = m_connections.size();
+                epoll_ctl(m_epollFileDescriptor, EPOLL_CTL_ADD, FileDescriptor, &Event);
+                m_connections.push_back(Connection{FileDescriptor});
+            }
+            return true;
+        }
+        /**
+         * @brief Get the number of open connections
+         */
+        size_t getConnectionCount() const { return m_connections.size(); }
+        /**
+         * @brief Send messages until every connection ran out of messages or failed
+         * @param source Supplies the messages, called again after every acknowledgment
+         */
+        LoadResult run(const MessageSource& source)
+        {
+            LoadResult Result{};
+            m_result = &Result;
+            m_source = &source;
+            m_activeCount = 0;
+            // The default 50us timer slack would delay every paced send
+            prctl(PR_SET_TIMERSLACK, 1UL);
+            uint64_t StartTime = now();
+            for(size_t Index = 0; Index < m_connections.size(); Index++)
+            {
+                scheduleNext(Index, StartTime);
+            }
+            epoll_event Events[LOAD_MAX_EVENTS];
+            while(m_activeCount > 0)
+            {
+                uint64_t Now = now();
+                while(!m_sendTimes.empty() && (m_sendTimes.top().first <= Now))
+                {
+                    size_t Index = m_sendTimes.top().second;
+                    m_sendTimes.pop();
+                    sendMessage(Index, Now);
+                }
+                // Sleep until the next intended send, nanosecond timeout so open-loop rates stay exact
+                timespec Timeout{};
+                timespec* WaitTimeout = nullptr;
+                if(!m_sendTimes.empty())
+                {
+                    uint64_t Delay = m_sendTimes.top().first - std::min(m_sendTimes.top().first, now());
+                    Timeout.tv_sec = static_cast<time_t>(Delay / 1000000000ULL);
+                    Timeout.tv_nsec = static_cast<long>(Delay % 1000000000ULL);
+                    WaitTimeout = &Timeout;
+                }
+                int EventCount = epoll_pwait2(m_epollFileDescriptor, Events, LOAD_MAX_EVENTS, WaitTimeout, nullptr);
+                for(int EventIndex = 0; EventIndex < EventCount; EventIndex++)
+                {
+                    receiveAcknowledgments(static_cast<size_t>(Events[EventIndex].data.u64));
+                }
+            }
+            if(m_lastAcknowledgmentTime > m_firstSendTime)
+            {
+                Result.elapsedSeconds = static_cast<double>(m_lastAcknowledgmentTime - m_firstSendTime) / 1e9;
+            }
+            m_result = nullptr;
+            m_source = nullptr;
+            return Result;
+        }
+        /**
+         * @brief Get a percentile of sorted latencies
+         * @param percentile Between 0 and 100
+         */
+        static uint64_t getPercentile(const std::vector<uint64_t>& sortedLatencies, double percentile)
+        {
+            if(sortedLatencies.empty())
+            {
+                return 0;
+            }
+            size_t Rank = static_cast<size_t>((percentile / 100.0) * static_cast<double>(sortedLatencies.size() - 1));
+            return sortedLatencies[Rank];
+        }
+        /**
+         * @brief Print throughput and latency percentiles of a run
+         */
+        static void printReport(const std::string& name, LoadResult& result)
+        {
+            std::sort(result.responseLatencies.begin(), result.responseLatencies.end());
+            std::sort(result.serviceLatencies.begin(), result.serviceLatencies.end());
+            double Throughput = (result.elapsedSeconds > 0.0) ? (static_cast<double>(result.acknowledgedCount) / result.elapsedSeconds) : 0.0;
+            std::printf("=== %s RESULTS ===\n", name.c_str());
+            std::printf("Sent: %llu, acknowledged: %llu, failed connections: %llu\n",
+                        static_cast<unsigned long long>(result.sentCount),
+                        static_cast<unsigned long long>(result.acknowledgedCount),
+                        static_cast<unsigned long long>(result.failedConnections));
+            std::printf("Elapsed: %.3f s, throughput: %.0f req/s\n", result.elapsedSeconds, Throughput);
+            std::printf("%-10s %10s %10s %10s %10s %10s\n", "latency", "p50 us", "p90 us", "p99 us", "p999 us", "max us");
+            for(const auto& [Label, Latencies] : {std::pair<const char*, const std::vector<uint64_t>*>{"response", &result.responseLatencies},
+                                                  std::pair<const char*, const std::vector<uint64_t>*>{"service", &result.serviceLatencies}})
+            {
+                std::printf("%-10s %10.1f %10.1f %10.1f %10.1f %10.1f\n", Label,
+                            getPercentile(*Latencies, 50.0) / 1e3, getPercentile(*Latencies, 90.0) / 1e3,
+                            getPercentile(*Latencies, 99.0) / 1e3, getPercentile(*Latencies, 99.9) / 1e3,
+                            Latencies->empty() ? 0.0 : (Latencies->back() / 1e3));
+            }
+        }
+        /**
+         * @brief Monotonic time in nanoseconds
+         */
+        static uint64_t now()
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+    private:
+        /**
+         * @brief State of one client connection
+         */
+        struct Connection
+        {
+            int fileDescriptor{-1};      ///< Connected socket
+            ScheduledMessage message{};  ///< Message in flight
+            uint64_t sendTime{};         ///< Actual send time of the message in flight
+            bool isActive{false};        ///< Has a message scheduled or in flight
+        };
+        using SendTime = std::pair<uint64_t, size_t>;   ///< Intended send time and connection
+        std::string m_host{};                           ///< Server address
+        int m_port{};                                   ///< Server port
+        int m_epollFileDescriptor{-1};                  ///< Readiness of the connections
+        std::vector<Connection> m_connections{};        ///< Client connections
+        std::priority_queue<SendTime, std::vector<SendTime>, std::greater<SendTime>> m_sendTimes{};  ///< Earliest send first
+        size_t m_activeCount{};                         ///< Connections with a message scheduled or in flight
+        uint64_t m_firstSendTime{};                     ///< First send of the run
+        uint64_t m_lastAcknowledgmentTime{};            ///< Last acknowledgment of the run
+        LoadResult* m_result{nullptr};                  ///< Result of the current run
+        const MessageSource* m_source{nullptr};         ///< Message source of the current run
+        /**
+         * @brief Fetch the next message of a connection and send or schedule it
+         */
+        void scheduleNext(size_t index, uint64_t now)
+        {
+            Connection& DriverConnection = m_connections[index];
+            bool HasMessage = (-1 != DriverConnection.fileDescriptor) && (*m_source)(index, now, DriverConnection.message);
+            if(HasMessage != DriverConnection.isActive)
+            {
+                DriverConnection.isActive = HasMessage;
+                HasMessage ? m_activeCount++ : m_activeCount--;
+            }
+            if(!HasMessage)
+            {
+                return;
+            }
+            if(DriverConnection.message.intendedTime <= now)
+            {
+                sendMessage(index, now);
+            }
+            else
+            {
+                m_sendTimes.emplace(DriverConnection.message.intendedTime, index);
+            }
+        }
+        /**
+         * @brief Send the scheduled message of a connection
+         */
+        void sendMessage(size_t index, uint64_t now)
+        {
+            Connection& DriverConnection = m_connections[index];
+            if(-1 == DriverConnection.fileDescriptor)
+            {
+                // Failed while its message was scheduled
+                return;
+            }
+            if(0 == m_firstSendTime)
+            {
+                m_firstSendTime = now;
+            }
+            // Small messages fit the socket buffer, a short write counts as a failure
+            ssize_t SentBytes = send(DriverConnection.fileDescriptor, DriverConnection.message.payload.data(),
+                                     DriverConnection.message.payload.size(), MSG_NOSIGNAL);
+            if(SentBytes != static_cast<ssize_t>(DriverConnection.message.payload.size()))
+            {
+                failConnection(index);
+                return;
+            }
+            DriverConnection.sendTime = now;
+            m_result->sentCount++;
+        }
+        /**
+         * @brief Read the acknowledgments of a connection and move on to its next message
+         */
+        void receiveAcknowledgments(size_t index)
+        {
+            Connection& DriverConnection = m_connections[index];
+            char Buffer[LOAD_RECEIVE_BUFFER_SIZE];
+            ssize_t ReceivedBytes = recv(DriverConnection.fileDescriptor, Buffer, sizeof(Buffer), MSG_DONTWAIT);
+            if(ReceivedBytes <= 0)
+            {
+                if((0 == ReceivedBytes) || ((EAGAIN != errno) && (EWOULDBLOCK != errno)))
+                {
+                    failConnection(index);
+                }
+                return;
+            }
+            uint64_t Now = now();
+            for(ssize_t Offset = 0; Offset < ReceivedBytes; Offset++)
+            {
+                if(('\n' != Buffer[Offset]) || (0 == DriverConnection.sendTime))
+                {
+                    continue;
+                }
+                m_result->acknowledgedCount++;
+                m_result->responseLatencies.push_back(Now - std::min(Now, DriverConnection.message.intendedTime));
+                m_result->serviceLatencies.push_back(Now - DriverConnection.sendTime);
+                m_lastAcknowledgmentTime = Now;
+                DriverConnection.sendTime = 0;
+                scheduleNext(index, Now);
+            }
+        }
+        /**
+         * @brief Stop using a broken connection
+         */
+        void failConnection(size_t index)
+        {
+            Connection& DriverConnection = m_connections[index];
+            m_result->failedConnections++;
+            epoll_ctl(m_epollFileDescriptor, EPOLL_CTL_DEL, DriverConnection.fileDescriptor, nullptr);
+            close(DriverConnection.fileDescriptor);
+            DriverConnection.fileDescriptor = -1;
+            DriverConnection.sendTime = 0;
+            if(DriverConnection.isActive)
+            {
+                DriverConnection.isActive = false;
+                m_activeCount--;
+            }
+        }
+};
+} // namespace App
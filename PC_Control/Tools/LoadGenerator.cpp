@@ -0,0 +1,469 @@
+/**
+ * @file LoadGenerator.cpp
+ * @brief Closed and open-loop load generator and benchmark suite for the server
+ *
+ * Closed loop keeps a fixed number of connections busy, each sending its next
+ * request as soon as the previous one was acknowledged. Open loop sends at a
+ * fixed arrival rate and measures every latency from the intended send time,
+ * so a stalled server is not hidden by the generator waiting on it. The suite
+ * starts a localhost server in no-op handler mode, runs a set of configurations
+ * against it and saves requests/sec, latency percentiles and server CPU time
+ * per request as JSON that --compare reads back.
+ *
+ * Build from this directory:
+ *     g++ -std=c++20 -O2 -I.. LoadGenerator.cpp -o LoadGenerator
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <csignal>               ///< For kill and SIGTERM
+#include <cstdlib>               ///< For std::strtod and std::strtoul
+#include <ctime>                 ///< For std::time and std::strftime
+#include <fcntl.h>               ///< For open
+#include <fstream>               ///< For std::ifstream and std::ofstream
+#include <iostream>              ///< For std::cout and std::cerr
+#include <map>                   ///< For std::map
+#include <sstream>               ///< For std::ostringstream
+#include <string>                ///< For std::string class operations
+#include <sys/wait.h>            ///< For waitpid
+#include <thread>                ///< For std::this_thread::sleep_for
+#include <vector>                ///< For std::vector
+#include "LoadDriver.hpp"
+
+using namespace App;
+const std::string DEFAULT_HOST{"127.0.0.1"};       ///< Server address
+constexpr int DEFAULT_PORT{8080};                  ///< Server port
+const std::string DEFAULT_COMMAND{"open_browser"}; ///< Registered command, run the server with --noop-handlers
+constexpr double DEFAULT_DURATION_SECONDS{5.0};    ///< Length of every run
+constexpr uint32_t SERVER_START_TIMEOUT_MS{5000};  ///< Time the suite waits for its server to listen
+
+/**
+ * @brief enum class LoadMode represents how requests are paced
+ */
+enum class LoadMode : uint8_t
+{
+    CLOSED = UINT8_C(0),   ///< Fixed concurrency, every connection sends again once acknowledged
+    OPEN   = UINT8_C(1)    ///< Fixed arrival rate spread evenly over the connections
+};
+
+/**
+ * @brief One benchmark configuration
+ */
+struct BenchmarkConfiguration
+{
+    std::string name{};               ///< Stable name results are compared by
+    LoadMode mode{LoadMode::CLOSED};  ///< Pacing of the requests
+    size_t connections{};             ///< Concurrent connections
+    double rate{};                    ///< Requests per second over all connections, open loop only
+};
+
+/**
+ * @brief Measured outcome of one configuration
+ */
+struct BenchmarkResult
+{
+    BenchmarkConfiguration configuration{};  ///< Configuration that was run
+    uint64_t requests{};                     ///< Acknowledged requests
+    uint64_t failedConnections{};            ///< Connections lost during the run
+    double requestsPerSecond{};              ///< Acknowledged requests per second
+    double p50Microseconds{};                ///< Median response latency
+    double p99Microseconds{};                ///< 99th percentile response latency
+    double p999Microseconds{};               ///< 99.9th percentile response latency
+    double maxMicroseconds{};                ///< Largest response latency
+    double cpuMicrosecondsPerRequest{-1.0};  ///< Server user and system time per request, -1 if unknown
+};
+
+/**
+ * @brief Configurations run by --suite, from a single connection up to thousands
+ */
+const std::vector<BenchmarkConfiguration> BENCHMARK_SUITE{
+    {"closed-c1",          LoadMode::CLOSED, 1,    0.0},
+    {"closed-c16",         LoadMode::CLOSED, 16,   0.0},
+    {"closed-c256",        LoadMode::CLOSED, 256,  0.0},
+    {"closed-c2048",       LoadMode::CLOSED, 2048, 0.0},
+    {"open-c64-r1000",     LoadMode::OPEN,   64,   1000.0},
+    {"open-c256-r10000",   LoadMode::OPEN,   256,  10000.0},
+    {"open-c2048-r50000",  LoadMode::OPEN,   2048, 50000.0}
+};
+
+/**
+ * @brief Print the command line options
+ */
+void printUsage(const char* programName)
+{
+    std::cerr << "Usage:\n"
+              << "  " << programName << " [--mode closed|open] [--connections <count>] [--rate <req/s>] [--duration <s>]\n"
+              << "      [--host <address>|unix:<path>] [--port <port>] [--command <text>] [--server-pid <pid>] [--json <file>]\n"
+              << "  " << programName << " --suite <server binary> [--duration <s>] [--port <port>] [--json <file>]\n"
+              << "  " << programName << " --compare <baseline json> <current json>\n";
+}
+
+/**
+ * @brief Read the user and system time of a process
+ * @return Microseconds, or -1 if the process is unknown
+ */
+double readProcessCpuMicroseconds(pid_t processID)
+{
+    std::ifstream StatFile("/proc/" + std::to_string(processID) + "/stat");
+    std::string Stat;
+    if((processID <= 0) || !std::getline(StatFile, Stat))
+    {
+        return -1.0;
+    }
+    // The command name may contain spaces, the fields after it are space separated
+    std::istringstream Fields(Stat.substr(Stat.rfind(')') + 2));
+    std::string Field;
+    unsigned long long UserTicks = 0;
+    unsigned long long SystemTicks = 0;
+    for(int Index = 3; (Index <= 15) && (Fields >> Field); Index++)
+    {
+        if(14 == Index)
+        {
+            UserTicks = std::strtoull(Field.c_str(), nullptr, 10);
+        }
+        else if(15 == Index)
+        {
+            SystemTicks = std::strtoull(Field.c_str(), nullptr, 10);
+        }
+    }
+    return static_cast<double>(UserTicks + SystemTicks) * 1e6 / static_cast<double>(sysconf(_SC_CLK_TCK));
+}
+
+/**
+ * @brief Run one configuration against a server
+ * @param serverID Server process for the CPU time, 0 if unknown
+ */
+BenchmarkResult runConfiguration(const BenchmarkConfiguration& configuration, const std::string& host, int port,
+                                 double durationSeconds, const std::string& command, pid_t serverID)
+{
+    BenchmarkResult Result{configuration};
+    LoadDriver Driver(host, port);
+    if(!Driver.connect(configuration.connections))
+    {
+        std::cerr << "Unable to connect " << configuration.connections << " connections to " << host << ":" << port << "\n";
+        Result.failedConnections = configuration.connections;
+        return Result;
+    }
+    std::string Payload = command + "\n";
+    uint64_t Duration = static_cast<uint64_t>(durationSeconds * 1e9);
+    std::vector<uint64_t> SentCounts(configuration.connections, 0);
+    double CpuBefore = readProcessCpuMicroseconds(serverID);
+    uint64_t StartTime = LoadDriver::now();
+    LoadResult Load = Driver.run([&](size_t connection, uint64_t now, ScheduledMessage& message)
+    {
+        if(LoadMode::CLOSED == configuration.mode)
+        {
+            message.intendedTime = now;
+        }
+        else
+        {
+            // Connection i owns the sends i, i + C, i + 2C, ... of the global arrival schedule
+            double Sequence = static_cast<double>(connection + (SentCounts[connection] * configuration.connections));
+            message.intendedTime = StartTime + static_cast<uint64_t>(Sequence * 1e9 / configuration.rate);
+        }
+        if(message.intendedTime >= (StartTime + Duration))
+        {
+            return false;
+        }
+        SentCounts[connection]++;
+        message.payload = Payload;
+        return true;
+    });
+    double CpuAfter = readProcessCpuMicroseconds(serverID);
+    LoadDriver::printReport(configuration.name, Load);
+    Result.requests = Load.acknowledgedCount;
+    Result.failedConnections = Load.failedConnections;
+    Result.requestsPerSecond = (Load.elapsedSeconds > 0.0) ? (static_cast<double>(Load.acknowledgedCount) / Load.elapsedSeconds) : 0.0;
+    Result.p50Microseconds = LoadDriver::getPercentile(Load.responseLatencies, 50.0) / 1e3;
+    Result.p99Microseconds = LoadDriver::getPercentile(Load.responseLatencies, 99.0) / 1e3;
+    Result.p999Microseconds = LoadDriver::getPercentile(Load.responseLatencies, 99.9) / 1e3;
+    Result.maxMicroseconds = Load.responseLatencies.empty() ? 0.0 : (Load.responseLatencies.back() / 1e3);
+    if((CpuBefore >= 0.0) && (CpuAfter >= 0.0) && (Load.acknowledgedCount > 0))
+    {
+        Result.cpuMicrosecondsPerRequest = (CpuAfter - CpuBefore) / static_cast<double>(Load.acknowledgedCount);
+        std::printf("Server CPU: %.2f us per request\n", Result.cpuMicrosecondsPerRequest);
+    }
+    return Result;
+}
+
+/**
+ * @brief Start a server in no-op handler mode and wait until it accepts connections
+ * @return Server process, -1 on error
+ */
+pid_t startServer(const std::string& serverPath, int port)
+{
+    pid_t ServerID = fork();
+    if(0 == ServerID)
+    {
+        // The server needs a descriptor per connection
+        rlimit FileLimit{};
+        if(0 == getrlimit(RLIMIT_NOFILE, &FileLimit))
+        {
+            FileLimit.rlim_cur = FileLimit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &FileLimit);
+        }
+        int NullFileDescriptor = open("/dev/null", O_WRONLY);
+        dup2(NullFileDescriptor, STDOUT_FILENO);
+        execl(serverPath.c_str(), serverPath.c_str(), "--noop-handlers", "--quiet", static_cast<char*>(nullptr));
+        _exit(EXIT_FAILURE);
+    }
+    if(-1 == ServerID)
+    {
+        return -1;
+    }
+    sockaddr_in ServerAddress{};
+    ServerAddress.sin_family = AF_INET;
+    ServerAddress.sin_port = htons(static_cast<uint16_t>(port));
+    inet_pton(AF_INET, DEFAULT_HOST.c_str(), &ServerAddress.sin_addr);
+    for(uint32_t Waited = 0; Waited < SERVER_START_TIMEOUT_MS; Waited += 50)
+    {
+        int Probe = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool IsListening = (0 == ::connect(Probe, reinterpret_cast<sockaddr*>(&ServerAddress), sizeof(ServerAddress)));
+        close(Probe);
+        if(IsListening)
+        {
+            return ServerID;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    kill(ServerID, SIGKILL);
+    waitpid(ServerID, nullptr, 0);
+    return -1;
+}
+
+/**
+ * @brief Stop a server started by the suite
+ */
+void stopServer(pid_t serverID)
+{
+    kill(serverID, SIGTERM);
+    waitpid(serverID, nullptr, 0);
+}
+
+/**
+ * @brief Save results as JSON, one result object per line so runs diff cleanly
+ */
+bool writeJson(const std::string& fileName, const std::vector<BenchmarkResult>& results, double durationSeconds)
+{
+    std::ofstream JsonFile(fileName, std::ios::trunc);
+    if(!JsonFile.is_open())
+    {
+        return false;
+    }
+    char Timestamp[32]{};
+    std::time_t Now = std::time(nullptr);
+    std::strftime(Timestamp, sizeof(Timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&Now));
+    JsonFile << "{\n  \"timestamp\": \"" << Timestamp << "\",\n"
+             << "  \"duration_seconds\": " << durationSeconds << ",\n"
+             << "  \"results\": [\n";
+    for(size_t Index = 0; Index < results.size(); Index++)
+    {
+        const BenchmarkResult& Result = results[Index];
+        char Line[512];
+        std::snprintf(Line, sizeof(Line),
+                      "    {\"name\": \"%s\", \"mode\": \"%s\", \"connections\": %zu, \"target_rate\": %.0f, "
+                      "\"requests\": %llu, \"failed_connections\": %llu, \"requests_per_second\": %.1f, "
+                      "\"p50_us\": %.1f, \"p99_us\": %.1f, \"p999_us\": %.1f, \"max_us\": %.1f, \"cpu_us_per_request\": %.3f}%s\n",
+                      Result.configuration.name.c_str(), (LoadMode::OPEN == Result.configuration.mode) ? "open" : "closed",
+                      Result.configuration.connections, Result.configuration.rate,
+                      static_cast<unsigned long long>(Result.requests), static_cast<unsigned long long>(Result.failedConnections),
+                      Result.requestsPerSecond, Result.p50Microseconds, Result.p99Microseconds, Result.p999Microseconds,
+                      Result.maxMicroseconds, Result.cpuMicrosecondsPerRequest, ((Index + 1) < results.size()) ? "," : "");
+        JsonFile << Line;
+    }
+    JsonFile << "  ]\n}\n";
+    return true;
+}
+
+/**
+ * @brief helper function to read a value of a result line written by writeJson
+ */
+std::string extractValue(const std::string& line, const std::string& key)
+{
+    size_t Position = line.find("\"" + key + "\": ");
+    if(std::string::npos == Position)
+    {
+        return "";
+    }
+    Position += key.size() + 4;
+    size_t End = line.find_first_of(",}", Position);
+    std::string Value = line.substr(Position, End - Position);
+    if(!Value.empty() && ('"' == Value.front()))
+    {
+        Value = Value.substr(1, Value.size() - 2);
+    }
+    return Value;
+}
+
+/**
+ * @brief Read the results of a JSON file written by writeJson, keyed by configuration name
+ */
+std::map<std::string, std::map<std::string, double>> readJson(const std::string& fileName)
+{
+    std::map<std::string, std::map<std::string, double>> Results;
+    std::ifstream JsonFile(fileName);
+    std::string Line;
+    while(std::getline(JsonFile, Line))
+    {
+        std::string Name = extractValue(Line, "name");
+        if(Name.empty())
+        {
+            continue;
+        }
+        for(const char* Key : {"requests_per_second", "p99_us", "cpu_us_per_request"})
+        {
+            Results[Name][Key] = std::strtod(extractValue(Line, Key).c_str(), nullptr);
+        }
+    }
+    return Results;
+}
+
+/**
+ * @brief Print the change of every configuration found in both result files
+ */
+int compareResults(const std::string& baselineFile, const std::string& currentFile)
+{
+    auto Baseline = readJson(baselineFile);
+    auto Current = readJson(currentFile);
+    if(Baseline.empty() || Current.empty())
+    {
+        std::cerr << "No results in " << (Baseline.empty() ? baselineFile : currentFile) << "\n";
+        return 1;
+    }
+    auto Change = [](double before, double after)
+    {
+        return (before > 0.0) ? (((after - before) / before) * 100.0) : 0.0;
+    };
+    std::printf("=== BENCHMARK COMPARISON ===\n");
+    std::printf("%-20s %12s %8s %10s %8s %10s %8s\n", "configuration", "req/s", "change", "p99 us", "change", "cpu us/req", "change");
+    for(const auto& [Name, Values] : Current)
+    {
+        auto BaselineEntry = Baseline.find(Name);
+        if(Baseline.end() == BaselineEntry)
+        {
+            continue;
+        }
+        const auto& Before = BaselineEntry->second;
+        std::printf("%-20s %12.0f %+7.1f%% %10.1f %+7.1f%% %10.3f %+7.1f%%\n", Name.c_str(),
+                    Values.at("requests_per_second"), Change(Before.at("requests_per_second"), Values.at("requests_per_second")),
+                    Values.at("p99_us"), Change(Before.at("p99_us"), Values.at("p99_us")),
+                    Values.at("cpu_us_per_request"), Change(Before.at("cpu_us_per_request"), Values.at("cpu_us_per_request")));
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchmarkConfiguration configuration{"single", LoadMode::CLOSED, 1, 0.0};
+    std::string host = DEFAULT_HOST;
+    int port = DEFAULT_PORT;
+    double durationSeconds = DEFAULT_DURATION_SECONDS;
+    std::string command = DEFAULT_COMMAND;
+    pid_t serverID = 0;
+    std::string jsonFile;
+    std::string serverPath;
+    for(int argument = 1; argument < argc; argument++)
+    {
+        std::string option = argv[argument];
+        if(("--compare" == option) && ((argument + 2) < argc))
+        {
+            return compareResults(argv[argument + 1], argv[argument + 2]);
+        }
+        if((argument + 1) >= argc)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++argument];
+        if("--mode" == option)
+        {
+            configuration.mode = ("open" == value) ? LoadMode::OPEN : LoadMode::CLOSED;
+        }
+        else if("--connections" == option)
+        {
+            configuration.connections = std::strtoul(value.c_str(), nullptr, 10);
+        }
+        else if("--rate" == option)
+        {
+            configuration.rate = std::strtod(value.c_str(), nullptr);
+        }
+        else if("--duration" == option)
+        {
+            durationSeconds = std::strtod(value.c_str(), nullptr);
+        }
+        else if("--host" == option)
+        {
+            host = value;
+        }
+        else if("--port" == option)
+        {
+            port = std::atoi(value.c_str());
+        }
+        else if("--command" == option)
+        {
+            command = value;
+        }
+        else if("--server-pid" == option)
+        {
+            serverID = static_cast<pid_t>(std::atoi(value.c_str()));
+        }
+        else if("--json" == option)
+        {
+            jsonFile = value;
+        }
+        else if("--suite" == option)
+        {
+            serverPath = value;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if((0 == configuration.connections) || ((LoadMode::OPEN == configuration.mode) && (configuration.rate <= 0.0)))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<BenchmarkResult> results;
+    if(serverPath.empty())
+    {
+        configuration.name = ((LoadMode::OPEN == configuration.mode) ? "open-c" : "closed-c") + std::to_string(configuration.connections);
+        results.push_back(runConfiguration(configuration, host, port, durationSeconds, command, serverID));
+    }
+    else
+    {
+        // A fresh server per configuration keeps the runs independent
+        for(const auto& suiteConfiguration : BENCHMARK_SUITE)
+        {
+            pid_t suiteServerID = startServer(serverPath, port);
+            if(-1 == suiteServerID)
+            {
+                std::cerr << "Unable to start server: " << serverPath << "\n";
+                return 1;
+            }
+            results.push_back(runConfiguration(suiteConfiguration, DEFAULT_HOST, port, durationSeconds, command, suiteServerID));
+            stopServer(suiteServerID);
+        }
+    }
+    if(!jsonFile.empty())
+    {
+        if(!writeJson(jsonFile, results, durationSeconds))
+        {
+            std::cerr << "Unable to write results: " << jsonFile << "\n";
+            return 1;
+        }
+        std::cout << "Results saved to " << jsonFile << "\n";
+    }
+    for(const auto& result : results)
+    {
+        if(result.failedConnections > 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
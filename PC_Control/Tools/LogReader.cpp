@@ -0,0 +1,97 @@
+/**
+ * @file LogReader.cpp
+ * @brief Streams the records of a compressed log segment
+ *
+ * Prints the records of an archive written by LogArchive, or appends them to
+ * a log file. With a time range only the frames whose records fall into it
+ * are decompressed, so reading an hour out of a large segment stays cheap.
+ *
+ * Build from this directory:
+ *     g++ -std=c++20 -O2 -pthread -I.. LogReader.cpp ../LogArchive.cpp -o LogReader
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <iostream>              ///< For std::cout and std::cerr
+#include <limits>                ///< For std::numeric_limits
+#include <string>                ///< For std::string class operations
+#include "LogArchive.hpp"
+
+using namespace App;
+
+/**
+ * @brief Print the command line options
+ */
+void printUsage(const char* programName)
+{
+    std::cerr << "Usage: " << programName << " <archive> [--from \"YYYY-MM-DD HH:MM:SS\"] [--to \"YYYY-MM-DD HH:MM:SS\"] [--output <file>] [--frames]\n"
+              << "  --from, --to  Only the records of this time range, both ends inclusive\n"
+              << "  --output      Append the records to <file> instead of printing them\n"
+              << "  --frames      Print the number of frames in the archive\n";
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    std::string archiveFile = argv[1];
+    std::string outputFile;
+    int64_t from = std::numeric_limits<int64_t>::min();
+    int64_t to = std::numeric_limits<int64_t>::max();
+    bool isFrameReport = false;
+    for(int argument = 2; argument < argc; argument++)
+    {
+        std::string option = argv[argument];
+        if((("--from" == option) || ("--to" == option)) && ((argument + 1) < argc))
+        {
+            int64_t timestamp = LogArchive::parseTimestamp(argv[++argument]);
+            if(LOG_ARCHIVE_NO_TIMESTAMP == timestamp)
+            {
+                std::cerr << "Invalid timestamp: " << argv[argument] << '\n';
+                return 1;
+            }
+            (("--from" == option) ? from : to) = timestamp;
+        }
+        else if(("--output" == option) && ((argument + 1) < argc))
+        {
+            outputFile = argv[++argument];
+        }
+        else if("--frames" == option)
+        {
+            isFrameReport = true;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    LogArchiveReader reader(archiveFile);
+    if(!reader.open())
+    {
+        std::cerr << "Not a log archive: " << archiveFile << '\n';
+        return 1;
+    }
+    if(isFrameReport)
+    {
+        std::cerr << "Frames: " << reader.getFrameCount() << '\n';
+    }
+    if(!outputFile.empty())
+    {
+        return reader.dumpToLogFile(outputFile, from, to) ? 0 : 1;
+    }
+    bool isRead = reader.readRange(from, to, [](std::string_view record)
+    {
+        std::cout << record << '\n';
+    });
+    if(!isRead)
+    {
+        std::cerr << "Archive is damaged, printed the records before the damage\n";
+        return 1;
+    }
+    return 0;
+}
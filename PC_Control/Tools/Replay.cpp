@@ -0,0 +1,166 @@
+/**
+ * @file Replay.cpp
+ * @brief Replays a captured request traffic file against a running server
+ *
+ * Fires the messages of a capture file back at their original pacing, a
+ * multiple of it or as fast as acknowledgments allow, spread over as many
+ * connections as requested, and reports throughput and latency percentiles.
+ * Start the server with --noop-handlers to measure the request path alone.
+ * Only text requests are replayed: binary frames name commands by IDs of the
+ * capturing server's table, and subscriptions reply without a request.
+ *
+ * Build from this directory:
+ *     g++ -std=c++20 -O2 -pthread -I.. Replay.cpp ../RequestCapture.cpp ../Logger.cpp ../EventChannel.cpp -o Replay
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <cstdlib>               ///< For std::strtod and std::strtoul
+#include <deque>                 ///< For std::deque
+#include <iostream>              ///< For std::cout and std::cerr
+#include <map>                   ///< For std::map
+#include <string>                ///< For std::string class operations
+#include <vector>                ///< For std::vector
+#include "BinaryProtocol.hpp"
+#include "LoadDriver.hpp"
+#include "RequestCapture.hpp"
+
+using namespace App;
+const std::string DEFAULT_HOST{"127.0.0.1"};     ///< Server address
+constexpr int DEFAULT_PORT{8080};                ///< Server port
+
+/**
+ * @brief Print the command line options
+ */
+void printUsage(const char* programName)
+{
+    std::cerr << "Usage: " << programName << " <capture file> [--host <address>|unix:<path>] [--port <port>]"
+              << " [--speed <factor>|max] [--connections <count>]\n"
+              << "  --speed        1 keeps the captured pacing, N replays N times faster, max sends back to back\n"
+              << "  --connections  0 keeps the captured connections, otherwise they are spread over this many\n";
+}
+
+/**
+ * @brief Check if a captured message is acknowledged with one line and leaves the connection open
+ */
+bool isReplayable(const RequestCapture::CapturedMessage& message)
+{
+    if(CaptureRecordType::TEXT != message.type)
+    {
+        return false;
+    }
+    const std::string& data = message.data;
+    size_t First = data.find_first_not_of(" \n\r\t");
+    if(std::string::npos == First)
+    {
+        // The server does not acknowledge empty messages
+        return false;
+    }
+    std::string Command = data.substr(First, data.find_last_not_of(" \n\r\t") + 1 - First);
+    for(auto& Letter : Command)
+    {
+        Letter = static_cast<char>(std::tolower(static_cast<unsigned char>(Letter)));
+    }
+    // The handshake switches to binary replies, subscriptions send publications nobody requested
+    return ("exit" != Command) && ("quit" != Command) && (BINARY_HANDSHAKE_COMMAND != Command) &&
+           (0 != Command.rfind("subscribe", 0)) && (0 != Command.rfind("unsubscribe", 0));
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    std::string captureFile = argv[1];
+    std::string host = DEFAULT_HOST;
+    int port = DEFAULT_PORT;
+    double speed = 1.0;       // 0 replays at maximum speed
+    size_t connectionCount = 0;
+    for(int argument = 2; argument < argc; argument++)
+    {
+        std::string option = argv[argument];
+        if((argument + 1) >= argc)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++argument];
+        if("--host" == option)
+        {
+            host = value;
+        }
+        else if("--port" == option)
+        {
+            port = std::atoi(value.c_str());
+        }
+        else if("--speed" == option)
+        {
+            speed = ("max" == value) ? 0.0 : std::strtod(value.c_str(), nullptr);
+        }
+        else if("--connections" == option)
+        {
+            connectionCount = std::strtoul(value.c_str(), nullptr, 10);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    std::vector<RequestCapture::CapturedMessage> messages;
+    if(!RequestCapture::readFile(captureFile, messages))
+    {
+        std::cerr << "Unable to read capture file: " << captureFile << "\n";
+        return 1;
+    }
+    // Captured connections keep their order of appearance, folded onto the requested count
+    std::map<uint32_t, size_t> connectionIndices;
+    for(const auto& message : messages)
+    {
+        connectionIndices.emplace(message.connectionID, connectionIndices.size());
+    }
+    if(0 == connectionCount)
+    {
+        connectionCount = std::max<size_t>(1, connectionIndices.size());
+    }
+    std::vector<std::deque<ScheduledMessage>> schedules(connectionCount);
+    size_t replayedCount = 0;
+    for(const auto& message : messages)
+    {
+        if(!isReplayable(message))
+        {
+            continue;
+        }
+        uint64_t offset = (speed > 0.0) ? static_cast<uint64_t>(static_cast<double>(message.timestamp) / speed) : 0;
+        schedules[connectionIndices[message.connectionID] % connectionCount].push_back(ScheduledMessage{offset, message.data});
+        replayedCount++;
+    }
+    std::cout << "Replaying " << replayedCount << " of " << messages.size() << " captured messages from "
+              << connectionIndices.size() << " connections over " << connectionCount << " connections at "
+              << ((speed > 0.0) ? (std::to_string(speed) + "x") : std::string("maximum")) << " speed\n";
+
+    LoadDriver driver(host, port);
+    if(!driver.connect(connectionCount))
+    {
+        std::cerr << "Unable to connect " << connectionCount << " connections to " << host << ":" << port << "\n";
+        return 1;
+    }
+    uint64_t startTime = LoadDriver::now();
+    LoadResult result = driver.run([&](size_t connection, uint64_t now, ScheduledMessage& message)
+    {
+        if(schedules[connection].empty())
+        {
+            return false;
+        }
+        message = std::move(schedules[connection].front());
+        schedules[connection].pop_front();
+        // At maximum speed every message is intended to leave as soon as its predecessor was acknowledged
+        message.intendedTime = (speed > 0.0) ? (startTime + message.intendedTime) : now;
+        return true;
+    });
+    LoadDriver::printReport("REPLAY", result);
+    return (0 == result.failedConnections) ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+/**
+ * @file SharedMemoryBenchmark.cpp
+ * @brief Compares the shared memory transport with TCP loopback
+ *
+ * Sends the same command the same number of times over one TCP connection
+ * and over one shared memory channel of a running server, first one request
+ * at a time and then, over shared memory, with a window of outstanding
+ * requests, and reports throughput and latency percentiles of each run.
+ * Start the server with --noop-handlers to measure the transports alone.
+ *
+ * Build from this directory:
+ *     g++ -std=c++20 -O2 -I.. SharedMemoryBenchmark.cpp -o SharedMemoryBenchmark
+ *
+ * @author Mohamed Hafez
+ * @version 1.0
+ */
+
+#include <cstdlib>               ///< For std::strtoul
+#include <deque>                 ///< For std::deque
+#include <iostream>              ///< For std::cout and std::cerr
+#include <string>                ///< For std::string class operations
+#include "LoadDriver.hpp"
+#include "SharedMemoryClient.hpp"
+
+using namespace App;
+const std::string DEFAULT_HOST{"127.0.0.1"};                 ///< TCP server address
+constexpr int DEFAULT_PORT{8080};                            ///< TCP server port
+const std::string DEFAULT_SOCKET_PATH{"PCControlShm.sock"};  ///< Shared memory transport socket
+const std::string DEFAULT_COMMAND{"open_browser"};           ///< Registered command, run the server with --noop-handlers
+constexpr size_t DEFAULT_REQUEST_COUNT{100000};              ///< Requests per run
+constexpr size_t DEFAULT_WINDOW{64};                         ///< Outstanding requests of the pipelined run
+
+/**
+ * @brief Print the command line options
+ */
+void printUsage(const char* programName)
+{
+    std::cerr << "Usage: " << programName << " [--host <address>] [--port <port>] [--socket <path>]"
+              << " [--requests <count>] [--window <count>] [--command <text>]\n";
+}
+
+/**
+ * @brief Send requests one at a time over a TCP connection
+ */
+bool runTcp(const std::string& host, int port, const std::string& command, size_t requestCount, LoadResult& result)
+{
+    LoadDriver Driver(host, port);
+    if(!Driver.connect(1))
+    {
+        return false;
+    }
+    std::string Payload = command + "\n";
+    size_t Remaining = requestCount;
+    result = Driver.run([&](size_t, uint64_t now, ScheduledMessage& message)
+    {
+        if(0 == Remaining)
+        {
+            return false;
+        }
+        Remaining--;
+        message.intendedTime = now;
+        message.payload = Payload;
+        return true;
+    });
+    return (0 == result.failedConnections);
+}
+
+/**
+ * @brief Send requests over a shared memory channel with up to window requests outstanding
+ */
+bool runSharedMemory(const std::string& socketPath, const std::string& command, size_t requestCount, size_t window, LoadResult& result)
+{
+    SharedMemoryClient Client;
+    if(!Client.connect(socketPath))
+    {
+        return false;
+    }
+    std::deque<uint64_t> SendTimes;
+    size_t SentCount = 0;
+    uint64_t StartTime = LoadDriver::now();
+    while(result.acknowledgedCount < requestCount)
+    {
+        while((SentCount < requestCount) && (SendTimes.size() < window))
+        {
+            SendTimes.push_back(LoadDriver::now());
+            if(!Client.send(command))
+            {
+                return false;
+            }
+            SentCount++;
+        }
+        if(!Client.receiveAcknowledgment())
+        {
+            return false;
+        }
+        uint64_t Latency = LoadDriver::now() - SendTimes.front();
+        SendTimes.pop_front();
+        result.responseLatencies.push_back(Latency);
+        result.serviceLatencies.push_back(Latency);
+        result.acknowledgedCount++;
+    }
+    result.sentCount = SentCount;
+    result.elapsedSeconds = static_cast<double>(LoadDriver::now() - StartTime) / 1e9;
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string host = DEFAULT_HOST;
+    int port = DEFAULT_PORT;
+    std::string socketPath = DEFAULT_SOCKET_PATH;
+    std::string command = DEFAULT_COMMAND;
+    size_t requestCount = DEFAULT_REQUEST_COUNT;
+    size_t window = DEFAULT_WINDOW;
+    for(int argument = 1; argument < argc; argument++)
+    {
+        std::string option = argv[argument];
+        if((argument + 1) >= argc)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++argument];
+        if("--host" == option)
+        {
+            host = value;
+        }
+        else if("--port" == option)
+        {
+            port = std::atoi(value.c_str());
+        }
+        else if("--socket" == option)
+        {
+            socketPath = value;
+        }
+        else if("--requests" == option)
+        {
+            requestCount = std::strtoul(value.c_str(), nullptr, 10);
+        }
+        else if("--window" == option)
+        {
+            window = std::max<size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+        }
+        else if("--command" == option)
+        {
+            command = value;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    LoadResult tcpResult{};
+    if(!runTcp(host, port, command, requestCount, tcpResult))
+    {
+        std::cerr << "TCP run against " << host << ":" << port << " failed\n";
+        return 1;
+    }
+    LoadDriver::printReport("TCP LOOPBACK", tcpResult);
+    LoadResult sharedMemoryResult{};
+    if(!runSharedMemory(socketPath, command, requestCount, 1, sharedMemoryResult))
+    {
+        std::cerr << "Shared memory run on " << socketPath << " failed\n";
+        return 1;
+    }
+    LoadDriver::printReport("SHARED MEMORY", sharedMemoryResult);
+    LoadResult pipelinedResult{};
+    if(!runSharedMemory(socketPath, command, requestCount, window, pipelinedResult))
+    {
+        std::cerr << "Pipelined shared memory run on " << socketPath << " failed\n";
+        return 1;
+    }
+    LoadDriver::printReport("SHARED MEMORY WINDOW " + std::to_string(window), pipelinedResult);
+    return 0;
+}
@@ -1,80 +1,572 @@
 #include <cstdint>
+#include <cstdlib>
 #include <iostream>
 #include <string>
-#include <thread>
 #include <chrono>
+#include <memory>
+#include <vector>
+#include <csignal>
+#include <functional>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include "EventLoop.hpp"
+#include "Task.hpp"
 #include "Server.hpp"
 #include "PCControl.hpp"
+#include "PluginLoader.hpp"
+#include "RequestCoalescer.hpp"
+#include "RequestScheduler.hpp"
+#include "Request.hpp"
+#include "RequestTracer.hpp"
+#include "Metrics.hpp"
+#include "MetricsServer.hpp"
+#include "Logger.hpp"
+#include "EventChannel.hpp"
+#include "RequestJournal.hpp"
+#include "RequestCapture.hpp"
+#include "SharedMemoryTransport.hpp"
+#include "SubscriptionHub.hpp"
+#include "RestartHandoff.hpp"
+#include "RuntimeConfig.hpp"
+#include "LogArchive.hpp"
+#include "ProcessSampler.hpp"
 
 using namespace App;
 constexpr int PORT{8080};                          ///< Port number for the server
 const std::string SERVER_IP{"192.168.1.11"};    ///< IP address for the server
+constexpr bool ENABLE_REQUEST_COALESCING{false};   ///< Merge duplicate idempotent requests (opt-in)
+constexpr uint32_t COALESCING_WINDOW_MS{2000};     ///< Window in which duplicates are merged
+constexpr uint32_t SCHEDULER_AGING_MS{5000};       ///< Waiting time after which any request is served
+const std::string PLUGIN_DIRECTORY{"Plugins"};     ///< Directory watched for handler plugins
+constexpr bool ENABLE_REQUEST_TRACING{true};       ///< Record request stage timestamps
+const std::string TRACE_FILE{"RequestTrace.json"}; ///< Chrome trace written at shutdown
+constexpr bool ENABLE_METRICS{true};               ///< Serve Prometheus metrics on a separate port
+constexpr int METRICS_PORT{9100};                  ///< Port number for the metrics endpoint
+constexpr EventProfile EVENT_PROFILE{EventProfile::VERBOSE};  ///< PRODUCTION keeps only warnings and errors
+constexpr DurabilityMode JOURNAL_DURABILITY{DurabilityMode::NONE};  ///< Default of journal_durability: NONE, ASYNC or GROUP_COMMIT
+const std::string JOURNAL_FILE{"RequestJournal.wal"};  ///< Write-ahead journal of accepted requests
+constexpr bool ENABLE_UNIX_SOCKET{true};           ///< Serve same-host clients without the TCP loopback stack
+const std::string UNIX_SOCKET_PATH{"PCControl.sock"};  ///< Unix domain socket file, access follows its permissions
+constexpr bool ENABLE_SHARED_MEMORY_TRANSPORT{true};   ///< Hand out shared memory channels to local clients
+const std::string SHARED_MEMORY_SOCKET_PATH{"PCControlShm.sock"};  ///< Socket the channels are handed out on
+constexpr uint32_t BUSY_POLL_US{0};                ///< Spin this long before the loop blocks, 0 always blocks (opt-in)
+constexpr bool ENABLE_RESTART_HANDOFF{true};       ///< Let a restarted binary take the sockets over with --takeover
+const std::string HANDOFF_SOCKET_PATH{"PCControlHandoff.sock"};  ///< Socket a successor takes the sockets over on
+constexpr bool ENABLE_BATCHED_LOGGING{true};       ///< Write log files in batches, the crash handler writes what is pending
+constexpr uint32_t LOG_FLUSH_INTERVAL_MS{1000};    ///< Longest time a batched log record waits for its write
+const std::string CONFIG_FILE{"PCControl.conf"};   ///< Settings file, reloaded on SIGHUP, the constants above are its defaults
 
-void runServer(Server& server, uint32_t interval_ms)
+/**
+ * @brief Pass a received request through the coalescing stage into the scheduler
+ */
+void submitRequest(Request request, PCControl& pcControl, RequestCoalescer& coalescer, RequestScheduler& scheduler, RequestJournal* journal)
 {
-    while (true)
+    request.stamp(RequestStage::DEQUEUE);
+    // Binary requests carry a bare command and are looked up by registry ID
+    bool isBinary = (0 != request.commandID);
+    RequestScheduler::RequestOptions options = isBinary ? RequestScheduler::RequestOptions{} : RequestScheduler::parseRequestOptions(request.command);
+    bool isIdempotent = isBinary ? pcControl.isIdempotent(request.commandID) : pcControl.isIdempotent(request.command);
+    RequestCoalescer::Ticket ticket = coalescer.submit(request, isIdempotent);
+    if(ticket.isCoalesced)
+    {
+        EVENT_INFO("Coalesced duplicate request: " << request.command);
+        // The merged request never reaches a handler, its trace ends at dequeue and its result is the one of the pending request
+        RequestTracer::record(request);
+        if(journal)
+        {
+            // The request it was merged into is journaled and replayed on its own
+            journal->complete(request.id);
+        }
+    }
+    else
+    {
+        RequestPriority priority = options.hasPriority ? options.priority
+                                 : (isBinary ? pcControl.getPriority(request.commandID) : pcControl.getPriority(request.command));
+        scheduler.push(ticket.id, request, priority, options.deadline);
+    }
+}
+
+/**
+ * @brief Tell the subscribers of the completions topic how a request ended
+ */
+void publishCompletion(SubscriptionHub& subscriptionHub, const Request& request, const char* status)
+{
+    // Skip formatting while nobody listens
+    if(subscriptionHub.hasSubscribers(Topic::COMPLETIONS))
+    {
+        subscriptionHub.publish(Topic::COMPLETIONS, std::to_string(request.id) + ' ' + status + ' ' + request.command);
+    }
+}
+
+/**
+ * @brief Send the result of a request to its client and the completions topic, with every duplicate merged into it
+ */
+void finishRequest(Server& server, RequestCoalescer& coalescer, SubscriptionHub& subscriptionHub, const Request& request, uint64_t ticketID,
+                   bool isExecuted, const std::string& resultText, const char* status)
+{
+    server.completeRequest(request, isExecuted, resultText);
+    publishCompletion(subscriptionHub, request, status);
+    // Share the result with every merged submitter
+    for(const Request& mergedRequest : coalescer.complete(ticketID))
     {
-        try
+        server.completeRequest(mergedRequest, isExecuted, resultText);
+        publishCompletion(subscriptionHub, mergedRequest, status);
+    }
+}
+
+/**
+ * @brief Report requests that missed their deadline, they are never run
+ */
+void completeExpiredRequests(Server& server, RequestCoalescer& coalescer, RequestScheduler& scheduler, RequestJournal* journal,
+                             SubscriptionHub& subscriptionHub)
+{
+    for(const auto& expiredRequest : scheduler.takeExpiredRequests())
+    {
+        EVENT_WARNING("Request expired before it ran: " << expiredRequest.request.command);
+        finishRequest(server, coalescer, subscriptionHub, expiredRequest.request, expiredRequest.ticketID, false, "expired", "expired");
+        RequestTracer::record(expiredRequest.request);
+        if(journal)
         {
-            auto start = std::chrono::steady_clock::now();
-            server.saveClientRequests();
-            // Sleep until next cycle
-            std::this_thread::sleep_until(start + std::chrono::milliseconds(interval_ms));
-        } catch (const std::exception& e) {
-            std::cerr << "Server thread error: " << e.what() << std::endl;
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+            journal->complete(expiredRequest.request.id);
         }
     }
 }
 
-void runApp(Server& server, PCControl& pcControl, uint32_t interval_ms)
+Task<void> runApp(EventLoop& loop, Server& server, PCControl& pcControl, RequestCoalescer& coalescer, RequestScheduler& scheduler, RequestJournal* journal,
+                  SubscriptionHub& subscriptionHub)
 {
     while (true)
     {
-        try
+        // Suspend until a request arrives, empty when the loop is stopping
+        Request request = co_await server.getNextRequest();
+        if(request.command.empty())
+        {
+            break;
+        }
+        submitRequest(request, pcControl, coalescer, scheduler, journal);
+        while(server.tryGetNextRequest(request))
         {
-            auto start = std::chrono::steady_clock::now();
-            std::cout << "Checking for new requests..." << std::endl;
-            // Get the next request if available and process it
-            std::string request = server.getNextRequest();
-            if(!request.empty())
+            submitRequest(request, pcControl, coalescer, scheduler, journal);
+        }
+        // Process the scheduled requests
+        RequestScheduler::ScheduledRequest scheduledRequest;
+        while(scheduler.pop(scheduledRequest))
+        {
+            try
+            {
+                EVENT_DEBUG("Processing request: " << scheduledRequest.request.command);
+                std::string resultText;
+                scheduledRequest.request.stamp(RequestStage::DISPATCH);
+                const Request& dispatchedRequest = scheduledRequest.request;
+                bool result = (0 != dispatchedRequest.commandID) ? pcControl.handleRequest(dispatchedRequest.commandID, resultText)
+                                                                 : pcControl.handleRequest(dispatchedRequest.command, resultText);
+                scheduledRequest.request.stamp(RequestStage::COMPLETE);
+                if(!result)
+                {
+                    Metrics::increment(MetricCounter::HANDLER_FAILURES);
+                }
+                EVENT_DEBUG("Request result: " << resultText);
+                // The client hears the combined result of a batch, not just that it was received
+                finishRequest(server, coalescer, subscriptionHub, scheduledRequest.request, scheduledRequest.ticketID, result, resultText,
+                              result ? "ok" : "failed");
+            } catch (const std::exception& e) {
+                scheduledRequest.request.stamp(RequestStage::COMPLETE);
+                Metrics::increment(MetricCounter::HANDLER_FAILURES);
+                EVENT_ERROR("App error: " << e.what());
+                finishRequest(server, coalescer, subscriptionHub, scheduledRequest.request, scheduledRequest.ticketID, false, "failed", "failed");
+            }
+            RequestTracer::record(scheduledRequest.request);
+            if(journal)
             {
-                std::cout << "Processing request: " << request << std::endl;
-                pcControl.handleRequest(request);
+                // Executed requests are not replayed after a crash
+                journal->complete(scheduledRequest.request.id);
             }
-            else
+            const auto& timestamps = scheduledRequest.request.timestamps;
+            Metrics::observeDispatch(scheduledRequest.request.command,
+                                     timestamps[static_cast<size_t>(RequestStage::COMPLETE)] - timestamps[static_cast<size_t>(RequestStage::DISPATCH)]);
+            completeExpiredRequests(server, coalescer, scheduler, journal, subscriptionHub);
+            // Let the loop receive requests that may outrank the remaining ones
+            bool isRunning = co_await loop.yield();
+            if(!isRunning)
             {
-                std::cout << "No requests to process." << std::endl;
+                co_return;
+            }
+            while(server.tryGetNextRequest(request))
+            {
+                submitRequest(request, pcControl, coalescer, scheduler, journal);
             }
-            // Sleep until next cycle
-            std::this_thread::sleep_until(start + std::chrono::milliseconds(interval_ms));
-        } catch (const std::exception& e) {
-            std::cerr << "App thread error: " << e.what() << std::endl;
-            std::this_thread::sleep_for(std::chrono::seconds(1));
         }
+        completeExpiredRequests(server, coalescer, scheduler, journal, subscriptionHub);
     }
 }
 
-int main()
+/**
+ * @brief Apply the settings that take effect without a restart, runs on the loop thread
+ */
+void applySettings(const RuntimeConfig::Settings& settings, EventLoop& loop, Server& server, PCControl& pcControl, SubscriptionHub& subscriptionHub,
+                   ProcessSampler& processSampler)
 {
+    server.setListenBacklog(settings.listenBacklog);
+    server.setSocketBufferSizes(settings.socketReceiveBufferBytes, settings.socketSendBufferBytes);
+    server.setMessageQueueLimit(settings.messageQueueLimit);
+    if(!loop.setCpuAffinity(settings.loopCpus))
+    {
+        EVENT_WARNING("Unable to pin the event loop to the configured CPUs");
+    }
+    subscriptionHub.setQueueLimit(settings.subscriberQueueLimit);
+    EventChannel::setCapacity(settings.eventChannelCapacity);
+    EventChannel::setLevel(settings.eventLevel);
+    Logger::setAllLogLevels(settings.logLevel);
+    Logger::setSegmentSize(settings.logSegmentBytes);
+    server.setLogLevel(settings.serverLogLevel.value_or(settings.logLevel));
+    pcControl.setLogLevel(settings.pcControlLogLevel.value_or(settings.logLevel));
+    processSampler.setInterval(std::chrono::milliseconds(settings.sampleIntervalMs));
+}
+
+/**
+ * @brief Stop the loop on SIGINT or SIGTERM so every coroutine unwinds, reload the settings on SIGHUP
+ */
+Task<void> waitForSignals(EventLoop& loop, int signalFileDescriptor, RuntimeConfig& config,
+                          std::function<void(const RuntimeConfig::Settings&)> onReload)
+{
+    while(true)
+    {
+        // Bind the awaited result first, GCC 12 miscompiles a co_await used directly as an if condition
+        bool isSignaled = co_await loop.waitReadable(signalFileDescriptor);
+        if(!isSignaled)
+        {
+            co_return;
+        }
+        // The descriptor is edge-triggered, drain every pending signal
+        signalfd_siginfo signalInfo{};
+        while(sizeof(signalInfo) == read(signalFileDescriptor, &signalInfo, sizeof(signalInfo)))
+        {
+            if(SIGHUP != signalInfo.ssi_signo)
+            {
+                EVENT_INFO("Shutdown signal received.");
+                loop.stop();
+                co_return;
+            }
+            RuntimeConfig::Settings previousSettings = config.get();
+            if(config.load())
+            {
+                onReload(config.get());
+                EVENT_INFO("Configuration reloaded from " << config.getFileName());
+                if(previousSettings.isRestartNeeded(config.get()))
+                {
+                    EVENT_WARNING("Port, receive buffer size and journal durability changes take effect after a restart");
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Write the batched log records periodically so a quiet logger does not hold them
+ */
+Task<void> flushLogsPeriodically(EventLoop& loop, const RuntimeConfig& config)
+{
+    while(true)
+    {
+        // Read every round so a reload changes the interval
+        bool isRunning = co_await loop.sleepFor(std::chrono::milliseconds(config.get().logFlushIntervalMs));
+        if(!isRunning)
+        {
+            break;
+        }
+        Logger::flushAll();
+    }
+}
+
+/**
+ * @brief Stop the loop once a successor takes over, the idle connections stay open for it
+ */
+Task<void> waitForSuccessor(EventLoop& loop, Server& server, RestartHandoff& restartHandoff)
+{
+    bool isRequested = co_await restartHandoff.waitForSuccessor();
+    if(isRequested)
+    {
+        EVENT_INFO("Successor connected, handing off.");
+        server.beginHandoff();
+        loop.stop();
+    }
+}
+
+/**
+ * @brief Print the command line options
+ */
+void printUsage(const char* programName)
+{
+    std::cout << "Usage: " << programName << " [--config <file>] [--capture <file>] [--busy-poll <us>] [--noop-handlers] [--quiet] [--takeover]\n"
+              << "  --config <file>   Read the settings from <file>, reloaded on SIGHUP (default " << CONFIG_FILE << ")\n"
+              << "  --capture <file>  Record the received traffic for the replay tool\n"
+              << "  --busy-poll <us>  Spin up to <us> microseconds before the event loop blocks\n"
+              << "  --noop-handlers   Look up handlers without invoking them, for benchmarks\n"
+              << "  --quiet           Use the production event profile, warnings and errors only\n"
+              << "  --takeover        Take the sockets over from the running server instead of binding\n";
+}
+
+int main(int argc, char* argv[])
+{
+    std::string configFile = CONFIG_FILE;
+    std::string captureFile;
+    bool isNoOpMode = false;
+    bool isTakeover = false;
+    uint32_t busyPollUs = BUSY_POLL_US;
+    EventProfile eventProfile = EVENT_PROFILE;
+    for(int argument = 1; argument < argc; argument++)
+    {
+        std::string option = argv[argument];
+        if(("--config" == option) && ((argument + 1) < argc))
+        {
+            configFile = argv[++argument];
+        }
+        else if(("--capture" == option) && ((argument + 1) < argc))
+        {
+            captureFile = argv[++argument];
+        }
+        else if(("--busy-poll" == option) && ((argument + 1) < argc))
+        {
+            busyPollUs = static_cast<uint32_t>(std::strtoul(argv[++argument], nullptr, 10));
+        }
+        else if("--noop-handlers" == option)
+        {
+            isNoOpMode = true;
+        }
+        else if("--quiet" == option)
+        {
+            eventProfile = EventProfile::PRODUCTION;
+        }
+        else if("--takeover" == option)
+        {
+            isTakeover = true;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
     try {
-        Server server(PORT);
-        PCControl pcControl;
+        // Log batches are written on a crash, the alternate stack belongs to this thread
+        bool isCrashHandlerInstalled = Logger::installCrashHandler();
+        Logger::setBatchedWrites(ENABLE_BATCHED_LOGGING && isCrashHandlerInstalled);
+        // Shutdown and reload signals are delivered through the event loop, block them before any thread starts
+        sigset_t loopSignals;
+        sigemptyset(&loopSignals);
+        sigaddset(&loopSignals, SIGINT);
+        sigaddset(&loopSignals, SIGTERM);
+        sigaddset(&loopSignals, SIGHUP);
+        pthread_sigmask(SIG_BLOCK, &loopSignals, nullptr);
+        int signalFileDescriptor = signalfd(-1, &loopSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+        RequestTracer::setEnabled(ENABLE_REQUEST_TRACING);
+        EventChannel::setProfile(eventProfile);
+        // The compiled-in constants are the defaults of the keys the file leaves out
+        RuntimeConfig::Settings defaultSettings;
+        defaultSettings.port = PORT;
+        defaultSettings.metricsPort = METRICS_PORT;
+        defaultSettings.receiveBufferSize = SERVER_BUFFER_SIZE;
+        defaultSettings.journalDurability = JOURNAL_DURABILITY;
+        defaultSettings.listenBacklog = BACKLOG;
+        defaultSettings.subscriberQueueLimit = SUBSCRIBER_QUEUE_LIMIT;
+        defaultSettings.messageQueueLimit = SERVER_MESSAGE_QUEUE_LIMIT;
+        defaultSettings.eventChannelCapacity = EVENT_CHANNEL_CAPACITY;
+        defaultSettings.eventLevel = (EventProfile::PRODUCTION == eventProfile) ? Logger::Levels::WARNING : Logger::Levels::DEBUG;
+        defaultSettings.logFlushIntervalMs = LOG_FLUSH_INTERVAL_MS;
+        defaultSettings.logSegmentBytes = LOGGER_SEGMENT_SIZE;
+        defaultSettings.sampleIntervalMs = PROCESS_SAMPLE_INTERVAL_MS;
+        RuntimeConfig config(configFile, defaultSettings);
+        if(!config.load())
+        {
+            std::cerr << "Invalid configuration file: " << configFile << std::endl;
+            return 1;
+        }
+        const RuntimeConfig::Settings& settings = config.get();
+        // Sealed log segments are compressed off the request path
+        Logger::setSegmentListener(LogArchive::submit);
+        LogArchive::start();
+        // Status queries are answered from its samples, so it outlives the server
+        ProcessSampler processSampler(std::chrono::milliseconds(settings.sampleIntervalMs));
 
-        std::cout << "Waiting for client connection..." << std::endl;
-        server.acceptClientConnection();
-        std::cout << "Client connected. Starting threads..." << std::endl;
+        EventLoop loop;
+        // Accepted sockets inherit the interval, so it is set before the server starts
+        loop.setBusyPoll(std::chrono::microseconds(busyPollUs));
+        // Clients may subscribe to results, process state and diagnostic events on their connection
+        SubscriptionHub subscriptionHub(loop);
+        EventChannel::setSubscriber([&subscriptionHub](Logger::Levels, const std::string& message)
+        {
+            // The formatted event already names its level
+            if(subscriptionHub.hasSubscribers(Topic::EVENTS))
+            {
+                subscriptionHub.publish(Topic::EVENTS, message);
+            }
+        });
+        // Blocks until the running server stopped and passed its sockets, so there is no moment without a listener
+        RestartHandoff::State takenOverState;
+        if(isTakeover && !RestartHandoff::takeOver(HANDOFF_SOCKET_PATH, takenOverState))
+        {
+            std::cerr << "No running server handed off, starting without takeover" << std::endl;
+        }
+        Server server(loop, settings.port, takenOverState.listeningFileDescriptor, settings.receiveBufferSize);
+        server.attachSubscriptionHub(subscriptionHub);
+        if(ENABLE_UNIX_SOCKET && (-1 == takenOverState.unixfileDescriptor))
+        {
+            // Failures are logged, TCP clients are served either way
+            server.listenOnUnixSocket(UNIX_SOCKET_PATH);
+        }
+        PCControl pcControl;
+        pcControl.setNoOpMode(isNoOpMode);
+        // Binary clients receive the command IDs of the registry in their handshake
+        server.attachCommandRegistry(pcControl);
+        // Only the latest state of a process matters to a subscriber that fell behind
+        pcControl.setProcessStateListener([&subscriptionHub, &processSampler](const std::string& process, pid_t processID, const std::string& state)
+        {
+            if("started" == state)
+            {
+                // Sampled until it exits, the sampler notices that on its own
+                processSampler.track(process, processID);
+            }
+            subscriptionHub.publish(Topic::PROCESS_STATE, process + ' ' + std::to_string(processID) + ' ' + state, process);
+        });
+        server.attachProcessSampler(processSampler);
+        processSampler.start();
+        // Load handler plugins and reload them whenever they change
+        PluginLoader pluginLoader(pcControl, PLUGIN_DIRECTORY);
+        pluginLoader.start();
+        RequestCoalescer coalescer(ENABLE_REQUEST_COALESCING, std::chrono::milliseconds(COALESCING_WINDOW_MS));
+        RequestScheduler scheduler{std::chrono::milliseconds(SCHEDULER_AGING_MS)};
+        // Journal accepted requests and replay the ones a previous run did not complete
+        std::unique_ptr<RequestJournal> journal;
+        if(settings.journalDurability != DurabilityMode::NONE)
+        {
+            journal = std::make_unique<RequestJournal>(JOURNAL_FILE, settings.journalDurability);
+            server.attachJournal(*journal);
+            journal->start();
+            loop.spawn(journal->resumeCommitWaiters(loop));
+        }
+        // Record the received traffic for replay
+        std::unique_ptr<RequestCapture> capture;
+        if(!captureFile.empty())
+        {
+            capture = std::make_unique<RequestCapture>(captureFile);
+            server.attachCapture(*capture);
+        }
+        // Continue the connections and requests of the previous process once journal and capture see them
+        server.adoptHandoff(takenOverState);
+        RestartHandoff restartHandoff(loop);
+        if(ENABLE_RESTART_HANDOFF && restartHandoff.listen(HANDOFF_SOCKET_PATH))
+        {
+            loop.spawn(waitForSuccessor(loop, server, restartHandoff));
+        }
+        // Local clients may skip the sockets for every request
+        std::unique_ptr<SharedMemoryTransport> sharedMemoryTransport;
+        if(ENABLE_SHARED_MEMORY_TRANSPORT)
+        {
+            sharedMemoryTransport = std::make_unique<SharedMemoryTransport>(loop, server);
+            if(sharedMemoryTransport->listen(SHARED_MEMORY_SOCKET_PATH))
+            {
+                loop.spawn(sharedMemoryTransport->acceptChannels());
+            }
+        }
+        // Scrapes read lock-free counters from their own thread
+        Metrics::registerGauge("message_queue_depth", "Requests waiting in the server message queue",
+                               [&server]() { return static_cast<double>(server.getMessageQueue().size()); });
+        Metrics::registerGauge("message_queue_high_water_mark", "Largest number of requests ever waiting in the server message queue",
+                               [&server]() { return static_cast<double>(server.getMessageQueue().getHighWaterMark()); });
+        Metrics::registerGauge("coalesced_requests", "Requests merged into an identical pending request",
+                               [&coalescer]() { return static_cast<double>(coalescer.getCoalescedCount()); });
+        Metrics::registerGauge("logger_dropped_messages", "Log records every logger failed to write to its file",
+                               []() { return static_cast<double>(Logger::getDroppedCount()); });
+        Metrics::registerGauge("logger_filtered_messages", "Log messages every logger filtered out below its level",
+                               []() { return static_cast<double>(Logger::getFilteredCount()); });
+        Metrics::registerGauge("event_channel_dropped_events", "Diagnostic events dropped by the rate limit or capacity",
+                               []() { return static_cast<double>(EventChannel::getDroppedCount()); });
+        // CPU cost of the loop thread, shows what busy polling spends for its latency
+        Metrics::registerGauge("event_loop_cpu_seconds", "CPU time of the event loop thread",
+                               [&loop]() { return loop.getBusyPollStatistics().cpuSeconds; });
+        Metrics::registerGauge("event_loop_spin_seconds", "Time the event loop spent polling without blocking",
+                               [&loop]() { return loop.getBusyPollStatistics().spinSeconds; });
+        Metrics::registerGauge("event_loop_spin_hits", "Event loop spins that found events before blocking",
+                               [&loop]() { return static_cast<double>(loop.getBusyPollStatistics().spinHitCount); });
+        Metrics::registerGauge("event_loop_blocking_waits", "Event loop waits that blocked the thread",
+                               [&loop]() { return static_cast<double>(loop.getBusyPollStatistics().blockingWaitCount); });
+        std::unique_ptr<MetricsServer> metricsServer;
+        if(ENABLE_METRICS)
+        {
+            metricsServer = std::make_unique<MetricsServer>(settings.metricsPort);
+            metricsServer->start();
+        }
 
-        // Create the server thread
-        auto serverThread = std::thread(runServer, std::ref(server), 500);
-        // Wait a bit to ensure server thread is running
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        // Create the app thread
-        auto appThread = std::thread(runApp, std::ref(server), std::ref(pcControl), 1000);
+        // Connection handling and request processing share the event loop
+        loop.spawn(server.acceptClientConnections());
+        loop.spawn(subscriptionHub.run());
+        loop.spawn(runApp(loop, server, pcControl, coalescer, scheduler, journal.get(), subscriptionHub));
+        // Runs on the loop thread that later reloads apply on, the CPU affinity then pins the loop
+        applySettings(settings, loop, server, pcControl, subscriptionHub, processSampler);
+        loop.spawn(waitForSignals(loop, signalFileDescriptor, config,
+                                  [&loop, &server, &pcControl, &subscriptionHub, &processSampler](const RuntimeConfig::Settings& reloadedSettings)
+                                  {
+                                      applySettings(reloadedSettings, loop, server, pcControl, subscriptionHub, processSampler);
+                                  }));
+        if(Logger::isBatchedWritesEnabled())
+        {
+            loop.spawn(flushLogsPeriodically(loop, config));
+        }
+        std::cout << "Waiting for client connections..." << std::endl;
+        // From here on diagnostics are written by the event channel thread
+        EventChannel::start();
+        // Runs until a shutdown signal stopped the loop and every coroutine finished
+        loop.run();
+        loop.closeFileDescriptor(signalFileDescriptor);
+        EventChannel::stop();
+        EventChannel::setSubscriber(nullptr);
+        if(metricsServer)
+        {
+            metricsServer->stop();
+        }
 
-        // Wait for threads to finish (they won't in this case unless there's an error)
-        serverThread.join();
-        appThread.join();
+        if(sharedMemoryTransport)
+        {
+            // Channel threads may still wait on the journal, so they stop first
+            sharedMemoryTransport->stop();
+            sharedMemoryTransport->printStatistics();
+        }
+        loop.printStatistics();
+        config.printStatistics();
+        processSampler.stop();
+        processSampler.printStatistics();
+        // Segments sealed from here on stay plain text until a later run is stopped
+        LogArchive::stop();
+        LogArchive::printStatistics();
+        subscriptionHub.printStatistics();
+        coalescer.printStatistics();
+        scheduler.printStatistics();
+        if(journal)
+        {
+            journal->stop();
+            journal->printStatistics();
+        }
+        if(restartHandoff.isRequested())
+        {
+            // The successor binds the metrics port itself, journal and shared memory sockets are already released
+            metricsServer.reset();
+            RestartHandoff::State handoffState = server.releaseForHandoff();
+            std::vector<Request> scheduledRequests;
+            RequestScheduler::ScheduledRequest scheduledRequest;
+            while(scheduler.pop(scheduledRequest))
+            {
+                scheduledRequests.push_back(std::move(scheduledRequest.request));
+            }
+            // Scheduled requests were received before the ones still queued
+            handoffState.requests.insert(handoffState.requests.begin(), scheduledRequests.begin(), scheduledRequests.end());
+            // With a journal the requests reach the successor through its replay, it only matches them to their connections
+            restartHandoff.handOff(handoffState);
+        }
+        if(RequestTracer::isEnabled())
+        {
+            RequestTracer::exportChromeTrace(TRACE_FILE);
+            RequestTracer::printSummary();
+        }
     } catch (const std::exception& e) {
         std::cerr << "Main thread error: " << e.what() << std::endl;
         return 1;